@@ -30,6 +30,10 @@
 #include "usb.h"    	/* Header file of existing CF control module */
 #endif
 
+#ifdef DRV_FILE
+#include "filedisk.h"	/* Host build disk image file */
+#endif
+
 
 /*-----------------------------------------------------------------------*/
 
@@ -66,6 +70,10 @@ DSTATUS disk_status (
 #ifdef DRV_USB
 	case DEV_USB :
 		return ( usb_disk_status() );
+#endif
+#ifdef DRV_FILE
+	case DEV_FILE :
+		return ( file_disk_status() );
 #endif
 	}
 	return STA_NOINIT;
@@ -98,6 +106,10 @@ DSTATUS disk_initialize (
 #ifdef DRV_USB
 	case DEV_USB :
 		return ( usb_disk_initialize() );
+#endif
+#ifdef DRV_FILE
+	case DEV_FILE :
+		return ( file_disk_initialize() );
 #endif
 	}
 	return STA_NOINIT;
@@ -132,6 +144,10 @@ DRESULT disk_read (
 #ifdef DRV_USB
 	case DEV_USB :
 		return ( usb_disk_read(buff, sector, count) );
+#endif
+#ifdef DRV_FILE
+	case DEV_FILE :
+		return ( file_disk_read(buff, sector, count) );
 #endif
 	}
 	return RES_PARERR;
@@ -167,6 +183,10 @@ DRESULT disk_write (
 #ifdef DRV_USB
 	case DEV_USB :
 		return ( usb_disk_write(buff, sector, count) );
+#endif
+#ifdef DRV_FILE
+	case DEV_FILE :
+		return ( file_disk_write(buff, sector, count) );
 #endif
 	}
 
@@ -202,6 +222,10 @@ DRESULT disk_ioctl (
 #ifdef DRV_USB
     case DEV_MMC :
         return ( usb_disk_ioctl(cmd, buff) );
+#endif
+#ifdef DRV_FILE
+    case DEV_FILE :
+        return ( file_disk_ioctl(cmd, buff) );
 #endif
     }
     return RES_PARERR;
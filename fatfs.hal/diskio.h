@@ -16,6 +16,11 @@ extern "C" {
 #define DEV_CFC     1   /* Example: Map CF card to physical drive 2 */
 #define DEV_RAM     2   /* Example: Map Ramdisk to physical drive 0 */
 #define DEV_USB     3   /* Example: Map USB MSD to physical drive 2 */
+#define DEV_FILE    0   /* Host build: disk image file in place of the SD card */
+
+#if defined(DRV_FILE) && defined(DRV_MMC)
+#error DRV_FILE and DRV_MMC both use drive 0
+#endif
 
 #define _USE_WRITE  1   /* 1: Enable disk_write function */
 #define _USE_IOCTL  1   /* 1: Enable disk_ioctl fucntion */
@@ -26,6 +26,7 @@
 #include "gpib_hal.h"
 #include "gpib_task.h"
 #include "amigo.h"
+#include "latency.h"
 
 #ifdef AMIGO
 
@@ -512,6 +513,8 @@ int amigo_verify(uint16_t sectors)
 /// @brief  Format Disk
 ///
 /// - Refernce: A50.
+/// - Sectors are in logical order on the image so the whole disk is one
+///   fill with one open, see dbf_open_fill().
 ///
 /// @param[in] db: byte to fill sector buffer with)
 ///
@@ -519,16 +522,17 @@ int amigo_verify(uint16_t sectors)
 /// @return 1 on Error,Sets dsj and Amigo_errors
 int amigo_format(uint8_t db)
 {
-
-    DWORD pos;
-    int len;
+    uint32_t size;
     int stat = 0;
 
     AMIGOs->sector = 0;
     AMIGOs->head = 0;
     AMIGOs->cyl = 0;
 
-    memset((void *) gpib_iobuff, db, AMIGOp->GEOMETRY.BYTES_PER_SECTOR);
+    size = (uint32_t) AMIGOp->GEOMETRY.BYTES_PER_SECTOR
+        * AMIGOp->GEOMETRY.SECTORS_PER_TRACK
+        * AMIGOp->GEOMETRY.HEADS
+        * AMIGOp->GEOMETRY.CYLINDERS;
 
 #if SDEBUG
     if(debuglevel & 32)
@@ -536,34 +540,15 @@ int amigo_format(uint8_t db)
     if(debuglevel & 64)
         gpib_timer_elapsed_begin();
 #endif
-    while( 1 )
+    if(dbf_open_fill(AMIGOp->HEADER.NAME, 0, size, db, &AMIGOs->Errors, 1) != (long) size)
     {
-        ///@brief computer logical block
-        pos = amigo_chs_to_logical(AMIGOs, "Format");
-
-        len = dbf_open_write(AMIGOp->HEADER.NAME,
-            pos, gpib_iobuff,AMIGOp->GEOMETRY.BYTES_PER_SECTOR, &AMIGOs->Errors);
-
-        if(len != AMIGOp->GEOMETRY.BYTES_PER_SECTOR)
-        {
-            AMIGOs->Errors |= ERR_WRITE;
-            AMIGOs->dsj = 1;
-            stat = 1;
-            break;
-        }
-
-        ///@brief increment sector/cyl do not display at overflow (expected)
-        if( amigo_increment(NULL) )
-        {
-            // reset sector,head,cyl
-            AMIGOs->sector = 0;
-            AMIGOs->head = 0;
-            AMIGOs->cyl = 0;
-            AMIGOs->dsj = 0;
-            stat = 0;
-            break;
-        }
-
+        AMIGOs->Errors |= ERR_WRITE;
+        AMIGOs->dsj = 1;
+        stat = 1;
+    }
+    else
+    {
+        AMIGOs->dsj = 0;
     }
 #if SDEBUG
     if(debuglevel & 64)
@@ -587,6 +572,7 @@ int amigo_buffered_read()
     uint16_t status;
     int len;
     DWORD pos;
+    lat_t lat;
 
     pos = amigo_chs_to_logical(AMIGOs, "Buffered Read");
 
@@ -595,7 +581,9 @@ int amigo_buffered_read()
         gpib_timer_elapsed_begin();
 #endif
 
+    lat_begin(&lat);
     len = dbf_open_read(AMIGOp->HEADER.NAME, pos, gpib_iobuff, AMIGOp->GEOMETRY.BYTES_PER_SECTOR, &AMIGOs->Errors);
+    lat_end(LAT_DISK, &lat);
 
 #if SDEBUG
     if(debuglevel & 64)
@@ -612,7 +600,9 @@ int amigo_buffered_read()
         gpib_timer_elapsed_begin();
 #endif
     status = EOI_FLAG;
+    lat_begin(&lat);
     len = gpib_write_str(gpib_iobuff, AMIGOp->GEOMETRY.BYTES_PER_SECTOR, &status);
+    lat_end_bytes(LAT_GPIB, &lat, len);
 #if SDEBUG
     if(debuglevel & 128)
         gpib_timer_elapsed_end("GPIB write");
@@ -650,6 +640,7 @@ int amigo_buffered_write()
 {
     uint16_t status;
     int len;
+    lat_t lat;
 
     DWORD pos;
 
@@ -660,7 +651,9 @@ int amigo_buffered_write()
         gpib_timer_elapsed_begin();
 #endif
     status = 0;
+    lat_begin(&lat);
     len = gpib_read_str(gpib_iobuff, AMIGOp->GEOMETRY.BYTES_PER_SECTOR, &status);
+    lat_end_bytes(LAT_GPIB, &lat, len);
 
 #if SDEBUG
     if(debuglevel & 128)
@@ -682,7 +675,9 @@ int amigo_buffered_write()
         gpib_timer_elapsed_begin();
 #endif
 
+    lat_begin(&lat);
     len = dbf_open_write(AMIGOp->HEADER.NAME, pos, gpib_iobuff, AMIGOp->GEOMETRY.BYTES_PER_SECTOR, &AMIGOs->Errors);
+    lat_end(LAT_DISK, &lat);
 
 #if SDEBUG
     if(debuglevel  & 64)
@@ -1315,6 +1310,22 @@ int Amigo_Execute( int secondary )
 }
 
 
+/// @brief  Amigo_Command() with the command phase time added to the latency histograms
+/// @param[in] secondary: command
+/// @return  Amigo_Command() result
+/// @see latency.c
+int amigo_command_phase( int secondary )
+{
+    int ret;
+    lat_t lat;
+
+    lat_begin(&lat);
+    ret = Amigo_Command(secondary);
+    lat_end(LAT_CMD, &lat);
+    return(ret);
+}
+
+
 /// @brief AMIGO Command state processing.
 ///
 /// - Perform Command, Execute or Reporting Phase functions.
@@ -1355,19 +1366,19 @@ int AMIGO_COMMANDS(uint8_t ch)
 
         if(ch == 0x68 && AMIGO_is_MLA(listening) ) // Single byte command
         {
-            return (Amigo_Command(ch) );
+            return (amigo_command_phase(ch) );
         }
         if(ch == 0x69 && AMIGO_is_MLA(listening) ) // Single byte command
         {
-            return (Amigo_Command(ch) );
+            return (amigo_command_phase(ch) );
         }
         if(ch == 0x6a && AMIGO_is_MLA(listening) ) // Single byte command
         {
-            return (Amigo_Command(ch) );
+            return (amigo_command_phase(ch) );
         }
         if(ch == 0x6c && AMIGO_is_MLA(listening) ) // Single byte command
         {
-            return (Amigo_Command(ch) );
+            return (amigo_command_phase(ch) );
         }
         if(ch == 0x70 && AMIGO_is_MTA(talking))
         {
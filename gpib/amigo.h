@@ -59,6 +59,7 @@ int amigo_todo ( uint8_t secondary );
 void amigo_check_unit( uint8_t unit );
 int Amigo_Command ( int secondary );
 int Amigo_Execute ( int secondary );
+int amigo_command_phase ( int secondary );
 int AMIGO_COMMANDS ( uint8_t ch );
 
 
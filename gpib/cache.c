@@ -0,0 +1,661 @@
+/**
+ @file gpib/cache.c
+
+ @brief Disk block cache for HP85 disk emulator project for AVR.
+
+ @par Edit History
+ - [1.0]   [Mike Gore]  Initial revision of file.
+
+ @par Copyright &copy; 2014-2020 Mike Gore, All rights reserved. GPL
+ @see http://github.com/magore/hp85disk
+ @see http://github.com/magore/hp85disk/COPYRIGHT.md for Copyright details
+
+ - Each dbf_open_read() opens the image, walks the FAT cluster chain
+   to the seek position and closes it again - for every 256 byte block.
+ - Here blocks are kept in RAM with LRU replacement, keyed by device and block.
+ - A miss reads up to CACHE_FILL_MAX blocks with one open and seek.
+   - The caller decides how many, see the SS80 read-ahead in ss80.c.
+ - Whole block writes stay in the cache marked dirty - write back.
+   - FatFs then sees runs of adjacent blocks through one open file
+     so each 512 byte SD sector is written once, not once per half.
+   - Dirty blocks are written back when the bus is idle, on device clear,
+     IFC and user abort, and before a read or write that bypasses the cache.
+   - While idle the work is done in short slices, see cache_idle(), so a
+     host that starts a new transaction waits for one slice at most.
+ - A sequential SS80 read leaves a hint, the next blocks are read ahead
+   in an idle slice before the host asks for them.
+   - CACHE_SYNC = 1 in the config file writes them back at the end of every
+     SS80 write so the host sees any error in the report phase.
+   - A write protected card always writes through for the same reason.
+ - With the SS80 journal on, the journal is synced before an image is
+   written and emptied once the image has no dirty blocks, see journal.c.
+ - Build with CACHE_SUPPORT=1, the AVR flash is nearly full.
+ - Use "gpib cache" to display or reset the counters.
+
+*/
+
+
+#include "user_config.h"
+
+#include "defines.h"
+#include "gpib_hal.h"
+#include "gpib.h"
+#include "cache.h"
+#include "journal.h"
+
+#include "posix.h"
+
+///@brief Cache enabled
+uint8_t cache_enable = 1;
+
+///@brief Write back at the end of every SS80 write, CACHE_SYNC in the config file
+uint8_t cache_sync = 0;
+
+#ifdef CACHE_SUPPORT
+///@brief Cache counters
+CacheStatsType cache_stats;
+
+///@brief Cache entries
+static CacheEntryType cache_tab[CACHE_BLOCKS];
+
+///@brief Cache data, allocated on first use
+static uint8_t *cache_data = NULL;
+
+///@brief Allocation failed, do not try again
+static uint8_t cache_failed = 0;
+
+///@brief LRU clock
+static uint32_t cache_clock = 0;
+
+///@brief Read ahead hint for the next idle slice, see cache_hint()
+static void *hint_dev = NULL;
+static char *hint_name = NULL;
+static uint32_t hint_block = 0;
+
+
+/// @brief Allocate the cache data on first use.
+/// @return 1 if the cache can be used, 0 if not
+int cache_init()
+{
+    if(cache_data != NULL)
+        return(1);
+    if(cache_failed)
+        return(0);
+    cache_data = safecalloc(CACHE_BLOCKS * CACHE_BLOCK_SIZE, 1);
+    if(cache_data == NULL)
+    {
+        cache_failed = 1;
+        return(0);
+    }
+    memset(cache_tab, 0, sizeof(cache_tab));
+    return(1);
+}
+
+
+/// @brief Data of a cache entry
+/// @param[in] i: entry index
+/// @return data pointer
+static uint8_t *cache_block(int i)
+{
+    return(cache_data + i * CACHE_BLOCK_SIZE);
+}
+
+
+/// @brief Find a cached block
+/// @param[in] dev: device
+/// @param[in] block: block number
+/// @return entry index or -1
+static int cache_find(void *dev, uint32_t block)
+{
+    int i;
+    for(i=0;i<CACHE_BLOCKS;++i)
+    {
+        if((cache_tab[i].flags & CACHE_VALID) && cache_tab[i].dev == dev && cache_tab[i].block == block)
+            return(i);
+    }
+    return(-1);
+}
+
+
+/// @brief Pick an entry to replace - a free one or the least recently used
+///
+/// - Dirty entries are never replaced, they must be written back first.
+/// @return entry index or -1 if every entry is dirty
+static int cache_victim()
+{
+    int i;
+    int lru = -1;
+
+    for(i=0;i<CACHE_BLOCKS;++i)
+    {
+        if(!(cache_tab[i].flags & CACHE_VALID))
+            return(i);
+        if(cache_tab[i].flags & CACHE_DIRTY)
+            continue;
+        if(lru < 0 || cache_tab[i].age < cache_tab[lru].age)
+            lru = i;
+    }
+    return(lru);
+}
+
+
+/// @brief Count dirty blocks
+/// @param[in] dev: device, NULL for all devices
+/// @return number of dirty blocks
+int cache_dirty(void *dev)
+{
+    int i;
+    int count = 0;
+
+    for(i=0;i<CACHE_BLOCKS;++i)
+    {
+        if((cache_tab[i].flags & CACHE_DIRTY) && (dev == NULL || cache_tab[i].dev == dev))
+            ++count;
+    }
+    return(count);
+}
+
+
+/// @brief Find the dirty block of a device with the lowest block number after block
+/// @param[in] dev: device
+/// @param[in] block: find blocks after this one
+/// @param[in] first: 1 to include block itself
+/// @return entry index or -1
+static int cache_next_dirty(void *dev, uint32_t block, int first)
+{
+    int i;
+    int next = -1;
+
+    for(i=0;i<CACHE_BLOCKS;++i)
+    {
+        if(!(cache_tab[i].flags & CACHE_DIRTY) || cache_tab[i].dev != dev)
+            continue;
+        if(cache_tab[i].block < block || (!first && cache_tab[i].block == block))
+            continue;
+        if(next < 0 || cache_tab[i].block < cache_tab[next].block)
+            next = i;
+    }
+    return(next);
+}
+
+
+/// @brief Write back the dirty blocks of one device with one open
+///
+/// - Blocks go out in block order, we only seek between runs.
+/// - After an error the remaining dirty blocks of the device are dropped.
+/// @param[in] dev: device
+/// @param[in] max: most blocks to write back
+/// @return blocks written back, -1 on error
+static int cache_flush_dev(void *dev, int max)
+{
+    FIL fp;
+    UINT bytes;
+    int rc, i, count;
+    uint32_t next;
+
+    i = cache_next_dirty(dev, 0, 1);
+    if(i < 0)
+    {
+        journal_done(dev);
+        return(0);
+    }
+
+    ///@brief Write-ahead - the journal reaches the card before the image
+    journal_sync(dev);
+
+    cache_stats.flushes++;
+    count = 0;
+    rc = dbf_open(&fp, cache_tab[i].name, FA_OPEN_EXISTING | FA_READ | FA_WRITE);
+    if(rc == FR_OK)
+    {
+        next = 0;
+        while(i >= 0 && count < max)
+        {
+            if(cache_tab[i].block != next)
+                rc = dbf_lseek(&fp, cache_tab[i].block * CACHE_BLOCK_SIZE);
+            if(rc != FR_OK)
+                break;
+            bytes = 0;
+            rc = dbf_write(&fp, cache_block(i), CACHE_BLOCK_SIZE, &bytes);
+            if(rc == FR_OK && bytes != CACHE_BLOCK_SIZE)
+                rc = FR_DENIED;
+            if(rc != FR_OK)
+                break;
+            cache_tab[i].flags &= ~CACHE_DIRTY;
+            cache_stats.flushed++;
+            ++count;
+            next = cache_tab[i].block + 1;
+            i = cache_next_dirty(dev, cache_tab[i].block, 0);
+        }
+        if(dbf_close(&fp) != FR_OK && rc == FR_OK)
+            rc = FR_DISK_ERR;
+    }
+
+    if(rc == FR_OK)
+    {
+        if(i < 0)
+            journal_done(dev);
+        return(count);
+    }
+
+    ///@brief Drop what is left so we do not retry forever
+    count = 0;
+    for(i=0;i<CACHE_BLOCKS;++i)
+    {
+        if((cache_tab[i].flags & CACHE_DIRTY) && cache_tab[i].dev == dev)
+        {
+            cache_tab[i].flags = 0;
+            ++count;
+        }
+    }
+    cache_stats.lost += count;
+    printf("[Cache write back failed, %d blocks lost]\n", count);
+    return(-1);
+}
+
+
+/// @brief Write back dirty blocks
+/// @param[in] dev: device, NULL for all devices
+/// @return 0 on success, -1 on error
+int cache_flush(void *dev)
+{
+    int i;
+    int ret = 0;
+
+    if(dev != NULL)
+        return( cache_flush_dev(dev, CACHE_BLOCKS) < 0 ? -1 : 0 );
+
+    for(i=0;i<CACHE_BLOCKS;++i)
+    {
+        if(cache_tab[i].flags & CACHE_DIRTY)
+        {
+            if(cache_flush_dev(cache_tab[i].dev, CACHE_BLOCKS) < 0)
+                ret = -1;
+        }
+    }
+    return(ret);
+}
+
+
+/// @brief Drop cached blocks
+///
+/// - Used on media change and configuration changes.
+/// - Dirty blocks are dropped, call cache_flush() first to keep them.
+/// @param[in] dev: device, NULL for all devices
+/// @return void
+void cache_invalidate(void *dev)
+{
+    int i;
+    for(i=0;i<CACHE_BLOCKS;++i)
+    {
+        if(dev == NULL || cache_tab[i].dev == dev)
+            cache_tab[i].flags = 0;
+    }
+    if(dev == NULL || hint_dev == dev)
+        hint_dev = NULL;
+}
+
+
+/// @brief Update cached blocks after data was written to the disk
+///
+/// - Whole blocks are copied, partly written blocks are dropped.
+/// - The caller must write back dirty blocks of dev first.
+/// @param[in] dev: device
+/// @param[in] pos: byte position in the image
+/// @param[in] buf: data written
+/// @param[in] size: number of bytes written
+/// @return void
+void cache_update(void *dev, uint32_t pos, uint8_t *buf, int size)
+{
+    uint32_t block;
+    int offset, len, i;
+
+    if(cache_data == NULL)
+        return;
+
+    while(size > 0)
+    {
+        block = pos / CACHE_BLOCK_SIZE;
+        offset = pos % CACHE_BLOCK_SIZE;
+        len = CACHE_BLOCK_SIZE - offset;
+        if(len > size)
+            len = size;
+
+        i = cache_find(dev, block);
+        if(i >= 0)
+        {
+            if(len == CACHE_BLOCK_SIZE)
+                memcpy(cache_block(i), buf, CACHE_BLOCK_SIZE);
+            else
+                cache_tab[i].flags = 0;
+        }
+        pos += len;
+        buf += len;
+        size -= len;
+    }
+}
+
+
+/// @brief Read blocks from the disk into the cache with one open and seek
+///
+/// - Stops early at a block that is already cached or at the end of the image.
+/// @param[in] dev: device
+/// @param[in] name: image file name
+/// @param[in] block: first block
+/// @param[in] count: number of blocks
+/// @param[out] errors: error flags like dbf_open_read()
+/// @return blocks read, -1 if the first block could not be read
+static int cache_fill(void *dev, char *name, uint32_t block, int count, int *errors)
+{
+    FIL fp;
+    UINT bytes;
+    int rc, i, k;
+
+    rc = dbf_open(&fp, name, FA_OPEN_EXISTING | FA_READ);
+    if(rc != FR_OK)
+    {
+        *errors = ERR_DISK | ERR_READ;
+        return(-1);
+    }
+
+    rc = dbf_lseek(&fp, block * CACHE_BLOCK_SIZE);
+    if(rc != FR_OK)
+    {
+        *errors = ERR_SEEK | ERR_READ;
+        dbf_close(&fp);
+        return(-1);
+    }
+
+    cache_stats.fills++;
+    for(k=0;k<count;++k)
+    {
+        if(k && cache_find(dev, block + k) >= 0)
+            break;
+
+        i = cache_victim();
+        if(i < 0)
+            break;
+        cache_tab[i].flags = 0;
+
+        bytes = 0;
+        rc = f_read(&fp, cache_block(i), CACHE_BLOCK_SIZE, &bytes);
+        if(rc != FR_OK || bytes != CACHE_BLOCK_SIZE)
+        {
+            if(k)
+                break;
+            if(rc != FR_OK)
+                put_rc(rc);
+            *errors = ERR_READ;
+            dbf_close(&fp);
+            return(-1);
+        }
+
+        cache_tab[i].dev = dev;
+        cache_tab[i].name = name;
+        cache_tab[i].block = block + k;
+        cache_tab[i].age = ++cache_clock;
+        cache_tab[i].flags = CACHE_VALID;
+        if(k)
+        {
+            cache_tab[i].flags |= CACHE_PREFETCH;
+            cache_stats.prefetched++;
+        }
+    }
+
+    if(dbf_close(&fp) != FR_OK)
+    {
+        *errors = ERR_DISK;
+        return(-1);
+    }
+    return(k);
+}
+
+
+/// @brief Leave a read ahead hint for the next idle slice
+///
+/// - Only the last hint is kept, any cache read or write drops it.
+/// @param[in] dev: device
+/// @param[in] name: image file name
+/// @param[in] pos: byte position the host is expected to read next
+/// @return void
+void cache_hint(void *dev, char *name, uint32_t pos)
+{
+    if(!cache_enable || (pos % CACHE_BLOCK_SIZE) || cache_data == NULL)
+        return;
+    hint_dev = dev;
+    hint_name = name;
+    hint_block = pos / CACHE_BLOCK_SIZE;
+    if(!cache_dirty(NULL))
+        gpib_idle_set(CACHE_PREFETCH_TICKS);
+}
+
+
+/// @brief Do one bounded slice of background work while the bus is idle
+///
+/// - Called from gpib_idle_task(), never from the timer interrupt
+///   because FatFs is not reentrant, the timer only counts down the
+///   idle time, see gpib_idle_set().
+/// - Writes back at most CACHE_IDLE_SLICE dirty blocks with one open.
+/// - With nothing dirty reads ahead at most CACHE_IDLE_SLICE blocks
+///   from the cache_hint() position.
+/// - Each file is closed after the slice so the directory entry and FAT
+///   are up to date on the card.
+/// @return 1 if there may be more work, 0 if there is nothing left
+int cache_idle()
+{
+    int i, n;
+    int errors = 0;
+
+    for(i=0;i<CACHE_BLOCKS;++i)
+    {
+        if(cache_tab[i].flags & CACHE_DIRTY)
+        {
+            n = cache_flush_dev(cache_tab[i].dev, CACHE_IDLE_SLICE);
+            cache_stats.slices++;
+            if(n > 0)
+                cache_stats.idle_flushed += n;
+            return(1);
+        }
+    }
+
+    if(hint_dev == NULL)
+        return(0);
+
+    ///@brief Skip blocks that are already cached
+    for(n=0;n<CACHE_IDLE_SLICE && cache_find(hint_dev, hint_block) >= 0;++n)
+        ++hint_block;
+
+    if(n < CACHE_IDLE_SLICE && cache_victim() >= 0)
+    {
+        n = cache_fill(hint_dev, hint_name, hint_block, CACHE_IDLE_SLICE - n, &errors);
+        if(n > 0)
+        {
+            ///@brief The first block is a guess too
+            i = cache_find(hint_dev, hint_block);
+            if(i >= 0)
+            {
+                cache_tab[i].flags |= CACHE_PREFETCH;
+                cache_stats.prefetched++;
+            }
+            cache_stats.idle_prefetched += n;
+            cache_stats.slices++;
+        }
+    }
+    hint_dev = NULL;
+    return(0);
+}
+
+
+/// @brief Write to a disk image through the cache
+///
+/// - Same result as dbf_open_write().
+/// - Whole aligned blocks stay in the cache until written back.
+/// - Anything else writes the disk, after the dirty blocks of dev.
+/// @param[in] dev: device
+/// @param[in] name: image file name
+/// @param[in] pos: byte position in the image
+/// @param[in] buf: data
+/// @param[in] size: number of bytes
+/// @param[out] errors: error flags
+/// @return bytes written or -1 on error
+int cache_write(void *dev, char *name, uint32_t pos, uint8_t *buf, int size, int *errors)
+{
+    uint32_t block = pos / CACHE_BLOCK_SIZE;
+    int i, len;
+
+    hint_dev = NULL;
+
+    if(!cache_enable || size != CACHE_BLOCK_SIZE || (pos % CACHE_BLOCK_SIZE) || mmc_wp_status() || !cache_init())
+    {
+        if(cache_flush(dev))
+        {
+            *errors = ERR_WRITE;
+            return(-1);
+        }
+        journal_sync(dev);
+        len = dbf_open_write(name, pos, buf, size, errors);
+        if(len == size)
+            cache_update(dev, pos, buf, size);
+        return(len);
+    }
+
+    cache_stats.writes++;
+    i = cache_find(dev, block);
+    if(i >= 0)
+    {
+        if(cache_tab[i].flags & CACHE_DIRTY)
+            cache_stats.rewrites++;
+    }
+    else
+    {
+        i = cache_victim();
+        if(i < 0)
+        {
+            if(cache_flush(NULL))
+            {
+                *errors = ERR_WRITE;
+                return(-1);
+            }
+            i = cache_victim();
+        }
+        cache_tab[i].dev = dev;
+        cache_tab[i].name = name;
+        cache_tab[i].block = block;
+    }
+
+    memcpy(cache_block(i), buf, CACHE_BLOCK_SIZE);
+    cache_tab[i].age = ++cache_clock;
+    cache_tab[i].flags = CACHE_VALID | CACHE_DIRTY;
+
+    ///@brief Restart the idle timer, see gpib_idle_task()
+    gpib_idle_set(CACHE_IDLE_TICKS);
+    return(CACHE_BLOCK_SIZE);
+}
+
+
+/// @brief Read from a disk image through the cache
+///
+/// - Same result as dbf_open_read().
+/// - Only whole aligned blocks are cached, anything else reads the disk.
+/// @param[in] dev: device
+/// @param[in] name: image file name
+/// @param[in] pos: byte position in the image
+/// @param[out] buf: data
+/// @param[in] size: number of bytes
+/// @param[in] fill: blocks to read from the disk on a miss, 1 = no read-ahead
+/// @param[out] errors: error flags
+/// @return bytes read or -1 on error
+int cache_read(void *dev, char *name, uint32_t pos, uint8_t *buf, int size, int fill, int *errors)
+{
+    uint32_t block = pos / CACHE_BLOCK_SIZE;
+    int i;
+
+    hint_dev = NULL;
+    if(!cache_enable || size != CACHE_BLOCK_SIZE || (pos % CACHE_BLOCK_SIZE) || !cache_init())
+    {
+        if(cache_flush(dev))
+        {
+            *errors = ERR_READ;
+            return(-1);
+        }
+        return( dbf_open_read(name, pos, buf, size, errors) );
+    }
+
+    i = cache_find(dev, block);
+    if(i >= 0)
+    {
+        cache_stats.hits++;
+        if(cache_tab[i].flags & CACHE_PREFETCH)
+        {
+            cache_stats.prefetch_hits++;
+            cache_tab[i].flags &= ~CACHE_PREFETCH;
+        }
+    }
+    else
+    {
+        cache_stats.misses++;
+        if(fill < 1)
+            fill = 1;
+        if(fill > CACHE_FILL_MAX)
+            fill = CACHE_FILL_MAX;
+        if(cache_victim() < 0)
+            cache_flush(NULL);
+        if(cache_fill(dev, name, block, fill, errors) < 1)
+            return(-1);
+        i = cache_find(dev, block);
+        if(i < 0)
+            return(-1);
+    }
+
+    cache_tab[i].age = ++cache_clock;
+    memcpy(buf, cache_block(i), CACHE_BLOCK_SIZE);
+    return(CACHE_BLOCK_SIZE);
+}
+
+
+/// @brief Display or reset the cache counters
+/// @param[in] reset: clear the counters
+/// @return void
+void cache_display(int reset)
+{
+    uint32_t total;
+    uint32_t percent = 0;
+
+    if(reset)
+    {
+        memset(&cache_stats, 0, sizeof(cache_stats));
+        return;
+    }
+
+    ///@brief 32 bit math - hits * 100 only while it can not overflow
+    total = cache_stats.hits + cache_stats.misses;
+    if(total >= 0x1000000UL)
+        percent = cache_stats.hits / (total / 100);
+    else if(total)
+        percent = cache_stats.hits * 100 / total;
+    printf("Cache: %s, %d blocks of %d bytes%s\n",
+        cache_enable ? "enabled" : "disabled",
+        CACHE_BLOCKS, CACHE_BLOCK_SIZE,
+        cache_failed ? ", allocation failed" : "");
+    printf("  hits:%lu misses:%lu hit rate:%lu percent\n",
+        (unsigned long) cache_stats.hits,
+        (unsigned long) cache_stats.misses,
+        (unsigned long) percent);
+    printf("  disk reads:%lu read ahead:%lu used:%lu\n",
+        (unsigned long) cache_stats.fills,
+        (unsigned long) cache_stats.prefetched,
+        (unsigned long) cache_stats.prefetch_hits);
+    printf("  writes:%lu rewrites:%lu dirty:%d sync:%d\n",
+        (unsigned long) cache_stats.writes,
+        (unsigned long) cache_stats.rewrites,
+        cache_dirty(NULL), (int) cache_sync);
+    printf("  write backs:%lu blocks:%lu lost:%lu\n",
+        (unsigned long) cache_stats.flushes,
+        (unsigned long) cache_stats.flushed,
+        (unsigned long) cache_stats.lost);
+    printf("  idle slices:%lu written back:%lu read ahead:%lu\n",
+        (unsigned long) cache_stats.slices,
+        (unsigned long) cache_stats.idle_flushed,
+        (unsigned long) cache_stats.idle_prefetched);
+}
+#endif // #ifdef CACHE_SUPPORT
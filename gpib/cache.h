@@ -0,0 +1,107 @@
+/**
+ @file gpib/cache.h
+
+ @brief Disk block cache for HP85 disk emulator project for AVR.
+
+ @par Edit History
+ - [1.0]   [Mike Gore]  Initial revision of file.
+
+ @par Copyright &copy; 2014-2020 Mike Gore, All rights reserved. GPL
+ @see http://github.com/magore/hp85disk
+ @see http://github.com/magore/hp85disk/COPYRIGHT.md for Copyright details
+
+*/
+
+#ifndef _CACHE_H_
+#define _CACHE_H_
+
+///@brief Cache block size - one SS80 block
+#define CACHE_BLOCK_SIZE    256
+
+///@brief Number of cached blocks - AVR RAM is small
+#ifndef CACHE_BLOCKS
+#define CACHE_BLOCKS        8
+#endif
+
+///@brief Most blocks read from the disk on one miss - read-ahead included
+#define CACHE_FILL_MAX      (CACHE_BLOCKS/2)
+
+///@brief Write back dirty blocks after the bus has been idle this long
+#define CACHE_IDLE_MS       200
+#define CACHE_IDLE_TICKS    ((CACHE_IDLE_MS * 1000L) / GPIB_TASK_TIC_US)
+
+///@brief Read ahead of a sequential SS80 read after the bus has been idle this long
+#define CACHE_PREFETCH_MS    10
+#define CACHE_PREFETCH_TICKS ((CACHE_PREFETCH_MS * 1000L) / GPIB_TASK_TIC_US)
+
+///@brief Most blocks written back or read ahead in one idle time slice
+/// - The bus waits for the slice, so it is kept short, see cache_idle().
+#define CACHE_IDLE_SLICE    CACHE_FILL_MAX
+
+///@brief Ticks between idle time slices - the bus is polled in between
+#define CACHE_SLICE_TICKS   1
+
+///@brief Cache entry flags
+#define CACHE_VALID         0x01    ///< data is valid
+#define CACHE_PREFETCH      0x02    ///< read ahead and not used yet
+#define CACHE_DIRTY         0x04    ///< written by the host, not on the disk yet
+
+///@brief One cached block
+typedef struct
+{
+    void *dev;          ///< owner device, SS80p
+    char *name;         ///< image file name, for write back
+    uint32_t block;     ///< block number in the image
+    uint32_t age;       ///< last use, for LRU replacement
+    uint8_t flags;      ///< CACHE_VALID, CACHE_PREFETCH, CACHE_DIRTY
+} CacheEntryType;
+
+///@brief Cache counters
+typedef struct
+{
+    uint32_t hits;          ///< blocks found in the cache
+    uint32_t misses;        ///< blocks read from the disk
+    uint32_t fills;         ///< disk reads, each one open and seek
+    uint32_t prefetched;    ///< blocks read ahead
+    uint32_t prefetch_hits; ///< read ahead blocks that were used
+    uint32_t writes;        ///< blocks written by the host
+    uint32_t rewrites;      ///< writes to a block that was still dirty
+    uint32_t flushes;       ///< write backs, each one open
+    uint32_t flushed;       ///< blocks written back
+    uint32_t lost;          ///< dirty blocks dropped after a write back error
+    uint32_t slices;        ///< idle time slices that did some work
+    uint32_t idle_flushed;  ///< blocks written back in idle time slices
+    uint32_t idle_prefetched; ///< blocks read ahead in idle time slices
+} CacheStatsType;
+
+extern uint8_t cache_enable;
+extern uint8_t cache_sync;
+extern CacheStatsType cache_stats;
+
+#ifndef CACHE_SUPPORT
+///@brief Not built - SS80 reads and writes go straight to the image
+#define cache_invalidate(dev)                           ((void) (dev))
+#define cache_update(dev,pos,buf,size)                  ((void) (dev))
+#define cache_hint(dev,name,pos)                        ((void) (dev))
+#define cache_write(dev,name,pos,buf,size,errors)       dbf_open_write(name,pos,buf,size,errors)
+#define cache_read(dev,name,pos,buf,size,fill,errors)   ((void) (fill), dbf_open_read(name,pos,buf,size,errors))
+static inline int cache_dirty(void *dev) { return(0); }
+static inline int cache_flush(void *dev) { return(0); }
+static inline int cache_idle(void) { return(0); }
+#endif
+
+#ifdef CACHE_SUPPORT
+/* cache.c */
+int cache_init ( void );
+void cache_invalidate ( void *dev );
+void cache_update ( void *dev , uint32_t pos , uint8_t *buf , int size );
+int cache_dirty ( void *dev );
+int cache_flush ( void *dev );
+void cache_hint ( void *dev , char *name , uint32_t pos );
+int cache_idle ( void );
+int cache_write ( void *dev , char *name , uint32_t pos , uint8_t *buf , int size , int *errors );
+int cache_read ( void *dev , char *name , uint32_t pos , uint8_t *buf , int size , int fill , int *errors );
+void cache_display ( int reset );
+#endif
+
+#endif  // #ifndef _CACHE_H_
@@ -32,10 +32,11 @@
 /// Stops sending with EOI
 /// @param[in] from:    GPIB talker
 /// @param[in] to:      GPIB listener
+/// @param[in] sec:     secondary address sent after the listener, 0 for none
 /// @param[in] str: string to send
 /// @param[in] len: number of bytes to send (if 0 then length of string)
 /// @return  number of bytes sent
-int controller_send_str(uint8_t from, uint8_t to, char *str, int len)
+int controller_send_str(uint8_t from, uint8_t to, uint8_t sec, char *str, int len)
 {
     uint16_t status = 0;
     int size;
@@ -47,6 +48,8 @@ int controller_send_str(uint8_t from, uint8_t to, char *str, int len)
 
     gpib_write_byte(0x40 | from | ATN_FLAG);// GPIB talker
     gpib_write_byte(0x20 | to | ATN_FLAG);  // GPIB listener
+    if(sec)
+        gpib_write_byte(sec | ATN_FLAG);    // GPIB listener secondary
 
     status = EOI_FLAG;
     size = gpib_write_str((uint8_t *)str, len, &status);
@@ -58,12 +61,15 @@ int controller_send_str(uint8_t from, uint8_t to, char *str, int len)
 
 /// @brief  Controller Mode read ASCII string
 /// Stops reading at EOI
+/// - The string is terminated, so read binary data with len one more
+///   than the number of bytes expected.
 /// @param[in] from:    GPIB talker
 /// @param[in] to:      GPIB listener
+/// @param[in] sec:     secondary address sent after the talker, 0 for none
 /// @param[in] str: string to read
 /// @param[in] len: maximum number of bytes to read
 /// @return  number of bytes read
-int controller_read_str(uint8_t from, uint8_t to, char *str, int len)
+int controller_read_str(uint8_t from, uint8_t to, uint8_t sec, char *str, int len)
 {
     uint16_t status;
     int size;
@@ -71,8 +77,10 @@ int controller_read_str(uint8_t from, uint8_t to, char *str, int len)
     gpib_write_byte(0x5f | ATN_FLAG);   // untalk
     gpib_write_byte(0x3f | ATN_FLAG);   // unlisten
 
-    gpib_write_byte(0x40 | from | ATN_FLAG);    // GPIB talker
     gpib_write_byte(0x20 | to | ATN_FLAG);      // GPIB listener
+    gpib_write_byte(0x40 | from | ATN_FLAG);    // GPIB talker
+    if(sec)
+        gpib_write_byte(sec | ATN_FLAG);        // GPIB talker secondary
 
     status = EOI_FLAG;
     size = gpib_read_str((uint8_t *)str,len, &status);
@@ -127,6 +135,8 @@ void controller_ifc()
     delayms(200);
     GPIB_PIN_FLOAT(IFC);
     delayms(200);
+    ///@brief Our own IFC must not abort the next transfer
+    gpib_event_clear(GPIB_EV_IFC);
     gpib_write_byte(0x5f | ATN_FLAG);   // untalk
     gpib_write_byte(0x3f | ATN_FLAG);   // unlisten
 }
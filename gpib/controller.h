@@ -21,8 +21,8 @@
 #include <user_config.h>
 
 /* controller.c */
-int controller_send_str ( uint8_t from , uint8_t to , char *str , int len );
-int controller_read_str ( uint8_t from , uint8_t to , char *str , int len );
+int controller_send_str ( uint8_t from , uint8_t to , uint8_t sec , char *str , int len );
+int controller_read_str ( uint8_t from , uint8_t to , uint8_t sec , char *str , int len );
 int controller_read_trace ( uint8_t from , uint8_t to );
 void controller_ifc ( void );
 
@@ -85,6 +85,10 @@ typedef struct stat stat_t;
 #define ERR_GPIB   0b00100000   //< GPIB Error
 #define ERR_UNIT   0b01000000   //< Unit number Error
 #define ERR_VOLUME 0b10000000   //< Volume number Error
+#define ERR_OPCODE   0b0000000100000000 //< Illegal Opcode
+#define ERR_SEQUENCE 0b0000001000000000 //< Message Sequence
+#define ERR_LENGTH   0b0000010000000000 //< Message Length
+#define ERR_PARAM    0b0000100000000000 //< Parameter Bounds
 
 // =============================================
 ///@brief Fault bit and Message type
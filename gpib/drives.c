@@ -18,6 +18,10 @@
 #include "gpib_task.h"
 #include "amigo.h"
 #include "ss80.h"
+#include "printer.h"
+#include "latency.h"
+#include "cache.h"
+#include "journal.h"
 #include <time.h>
 #include "lifutils.h"
 
@@ -31,6 +35,13 @@ static int stack_p[MAX_STACK];
 
 DeviceType Devices[MAX_DEVICES];
 
+///@brief SS80_TUNE in the config file - rewrite the describe timing, see tune_drives()
+uint8_t ss80_tune = 0;
+
+///@brief Devices[] index by type and GPIB address, -1 if none
+/// Rebuilt by device_table_update() whenever Devices[] changes
+int8_t DeviceTable[DEVICE_TABLE_TYPES][DEVICE_TABLE_ADDRESSES];
+
 ///@brief Active Printer Device
 PRINTERDeviceType *PRINTERp = NULL;
 
@@ -309,15 +320,52 @@ int find_free()
     return(find_type(NO_TYPE));
 }
 
+///@brief Rebuild the address table from Devices[]
+/// Called after Devices[] is changed by the config file or the defaults
+/// The first device with a matching type and address wins, as before
+/// Devices are checked here once and get their command handler, so
+/// device_activate() and GPIB_COMMANDS() need no further tests
+///@return void
+void device_table_update()
+{
+    int i;
+    int type, address;
+
+    memset(DeviceTable, 0xff, sizeof(DeviceTable));
+
+    for(i=MAX_DEVICES-1;i>=0;--i)
+    {
+        type = Devices[i].TYPE;
+        address = Devices[i].ADDRESS;
+        Devices[i].handler = NULL;
+        if(type == NO_TYPE || type >= DEVICE_TABLE_TYPES || address > 30)
+            continue;
+        if(Devices[i].dev == NULL)
+            continue;
+        if(type != PRINTER_TYPE && Devices[i].state == NULL)
+            continue;
+        if(type == SS80_TYPE)
+            Devices[i].handler = SS80_COMMANDS;
+#ifdef AMIGO
+        if(type == AMIGO_TYPE)
+            Devices[i].handler = AMIGO_COMMANDS;
+#endif
+        if(type == PRINTER_TYPE)
+            Devices[i].handler = PRINTER_COMMANDS;
+        if(Devices[i].handler == NULL)
+            continue;
+        DeviceTable[type][address] = i;
+    }
+}
+
 ///@brief Find a device with matching type AND address
+/// Called for every GPIB command byte so we use the address table
 ///@param type: disk type
 ///@param address: GPIB device address 0 based
 ///@param base: BASE_MLA,BASE_MTA or BASE_MSA address range
 ///@return index of Devices[] or -1 if not found
 int find_device(int type, int address, int base)
 {
-    int i;
-
     ///@skip Only interested in device addresses
     if(address < BASE_MLA || address >(BASE_MSA+30))
         return(-1);
@@ -326,16 +374,71 @@ int find_device(int type, int address, int base)
     if(address < base || address > (base+30))
         return(-1);
 
+    if(type <= NO_TYPE || type >= DEVICE_TABLE_TYPES)
+        return(-1);
+
     ///@brief convert to device address
-    address -= base;
+    return( DeviceTable[type][address - base] );
+}
 
-    ///@brief search for device address
-    for(i=0;i<MAX_DEVICES;++i)
+///@brief Find the device addressed by a GPIB command byte, any type
+/// Types are tried in the order GPIB_COMMANDS() always used: AMIGO, SS80, PRINTER
+///@param address: GPIB listen, talk or secondary address
+///@param base: BASE_MLA,BASE_MTA or BASE_MSA address range
+///@return index of Devices[] or -1 if not found
+int find_addressed(int address, int base)
+{
+    int index = -1;
+
+#ifdef AMIGO
+    index = find_device(AMIGO_TYPE, address, base);
+#endif
+    if(index == -1)
+        index = find_device(SS80_TYPE, address, base);
+    if(index == -1)
+        index = find_device(PRINTER_TYPE, address, base);
+    return(index);
+}
+
+///@brief Set the active device pointers of a device in the address table
+/// The device was checked by device_table_update()
+///@param index: Devices[] index from find_device() or find_addressed()
+///@return void
+void device_activate(int index)
+{
+    DeviceType *d = &Devices[index];
+
+    LATp = (LatencyType *) d->lat;
+    switch(d->TYPE)
     {
-        if(Devices[i].TYPE == type && Devices[i].ADDRESS == address)
-            return(i);
+        case SS80_TYPE:
+            SS80p = (SS80DiskType *) d->dev;
+            SS80s = (SS80StateType *) d->state;
+            break;
+#ifdef AMIGO
+        case AMIGO_TYPE:
+            AMIGOp = (AMIGODiskType *) d->dev;
+            AMIGOs = (AMIGOStateType *) d->state;
+            break;
+#endif
+        case PRINTER_TYPE:
+            PRINTERp = (PRINTERDeviceType *) d->dev;
+            break;
     }
-    return(-1);
+}
+
+///@brief Is a device of this type addressed - if so make it the active device
+///@param type: device type
+///@param address: GPIB listen, talk or secondary address
+///@param base: BASE_MLA,BASE_MTA or BASE_MSA address range
+///@return 1 if addressed or 0
+int device_addressed(int type, int address, int base)
+{
+    int index = find_device(type, address, base);
+    if(index == -1)
+        return(0);
+    device_activate(index);
+    return(1);
 }
 
 ///@brief Set the Active disk or device pointers
@@ -386,6 +489,8 @@ int set_active_device(int index)
         return(0);
     }
 
+    LATp = (LatencyType *) Devices[index].lat;
+
     if(type == PRINTER_TYPE)
     {
         PRINTERp = (PRINTERDeviceType *) Devices[index].dev;
@@ -458,6 +563,7 @@ void SS80_Set_Defaults(int index)
 	SS80p->UNIT.ACCESS_TIME				= SS80DEFAULTp->UNIT.ACCESS_TIME;
 	SS80p->UNIT.MAXIMUM_INTERLEAVE		= SS80DEFAULTp->UNIT.MAXIMUM_INTERLEAVE;
 	SS80p->UNIT.FIXED_VOLUMES			= SS80DEFAULTp->UNIT.FIXED_VOLUMES;
+	SS80p->UNIT.REMOVABLE_VOLUMES		= SS80DEFAULTp->UNIT.REMOVABLE_VOLUMES;
 
 	SS80p->VOLUME.MAX_CYLINDER			= SS80DEFAULTp->VOLUME.MAX_CYLINDER;
 	SS80p->VOLUME.MAX_HEAD				= SS80DEFAULTp->VOLUME.MAX_HEAD;
@@ -497,6 +603,7 @@ int alloc_device(int type)
             Devices[ind].TYPE = type;
             Devices[ind].dev = safecalloc(sizeof(SS80DiskType)+7,1);
             Devices[ind].state = safecalloc(sizeof(SS80StateType)+7,1);
+            Devices[ind].lat = lat_alloc();
             index = ind;
 			SS80_Set_Defaults(index);	// Set any defaults we may have
             break;
@@ -505,6 +612,7 @@ int alloc_device(int type)
             Devices[ind].TYPE = type;
             Devices[ind].dev = safecalloc(sizeof(AMIGODiskType)+7,1);
             Devices[ind].state = safecalloc(sizeof(AMIGOStateType)+7,1);
+            Devices[ind].lat = lat_alloc();
             index = ind;
             break;
 #endif
@@ -538,7 +646,9 @@ void init_Devices()
         memset(Devices[i].model, 0, sizeof(Devices[i].model) );
         Devices[i].dev = NULL;
         Devices[i].state = NULL;
+        Devices[i].lat = NULL;
     }
+    device_table_update();
 }
 
 /// ===============================================
@@ -647,6 +757,7 @@ void set_Config_Defaults()
             Devices[index].PPR = SS80DiskDefault.HEADER.PPR;
             Devices[index].dev = (void *)&SS80DiskDefault;
             Devices[index].state = safecalloc(sizeof(SS80StateType)+7,1);
+            Devices[index].lat = lat_alloc();
         }
     }
 #ifdef AMIGO
@@ -664,6 +775,7 @@ void set_Config_Defaults()
             Devices[index].PPR = AMIGODiskDefault.HEADER.PPR;
             Devices[index].dev = (void *) &AMIGODiskDefault;
             Devices[index].state = safecalloc(sizeof(AMIGOStateType)+7,1);
+            Devices[index].lat = lat_alloc();
         }
     }
 #endif //#ifdef AMIGO
@@ -684,6 +796,7 @@ void set_Config_Defaults()
     }
 #endif // SET_DEFAULTS
 
+    device_table_update();
 }
 
 /// ===============================================
@@ -756,13 +869,74 @@ void hpdir_set_parameters(int index, char *model)
 		hpdir_set_device(index);
 }
 
+/// ===============================================
+/// @brief Check the units and volumes of an SS80 device
+///
+/// - MEDIA[0] is unit 0 volume 0 from the HEADER and VOLUME sections.
+/// - Drops bad or duplicate MEDIA sections.
+/// - Sets UNITS_INSTALLED and the multi-unit controller type to match.
+/// @param[in] SS80p: SS80 device
+/// @return void
+void SS80_Post_Media(SS80DiskType *SS80p)
+{
+    int i, j, count;
+    SS80MediaType *m;
+    uint16_t units = 0;
+
+    SS80p->MEDIA[0].UNIT_NUMBER = 0;
+    SS80p->MEDIA[0].VOLUME_NUMBER = 0;
+    SS80p->MEDIA[0].NAME = SS80p->HEADER.NAME;
+    SS80p->MEDIA[0].MAX_BLOCK_NUMBER = SS80p->VOLUME.MAX_BLOCK_NUMBER;
+
+    count = 1;
+    for(i=1;i<SS80p->MEDIA_COUNT;++i)
+    {
+        m = &SS80p->MEDIA[i];
+        if(m->NAME == NULL || m->UNIT_NUMBER >= SS80_MAX_UNITS || m->VOLUME_NUMBER >= SS80_MAX_VOLUMES)
+        {
+            printf("SS80 %02d MEDIA unit:%d volume:%d skipped - needs a FILE, unit 0..14 and volume 0..7\n",
+                (int) SS80p->HEADER.ADDRESS, (int) m->UNIT_NUMBER, (int) m->VOLUME_NUMBER);
+            continue;
+        }
+        for(j=0;j<count;++j)
+        {
+            if(SS80p->MEDIA[j].UNIT_NUMBER == m->UNIT_NUMBER && SS80p->MEDIA[j].VOLUME_NUMBER == m->VOLUME_NUMBER)
+                break;
+        }
+        if(j < count)
+        {
+            printf("SS80 %02d MEDIA unit:%d volume:%d skipped - defined twice\n",
+                (int) SS80p->HEADER.ADDRESS, (int) m->UNIT_NUMBER, (int) m->VOLUME_NUMBER);
+            continue;
+        }
+        if(!m->MAX_BLOCK_NUMBER)
+            m->MAX_BLOCK_NUMBER = SS80p->VOLUME.MAX_BLOCK_NUMBER;
+        SS80p->MEDIA[count++] = *m;
+    }
+    SS80p->MEDIA_COUNT = count;
+
+    for(i=0;i<count;++i)
+        units |= (1 << SS80p->MEDIA[i].UNIT_NUMBER);
+    SS80p->CONTROLLER.UNITS_INSTALLED = 0x8000 | units;
+
+    ///@brief 4 = SS/80 single unit, 5 = SS/80 multi-unit controller
+    if((units & ~1) && SS80p->CONTROLLER.TYPE == 4)
+        SS80p->CONTROLLER.TYPE = 5;
+}
+
+
 /// ===============================================
 /// @brief Post Process COnfiguration file after reading
-/// @return  void
-void Post_Config()
+///
+/// - Rejects inconsistent geometry once here instead of on every request.
+/// - Packs the SS80 describe and the identify bytes.
+/// @return  number of errors
+int Post_Config()
 {
     int i;
+    int errors = 0;
     long sectors;
+    uint32_t chs;
 
     ///@brief Active SS80 Device
     SS80DiskType *SS80p = NULL;
@@ -782,11 +956,43 @@ void Post_Config()
             SS80p= (SS80DiskType *)Devices[i].dev;
 			if( SS80p->UNIT.BYTES_PER_BLOCK != 256)
 			{
-				// SS80p->UNIT.BYTES_PER_BLOCK = 256;
+				SS80p->UNIT.BYTES_PER_BLOCK = 256;
 				printf("Warning: %s BYTES_PER_BLOCK != 256, Adjusting to 256\n", Devices[i].model);
+				++errors;
+			}
+			///@brief CHS is optional, all 0 means single vector only
+			/// otherwise (V1-V3+1)(V4+1)(V5-V6+1) must be V7-V12+1
+			if(SS80p->VOLUME.MAX_CYLINDER || SS80p->VOLUME.MAX_HEAD || SS80p->VOLUME.MAX_SECTOR)
+			{
+				chs = (SS80p->VOLUME.MAX_CYLINDER+1)
+					* (SS80p->VOLUME.MAX_HEAD+1)
+					* (SS80p->VOLUME.MAX_SECTOR+1);
+				if(chs != SS80p->VOLUME.MAX_BLOCK_NUMBER+1)
+				{
+					printf("Warning: %s CHS blocks %lu != MAX_BLOCK_NUMBER+1 %lu, using single vector only\n", 
+						Devices[i].model, (unsigned long) chs, (unsigned long) SS80p->VOLUME.MAX_BLOCK_NUMBER+1);
+					SS80p->VOLUME.MAX_CYLINDER = 0;
+					SS80p->VOLUME.MAX_HEAD = 0;
+					SS80p->VOLUME.MAX_SECTOR = 0;
+					++errors;
+				}
+			}
+			if(!SS80p->UNIT.FIXED_VOLUMES && !SS80p->UNIT.REMOVABLE_VOLUMES)
+			{
+				SS80p->UNIT.FIXED_VOLUMES = 1;
+				printf("Warning: %s has no FIXED_VOLUMES or REMOVABLE_VOLUMES, using FIXED_VOLUMES\n", Devices[i].model);
+				++errors;
+			}
+			if(SS80p->VOLUME.MAX_BLOCK_NUMBER == 0)
+			{
+				printf("Warning: %s MAX_BLOCK_NUMBER is 0\n", Devices[i].model);
+				++errors;
 			}
 			sectors = SS80p->VOLUME.MAX_BLOCK_NUMBER+1;
 			Devices[i].BLOCKS = sectors;
+			SS80_Post_Media(SS80p);
+			SS80_Describe_Pack(SS80p);
+			V2B_MSB(SS80p->CONFIG.IDENTIFY,0,2,SS80p->CONFIG.ID);
         } // SS80_TYPE
 
 #ifdef AMIGO
@@ -801,10 +1007,19 @@ void Post_Config()
 			sectors = AMIGOp->GEOMETRY.SECTORS_PER_TRACK
 				 * AMIGOp->GEOMETRY.HEADS
 				 * AMIGOp->GEOMETRY.CYLINDERS;
+			if(sectors <= 0)
+			{
+				printf("Warning: %s SECTORS_PER_TRACK, HEADS and CYLINDERS must not be 0\n", Devices[i].model);
+				++errors;
+			}
 			Devices[i].BLOCKS = sectors;
+			V2B_MSB(AMIGOp->CONFIG.IDENTIFY,0,2,AMIGOp->CONFIG.ID);
         } 
 #endif // #ifdef AMIGO
     }
+
+    device_table_update();
+    return(errors);
 }
 
 typedef union {
@@ -832,6 +1047,8 @@ int Read_Config(char *name)
     PRINTERDeviceType *PRINTERp = NULL;
     ///@brief SS80 Device
     SS80DiskType *SS80p = NULL;
+    ///@brief SS80 unit and volume in a MEDIA section
+    SS80MediaType *media = NULL;
 
 #ifdef AMIGO
     ///@brief AMIGO Device
@@ -856,6 +1073,7 @@ int Read_Config(char *name)
         perror("Read_Config - open");
         printf("Read_Config: open(%s) failed\n", name);
         set_Config_Defaults();
+        errors += Post_Config();
         return(errors);
     }
 
@@ -958,6 +1176,22 @@ int Read_Config(char *name)
             {
 				debuglevel = val.w;
             }
+            else if( MATCHI (token,"CACHE_SYNC") )
+            {
+				cache_sync = val.b;
+            }
+            else if( MATCHI (token,"SS80_TUNE") )
+            {
+				ss80_tune = val.b;
+            }
+            else if( MATCHI (token,"JOURNAL") )
+            {
+				journal_enable = val.b;
+            }
+            else if( MATCHI (token,"JOURNAL_GROUP") )
+            {
+				journal_group = val.b ? val.b : 1;
+            }
             else if( MATCHI (token,"PRINTER_DEFAULT_ADDRESS") )
             {
                 //FIXME REMOVE from config
@@ -1031,6 +1265,24 @@ int Read_Config(char *name)
                 push_state(state);
                 state = SS80_VOLUME;
             }
+            else if( MATCHI (token,"MEDIA") )
+            {
+                push_state(state);
+                state = SS80_MEDIA;
+                ///@brief MEDIA[0] is unit 0 volume 0, see SS80_Post_Media()
+                if(SS80p->MEDIA_COUNT == 0)
+                    SS80p->MEDIA_COUNT = 1;
+                if(SS80p->MEDIA_COUNT < SS80_MAX_MEDIA)
+                {
+                    media = &SS80p->MEDIA[SS80p->MEDIA_COUNT++];
+                }
+                else
+                {
+                    media = NULL;
+                    printf("SS80 MEDIA more than %d images at line:%d\n", SS80_MAX_MEDIA, lines);
+                    ++errors;
+                }
+            }
             else
             {
                 printf("Unexpected SS80 START token: %s, at line:%d\n", str,lines);
@@ -1209,6 +1461,34 @@ int Read_Config(char *name)
             }
             break;
 
+        case SS80_MEDIA:
+            if(media == NULL)
+            {
+                // Too many MEDIA sections, already reported
+            }
+            else if( MATCHI (token,"UNIT_NUMBER") )
+            {
+                media->UNIT_NUMBER = val.b;
+            }
+            else if( MATCHI (token,"VOLUME_NUMBER") )
+            {
+                media->VOLUME_NUMBER = val.b;
+            }
+            else if( MATCHI (token,"FILE") )
+            {
+                media->NAME = stralloc(arg);
+            }
+            else if( MATCHI (token,"MAX_BLOCK_NUMBER") )
+            {
+                media->MAX_BLOCK_NUMBER = val.l;
+            }
+            else
+            {
+                printf("Unexpected SS80 MEDIA token: %s, at line:%d\n", token,lines);
+                ++errors;
+            }
+            break;
+
 #ifdef AMIGO
         case AMIGO_STATE:
             if( MATCHI (token,"HEADER") )
@@ -1339,7 +1619,7 @@ int Read_Config(char *name)
     }
 
 	// Post process device values
-	Post_Config();
+	errors += Post_Config();
 
     return(errors);
 }
@@ -1420,7 +1700,7 @@ void display_Addresses()
 /// @return  void
 void display_Config()
 {
-    int i;
+    int i, j;
     ///@brief Active Printer Device
     PRINTERDeviceType *PRINTERp = NULL;
     ///@brief Active SS80 Device
@@ -1478,6 +1758,15 @@ void display_Config()
                 print_var("INTERLEAVE", (uint32_t)SS80p->VOLUME.INTERLEAVE);
                 print_var("# BLOCKS", (uint32_t)SS80p->VOLUME.MAX_BLOCK_NUMBER+1);
 			printf("  END\n");
+            for(j=1;j<SS80p->MEDIA_COUNT;++j)
+            {
+            printf("  MEDIA\n");
+                print_var("UNIT_NUMBER", (uint32_t)SS80p->MEDIA[j].UNIT_NUMBER);
+                print_var("VOLUME_NUMBER", (uint32_t)SS80p->MEDIA[j].VOLUME_NUMBER);
+                print_str("FILE", SS80p->MEDIA[j].NAME);
+                print_var("MAX_BLOCK_NUMBER", (uint32_t)SS80p->MEDIA[j].MAX_BLOCK_NUMBER);
+			printf("  END\n");
+            }
         } // SS80_TYPE
 
 #ifdef AMIGO
@@ -1526,7 +1815,7 @@ void display_Config()
 /// @return  void
 void format_drives()
 {
-    int i;
+    int i, j;
     struct stat st;
     long sectors;
     char label[32];
@@ -1550,29 +1839,35 @@ void format_drives()
         {
             SS80p= (SS80DiskType *)Devices[i].dev;
 
-            if(stat(SS80p->HEADER.NAME, &st) == -1) 
+            ///@brief Every unit and volume has its own image, see SS80_Post_Media()
+            for(j=0;j<SS80p->MEDIA_COUNT;++j)
             {
-                if( SS80p->UNIT.BYTES_PER_BLOCK != 256)
+                char *name = SS80p->MEDIA[j].NAME;
+
+                if(stat(name, &st) == -1) 
                 {
-                    printf("Can not use non 256 byte sectors\n");
-                    continue;
-                }
-                //SS80p->VOLUME.MAX_CYLINDER;
-                //SS80p->VOLUME.MAX_HEAD;
-                //SS80p->VOLUME.MAX_SECTOR;
-                sectors = Devices[i].BLOCKS;
-                sprintf(label,"SS80-%d", ss80);
+                    if( SS80p->UNIT.BYTES_PER_BLOCK != 256)
+                    {
+                        printf("Can not use non 256 byte sectors\n");
+                        break;
+                    }
+                    //SS80p->VOLUME.MAX_CYLINDER;
+                    //SS80p->VOLUME.MAX_HEAD;
+                    //SS80p->VOLUME.MAX_SECTOR;
+                    sectors = SS80p->MEDIA[j].MAX_BLOCK_NUMBER+1;
+                    sprintf(label,"SS80-%d", ss80);
 #ifdef LIF_SUPPORT
-                lif_create_image(SS80p->HEADER.NAME,
-                    label,
-                    lif_dir_count(sectors), 
-                    sectors);
+                    lif_create_image(name,
+                        label,
+                        lif_dir_count(sectors), 
+                        sectors);
 #else
-                printf("please create a SS80 LIF image with %ld sectors and 128 directory sectors\n", sectors);
+                    printf("please create a SS80 LIF image with %ld sectors and 128 directory sectors\n", sectors);
 #endif
 
+                }
+                ss80++;
             }
-            ss80++;
         } // SS80_TYPE
 
 #ifdef AMIGO
@@ -1603,3 +1898,65 @@ void format_drives()
     }
     printf("\n");
 }
+
+/// ===============================================
+/// @brief Replay the SS80 journal of every image
+///
+/// - Done even with JOURNAL = 0, the journal may be from an earlier run.
+/// @return  void
+void replay_drives()
+{
+    int i, j;
+    SS80DiskType *disk;
+
+    for(i=0;i<MAX_DEVICES;++i)
+    {
+        if(Devices[i].TYPE != SS80_TYPE)
+            continue;
+        disk = (SS80DiskType *)Devices[i].dev;
+        for(j=0;j<disk->MEDIA_COUNT;++j)
+            journal_replay(disk->MEDIA[j].NAME);
+    }
+}
+
+/// ===============================================
+/// @brief Measure the throughput of every SS80 drive
+///
+/// - Sets the read-ahead limit of each drive, see SS80_measure().
+/// - SS80_TUNE = 1 in the config file also rewrites the describe timing.
+/// @param[in] apply: rewrite BLOCK_TIME and CONTINUOUS_TRANSFER_RATE
+/// @return  void
+void tune_drives(int apply)
+{
+    int i;
+    SS80DiskType *disk;
+    SS80TuneType *t;
+
+    for(i=0;i<MAX_DEVICES;++i)
+    {
+        if(Devices[i].TYPE != SS80_TYPE)
+            continue;
+        disk = (SS80DiskType *)Devices[i].dev;
+        t = &disk->TUNE;
+        if(SS80_measure(disk, Devices[i].lat))
+        {
+            printf("SS80 %02d: throughput not measured\n", (int) Devices[i].ADDRESS);
+            continue;
+        }
+        printf("SS80 %02d: open %lu us, block %lu us, disk %lu bytes/s, bus %lu bytes/s, fill %d\n",
+            (int) Devices[i].ADDRESS,
+            (unsigned long) t->OPEN_US,
+            (unsigned long) t->BLOCK_US,
+            (unsigned long) t->DISK_RATE,
+            (unsigned long) t->BUS_RATE,
+            (int) t->FILL);
+        if(apply)
+        {
+            SS80_tune_describe(disk);
+            printf("SS80 %02d: describe BLOCK_TIME %u us, CONTINUOUS_TRANSFER_RATE %u kB/s\n",
+                (int) Devices[i].ADDRESS,
+                (unsigned) disk->UNIT.BLOCK_TIME,
+                (unsigned) disk->UNIT.CONTINUOUS_TRANSFER_RATE);
+        }
+    }
+}
@@ -51,6 +51,7 @@ typedef struct
 typedef struct 
 {
     uint16_t ID;        //<  Identify, For 9122 I1=02, I2=22H
+    uint8_t IDENTIFY[2];//<  ID packed MSB first by Post_Config()
 } ConfigType;
 
 // =============================================
@@ -193,6 +194,45 @@ typedef struct
 } SS80VolumeType;
 
 
+///@brief Most unit and volume images at one SS80 address, unit 0 volume 0 included
+#define SS80_MAX_MEDIA  4
+
+///@brief Most SS80 units, unit 15 is the controller
+#define SS80_MAX_UNITS  15
+
+///@brief Most SS80 volumes per unit - the describe volume bytes have 8 bits
+#define SS80_MAX_VOLUMES 8
+
+///@brief Packed SS80 describe sizes - controller, unit and volume
+#define SS80_DESCRIBE_CONTROLLER    5
+#define SS80_DESCRIBE_UNIT          19
+#define SS80_DESCRIBE_VOLUME        13
+#define SS80_DESCRIBE_SIZE  (SS80_DESCRIBE_CONTROLLER+SS80_DESCRIBE_UNIT+SS80_DESCRIBE_VOLUME)
+
+///@brief One SS80 unit and volume and its image file
+/// - Entry 0 is unit 0 volume 0 from the HEADER FILE and VOLUME sections
+/// - The others come from MEDIA sections, see Read_Config()
+/// - Units share the UNIT description, volumes share the VOLUME description
+///   except for the size
+typedef struct
+{
+    uint8_t UNIT_NUMBER;        //< SS80 unit 0 .. 14
+    uint8_t VOLUME_NUMBER;      //< SS80 volume 0 .. 7
+    char *NAME;                 //< Filename of emulated image
+    uint32_t MAX_BLOCK_NUMBER;  //< Maximum value of single vector address in blocks
+    uint8_t DESCRIBE[SS80_DESCRIBE_SIZE]; //< Describe reply, see SS80_Describe_Pack()
+} SS80MediaType;
+
+///@brief Measured disk and bus throughput, see SS80_measure()
+typedef struct
+{
+    uint32_t OPEN_US;           //< open, seek and read of one block in microseconds
+    uint32_t BLOCK_US;          //< one block of a sequential read in microseconds
+    uint32_t DISK_RATE;         //< sequential disk read bytes per second
+    uint32_t BUS_RATE;          //< GPIB bytes per second, 0 if not measured yet
+    uint8_t FILL;               //< most blocks per disk read, 0 if not measured yet
+} SS80TuneType;
+
 ///@brief Disk Information Structure
 typedef struct 
 {
@@ -201,6 +241,11 @@ typedef struct
     SS80ControllerType CONTROLLER;
     SS80UnitType UNIT;
     SS80VolumeType VOLUME;
+    ///@brief Units and volumes, set up by Post_Config()
+    uint8_t MEDIA_COUNT;
+    SS80MediaType MEDIA[SS80_MAX_MEDIA];
+    ///@brief Measured at startup, see tune_drives()
+    SS80TuneType TUNE;
 } SS80DiskType;
 // =============================================
 
@@ -214,13 +259,21 @@ typedef struct
     ///@brief Errors
     int Errors;         //< Error byte
     ///@brief SS80 Unit 
-    BYTE unitNO;        //< Unit Number - we only do 1
+    BYTE unitNO;        //< Unit Number
     ///@brief SS80 Volume 
-    BYTE volNO;         //< Volume Number - we only do 1
+    BYTE volNO;         //< Volume Number
+    ///@brief Image of unitNO and volNO, NULL if there is none
+    SS80MediaType *media;
     ///@brief Address in Blocks
     uint32_t AddressBlocks; 
     ///@brief Length in Bytes
     uint32_t Length;
+    ///@brief Length set by a message of complementary commands only, CS80 2-1
+    uint32_t LengthDefault;
+    ///@brief Byte address where the last Locate and Read ended
+    uint32_t ReadNext;
+    ///@brief Blocks read ahead past the end of a transfer
+    uint8_t ReadAhead;
 } SS80StateType;
 
 // =============================================
@@ -233,6 +286,7 @@ enum PARSE_STATES
     SS80_CONTROLLER,
     SS80_UNIT,
     SS80_VOLUME,
+    SS80_MEDIA,
     CONTROLLER_STATE,
     CONTROLLER_CONTROLLER,
     CONTROLLER_UNIT,
@@ -255,6 +309,11 @@ enum DEVICE_TYPES
     PRINTER_TYPE
 };
 
+///@brief Device types in the address table, see device_table_update()
+#define DEVICE_TABLE_TYPES  (PRINTER_TYPE+1)
+///@brief GPIB addresses in the address table
+#define DEVICE_TABLE_ADDRESSES 32
+
 ///@brief Device Type
 typedef struct
 {
@@ -265,6 +324,8 @@ typedef struct
     char     model[MODEL_SIZE];
     void     *dev;      // Disk or Printer Structure
     void     *state;    // Disk or Printer State Structure
+    void     *lat;      // Disk latency histograms, see latency.h
+    int      (*handler)(uint8_t ch); // Secondary command handler, set by device_table_update()
 } DeviceType;
 
 // =============================================
@@ -282,6 +343,8 @@ extern AMIGOStateType *AMIGOs;
 #endif
 extern PRINTERDeviceType *PRINTERp;
 extern DeviceType Devices[MAX_DEVICES];
+extern uint8_t ss80_tune;
+extern int8_t DeviceTable[DEVICE_TABLE_TYPES][DEVICE_TABLE_ADDRESSES];
 // =============================================
 
 
@@ -295,7 +358,11 @@ int count_drive_types ( uint8_t type );
 char *type_to_str ( int type );
 char *base_to_str ( int base );
 int find_free ( void );
+void device_table_update ( void );
 int find_device ( int type , int address , int base );
+int find_addressed ( int address , int base );
+void device_activate ( int index );
+int device_addressed ( int type , int address , int base );
 int set_active_device ( int index );
 void SS80_Set_Defaults ( int index );
 int alloc_device ( int type );
@@ -306,12 +373,15 @@ int pop_state ( void );
 void set_Config_Defaults ( void );
 void hpdir_set_device ( int index );
 void hpdir_set_parameters ( int index , char *model );
-void Post_Config ( void );
+void SS80_Post_Media ( SS80DiskType *SS80p );
+int Post_Config ( void );
 int Read_Config ( char *name );
 void print_var_P ( __memx const char *str , uint32_t val );
 void print_str_P ( __memx const char *str , char *arg );
 void display_Addresses ( void );
 void display_Config ( void );
 void format_drives ( void );
+void replay_drives ( void );
+void tune_drives ( int apply );
 
 #endif     // _DRIVES_H
@@ -23,6 +23,7 @@
 #include "defines.h"
 #include "gpib.h"
 #include "gpib_task.h"
+#include "gpib_capture.h"
 #include "amigo.h"
 #include "ss80.h"
 
@@ -74,10 +75,15 @@
 /// @brief common IO buffer for  gpib_read_str() and gpib_write_str()
 uint8_t gpib_iobuff[GPIB_IOBUFF_LEN];
 
+/// @brief Use burst transfers for data phases - see gpib_write_burst()
+uint8_t gpib_burst = 1;
+/// @brief Burst receive and send throughput counters
+gpib_burst_stats_t gpib_rx_stats, gpib_tx_stats;
+
 /// @brief gpib_unread() flag
-uint8_t gpib_unread_f = 0;                        // saved character flag
+GPIB_THREAD uint8_t gpib_unread_f = 0;            // saved character flag
 /// @brief gpib_unread() data
-uint16_t gpib_unread_data;                        // saved character and status
+GPIB_THREAD uint16_t gpib_unread_data;            // saved character and status
 
 /// @brief gpib talk address
 uint8_t talking;
@@ -97,6 +103,11 @@ uint16_t lastcmd,current;
 /// @brief gpib secondary
 uint8_t secondary;
 
+/// @brief Parallel polls seen by gpib_detect_PP()
+uint16_t gpib_pp_count = 0;
+/// @brief A parallel poll is in progress
+static uint8_t gpib_pp_active = 0;
+
 
 /// @brief GPIB command mapping to printable strings
 typedef struct {
@@ -197,6 +208,7 @@ void gpib_timer_task()
         gpib_timer.down_counter--;
     else
         gpib_timer.down_counter_done = 1;
+    gpib_event_task();
     sei();
 }
 
@@ -327,6 +339,20 @@ void gpib_bus_init( )
 }
 
 
+/// @brief  Handle an IFC latched in the event word
+///
+/// - Reset the bus like a polled IFC.
+/// - The event is cleared once IFC is released so a short pulse
+///   is still reported once and a held IFC keeps being reported.
+/// @return  void
+void gpib_event_ifc( void )
+{
+    gpib_bus_init();
+    if(GPIB_PIN_TST(IFC) == 1)
+        gpib_event_clear(GPIB_EV_IFC);
+}
+
+
 /// @brief  Reset GPIB states and related variables 
 ///
 /// - Called at powerup and IFC or reset states.
@@ -365,7 +391,7 @@ void gpib_enable_PPR(int bit)
         printf("gpib_enable_PPR: bit %d out of range\n", (int) bit);
         return;
     }
-    ppr_bit_set(bit);
+    ppr_update(1 << bit, 0);
 #if SDEBUG
     if(debuglevel & 2)
         printf("[EPPR bit:%d, mask:%02XH]\n",0xff & bit , 0xff & ppr_reg());
@@ -385,7 +411,7 @@ void gpib_disable_PPR(int bit)
         printf("gpib_disable_PPR: bit %d out of range\n", (int) bit);
         return;
     }
-    ppr_bit_clr(bit);
+    ppr_update(0, 1 << bit);
 #if SDEBUG
     if(debuglevel & 2)
         printf("[DPPR bit:%d, mask:%02XH]\n",0xff & bit, 0xff & ppr_reg());
@@ -409,7 +435,7 @@ void gpib_disable_PPR(int bit)
 ///     - SS80 pg 3-4, section 3-3
 /// @see gpib_enable_PPR()
 /// @see gpib_disable_PPR()
-/// @return  1 if we see a PPR, 0 if not
+/// @return  1 at the start of a parallel poll, 0 if not
 
 uint8_t gpib_detect_PP()
 {
@@ -418,11 +444,12 @@ uint8_t gpib_detect_PP()
 	///FIXME we can only read EOI in bus READ mode
     if(GPIB_PIN_TST(ATN) == 0 && GPIB_PIN_TST(EOI) == 0 )
     {
-
-#if SDEBUG
-        if(debuglevel & 2)
-           gpib_timer_elapsed_begin();
-#endif
+		///@brief Count each poll once, there is no handshake to wait for
+		/// The hardware answers so we return at once and do not stall the caller
+        if(gpib_pp_active)
+            return(0);
+        gpib_pp_active = 1;
+        ++gpib_pp_count;
 
         if(debuglevel & (0x200))
 		{
@@ -439,29 +466,9 @@ uint8_t gpib_detect_PP()
 					0xff & ppr_reg(), 0xff & pins, 0xff & ddr );
 #endif
 		}
-		// Wait for the state to end as there is no handshake
-		///FIXME we can only read EOI in bus READ mode
-		///  FIXME We add a test for read/write state ??
-        while(GPIB_PIN_TST(ATN) == 0 && GPIB_PIN_TST(EOI) == 0 )
-        {
-            if(uart_keyhit(0))
-                break;
-
-			// IFC is always in for a device
-            if(GPIB_PIN_TST(IFC) == 0)
-			{
-				// IFC test and gpib_bus_init() is tested in every state machine loop
-				// So not needed here
-				// gpib_bus_init();
-                break;
-			}
-        }
-#if SDEBUG
-        if(debuglevel & 2)
-			gpib_timer_elapsed_end("PP released");
-#endif
         return(1);
     }
+    gpib_pp_active = 0;
     return(0);
 }
 
@@ -479,6 +486,8 @@ void gpib_assert_ifc(void)
 
     GPIB_PIN_FLOAT_UP(IFC);
     delayus(250);
+    ///@brief Our own IFC must not abort the next transfer
+    gpib_event_clear(GPIB_EV_IFC);
 #if SDEBUG
     if(debuglevel & 4)
         printf("[IFC SENT]\n");
@@ -646,9 +655,6 @@ uint16_t gpib_write_byte(uint16_t ch)
 
     while(tx_state != GPIB_TX_DONE )
     {
-        if(uart_keyhit(0))
-            break;
-
 #if 0
 		// FIXME - this is disabled as it breaks write
 		// Try to detect PPR - only for debugging
@@ -657,10 +663,14 @@ uint16_t gpib_write_byte(uint16_t ch)
 #endif
 
 		// IFC is always in for a device
-        if(GPIB_PIN_TST(IFC) == 0)
+		// One test of the event word covers IFC and user abort
+        if(GPIB_EVENT_TEST(GPIB_EV_IFC | GPIB_EV_KEY))
         {
-            ch |= IFC_FLAG;
-			gpib_bus_init();
+            if(gpib_events & GPIB_EV_IFC)
+            {
+                ch |= IFC_FLAG;
+                gpib_event_ifc();
+            }
             break;
         }
 
@@ -798,7 +808,7 @@ uint16_t gpib_write_byte(uint16_t ch)
 			/// We are in read mode now
             ///@wait for DAV to finish float HI - finishing floating HI
             case GPIB_TX_WAIT_FOR_DAV_HI:
-                if(GPIO_PIN_TST(DAV) == 1)
+                if(GPIB_PIN_TST(DAV) == 1)
                 {
                     tx_state = GPIB_TX_FINISH;
                     break;
@@ -874,8 +884,6 @@ uint16_t gpib_read_byte(int trace)
     uint8_t rx_state;
     uint16_t ch;
     uint16_t bus, control, control_last;
-    extern uint8_t gpib_unread_f;
-    extern uint16_t gpib_unread_data;
 
     ch = 0;
     control_last = 0;
@@ -903,9 +911,6 @@ uint16_t gpib_read_byte(int trace)
     rx_state = GPIB_RX_START;
     while(rx_state != GPIB_RX_DONE)
     {
-        if(uart_keyhit(0))
-            break;
-
 // Try to detect PPR - only for debugging
 /// FIXME only enabled on V1 hardware
 #if BOARD == 1
@@ -914,11 +919,27 @@ uint16_t gpib_read_byte(int trace)
 #endif
 
 		// IFC is always in for a device
-        if(GPIB_PIN_TST(IFC) == 0)
+		// One test of the event word covers IFC, user abort and idle
+        if(GPIB_EVENT_TEST(GPIB_EV_IFC | GPIB_EV_KEY | GPIB_EV_IDLE))
         {
-            ch |= IFC_FLAG;
-			gpib_bus_init();
-            break;
+            if(gpib_events & (GPIB_EV_IFC | GPIB_EV_KEY))
+            {
+                if(gpib_events & GPIB_EV_IFC)
+                {
+                    ch |= IFC_FLAG;
+                    gpib_event_ifc();
+                }
+                break;
+            }
+            ///@brief Idle work only between bytes, otherwise it waits for the next byte
+            if(rx_state == GPIB_RX_WAIT_FOR_DAV_LOW && GPIB_PIN_TST(DAV))
+            {
+                GPIB_IO_LOW(NRFD);                // BUSY
+                gpib_event_clear(GPIB_EV_IDLE);
+                gpib_idle_task();
+                rx_state = GPIB_RX_START;
+                continue;
+            }
         }
 
 
@@ -1119,6 +1140,13 @@ void gpib_trace_display(uint16_t status,int trace_state)
     uint8_t bus = status & 0xff;
     extern FILE *gpib_log_fp;
 
+    ///@brief Binary capture saves the raw state, see gpib_capture.c
+    if(gpib_capture_active())
+    {
+        gpib_capture_record(status, trace_state);
+        return;
+    }
+
     str[0] = 0;
 
     // Display data bus ???
@@ -1296,6 +1324,31 @@ int gpib_read_str(uint8_t *buf, int size, uint16_t *status)
             printf("gpib_read_str: size = 0\n");
     }
 
+    ///@brief Data phases use the burst path unless we are tracing every byte
+    if(gpib_burst && size > 1 && !(*status & ATN_FLAG) && !gpib_unread_f
+#if SDEBUG
+        && !(debuglevel & 256)
+#endif
+    )
+    {
+        uint16_t eoi = *status & EOI_FLAG;
+
+        *status &= ~EOI_FLAG;
+        ind = gpib_read_burst(buf, size, status);
+
+        ///@brief EOI ended the read and the caller asked for it - same as the byte loop
+        if(eoi && (*status & EOI_FLAG))
+            return(ind);
+        *status |= eoi;
+
+        if ( ind != size )
+        {
+            if(debuglevel & (1+4))
+                printf("[gpib_read_str read(%d) expected(%d)]\n", ind , size);
+        }
+        return(ind);
+    }
+
     while(ind < size)
     {
         val = gpib_read_byte(NO_TRACE);
@@ -1343,6 +1396,351 @@ int gpib_read_str(uint8_t *buf, int size, uint16_t *status)
 }
 
 
+/// @brief  Check for IFC, user abort and timeout during a burst transfer
+///
+/// - Called every GPIB_BURST_POLL handshake polls instead of every poll.
+/// @return  IFC_FLAG, TIMEOUT_FLAG, 0 if ok, 0xffff on user abort
+static uint16_t gpib_burst_check( void )
+{
+    if(GPIB_EVENT_TEST(GPIB_EV_IFC | GPIB_EV_KEY))
+    {
+        if(gpib_events & GPIB_EV_IFC)
+        {
+            gpib_event_ifc();
+            return(IFC_FLAG);
+        }
+        return(0xffff);
+    }
+    if(gpib_timeout_test())
+        return(TIMEOUT_FLAG);
+    return(0);
+}
+
+/// @brief  Add a finished burst to the throughput counters
+/// @param[in] stats: counters to update
+/// @param[in] start: time the burst started
+/// @param[in] bytes: bytes transferred
+/// @param[in] err: error flags
+/// @return  void
+static void gpib_burst_account(gpib_burst_stats_t *stats, ts_t *start, int bytes, uint16_t err)
+{
+    stats->bursts++;
+    stats->bytes += bytes;
+    stats->us += timespec_us(start, NULL);
+    if(err & (IFC_FLAG | TIMEOUT_FLAG))
+        stats->errors++;
+}
+
+/// @brief  Receive a data string from the GPIB BUS in one burst.
+///
+/// - Same handshake as gpib_read_byte() without the per byte overhead.
+///   - We stay in listen mode for the whole transfer.
+///   - Bytes go straight into buf.
+///   - The IFC and keypress events are checked every GPIB_BURST_POLL polls.
+/// - Stops on size, EOI, ATN, IFC or timeout.
+///   - A byte sent with ATN is saved with gpib_unread() for gpib_task().
+/// - We always exit with NRFD and NDAC LOW - same as gpib_read_byte().
+///
+/// @param[out] buf: Binary gpib string
+/// @param[in] size: Size of buffer
+/// @param[in,out] status: same as gpib_read_str()
+///
+/// @return bytes read
+/// @see: gpib_read_str()
+int gpib_read_burst(uint8_t *buf, int size, uint16_t *status)
+{
+    int ind = 0;
+    uint8_t polls = GPIB_BURST_POLL;
+    uint16_t err = 0;
+    uint16_t val;
+    ts_t start;
+
+    clock_gettime(0, (ts_t *) &start);
+
+    gpib_bus_read_init(1);                          // Busy until we are ready
+
+    while(ind < size)
+    {
+        ///@brief Signal that we are ready to read
+        GPIB_PIN_FLOAT_UP(NRFD);
+        GPIB_BUS_SETTLE();
+
+        ///@brief No timeout while the controller has not sent the byte
+        while(GPIB_PIN_TST(DAV) == 1)
+        {
+            if(!--polls)
+            {
+                polls = GPIB_BURST_POLL;
+                if(GPIB_EVENT_TEST(GPIB_EV_IFC | GPIB_EV_KEY))
+                {
+                    if(gpib_events & GPIB_EV_IFC)
+                    {
+                        err = IFC_FLAG;
+                        gpib_event_ifc();
+                    }
+                    goto burst_exit;
+                }
+            }
+        }
+
+        GPIB_IO_LOW(NRFD);                          // BUSY
+
+        ///@brief gpib_bus_read strips command parity if ATN is low at read time
+        val = gpib_bus_read();
+        val |= gpib_control_pin_read();
+
+        GPIB_PIN_FLOAT_UP(NDAC);                    // Accepted
+        GPIB_BUS_SETTLE();
+        gpib_timeout_set(HTIMEOUT);
+#if BOARD != 2
+        ///@brief V1 boards can read NDAC - wait for the other listeners like gpib_read_byte()
+        while(GPIB_PIN_TST(NDAC) == 0)
+        {
+            if(!--polls)
+            {
+                polls = GPIB_BURST_POLL;
+                if(GPIB_EVENT_TEST(GPIB_EV_IFC))
+                {
+                    err = IFC_FLAG;
+                    gpib_event_ifc();
+                    goto burst_exit;
+                }
+                if(gpib_timeout_test())
+                {
+                    err = TIMEOUT_FLAG;
+                    goto burst_exit;
+                }
+            }
+        }
+        gpib_timeout_set(HTIMEOUT);
+#endif
+        while(GPIB_PIN_TST(DAV) == 0)
+        {
+            if(!--polls)
+            {
+                polls = GPIB_BURST_POLL;
+                if(GPIB_EVENT_TEST(GPIB_EV_IFC))
+                {
+                    err = IFC_FLAG;
+                    gpib_event_ifc();
+                    goto burst_exit;
+                }
+                if(gpib_timeout_test())
+                {
+                    err = TIMEOUT_FLAG;
+                    goto burst_exit;
+                }
+            }
+        }
+        GPIB_IO_LOW(NDAC);                          // Busy
+
+        lastcmd = current;
+        if(val & ATN_FLAG)
+        {
+            ///@brief Command byte - let the caller see it
+            current = val & CMD_MASK;
+            if(debuglevel & (1+4))
+                printf("gpib_read_burst(ind:%d): ATN %02XH unexpected\n",ind, 0xff & val);
+            gpib_unread(val);
+            break;
+        }
+        current = 0;
+
+        buf[ind++] = (val & DATA_MASK);
+
+        if(val & EOI_FLAG)
+        {
+            *status |= EOI_FLAG;
+            break;
+        }
+    }
+
+burst_exit:
+    gpib_bus_read_init(1);                          // Busy
+    if(err)
+    {
+#if SDEBUG
+        if(debuglevel & (1+4))
+            printf("<BURST RX %s at %d>\n", (err & IFC_FLAG) ? "IFC" : "TIMEOUT", ind);
+#endif
+        *status |= err;
+        lastcmd = current;
+        current = 0;
+    }
+    gpib_burst_account(&gpib_rx_stats, &start, ind, err);
+    return(ind);
+}
+
+/// @brief  Send a data string to the GPIB BUS in one burst.
+///
+/// - Same handshake as gpib_write_byte() without the per byte overhead.
+///   - The bus direction is set once and kept for the whole burst.
+///   - The timeout is armed every GPIB_BURST_REARM bytes, not every byte.
+///   - The IFC and keypress events and the timeout are checked every GPIB_BURST_POLL polls.
+/// - Data phase only - ATN is never asserted.
+/// - We always exit in read mode, NRFD and NDAC are busy on error.
+///
+/// @param[in] buf: Binary gpib string to send
+/// @param[in] size: Size of string
+/// @param[in] status: User status flags - EOI_FLAG sends EOI with the last byte
+///
+/// @return bytes sent
+///  - will match size on success.
+///  - Errors TIMEOUT_FLAG or IFC_FLAG will cause early exit and set status.
+/// @see: gpib_write_str()
+int gpib_write_burst(uint8_t *buf, int size, uint16_t *status)
+{
+    int ind = 0;
+    uint8_t polls = GPIB_BURST_POLL;
+    uint16_t err = 0;
+    ts_t start;
+
+    *status &= STATUS_MASK;
+
+    clock_gettime(0, (ts_t *) &start);
+
+    gpib_bus_read_init(0);
+    gpib_timeout_set(HTIMEOUT);
+
+    // Wait for release of DAV before starting
+    while(GPIB_PIN_TST(DAV) == 0)
+    {
+        if(!--polls)
+        {
+            polls = GPIB_BURST_POLL;
+            if((err = gpib_burst_check()))
+                goto burst_exit;
+        }
+    }
+
+#if BOARD == 2
+    GPIB_IO_HI(TE); // BUS OUT, DAV OUT, NRFD and NDAC IN
+    GPIB_IO_LOW(DC);// ATN OUT, EOI OUT, SRQ IN
+#endif
+    GPIB_PIN_FLOAT_UP(ATN);
+    GPIB_PIN_FLOAT_UP(EOI);
+
+    while(ind < size)
+    {
+        if((ind % GPIB_BURST_REARM) == 0)
+            gpib_timeout_set(HTIMEOUT);
+
+        // Wait for ready condition
+        while(GPIB_PIN_TST(NRFD) == 0 || GPIB_PIN_TST(NDAC) == 1)
+        {
+            if(!--polls)
+            {
+                polls = GPIB_BURST_POLL;
+                if((err = gpib_burst_check()))
+                    goto burst_exit;
+            }
+        }
+
+        if( (*status & EOI_FLAG) && (ind == size - 1) )
+            GPIB_IO_LOW(EOI);
+
+        GPIB_BUS_WR(buf[ind] ^ 0xff);               // Write Data inverted
+#if BOARD == 2
+        if(!ind)
+            GPIB_IO_HI(PE);                         // Tristate mode for the burst
+#endif
+        GPIB_BUS_SETTLE();                          // Let Data BUS settle
+        GPIB_IO_LOW(DAV);
+
+        // first device is ready
+        while(GPIB_PIN_TST(NRFD) == 1)
+        {
+            if(!--polls)
+            {
+                polls = GPIB_BURST_POLL;
+                if((err = gpib_burst_check()))
+                    goto burst_exit;
+            }
+        }
+
+        // ALL devices have accepted the byte
+        while(GPIB_PIN_TST(NDAC) == 0)
+        {
+            if(!--polls)
+            {
+                polls = GPIB_BURST_POLL;
+                if((err = gpib_burst_check()))
+                    goto burst_exit;
+            }
+        }
+
+        GPIB_PIN_FLOAT_UP(DAV);
+        ++ind;
+    }
+
+    GPIB_BUS_SETTLE();
+    gpib_bus_read_init(0);                          // Free BUS, NOT busy
+
+    // wait for DAV to finish floating HI
+    gpib_timeout_set(HTIMEOUT);
+    while(GPIB_PIN_TST(DAV) == 0)
+    {
+        if(gpib_timeout_test())
+        {
+            err = TIMEOUT_FLAG;
+            break;
+        }
+    }
+
+burst_exit:
+    if(err == 0xffff)
+    {
+        // User abort - same as gpib_write_byte(), no error flags
+        gpib_bus_read_init(0);
+    }
+    else if(err)
+    {
+#if SDEBUG
+        if(debuglevel & (1+4))
+            printf("<BURST %s at %d: NRFD=%d,NDAC=%d>\n",
+                (err & IFC_FLAG) ? "IFC" : "TIMEOUT",
+                ind, GPIB_PIN_TST(NRFD),GPIB_PIN_TST(NDAC));
+#endif
+        *status |= err;
+        if(err & TIMEOUT_FLAG)
+            gpib_bus_read_init(1);                  // Free BUS, BUSY on error
+    }
+    gpib_burst_account(&gpib_tx_stats, &start, ind, err == 0xffff ? 0 : err);
+    return(ind);
+}
+
+/// @brief  Display or reset the burst throughput counters
+/// @param[in] reset: clear the counters after display
+/// @return  void
+void gpib_burst_stats(int reset)
+{
+    gpib_burst_stats_t *stats;
+    uint32_t rate;
+    int i;
+
+    printf("burst=%d\n", (int) gpib_burst);
+    for(i=0;i<2;++i)
+    {
+        stats = i ? &gpib_tx_stats : &gpib_rx_stats;
+        rate = 0;
+        if(stats->us)
+            rate = (uint32_t) ((double) stats->bytes * 1000000.0 / (double) stats->us);
+        printf("%s bursts:%lu, bytes:%lu, us:%lu, errors:%lu, bytes/s:%lu\n",
+            i ? "TX" : "RX",
+            (unsigned long) stats->bursts,
+            (unsigned long) stats->bytes,
+            (unsigned long) stats->us,
+            (unsigned long) stats->errors,
+            (unsigned long) rate);
+    }
+    if(reset)
+    {
+        memset(&gpib_rx_stats, 0, sizeof(gpib_rx_stats));
+        memset(&gpib_tx_stats, 0, sizeof(gpib_tx_stats));
+    }
+}
+
+
 /// @brief  Send string to GPIB BUS - controlled by status flags.
 ///
 /// - Status flags used when sending
@@ -1385,6 +1783,22 @@ int gpib_write_str(uint8_t *buf, int size, uint16_t *status)
             printf("gpib_write_str: size = 0\n");
     }
 
+    ///@brief Data phases use the burst path unless we are tracing every byte
+    if(gpib_burst && size > 1 && !(*status & ATN_FLAG)
+#if SDEBUG
+        && !(debuglevel & 256)
+#endif
+    )
+    {
+        ind = gpib_write_burst(buf, size, status);
+        if ( ind != size )
+        {
+            if(debuglevel & (1+4))
+                printf("[gpib_write_str sent(%d) expected(%d)]\n", ind,size);
+        }
+        return(ind);
+    }
+
     while(ind < size)
     {
         ch = buf[ind++] & 0xff;                   // unsigned
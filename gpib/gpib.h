@@ -28,6 +28,21 @@
 /// @brief This is the default BUS timeout of 0.5 Seconds in Microseconds
 #define HTIMEOUT (500000L / GPIB_TASK_TIC_US)
 
+///@brief Burst transfers - see gpib_write_burst()
+/// Bytes sent before we rearm the timeout
+#define GPIB_BURST_REARM    64
+/// Handshake polls between IFC and user abort checks
+#define GPIB_BURST_POLL     32
+
+///@brief Burst transfer throughput counters - see gpib_burst_stats()
+typedef struct
+{
+    uint32_t bursts;    ///< number of bursts
+    uint32_t bytes;     ///< bytes transferred
+    uint32_t us;        ///< time in bursts in microseconds
+    uint32_t errors;    ///< bursts ending with IFC or timeout
+} gpib_burst_stats_t;
+
 
 ///@brief bus flags
 #define EOI_FLAG 0x0100
@@ -101,6 +116,11 @@ enum
 #define GPIB_IOBUFF_LEN     512 /* Max length of RX/TX GPIB string */
 extern uint8_t gpib_iobuff[GPIB_IOBUFF_LEN];
 
+extern uint8_t gpib_burst;
+extern gpib_burst_stats_t gpib_rx_stats;
+extern gpib_burst_stats_t gpib_tx_stats;
+extern uint16_t gpib_pp_count;
+
 extern int debuglevel;
 
 extern uint8_t talk31;
@@ -122,6 +142,7 @@ void gpib_timeout_set ( uint32_t time );
 uint8_t gpib_timeout_test ( void );
 void gpib_bus_read_init ( int busy);
 void gpib_bus_init ( void );
+void gpib_event_ifc ( void );
 void gpib_state_init ( void );
 void gpib_enable_PPR ( int bit );
 void gpib_disable_PPR ( int bit );
@@ -138,6 +159,9 @@ void gpib_decode_header ( FILE *fo );
 void gpib_trace_display ( uint16_t status , int trace_state );
 void gpib_decode ( uint16_t ch );
 int gpib_read_str ( uint8_t *buf , int size , uint16_t *status );
+int gpib_read_burst ( uint8_t *buf , int size , uint16_t *status );
+int gpib_write_burst ( uint8_t *buf , int size , uint16_t *status );
+void gpib_burst_stats ( int reset );
 int gpib_write_str ( uint8_t *buf , int size , uint16_t *status );
 
 #endif                                            // GPIB_H_
@@ -0,0 +1,293 @@
+/**
+ @file gpib/gpib_bench.c
+
+ @brief GPIB bus throughput benchmark for HP85 disk emulator project for AVR.
+
+ @par Edit History
+ - [1.0]   [Mike Gore]  Initial revision of file.
+
+ @par Copyright &copy; 2014-2020 Mike Gore, All rights reserved. GPL
+ @see http://github.com/magore/hp85disk
+ @see http://github.com/magore/hp85disk/COPYRIGHT.md for Copyright details
+
+ - We act as the controller and time controller_send_str() and
+   controller_read_str() against an SS80 drive on the bus.
+   - A second hp85disk board or a real drive.
+ - Stages:
+   - handshake: one command byte, a full three wire handshake.
+   - turnaround: a one byte execution phase - the addressing bytes
+     and the first byte of the device reply.
+   - read: locate and read execution phase, we are the listener.
+   - write: locate and write execution phase, we are the talker.
+     - Only if requested, the blocks just read are written back unchanged.
+   - Execution phases include the controller_*_str() addressing bytes.
+ - We do not parallel poll, the device holds off the handshake until ready.
+ - Build with GPIB_BENCH=1, the AVR flash is nearly full.
+ - The host build runs this code on the virtual bus controller thread
+   against the emulated drives, see hp85disk -B.
+
+*/
+
+
+#include "user_config.h"
+
+#include "defines.h"
+#include "gpib_hal.h"
+#include "gpib.h"
+#include "gpib_task.h"
+#include "controller.h"
+#include "gpib_bench.h"
+
+#include "posix.h"
+
+#ifdef GPIB_BENCH
+
+/// @brief Add a sample to a stage
+/// @param[in,out] t: stage timing
+/// @param[in] us: sample time
+/// @param[in] bytes: bytes transferred
+/// @return void
+static void bench_add(bench_time_t *t, uint32_t us, uint32_t bytes)
+{
+    t->samples++;
+    t->bytes += bytes;
+    t->total_us += us;
+    if(us > t->max_us)
+        t->max_us = us;
+}
+
+
+/// @brief Display a stage
+/// @param[in] name: stage name
+/// @param[in] t: stage timing
+/// @return void
+static void bench_show(char *name, bench_time_t *t)
+{
+    if(!t->samples)
+        return;
+    printf("  %-10s samples:%4lu avg:%8lu us max:%8lu us",
+        name, (unsigned long) t->samples,
+        (unsigned long) (t->total_us / t->samples),
+        (unsigned long) t->max_us);
+    if(t->bytes)
+        printf(" %8lu bytes/s", (unsigned long) rate_per_second(t->bytes, t->total_us ? t->total_us : 1));
+    printf("\n");
+}
+
+
+/// @brief Check the result of a controller transfer
+/// @param[in] what: transfer name for the error message
+/// @param[in] size: bytes transferred
+/// @param[in] len: bytes expected
+/// @return 0 on success, -1 on error
+static int bench_check(char *what, int size, int len)
+{
+    if(size == len)
+        return(0);
+    printf("[BENCH %s %d of %d]\n", what, size, len);
+    return(-1);
+}
+
+
+/// @brief SS80 command phase - set unit, address, length and opcode
+/// @param[in] address: device address
+/// @param[in] block: block address
+/// @param[in] bytes: transfer length
+/// @param[in] op: 0x00 = locate and read, 0x02 = locate and write
+/// @return 0 on success, -1 on error
+static int bench_command(int address, uint32_t block, uint32_t bytes, uint8_t op)
+{
+    uint8_t cmd[14];
+
+    cmd[0] = 0x20;                                  // Set Unit 0
+    cmd[1] = 0x10;                                  // Set Address
+    cmd[2] = 0;
+    cmd[3] = 0;
+    cmd[4] = block >> 24;
+    cmd[5] = block >> 16;
+    cmd[6] = block >> 8;
+    cmd[7] = block;
+    cmd[8] = 0x18;                                  // Set Length
+    cmd[9] = bytes >> 24;
+    cmd[10] = bytes >> 16;
+    cmd[11] = bytes >> 8;
+    cmd[12] = bytes;
+    cmd[13] = op;
+    return( bench_check("command",
+        controller_send_str(BENCH_CONTROLLER, address, 0x65, (char *) cmd, sizeof(cmd)),
+        sizeof(cmd)) );
+}
+
+
+/// @brief SS80 report phase - read QSTAT
+/// @param[in] address: device address
+/// @return QSTAT or -1 on error
+static int bench_report(int address)
+{
+    uint8_t qstat[2];
+
+    if(bench_check("report",
+        controller_read_str(address, BENCH_CONTROLLER, 0x70, (char *) qstat, sizeof(qstat)), 1))
+        return(-1);
+    return(qstat[0]);
+}
+
+
+/// @brief SS80 execution phase - read len bytes
+///
+/// - buf has room for the terminator controller_read_str() adds.
+/// @param[in] address: device address
+/// @param[out] buf: len + 1 bytes
+/// @param[in] len: number of bytes
+/// @param[out] t: execution phase timing, may be NULL
+/// @return 0 on success, -1 on error
+static int bench_recv(int address, uint8_t *buf, int len, bench_time_t *t)
+{
+    ts_t start;
+    int size;
+
+    clock_gettime(0, (ts_t *) &start);
+    size = controller_read_str(address, BENCH_CONTROLLER, 0x6e, (char *) buf, len + 1);
+    if(t)
+        bench_add(t, timespec_us(&start, NULL), size);
+    return( bench_check("read", size, len) );
+}
+
+
+/// @brief SS80 execution phase - write len bytes
+/// @param[in] address: device address
+/// @param[in] buf: data
+/// @param[in] len: number of bytes
+/// @param[out] t: execution phase timing, may be NULL
+/// @return 0 on success, -1 on error
+static int bench_send(int address, uint8_t *buf, int len, bench_time_t *t)
+{
+    ts_t start;
+    int size;
+
+    clock_gettime(0, (ts_t *) &start);
+    size = controller_send_str(BENCH_CONTROLLER, address, 0x6e, (char *) buf, len);
+    if(t)
+        bench_add(t, timespec_us(&start, NULL), size);
+    return( bench_check("sent", size, len) );
+}
+
+
+/// @brief SS80 locate and read
+/// @param[in] address: device address
+/// @param[out] buf: len + 1 bytes
+/// @param[in] len: number of bytes from block 0
+/// @param[out] t: execution phase timing, may be NULL
+/// @return 0 on success, -1 on error
+static int bench_read(int address, uint8_t *buf, int len, bench_time_t *t)
+{
+    if(bench_command(address, 0, len, 0x00))
+        return(-1);
+    if(bench_recv(address, buf, len, t))
+        return(-1);
+    return( bench_report(address) == 0 ? 0 : -1 );
+}
+
+
+/// @brief SS80 locate and write
+/// @param[in] address: device address
+/// @param[in] buf: data
+/// @param[in] len: number of bytes from block 0
+/// @param[out] t: execution phase timing, may be NULL
+/// @return 0 on success, -1 on error
+static int bench_write(int address, uint8_t *buf, int len, bench_time_t *t)
+{
+    if(bench_command(address, 0, len, 0x02))
+        return(-1);
+    if(bench_send(address, buf, len, t))
+        return(-1);
+    return( bench_report(address) == 0 ? 0 : -1 );
+}
+
+
+/// @brief Benchmark the bus against an SS80 drive
+///
+/// - gpib_task() must not be running, we are the controller.
+///   - The host build runs the device in another thread, see host/host_hal.c.
+/// @param[in] address: SS80 drive GPIB address
+/// @param[in] blocks: blocks per transfer, 1 .. BENCH_MAX_BLOCKS
+/// @param[in] write: also time writes - the blocks read are written back
+/// @return 0 on success, -1 on error
+int gpib_bench(int address, int blocks, int write)
+{
+    bench_time_t handshake, turnaround, rd, wr;
+    int len = blocks * BENCH_BLOCK_SIZE;
+    uint8_t *buf;
+    ts_t start;
+    int i;
+    int ret = -1;
+
+    if(address < 0 || address > 30 || address == BENCH_CONTROLLER)
+    {
+        printf("gpib bench: bad address %d\n", address);
+        return(-1);
+    }
+    if(blocks < 1 || blocks > BENCH_MAX_BLOCKS)
+    {
+        printf("gpib bench: blocks must be 1 .. %d\n", BENCH_MAX_BLOCKS);
+        return(-1);
+    }
+
+    buf = safecalloc(len + 1, 1);
+    if(buf == NULL)
+        return(-1);
+
+    memset(&handshake, 0, sizeof(handshake));
+    memset(&turnaround, 0, sizeof(turnaround));
+    memset(&rd, 0, sizeof(rd));
+    memset(&wr, 0, sizeof(wr));
+
+    printf("Bench SS80 address:%d blocks:%d burst:%d\n", address, blocks, (int) gpib_burst);
+
+    gpib_bus_init();
+
+    ///@brief the first report after power on may be non zero
+    bench_read(address, buf, BENCH_BLOCK_SIZE, NULL);
+
+    for(i=0;i<BENCH_HANDSHAKES;++i)
+    {
+        clock_gettime(0, (ts_t *) &start);
+        if(gpib_write_byte(0x3f | ATN_FLAG) & ERROR_MASK)   // unlisten
+            goto bench_exit;
+        bench_add(&handshake, timespec_us(&start, NULL), 1);
+    }
+
+    for(i=0;i<BENCH_TURNAROUNDS;++i)
+    {
+        if(bench_read(address, buf, 1, &turnaround))
+            goto bench_exit;
+    }
+
+    for(i=0;i<BENCH_PASSES;++i)
+    {
+        if(bench_read(address, buf, len, &rd))
+            goto bench_exit;
+    }
+
+    if(write)
+    {
+        for(i=0;i<BENCH_PASSES;++i)
+        {
+            if(bench_write(address, buf, len, &wr))
+                goto bench_exit;
+        }
+    }
+    ret = 0;
+
+bench_exit:
+    bench_show("handshake", &handshake);
+    bench_show("turnaround", &turnaround);
+    bench_show("read", &rd);
+    bench_show("write", &wr);
+    printf("Bench %s\n", ret ? "FAILED" : "done");
+
+    gpib_bus_init();
+    safefree(buf);
+    return(ret);
+}
+#endif // #ifdef GPIB_BENCH
@@ -0,0 +1,50 @@
+/**
+ @file gpib/gpib_bench.h
+
+ @brief GPIB bus throughput benchmark for HP85 disk emulator project for AVR.
+
+ @par Edit History
+ - [1.0]   [Mike Gore]  Initial revision of file.
+
+ @par Copyright &copy; 2014-2020 Mike Gore, All rights reserved. GPL
+ @see http://github.com/magore/hp85disk
+ @see http://github.com/magore/hp85disk/COPYRIGHT.md for Copyright details
+
+*/
+
+#ifndef _GPIB_BENCH_H_
+#define _GPIB_BENCH_H_
+
+///@brief Our controller address - same as the HP85
+#define BENCH_CONTROLLER    21
+
+///@brief SS80 block size
+#define BENCH_BLOCK_SIZE    256
+
+///@brief Largest transfer - limited by AVR RAM
+#define BENCH_MAX_BLOCKS    8
+
+///@brief Number of single handshakes timed
+#define BENCH_HANDSHAKES    64
+
+///@brief Number of EOI turnarounds timed
+#define BENCH_TURNAROUNDS   16
+
+///@brief Number of read and write transfers timed
+#define BENCH_PASSES        8
+
+///@brief Timing of one benchmark stage
+typedef struct
+{
+    uint32_t samples;
+    uint32_t bytes;
+    uint32_t total_us;
+    uint32_t max_us;
+} bench_time_t;
+
+#ifdef GPIB_BENCH
+/* gpib_bench.c */
+int gpib_bench ( int address , int blocks , int write );
+#endif
+
+#endif  // #ifndef _GPIB_BENCH_H_
@@ -0,0 +1,286 @@
+/**
+ @file gpib/gpib_capture.c
+
+ @brief Binary GPIB bus capture for HP85 disk emulator project for AVR.
+
+ @par Edit History
+ - [1.0]   [Mike Gore]  Initial revision of file.
+
+ @par Copyright &copy; 2014-2020 Mike Gore, All rights reserved. GPL
+ @see http://github.com/magore/hp85disk
+ @see http://github.com/magore/hp85disk/COPYRIGHT.md for Copyright details
+
+ - The text trace formats every bus byte and writes it to the card
+   while the bus waits, this slows down the bus we are observing.
+ - Here each bus state is a small binary record saved in a RAM ring buffer
+   and written to the file in GPIB_CAPTURE_BLOCK sized writes.
+ - The host program host/gpib_decode.c turns a capture back into
+   the gpib_decode_header() text layout and decodes SS80 and AMIGO commands.
+ - Build with GPIB_CAPTURE=1, the AVR flash is nearly full.
+
+*/
+
+
+#include "user_config.h"
+
+#include "defines.h"
+#include "gpib_hal.h"
+#include "gpib.h"
+#include "gpib_task.h"
+#include "gpib_capture.h"
+
+#include "posix.h"
+
+#ifdef GPIB_CAPTURE
+/// @brief Capture state, fp is NULL when not capturing
+gpib_capture_t gpib_cap;
+
+
+/// @brief Are we capturing ?
+/// @return 1 if capturing, 0 if not
+int gpib_capture_active()
+{
+    return(gpib_cap.fp != NULL);
+}
+
+
+/// @brief Open a capture file and write the file header
+///
+/// @param[in] name: capture file name
+/// @return 1 on success, 0 on error
+int gpib_capture_open(char *name)
+{
+    uint8_t header[GPIB_CAPTURE_HEADER_SIZE];
+
+    gpib_capture_close();
+
+    memset((void *) &gpib_cap, 0, sizeof(gpib_cap));
+
+    gpib_cap.ring = safecalloc(GPIB_CAPTURE_RING,1);
+    if(gpib_cap.ring == NULL)
+        return(0);
+
+    gpib_cap.fp = fopen(name,"wb");
+    if(gpib_cap.fp == NULL)
+    {
+        perror("open failed");
+        safefree(gpib_cap.ring);
+        gpib_cap.ring = NULL;
+        return(0);
+    }
+
+    memset(header, 0, sizeof(header));
+    memcpy(header, GPIB_CAPTURE_MAGIC, 7);
+    header[7] = GPIB_CAPTURE_VERSION;
+    header[8] = GPIB_CAPTURE_HEADER_SIZE;
+    header[10] = GPIB_CAPTURE_RECORD_SIZE;
+    header[12] = GPIB_CAPTURE_UNIT_NS & 0xff;
+    header[13] = (GPIB_CAPTURE_UNIT_NS >> 8) & 0xff;
+    header[14] = (GPIB_CAPTURE_UNIT_NS >> 16) & 0xff;
+    header[15] = (GPIB_CAPTURE_UNIT_NS >> 24) & 0xff;
+
+    if(fwrite(header, 1, sizeof(header), gpib_cap.fp) != sizeof(header))
+    {
+        printf("Capture header write failed\n");
+        gpib_capture_close();
+        return(0);
+    }
+
+    clock_gettime(0, (ts_t *) &gpib_cap.last);
+    return(1);
+}
+
+
+/// @brief Make room in the ring buffer for records that belong together
+///
+/// - A time record must never be saved without the record it extends.
+/// @param[in] count: number of records
+/// @return 1 if there is room, 0 on overrun
+static int gpib_capture_reserve(int count)
+{
+    int size = count * GPIB_CAPTURE_RECORD_SIZE;
+
+    ///@brief The ring is normally flushed long before this
+    if(gpib_cap.used + size > GPIB_CAPTURE_RING)
+        gpib_capture_flush(0);
+    if(gpib_cap.used + size > GPIB_CAPTURE_RING)
+    {
+        ++gpib_cap.overruns;
+        return(0);
+    }
+    return(1);
+}
+
+
+/// @brief Save one record in the ring buffer
+///
+/// - Call gpib_capture_reserve() first.
+/// @param[in] time: time delta
+/// @param[in] status: record status
+/// @param[in] type: record type
+/// @return void
+static void gpib_capture_put(uint16_t time, uint16_t status, uint8_t type)
+{
+    uint8_t rec[GPIB_CAPTURE_RECORD_SIZE];
+    int i;
+
+    rec[0] = time & 0xff;
+    rec[1] = time >> 8;
+    rec[2] = status & 0xff;
+    rec[3] = status >> 8;
+    rec[4] = type;
+
+    for(i=0;i<GPIB_CAPTURE_RECORD_SIZE;++i)
+    {
+        gpib_cap.ring[gpib_cap.head++] = rec[i];
+        if(gpib_cap.head >= GPIB_CAPTURE_RING)
+            gpib_cap.head = 0;
+    }
+    gpib_cap.used += GPIB_CAPTURE_RECORD_SIZE;
+}
+
+
+/// @brief Capture a bus state - called from gpib_trace_display()
+///
+/// @param[in] status: data bus value (lower 8 bits) control bus (upper 8 bits)
+/// @param[in] trace_state: TRACE_DISABLE, TRACE_READ or TRACE_BUS
+/// @see gpib_trace_display()
+/// @return void
+void gpib_capture_record(uint16_t status, int trace_state)
+{
+    ts_t now;
+    uint32_t us;
+    uint8_t type;
+
+    if(gpib_cap.fp == NULL)
+        return;
+
+    clock_gettime(0, (ts_t *) &now);
+    us = timespec_us((ts_t *) &gpib_cap.last, (ts_t *) &now);
+    gpib_cap.last = now;
+
+    if(!gpib_capture_reserve(us > 0xffffUL ? 2 : 1))
+        return;
+
+    if(us > 0xffffUL)
+        gpib_capture_put(0, us >> 16, GPIB_CAPTURE_TIME);
+
+    type = trace_state & GPIB_CAPTURE_STATE_MASK;
+    ///@brief Trace states have the handshake lines in status already
+    if(trace_state == TRACE_DISABLE)
+        type |= (gpib_handshake_pin_read() >> 8) & GPIB_CAPTURE_HANDSHAKE_MASK;
+    else
+        type |= (status >> 8) & GPIB_CAPTURE_HANDSHAKE_MASK;
+
+    gpib_capture_put(us & 0xffff, status, type);
+    ++gpib_cap.records;
+}
+
+
+/// @brief Write full blocks from the ring buffer to the capture file
+///
+/// - The ring size is a multiple of the block size so a block never wraps
+/// @param[in] all: also write the last partial block
+/// @return number of bytes written
+int gpib_capture_flush(int all)
+{
+    int len;
+    int total = 0;
+
+    if(gpib_cap.fp == NULL)
+        return(0);
+
+    while(gpib_cap.used >= GPIB_CAPTURE_BLOCK || (all && gpib_cap.used))
+    {
+        len = GPIB_CAPTURE_BLOCK;
+        if(len > gpib_cap.used)
+            len = gpib_cap.used;
+        if(len > GPIB_CAPTURE_RING - gpib_cap.tail)
+            len = GPIB_CAPTURE_RING - gpib_cap.tail;
+
+        if(fwrite(gpib_cap.ring + gpib_cap.tail, 1, len, gpib_cap.fp) != len)
+            ++gpib_cap.errors;
+
+        gpib_cap.tail += len;
+        if(gpib_cap.tail >= GPIB_CAPTURE_RING)
+            gpib_cap.tail = 0;
+        gpib_cap.used -= len;
+        total += len;
+    }
+    return(total);
+}
+
+
+/// @brief Flush and close the capture file, display the statistics
+/// @return void
+void gpib_capture_close()
+{
+    if(gpib_cap.fp != NULL)
+    {
+        gpib_capture_flush(1);
+        fclose(gpib_cap.fp);
+        gpib_cap.fp = NULL;
+        printf("Capture: %ld records, %ld overruns, %ld write errors\n",
+            (long) gpib_cap.records, (long) gpib_cap.overruns, (long) gpib_cap.errors);
+    }
+    if(gpib_cap.ring != NULL)
+    {
+        safefree(gpib_cap.ring);
+        gpib_cap.ring = NULL;
+    }
+}
+
+
+/// @brief  Capture GPIB activity passively - saving binary records to a file
+/// @param[in] name: file name to save to
+/// @param[in] detail: if non-zero capture every handshake state
+///
+/// - Same as gpib_trace_task() but the file is binary
+/// - Decode the file with host/gpibdecode
+/// - A keypress will exit the capture and close the file
+///
+/// @return  void
+///   Exit on Key Press
+
+void gpib_capture_task( char *name , int detail)
+{
+    int ch;
+
+    if(name == NULL || *name == 0)
+    {
+        printf("Capture file name required\n");
+        return;
+    }
+    name = skipspaces(name);
+
+    printf("Capturing GPIB BUS to:%s\n", name);
+    if(detail)
+        printf("FULL GPIB BUS handshake capture requested\n");
+    printf("Press ANY key to exit\n");
+
+    if(!gpib_capture_open(name))
+    {
+        printf("exiting...\n");
+        return;
+    }
+
+    gpib_state_init();                            // Init PPR talking and listening states
+    gpib_init_devices();
+
+    while(1)                                      // Main loop, forever
+    {
+        if(uart_keyhit(0))
+            break;
+
+        ch = gpib_read_byte(detail);
+        if(!detail)
+            gpib_decode(ch);
+
+        ///@brief The talker waits for us until the next gpib_read_byte()
+        gpib_capture_flush(0);
+    }
+
+    printf("Done\n");
+    gpib_capture_close();
+}
+#endif // #ifdef GPIB_CAPTURE
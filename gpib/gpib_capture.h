@@ -0,0 +1,80 @@
+/**
+ @file gpib/gpib_capture.h
+
+ @brief Binary GPIB bus capture for HP85 disk emulator project for AVR.
+
+ @par Edit History
+ - [1.0]   [Mike Gore]  Initial revision of file.
+
+ @par Copyright &copy; 2014-2020 Mike Gore, All rights reserved. GPL
+ @see http://github.com/magore/hp85disk
+ @see http://github.com/magore/hp85disk/COPYRIGHT.md for Copyright details
+
+*/
+
+#ifndef _GPIB_CAPTURE_H_
+#define _GPIB_CAPTURE_H_
+
+///@brief Capture file format - all values are little endian
+///
+/// File header, GPIB_CAPTURE_HEADER_SIZE bytes
+///   - 0  "GPIBCAP" magic
+///   - 7  format version
+///   - 8  uint16 header size
+///   - 10 uint16 record size
+///   - 12 uint32 time stamp unit in nanoseconds
+///
+/// Record, GPIB_CAPTURE_RECORD_SIZE bytes
+///   - 0  uint16 time since the previous record in time stamp units
+///   - 2  uint16 status - same as gpib_trace_display() status
+///   - 4  type
+///     - bits 0..1 trace state, TRACE_DISABLE, TRACE_READ or TRACE_BUS
+///       or GPIB_CAPTURE_TIME: status holds the upper 16 bits of the next time delta
+///     - bits 5..7 DAV, NRFD, NDAC handshake lines - status bits 13..15 >> 8
+#define GPIB_CAPTURE_MAGIC          "GPIBCAP"
+#define GPIB_CAPTURE_VERSION        1
+#define GPIB_CAPTURE_HEADER_SIZE    16
+#define GPIB_CAPTURE_RECORD_SIZE    5
+#define GPIB_CAPTURE_UNIT_NS        1000UL
+
+///@brief Record type field
+#define GPIB_CAPTURE_STATE_MASK     0x03
+#define GPIB_CAPTURE_TIME           0x03
+#define GPIB_CAPTURE_HANDSHAKE_MASK 0xe0
+
+///@brief Ring buffer is written to the file in GPIB_CAPTURE_BLOCK sized writes
+#define GPIB_CAPTURE_BLOCK          512
+#define GPIB_CAPTURE_BLOCKS         2
+#define GPIB_CAPTURE_RING           (GPIB_CAPTURE_BLOCK * GPIB_CAPTURE_BLOCKS)
+
+///@brief Capture state
+typedef struct
+{
+    FILE *fp;           ///< capture file
+    uint8_t *ring;      ///< ring buffer
+    uint16_t head;      ///< next byte to write into the ring
+    uint16_t tail;      ///< next byte to write to the file
+    uint16_t used;      ///< bytes in the ring
+    ts_t last;          ///< time of the previous record
+    uint32_t records;   ///< records captured
+    uint32_t overruns;  ///< records dropped because the ring was full
+    uint32_t errors;    ///< file write errors
+} gpib_capture_t;
+
+#ifndef GPIB_CAPTURE
+///@brief Not built - gpib trace writes text
+#define gpib_capture_active()                   0
+#define gpib_capture_record(status,trace_state) ((void) (status))
+#endif
+
+#ifdef GPIB_CAPTURE
+/* gpib_capture.c */
+int gpib_capture_active ( void );
+int gpib_capture_open ( char *name );
+void gpib_capture_record ( uint16_t status , int trace_state );
+int gpib_capture_flush ( int all );
+void gpib_capture_close ( void );
+void gpib_capture_task ( char *name , int detail );
+#endif
+
+#endif // #ifndef _GPIB_CAPTURE_H_
@@ -32,14 +32,249 @@ void gpib_timer_init()
         printf("GPIB Clock task init failed\n");
 
     gpib_timer_reset();
+    gpib_event_init();
 }
 
 
+///@brief GPIB bus and media events - see GPIB_EV_IFC .. GPIB_EV_MEDIA
+/// Hot loops test this one word instead of polling each source
+volatile uint8_t gpib_events = 0;
+
+#ifdef GPIB_VBUS
+///@brief Events this thread acts on, see host_bench()
+GPIB_THREAD uint8_t gpib_event_mask = 0xff;
+#endif
+
+///@brief Ticks until GPIB_EV_IDLE is latched, 0 = not armed
+static volatile uint16_t gpib_idle_ticks = 0;
+
+#ifdef GPIB_EVENT_STATS
+gpib_event_stats_t gpib_event_stats;
+
+///@brief Number of tests timed by gpib_event_display()
+#define GPIB_EVENT_COST_LOOPS 10000UL
+
+/// @brief Count newly latched events
+/// @param[in] ev: events that were not set before
+/// @return  void
+static void gpib_event_count(uint8_t ev)
+{
+    uint8_t i;
+    for(i=0;i<GPIB_EV_BITS;++i)
+    {
+        if(ev & (1 << i))
+            gpib_event_stats.latched[i]++;
+    }
+}
+#endif
+
+
+/// @brief Latch the IFC event from the control pins.
+///
+/// - Called from the pin change interrupt with interrupts disabled.
+/// - Events stay set until cleared with gpib_event_clear().
+/// - ATN and EOI are read with the data byte by the transfer loops, they
+///   are not latched so command bytes do not cost an interrupt each.
+/// @return  void
+static void gpib_event_latch( void )
+{
+    uint8_t ev = gpib_events;
+
+    if(GPIB_PIN_TST(IFC) == 0)
+        ev |= GPIB_EV_IFC;
+#ifdef GPIB_EVENT_STATS
+    gpib_event_count(ev & ~gpib_events);
+#endif
+    gpib_events = ev;
+}
+
+
+#ifdef GPIB_VBUS
+/// @brief Sample the virtual bus control pins into the event word.
+///
+/// - The host build has no pin change interrupts, GPIB_EVENT_TEST() calls this.
+/// @return  void
+void gpib_event_pins( void )
+{
+    cli();
+    gpib_event_latch();
+    sei();
+}
+#else
+///@brief Port D pin change - IFC
+ISR(PCINT3_vect)
+{
+    gpib_event_latch();
+}
+#endif
+
+
+/// @brief Enable the IFC pin change interrupt.
+///
+/// - On the ATmega1284P GPIO pin numbers are the PCINT numbers.
+/// @return  void
+void gpib_event_init( void )
+{
+    cli();
+    gpib_events = 0;
+#ifndef GPIB_VBUS
+    PCMSK3 |= _BV(IFC & 7);
+    PCIFR = _BV(PCIF3);
+    PCICR |= _BV(PCIE3);
+#endif
+    sei();
+}
+
+
+/// @brief Clear events after they have been handled.
+/// @param[in] mask: GPIB_EV_* bits to clear
+/// @return  void
+void gpib_event_clear(uint8_t mask)
+{
+    cli();
+    gpib_events &= ~mask;
+    sei();
+}
 
 
-///@brief Parallel Poll Response bit mask.
+/// @brief Update the user keypress and media events - called every tick.
+///
+/// - Runs from the timer interrupt so the hot loops never call
+///   uart_keyhit() or mmc_ins_status() themselves.
+/// - uart_rx_count() does cli()/sei(), so the AVR reads the ring buffer
+///   count directly - nothing here may re-enable interrupts.
+/// - The inputs are sampled first, then the event word is updated once.
+/// @return  void
+void gpib_event_task( void )
+{
+    uint8_t ev = 0;
+
+#ifdef GPIB_VBUS
+    if(uart_keyhit(0))
+#else
+    if(uarts[0].rx_count)
+#endif
+        ev |= GPIB_EV_KEY;
+    if(mmc_ins_status() != 1)
+        ev |= GPIB_EV_MEDIA;
+    if(gpib_idle_ticks && --gpib_idle_ticks == 0)
+        ev |= GPIB_EV_IDLE;
+    else if(gpib_events & GPIB_EV_IDLE)
+        ev |= GPIB_EV_IDLE;
+
+    ev |= gpib_events & ~(GPIB_EV_KEY | GPIB_EV_MEDIA | GPIB_EV_IDLE);
+#ifdef GPIB_EVENT_STATS
+    gpib_event_count(ev & ~gpib_events);
+#endif
+    gpib_events = ev;
+}
+
+
+/// @brief Latch GPIB_EV_IDLE after a number of ticks.
+///
+/// - Each call restarts the count, 0 disarms it.
+/// @param[in] ticks: ticks of GPIB_TASK_TIC_US
+/// @return  void
+void gpib_idle_set( uint16_t ticks )
+{
+    cli();
+    gpib_idle_ticks = ticks;
+    gpib_events &= ~GPIB_EV_IDLE;
+    sei();
+}
+
+
+#ifdef GPIB_EVENT_STATS
+/// @brief Counted GPIB_EVENT_TEST() for the instrumentation build.
+/// @param[in] mask: GPIB_EV_* bits to test
+/// @return  events in mask that are set
+uint8_t gpib_event_read(uint8_t mask)
+{
+    uint8_t ev;
+#ifdef GPIB_VBUS
+    gpib_event_pins();
+    mask &= gpib_event_mask;
+#endif
+    ev = gpib_events & mask;
+    gpib_event_stats.tests++;
+    if(ev)
+        gpib_event_stats.hits++;
+    return(ev);
+}
+
+
+/// @brief Display the event word counters and the cost of a test.
+///
+/// - The cost is measured against the per byte polling it replaced.
+/// @param[in] reset: clear the counters
+/// @return  void
+void gpib_event_display(int reset)
+{
+    static const char *names[GPIB_EV_BITS] = { "IFC", "KEY", "MEDIA", "IDLE" };
+    gpib_event_stats_t save;
+    ts_t start, now;
+    uint32_t i, ns_ev, ns_poll;
+    volatile uint8_t sink = 0;
+    uint8_t b;
+
+    if(reset)
+    {
+        memset(&gpib_event_stats, 0, sizeof(gpib_event_stats));
+        return;
+    }
+
+    // the cost loop must not count its own tests
+    save = gpib_event_stats;
+
+    clock_gettime(0, (ts_t *) &start);
+    for(i=0;i<GPIB_EVENT_COST_LOOPS;++i)
+        sink |= GPIB_EVENT_TEST(GPIB_EV_KEY | GPIB_EV_IFC);
+    clock_gettime(0, (ts_t *) &now);
+    subtract_timespec((ts_t *) &now, (ts_t *) &start);
+    ns_ev = (now.tv_sec * 1000000000UL + now.tv_nsec) / GPIB_EVENT_COST_LOOPS;
+
+    clock_gettime(0, (ts_t *) &start);
+    for(i=0;i<GPIB_EVENT_COST_LOOPS;++i)
+        sink |= (uart_keyhit(0) || GPIB_PIN_TST(IFC) == 0 || mmc_ins_status() != 1);
+    clock_gettime(0, (ts_t *) &now);
+    subtract_timespec((ts_t *) &now, (ts_t *) &start);
+    ns_poll = (now.tv_sec * 1000000000UL + now.tv_nsec) / GPIB_EVENT_COST_LOOPS;
+
+    gpib_event_stats = save;
+
+    printf("Events:%02XH, tests:%lu, hits:%lu\n",
+        0xff & gpib_events,
+        (unsigned long) gpib_event_stats.tests,
+        (unsigned long) gpib_event_stats.hits);
+    for(b=0;b<GPIB_EV_BITS;++b)
+        printf("  %-5s latched:%lu\n", names[b], (unsigned long) gpib_event_stats.latched[b]);
+    printf("Test cost: event word %lu ns, polling %lu ns\n",
+        (unsigned long) ns_ev, (unsigned long) ns_poll);
+}
+#endif
+
+
+
+
+///@brief Parallel Poll Response bits enabled - device PPR bit order.
+static uint8_t _ppr_mask;
+
+///@brief Parallel Poll Response register last written - hardware bit order.
 static uint8_t _ppr_reg;
 
+///@brief Hardware register bit for each device PPR bit.
+/// Precomputed so enabling or disabling a device is a single OR or AND
+static const uint8_t ppr_reg_bit[8] =
+{
+///@brief optionally reverse bit order in PPR mask
+/// Used only of PPR circuit board PPR bits are not reversed in hardware
+#if PPR_REVERSE_BITS == 1
+    0x80, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01
+#else
+    0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80
+#endif
+};
+
 /// @brief  Reverse the bits in an 8 bit value 
 ///
 /// - GPIB Parallel poll response bits are reversed.
@@ -63,6 +298,28 @@ uint8_t reverse_8bits(uint8_t mask)
 }
 
 
+/// @brief Write the PPR register - skipped if it has not changed.
+///
+/// - The SPI transfer and PPE latch pulse are done with interrupts off
+///   so the response bits on the bus change in one step.
+///
+/// @param[in] reg: register value in hardware bit order
+/// @param[in] force: write even if unchanged
+/// @return  void
+static void ppr_write(uint8_t reg, uint8_t force)
+{
+    if(reg == _ppr_reg && !force)
+        return;
+
+    cli();
+    SPI0_TXRX_Byte(reg);
+    GPIB_IO_HI(PPE);
+    GPIB_IO_LOW(PPE);
+    _ppr_reg = reg;
+    sei();
+}
+
+
 /// @brief Enable or Disable Parallel Poll Response bits - PPR.
 //
 /// - V1 hardware reversed bits in hardware. V2 in software
@@ -89,34 +346,55 @@ uint8_t reverse_8bits(uint8_t mask)
 
 void ppr_set(uint8_t mask)
 {
-///@brief optionally reverse bit order in PPR mask
-/// Used only of PPR circuit board PPR bits are not reversed in hardware
-#if PPR_REVERSE_BITS == 1
-    _ppr_reg = reverse_8bits(mask);
-#else
-    _ppr_reg = mask;
-#endif
-    SPI0_TXRX_Byte(_ppr_reg);
+    uint8_t i;
+    uint8_t reg = 0;
 
-    GPIB_IO_HI(PPE);
-    GPIB_IO_LOW(PPE);
+    for(i=0;i<8;++i)
+    {
+        if(mask & (1 << i))
+            reg |= ppr_reg_bit[i];
+    }
+    _ppr_mask = mask;
+    ppr_write(reg, 1);
+}
+
+
+/// @brief Enable and disable PPR bits with one register write.
+///
+/// - gpib_enable_PPR(), gpib_disable_PPR(), ppr_bit_set() and ppr_bit_clr()
+///   all end here.
+/// - Only the bits in set and clr are looked up in ppr_reg_bit[].
+/// - The register is not written if nothing changed.
+///
+/// @param[in] set: Parallel Poll Response bits to enable
+/// @param[in] clr: Parallel Poll Response bits to disable
+/// @return  void
+
+void ppr_update(uint8_t set, uint8_t clr)
+{
+    uint8_t i;
+    uint8_t reg = _ppr_reg;
+
+    _ppr_mask = (_ppr_mask & ~clr) | set;
+    for(i=0; set | clr; ++i, set >>= 1, clr >>= 1)
+    {
+        if(clr & 1)
+            reg &= ~ppr_reg_bit[i];
+        if(set & 1)
+            reg |= ppr_reg_bit[i];
+    }
+    ppr_write(reg, 0);
 }
 
 
 /// @brief  Return PPR enable register.
 ///
 /// - Hides the register access implimentation from the upper level.
-/// @return  PPR enable register
+/// @return  PPR enable register in device PPR bit order
 
 uint8_t ppr_reg()
 {
-///@brief optionally reverse bit order in PPR mask
-/// Used only of PPR circuit board PPR bits are not reversed in hardware
-#if PPR_REVERSE_BITS == 1
-    return(reverse_8bits(_ppr_reg));
-#else
-    return(_ppr_reg);
-#endif
+    return(_ppr_mask);
 }
 
 
@@ -154,9 +432,7 @@ void ppr_init()
 
 void ppr_bit_set(uint8_t bit)
 {
-///FIXME _ppr_reg = 0;
-    BIT_SET(_ppr_reg,bit);
-    ppr_set(_ppr_reg);
+    ppr_update(1 << (bit & 7), 0);
 }
 
 
@@ -178,9 +454,7 @@ void ppr_bit_set(uint8_t bit)
 
 void ppr_bit_clr(uint8_t bit)
 {
-///FIXME _ppr_reg = 0;
-    BIT_CLR(_ppr_reg,bit);
-    ppr_set(_ppr_reg);
+    ppr_update(0, 1 << (bit & 7));
 }
 
 
@@ -415,3 +689,114 @@ int dbf_open_write(char *name, uint32_t pos, void *buff, int size, int *errors)
     }
     return(bytes);
 }
+
+
+///@brief Fill buffer size - a multiple of the 512 byte SD sector size
+#ifndef DBF_FILL_BUFFER
+#define DBF_FILL_BUFFER 4096
+#endif
+
+///@brief Progress steps shown by dbf_open_fill()
+#define DBF_FILL_STEPS  8
+
+/// @brief Open, Seek, Fill with one byte value and Close - used to format
+///
+/// - One open for the whole fill, not one per sector.
+/// - An empty file first gets contiguous clusters with f_expand().
+/// - Large sector aligned writes go to the card without the FatFs window.
+/// - Progress with debuglevel 32, time and rate with debuglevel 64.
+///
+/// @param[in] name: File name to open.
+/// @param[in] pos: file offset.
+/// @param[in] size: bytes to fill.
+/// @param[in] val: fill byte.
+/// @param[in] errors: error flags pointer.
+/// @param[in] report: show progress, time and rate - 0 for a slice of a larger fill.
+///
+/// @return  bytes written.
+/// @return -1 on error.
+long dbf_open_fill(char *name, uint32_t pos, uint32_t size, uint8_t val, int *errors, int report)
+{
+    int rc;
+    FIL fp;
+    UINT bytes, len;
+    uint8_t *buf;
+    uint32_t done, step, next;
+    int bufsize;
+    ts_t start;
+
+    clock_gettime(0, (ts_t *) &start);
+
+    rc = dbf_open(&fp, name, FA_OPEN_ALWAYS | FA_READ | FA_WRITE);
+    if( rc != FR_OK)
+    {
+        *errors = ERR_DISK | ERR_WRITE;
+        if(mmc_wp_status())
+            *errors |= ERR_WP;
+        return( -1 );
+    }
+
+    ///@brief A new image - try for contiguous clusters, a fragmented file still works
+    if(f_size(&fp) == 0)
+        f_expand(&fp, pos + size, 1);
+
+    buf = safecalloc(DBF_FILL_BUFFER, 1);
+    if(buf != NULL)
+    {
+        bufsize = DBF_FILL_BUFFER;
+    }
+    else
+    {
+        buf = gpib_iobuff;
+        bufsize = GPIB_IOBUFF_LEN;
+    }
+    memset(buf, val, bufsize);
+
+    rc = dbf_lseek(&fp, pos);
+
+    step = size / DBF_FILL_STEPS;
+    next = step;
+    for(done = 0; rc == FR_OK && done < size; done += bytes)
+    {
+        ///@brief Align to the SD sector after an unaligned start
+        len = bufsize - ((pos + done) % 512);
+        if(len > size - done)
+            len = size - done;
+        bytes = 0;
+        rc = dbf_write(&fp, buf, len, &bytes);
+        if(rc == FR_OK && bytes != len)
+            rc = FR_DENIED;
+#if SDEBUG
+        if(report && (debuglevel & 32) && step && done + bytes >= next)
+        {
+            printf(".");
+            next += step;
+        }
+#endif
+    }
+
+    if(buf != gpib_iobuff)
+        safefree(buf);
+
+    if(dbf_close(&fp) != FR_OK && rc == FR_OK)
+        rc = FR_DISK_ERR;
+    if(rc != FR_OK)
+    {
+        *errors = ERR_WRITE;
+        if(mmc_wp_status())
+            *errors |= ERR_WP;
+        return( -1 );
+    }
+
+#if SDEBUG
+    if(report && (debuglevel & 64))
+    {
+        uint32_t us = timespec_us((ts_t *) &start, NULL);
+
+        printf("\n[Fill %s %lu bytes in %lu ms, %lu bytes/s]\n",
+            name, (unsigned long) done, (unsigned long) (us / 1000UL),
+            (unsigned long) rate_per_second(done, us ? us : 1));
+    }
+#endif
+    return(done);
+}
@@ -18,8 +18,18 @@
 
 #include "user_config.h"
 
+#ifdef GPIB_VBUS
+///@brief The virtual bus settles at once
+#define GPIB_BUS_SETTLE() /**/
+#else
 /* 2 Microseconds */
 #define GPIB_BUS_SETTLE() _delay_us(GPIB_BUS_SETTLE_DELAY)
+#endif
+
+#ifndef GPIB_THREAD
+///@brief Storage class of per bus engine state, thread local on the host
+#define GPIB_THREAD /**/
+#endif
 
 #define GPIB_TASK_TIC_US SYSTEM_TASK_TIC_US       /* Interrupt time in US */
 
@@ -35,6 +45,49 @@ typedef struct _gpib_t
 extern gpib_t gpib_timer;
 void gpib_clock_task( void );
 
+///@brief GPIB event word bits - see gpib_events
+/// - IFC is latched by a pin change interrupt
+/// - KEY and MEDIA are levels updated every tick by gpib_event_task()
+/// - IDLE is latched by gpib_event_task() when the gpib_idle_set() count runs out
+#define GPIB_EV_IFC     0x01    ///< IFC was asserted
+#define GPIB_EV_KEY     0x02    ///< uart_keyhit(0)
+#define GPIB_EV_MEDIA   0x04    ///< mmc_ins_status() != 1
+#define GPIB_EV_IDLE    0x08    ///< idle time is up - see gpib_idle_task()
+#define GPIB_EV_BITS    4
+
+extern volatile uint8_t gpib_events;
+
+#ifdef GPIB_VBUS
+///@brief Events this thread acts on - the host controller thread leaves
+/// IFC and idle work to the device thread, see host_bench()
+extern GPIB_THREAD uint8_t gpib_event_mask;
+#endif
+
+///@brief Test the event word in a hot loop
+/// @param[in] mask: GPIB_EV_* bits to test
+/// @return  events in mask that are set
+#ifdef GPIB_EVENT_STATS
+///@brief Instrumentation build - every test is counted
+#define GPIB_EVENT_TEST(mask)   gpib_event_read(mask)
+#elif defined(GPIB_VBUS)
+///@brief The virtual bus has no pin change interrupts so we sample it
+#define GPIB_EVENT_TEST(mask)   (gpib_event_pins(), gpib_events & gpib_event_mask & (mask))
+#else
+#define GPIB_EVENT_TEST(mask)   (gpib_events & (mask))
+#endif
+
+#ifdef GPIB_EVENT_STATS
+///@brief Event word instrumentation counters
+typedef struct
+{
+    uint32_t tests;                 ///< GPIB_EVENT_TEST() tests
+    uint32_t hits;                  ///< tests that found an event
+    uint32_t latched[GPIB_EV_BITS]; ///< times each event was latched
+} gpib_event_stats_t;
+
+extern gpib_event_stats_t gpib_event_stats;
+#endif
+
 
 ///  Notes:
 ///   "EOI" gets convereted into the required DDR and BIT definitions.
@@ -61,6 +114,45 @@ void gpib_clock_task( void );
 ///  val=PIN,  reads PIN state       val=LATCH reads latch
 
 
+#ifdef GPIB_VBUS
+///@brief Linux host build - the pins are on the virtual bus, see host/vbus.h
+#define EOI     VBUS_EOI
+#define DAV     VBUS_DAV
+#define NRFD    VBUS_NRFD
+#define NDAC    VBUS_NDAC
+#define IFC     VBUS_IFC
+#define SRQ     VBUS_SRQ
+#define ATN     VBUS_ATN
+#define REN     VBUS_REN
+
+#define TE      VBUS_TE
+#define PE      VBUS_PE
+#define DC      VBUS_DC
+#define SC      VBUS_SC
+#define LED1    VBUS_LED1
+#define LED2    VBUS_LED2
+
+#define PPE     VBUS_PPE
+
+#define GPIB_BUS_OUT()          vbus_bus_dir(0xff)
+#define GPIB_BUS_IN()           vbus_bus_dir(0)
+#define GPIB_BUS_RD()           vbus_bus_rd()
+#define GPIB_BUS_LATCH_WR(val)  vbus_bus_latch(val)
+#define GPIB_BUS_WR(val)        vbus_bus_wr(val)
+#define GPIB_PIN_FLOAT(a)       vbus_pin_float(a)
+#define GPIB_PIN_FLOAT_UP(a)    vbus_pin_float(a)
+#define GPIB_PIN_TST(a)         vbus_pin_tst(a)
+#define GPIB_IO_LOW(a)          vbus_pin_low(a)
+#define GPIB_IO_HI(a)           vbus_pin_hi(a)
+#define GPIB_IO_RD(a)           vbus_pin_rd(a)
+#define GPIB_LATCH_HI(a)        vbus_latch_wr(a,1)
+#define GPIB_LATCH_LOW(a)       vbus_latch_wr(a,0)
+#define GPIB_LATCH_RD(a)        vbus_latch_rd(a)
+#define GPIB_PPR_RD()           vbus_ppr_rd()
+#define GPIB_PPR_DDR_RD()       vbus_ppr_ddr_rd()
+
+#else   // GPIB_VBUS
+
 // control pins are the same on V1 and V2 hardware
 #define EOI     GPIO_B0
 #define DAV     GPIO_B1
@@ -141,6 +233,8 @@ void gpib_clock_task( void );
 /// Optional - see gpib_detect_PPR
 #define GPIB_PPR_DDR_RD()   GPIO_PORT_DDR_RD(GPIO_A)
 
+#endif  // GPIB_VBUS
+
 /// ===================================================
 // FIXME just to be safe we check that evreything is defained
 
@@ -195,8 +289,16 @@ void gpib_clock_task( void );
 
 /* gpib_hal.c */
 void gpib_timer_init ( void );
+void gpib_event_pins ( void );
+void gpib_event_init ( void );
+void gpib_event_clear ( uint8_t mask );
+void gpib_event_task ( void );
+void gpib_idle_set ( uint16_t ticks );
+uint8_t gpib_event_read ( uint8_t mask );
+void gpib_event_display ( int reset );
 uint8_t reverse_8bits ( uint8_t mask );
 void ppr_set ( uint8_t mask );
+void ppr_update ( uint8_t set , uint8_t clr );
 void soft_ppr_assert ( void );
 void soft_ppr_restore ( void );
 uint8_t ppr_reg ( void );
@@ -210,6 +312,7 @@ FRESULT dbf_lseek ( FIL *fp , DWORD ofs );
 FRESULT dbf_close ( FIL *fp );
 int dbf_open_read ( char *name , uint32_t pos , void *buff , int size , int *errors );
 int dbf_open_write ( char *name , uint32_t pos , void *buff , int size , int *errors );
+long dbf_open_fill ( char *name , uint32_t pos , uint32_t size , uint8_t val , int *errors , int report );
 
 
 #endif  // #ifndef _GPIB_HAL_H_
@@ -23,6 +23,7 @@
 #include "amigo.h"
 #include "ss80.h"
 #include "printer.h"
+#include "cache.h"
 
 #include "posix.h"
 
@@ -75,10 +76,7 @@ void gpib_log( char *str )
 /// @return  1 if true or 0
 int SS80_is_MLA(int address)
 {
-    int index = find_device(SS80_TYPE, address, BASE_MLA);
-    if(index == -1)
-        return(0);
-    return(set_active_device(index));
+    return( device_addressed(SS80_TYPE, address, BASE_MLA) );
 }
 
 /// @brief  Check if SS80 talking address
@@ -87,10 +85,7 @@ int SS80_is_MLA(int address)
 /// @return  1 if true or 0
 int SS80_is_MTA(int address)
 {
-    int index = find_device(SS80_TYPE, address, BASE_MTA);
-    if(index == -1)
-        return(0);
-    return(set_active_device(index));
+    return( device_addressed(SS80_TYPE, address, BASE_MTA) );
 }
 
 /// @brief  Check if SS80 secondary address
@@ -99,10 +94,7 @@ int SS80_is_MTA(int address)
 /// @return  1 if true or 0
 int SS80_is_MSA(int address)
 {
-    int index = find_device(SS80_TYPE, address, BASE_MSA);
-    if(index == -1)
-        return(0);
-    return(set_active_device(index));
+    return( device_addressed(SS80_TYPE, address, BASE_MSA) );
 }
 
 #ifdef AMIGO
@@ -112,10 +104,7 @@ int SS80_is_MSA(int address)
 /// @return  1 if true or 0
 int AMIGO_is_MLA(int address)
 {
-    int index = find_device(AMIGO_TYPE, address, BASE_MLA);
-    if(index == -1)
-        return(0);
-    return(set_active_device(index));
+    return( device_addressed(AMIGO_TYPE, address, BASE_MLA) );
 }
 
 /// @brief  Check if AMIGO talking address
@@ -124,10 +113,7 @@ int AMIGO_is_MLA(int address)
 /// @return  1 if true or 0
 int AMIGO_is_MTA(int address)
 {
-    int index = find_device(AMIGO_TYPE, address, BASE_MTA);
-    if(index == -1)
-        return(0);
-    return(set_active_device(index));
+    return( device_addressed(AMIGO_TYPE, address, BASE_MTA) );
 }
 
 /// @brief  Check if AMIGO secondary address
@@ -136,10 +122,7 @@ int AMIGO_is_MTA(int address)
 /// @return  1 if true or 0
 int AMIGO_is_MSA(int address)
 {
-    int index = find_device(AMIGO_TYPE, address, BASE_MSA);
-    if(index == -1)
-        return(0);
-    return(set_active_device(index));
+    return( device_addressed(AMIGO_TYPE, address, BASE_MSA) );
 }
 #endif                      // #ifdef AMIGO
 
@@ -149,10 +132,7 @@ int AMIGO_is_MSA(int address)
 /// @return  1 if true or 0
 int PRINTER_is_MLA(int address)
 {
-    int index = find_device(PRINTER_TYPE, address, BASE_MLA);
-    if(index == -1)
-        return(0);
-    return(set_active_device(index));
+    return( device_addressed(PRINTER_TYPE, address, BASE_MLA) );
 }
 
 /// @brief  Check if PRINTER talking address
@@ -161,10 +141,7 @@ int PRINTER_is_MLA(int address)
 /// @return  1 if true or 0
 int PRINTER_is_MTA(int address)
 {
-    int index = find_device(PRINTER_TYPE, address, BASE_MTA);
-    if(index == -1)
-        return(0);
-    return(set_active_device(index));
+    return( device_addressed(PRINTER_TYPE, address, BASE_MTA) );
 }
 
 /// @brief  Check if PRINTER secondary address
@@ -173,10 +150,7 @@ int PRINTER_is_MTA(int address)
 /// @return  1 if true or 0
 int PRINTER_is_MSA(int address)
 {
-    int index = find_device(PRINTER_TYPE, address, BASE_MSA);
-    if(index == -1)
-        return(0);
-    return(set_active_device(index));
+    return( device_addressed(PRINTER_TYPE, address, BASE_MSA) );
 }
 
 
@@ -271,7 +245,9 @@ void gpib_trace_task( char *name , int detail)
 uint16_t gpib_error_test(uint16_t val)
 {
 
-    if(val & ERROR_MASK || uart_keyhit(0) || mmc_ins_status() != 1 )
+    ///@brief The event word saves polling the UART and media on every byte
+    /// They are polled again below to confirm the event
+    if(val & ERROR_MASK || GPIB_EVENT_TEST(GPIB_EV_KEY | GPIB_EV_MEDIA) )
     {
         val &= ERROR_MASK;
 
@@ -312,6 +288,9 @@ uint16_t gpib_error_test(uint16_t val)
 ///  low level GPIB functions are still useful even without a DISK
         if( mmc_ins_status() != 1 )
         {
+            ///@brief Last chance for dirty blocks, the card may be back by now
+            cache_flush(NULL);
+            cache_invalidate(NULL);
             return(ABORT_FLAG);
         }
 
@@ -320,6 +299,7 @@ uint16_t gpib_error_test(uint16_t val)
         {
             while(GPIB_IO_RD(IFC) == 0)
                 ;
+            gpib_event_clear(GPIB_EV_IFC);
         }
         return(val);
     }
@@ -339,6 +319,9 @@ void gpib_init_devices(void)
 	// Enable this 14 April 2020 - testing MIke Gore
     gpib_state_init();   
 
+    cache_flush(NULL);                            // Write back before we forget
+    cache_invalidate(NULL);                       // Images may have changed
+
     SS80_init();                                  // SS80 state init
 
 #ifdef AMIGO
@@ -349,6 +332,25 @@ void gpib_init_devices(void)
 }
 
 
+/// @brief  Work to do while the bus is idle
+///
+/// - Called by gpib_read_byte() on GPIB_EV_IDLE while no byte is on the bus.
+/// - We hold NRFD busy meanwhile so the controller just waits.
+/// - One short slice at a time, the next one runs after CACHE_SLICE_TICKS
+///   so the bus is polled in between.
+/// - Cache write back and read ahead, and SS80 Initialize Media.
+/// @return  void
+void gpib_idle_task(void)
+{
+    int more = cache_idle();
+
+    if(SS80_idle())
+        more = 1;
+    if(more)
+        gpib_idle_set(CACHE_SLICE_TICKS);
+}
+
+
 /// @brief  Process all GPIB Secondary Commands
 ///
 /// - Dispatch emulator handler based on address
@@ -365,76 +367,29 @@ void gpib_init_devices(void)
 uint16_t GPIB_COMMANDS(uint16_t val, uint8_t unread)
 {
     uint16_t status;
+    int index = -1;
+
+    ///@brief One table lookup finds the device and its handler
+    /// AMIGO, SS80 then PRINTER - see find_addressed()
 
     ///@brief talking ?
     if(talking != UNT)
-    {
-
-#ifdef AMIGO
-        if ( AMIGO_is_MLA(listening) )
-        {
-            if(unread)
-                gpib_unread(val);
-            // secondary was previously set
-            status = AMIGO_COMMANDS(secondary);
-            secondary = 0;
-            return(status);
-        }
-#endif                      // ifdef AMIGO
-
-        if ( SS80_is_MLA(listening) )
-        {
-            if(unread)
-                gpib_unread(val);
-            // secondary was previously set
-            status = SS80_COMMANDS(secondary);
-            secondary = 0;
-            return(status);
-        }
-
-        if ( PRINTER_is_MLA(listening) )
-        {
-            if(unread)
-                gpib_unread(val);
-            status = PRINTER_COMMANDS(secondary);
-            secondary = 0;
-            return(status);
-        }
-    }
+        index = find_addressed(listening, BASE_MLA);
 
     ///@brief listening ?
-    if(listening != UNL)
-    {
-#ifdef AMIGO
-        if ( AMIGO_is_MTA(talking) )
-        {
-            if(unread)
-                gpib_unread(val);
-            status = AMIGO_COMMANDS(secondary);
-            secondary = 0;
-            return(status);
-        }
-#endif 
+    if(index == -1 && listening != UNL)
+        index = find_addressed(talking, BASE_MTA);
 
-        if ( SS80_is_MTA(talking) )
-        {
-            if(unread)
-                gpib_unread(val);
-            status = SS80_COMMANDS(secondary);
-            secondary = 0;
-            return(status);
-        }
+    if(index == -1)
+        return(0);
 
-        if ( PRINTER_is_MTA(talking) )
-        {
-            if(unread)
-                gpib_unread(val);
-            status = PRINTER_COMMANDS(secondary);
-            secondary = 0;
-            return(status);
-        }
-    }
-    return(0);
+    device_activate(index);
+    if(unread)
+        gpib_unread(val);
+    // secondary was previously set
+    status = Devices[index].handler(secondary);
+    secondary = 0;
+    return(status);
 }
 
 
@@ -573,26 +528,25 @@ void gpib_task(void)
 ///  - A11
 ///
 /// @param[in] ch: channel
+/// @param[in] ID: identify bytes packed by Post_Config()
 ///
 /// @return  0 on GPIB error returns error flags
 /// @see gpib.h ERROR_MASK for a full list.
 
-int Send_Identify(uint8_t ch, uint16_t ID)
+int Send_Identify(uint8_t ch, uint8_t *ID)
 {
     uint16_t status = EOI_FLAG;
-    uint8_t tmp[2];
 
-    V2B_MSB(tmp,0,2,ID);
-    if(gpib_write_str(tmp,2, &status) != 2)
+    if(gpib_write_str(ID,2, &status) != 2)
     {
         if(debuglevel & (1+4))
-            printf("[IDENT Unit:%02XH=%04XH FAILED]\n", 
-                (int)ch,(int)ID);
+            printf("[IDENT Unit:%02XH=%02X%02XH FAILED]\n", 
+                (int)ch,(int)ID[0],(int)ID[1]);
         return(status & ERROR_MASK);
     }
 #if SDEBUG
     if(debuglevel & 4)
-        printf("[IDENT Unit:%02XH=%04XH]\n", (int)ch,(int)ID);
+        printf("[IDENT Unit:%02XH=%02X%02XH]\n", (int)ch,(int)ID[0],(int)ID[1]);
 #endif
     return (status & ERROR_MASK);
 }
@@ -901,7 +855,7 @@ int GPIB_SECONDARY_ADDRESS(uint8_t ch)
 #endif
         ///@brief ch = secondary address
         gpib_disable_PPR(SS80p->HEADER.PPR);
-        return(Send_Identify( ch, SS80p->CONFIG.ID) );
+        return(Send_Identify( ch, SS80p->CONFIG.IDENTIFY) );
 
     }
 
@@ -916,7 +870,7 @@ int GPIB_SECONDARY_ADDRESS(uint8_t ch)
 #endif
         ///@brief ch = secondary address
         gpib_disable_PPR(AMIGOp->HEADER.PPR);
-        return( Send_Identify( ch, AMIGOp->CONFIG.ID) );
+        return( Send_Identify( ch, AMIGOp->CONFIG.IDENTIFY) );
     }
 #endif                      // #ifdef AMIGO
 
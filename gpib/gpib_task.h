@@ -35,9 +35,10 @@ uint16_t gpib_trace_read_byte ( void );
 void gpib_trace_task ( char *name , int detail );
 uint16_t gpib_error_test ( uint16_t val );
 void gpib_init_devices ( void );
+void gpib_idle_task ( void );
 uint16_t GPIB_COMMANDS ( uint16_t val , uint8_t unread );
 void gpib_task ( void );
-int Send_Identify ( uint8_t ch , uint16_t ID );
+int Send_Identify ( uint8_t ch , uint8_t *ID );
 int GPIB ( uint8_t ch );
 int GPIB_LISTEN ( uint8_t ch );
 int GPIB_TALK ( uint8_t ch );
@@ -22,6 +22,11 @@
 #include "amigo.h"
 #include "ss80.h"
 #include "gpib_tests.h"
+#include "gpib_capture.h"
+#include "gpib_bench.h"
+#include "latency.h"
+#include "cache.h"
+#include "journal.h"
 #include "stringsup.h"
 #include "printer.h"
 #include "lifutils.h"
@@ -39,15 +44,37 @@ void gpib_help(int full)
     {
         printf("gpib prefix is optional\n"
             "gpib addresses\n"
+#ifdef GPIB_BENCH
+            "gpib bench ADDRESS [blocks [write]]\n"
+#endif
+            "gpib burst [0|1|reset]\n"
+#ifdef CACHE_SUPPORT
+            "gpib cache [reset|on|off|flush|sync [0|1]]\n"
+#endif
+#ifdef GPIB_CAPTURE
+            "gpib capture filename.bin [BUS]\n"
+#endif
             "gpib config\n"
             "gpib debug N\n"
             "gpib elapsed\n"
             "gpib elapsed_reset\n"
+#ifdef GPIB_EVENT_STATS
+            "gpib events [reset]\n"
+#endif
             "gpib ifc\n"
+#ifdef JOURNAL_SUPPORT
+            "gpib journal [reset|on|off|group N]\n"
+#endif
+#ifdef LATENCY_STATS
+            "gpib latency [reset|on|off|csv [filename.csv]]\n"
+#endif
+            "gpib opcodes [reset]\n"
             "gpib plot filename.txt\n"
             "gpib plot_echo\n"
+            "gpib ppr\n"
             "gpib task\n"
             "gpib trace filename.txt [BUS]\n"
+            "gpib tune [apply]\n"
             "\n"
 #ifdef GPIB_EXTENDED_TESTS
 			"gpib port read pins   [A-D]\n"
@@ -99,6 +126,91 @@ int gpib_tests(int argc, char * argv[])
         return(1);
     }
 
+#ifdef GPIB_BENCH
+    if (MATCHARGS(ptr,"bench", (ind+1) ,argc))
+    {
+        int blocks = 1;
+        int write = 0;
+        if(ind+1 < argc)
+            blocks = get_value(argv[ind+1]);
+        if(ind+2 < argc && MATCHI(argv[ind+2],"write"))
+            write = 1;
+        gpib_bench(get_value(argv[ind]), blocks, write);
+        return(1);
+    }
+#endif
+
+    if (MATCHI(ptr,"burst") )
+    {
+        if(ind < argc && MATCHI(argv[ind],"reset"))
+        {
+            gpib_burst_stats(1);
+            return(1);
+        }
+        if(ind < argc)
+            gpib_burst = get_value(argv[ind]) ? 1 : 0;
+        gpib_burst_stats(0);
+        return(1);
+    }
+
+#ifdef CACHE_SUPPORT
+    if (MATCHI(ptr,"cache") )
+    {
+        if(ind < argc && MATCHI(argv[ind],"reset"))
+        {
+            cache_display(1);
+            return(1);
+        }
+        if(ind < argc && MATCHI(argv[ind],"on"))
+            cache_enable = 1;
+        if(ind < argc && MATCHI(argv[ind],"off"))
+        {
+            cache_flush(NULL);
+            cache_enable = 0;
+        }
+        if(ind < argc && MATCHI(argv[ind],"flush"))
+            cache_flush(NULL);
+        if(ind < argc && MATCHI(argv[ind],"sync"))
+            cache_sync = (ind+1 < argc) ? (get_value(argv[ind+1]) ? 1 : 0) : 1;
+        cache_display(0);
+        return(1);
+    }
+#endif
+
+#ifdef JOURNAL_SUPPORT
+    if (MATCHI(ptr,"journal") )
+    {
+        if(ind < argc && MATCHI(argv[ind],"reset"))
+        {
+            journal_display(1);
+            return(1);
+        }
+        if(ind < argc && MATCHI(argv[ind],"on"))
+            journal_enable = 1;
+        if(ind < argc && MATCHI(argv[ind],"off"))
+            journal_off();
+        if(ind+1 < argc && MATCHI(argv[ind],"group"))
+        {
+            journal_group = get_value(argv[ind+1]);
+            if(!journal_group)
+                journal_group = 1;
+        }
+        journal_display(0);
+        return(1);
+    }
+#endif
+
+#ifdef GPIB_CAPTURE
+    if (MATCHARGS(ptr,"capture", (ind+1) ,argc))
+    {
+        int detail = 0;
+        if(argv[ind+1] && MATCH(argv[ind+1],"BUS"))
+            detail = 1;
+        gpib_capture_task(argv[ind], detail);
+        return(1);
+    }
+#endif
+
     if (MATCHARGS(ptr,"addresses",(ind+0),argc))
     {
         display_Addresses();
@@ -124,6 +236,55 @@ int gpib_tests(int argc, char * argv[])
         return(1);
     }
 
+#ifdef GPIB_EVENT_STATS
+    if (MATCHI(ptr,"events") )
+    {
+        gpib_event_display(ind < argc && MATCHI(argv[ind],"reset"));
+        return(1);
+    }
+#endif
+
+#ifdef LATENCY_STATS
+    if (MATCHI(ptr,"latency") )
+    {
+        if(ind < argc && MATCHI(argv[ind],"reset"))
+        {
+            lat_reset();
+            return(1);
+        }
+        if(ind < argc && MATCHI(argv[ind],"csv"))
+        {
+            lat_csv(argv[ind+1]);
+            return(1);
+        }
+        if(ind < argc && MATCHI(argv[ind],"on"))
+            lat_enable = 1;
+        if(ind < argc && MATCHI(argv[ind],"off"))
+            lat_enable = 0;
+        lat_dump();
+        return(1);
+    }
+#endif
+
+    if (MATCHI(ptr,"tune") )
+    {
+        tune_drives(ind < argc && MATCHI(argv[ind],"apply"));
+        return(1);
+    }
+
+    if (MATCHI(ptr,"opcodes") )
+    {
+        SS80_op_display(ind < argc && MATCHI(argv[ind],"reset"));
+        return(1);
+    }
+
+    if (MATCHARGS(ptr,"ppr",(ind+0),argc))
+    {
+        printf("PPR enabled:%02XH, parallel polls seen:%u\n",
+            0xff & ppr_reg(), (unsigned) gpib_pp_count);
+        return(1);
+    }
+
     if ( MATCHARGS(ptr, "ifc",(ind+0),argc))
     {
         gpib_assert_ifc();
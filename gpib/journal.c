@@ -0,0 +1,572 @@
+/**
+ @file gpib/journal.c
+
+ @brief SS80 write-ahead journal for HP85 disk emulator project for AVR.
+
+ @par Edit History
+ - [1.0]   [Mike Gore]  Initial revision of file.
+
+ @par Copyright &copy; 2014-2020 Mike Gore, All rights reserved. GPL
+ @see http://github.com/magore/hp85disk
+ @see http://github.com/magore/hp85disk/COPYRIGHT.md for Copyright details
+
+ - A power loss while blocks are written back can leave a LIF directory
+   half updated on the SD Card.
+ - With JOURNAL = 1 in the config file each SS80 write transaction is
+   first recorded in a journal file next to the image, ie /ss80-1.jnl
+   for /ss80-1.lif, and closed with a commit record.
+   - Data record: type, 4 byte position, 2 byte size, data.
+   - Commit record: type, 4 byte sequence, 2 byte record count, 4 byte checksum.
+ - The journal is synced before any block of the image is written, so
+   the image never has data the journal does not.
+ - Group commit: the journal is synced once per JOURNAL_GROUP commits
+   instead of once per commit - or earlier when the image is written.
+ - Once the cache has written everything to the image the journal is emptied.
+ - At startup committed transactions are written to the image again and
+   the journal is removed, see journal_replay().
+   - A transaction without a good commit record is dropped.
+ - Transactions larger than the cache, or written around it, reach the
+   image before they end - they are committed in parts, see journal_sync().
+ - A journal write error, or "gpib journal off", removes the journal file.
+ - Build with JOURNAL_SUPPORT=1, it needs CACHE_SUPPORT=1.
+ - Use "gpib journal" to display or reset the counters.
+
+*/
+
+
+#include "user_config.h"
+
+#include "defines.h"
+#include "gpib_hal.h"
+#include "gpib.h"
+#include "gpib_task.h"
+#include "cache.h"
+#include "journal.h"
+
+#include "posix.h"
+
+///@brief Journal enabled, JOURNAL in the config file
+uint8_t journal_enable = 0;
+
+///@brief Commits per journal sync, JOURNAL_GROUP in the config file
+uint8_t journal_group = 1;
+
+#ifdef JOURNAL_SUPPORT
+///@brief Journal counters
+JournalStatsType journal_stats;
+
+///@brief Open journal file, allocated on first use
+static FIL *journal_fp = NULL;
+
+///@brief Image the open journal belongs to, NULL if none is open
+static void *journal_dev = NULL;
+
+///@brief Journal file name of journal_dev
+static char journal_name[JOURNAL_NAME_LEN];
+
+///@brief Transaction state
+static uint8_t journal_tx = 0;          ///< a transaction is open
+static uint8_t journal_used = 0;        ///< the journal file has records
+static uint8_t journal_pending = 0;     ///< commits not synced yet
+static uint16_t journal_count = 0;      ///< data records in the open transaction
+static uint32_t journal_sum = 0;        ///< checksum of the open transaction
+static uint32_t journal_seq = 0;        ///< commit sequence number
+#endif
+
+
+/// @brief Journal file name of an image - the extension becomes .jnl
+/// @param[in] name: image file name
+/// @param[out] jname: journal file name, JOURNAL_NAME_LEN bytes
+/// @return 0 on success, -1 if the name is too long
+static int journal_file_name(char *name, char *jname)
+{
+    char *ext = NULL;
+    char *ptr;
+    int len = strlen(name);
+
+    for(ptr = name; *ptr; ++ptr)
+    {
+        if(*ptr == '.')
+            ext = ptr;
+        if(*ptr == '/')
+            ext = NULL;
+    }
+    if(ext != NULL)
+        len = ext - name;
+    if(len + 5 > JOURNAL_NAME_LEN)
+        return(-1);
+    memcpy(jname, name, len);
+    strcpy(jname + len, ".jnl");
+    return(0);
+}
+
+
+#ifdef JOURNAL_SUPPORT
+
+
+/// @brief Add bytes to a checksum
+/// @param[in] sum: checksum so far
+/// @param[in] buf: data
+/// @param[in] size: number of bytes
+/// @return new checksum
+static uint32_t journal_checksum(uint32_t sum, uint8_t *buf, int size)
+{
+    while(size-- > 0)
+        sum = ((sum << 1) | (sum >> 31)) + *buf++;
+    return(sum);
+}
+
+
+/// @brief Close and remove the open journal
+///
+/// - Later image writes are not journaled, a journal left on the card
+///   would write its older data over them at the next startup.
+/// - The dirty blocks in the cache are newer than the journal, so it
+///   can go before they are written back.
+/// @return void
+static void journal_remove()
+{
+    if(journal_dev == NULL)
+        return;
+    f_close(journal_fp);
+    f_unlink(journal_name);
+    journal_dev = NULL;
+    journal_tx = 0;
+    journal_used = 0;
+    journal_pending = 0;
+}
+
+
+/// @brief Give up on the journal after a write error
+///
+/// - The image is still written, just without the journal.
+/// @return void
+static void journal_fail()
+{
+    printf("[Journal %s write failed, journal off]\n", journal_name);
+    journal_stats.errors++;
+    journal_remove();
+    journal_tx = 0;
+    journal_enable = 0;
+}
+
+
+/// @brief Append to the journal
+/// @param[in] buf: data
+/// @param[in] size: number of bytes
+/// @return 0 on success, -1 on error
+static int journal_write(uint8_t *buf, int size)
+{
+    UINT bytes = 0;
+    int rc;
+
+    rc = dbf_write(journal_fp, buf, size, &bytes);
+    if(rc != FR_OK || bytes != (UINT) size)
+    {
+        journal_fail();
+        return(-1);
+    }
+    journal_used = 1;
+    return(0);
+}
+
+
+/// @brief Sync the journal if commits are waiting
+/// @return void
+static void journal_flush()
+{
+    if(journal_dev == NULL || !journal_pending)
+        return;
+    if(f_sync(journal_fp) != FR_OK)
+    {
+        journal_fail();
+        return;
+    }
+    journal_pending = 0;
+    journal_stats.syncs++;
+}
+
+
+/// @brief Write a commit record for the data records so far
+/// @return void
+static void journal_put_commit()
+{
+    uint8_t rec[JOURNAL_COMMIT_SIZE];
+
+    if(!journal_count)
+        return;
+    rec[0] = JOURNAL_COMMIT;
+    V2B_LSB(rec, 1, 4, ++journal_seq);
+    V2B_LSB(rec, 5, 2, journal_count);
+    V2B_LSB(rec, 7, 4, journal_sum);
+    if(journal_write(rec, sizeof(rec)))
+        return;
+    journal_count = 0;
+    journal_sum = 0;
+    journal_stats.commits++;
+    ++journal_pending;
+}
+
+
+/// @brief Start a write transaction
+///
+/// - Only one image has an open journal, the one before is written back first.
+/// @param[in] dev: image, the SS80 media
+/// @param[in] name: image file name
+/// @return void
+void journal_begin(void *dev, char *name)
+{
+    int rc;
+
+    if(!journal_enable)
+        return;
+
+    if(journal_dev != NULL && journal_dev != dev)
+    {
+        journal_tx = 0;
+        cache_flush(journal_dev);               // Ends with journal_done()
+        if(journal_dev != NULL)
+        {
+            ///@brief Write back failed - keep the journal for the next startup
+            f_close(journal_fp);
+            journal_dev = NULL;
+        }
+    }
+
+    if(journal_dev == NULL)
+    {
+        if(journal_fp == NULL)
+            journal_fp = safecalloc(sizeof(FIL), 1);
+        if(journal_fp == NULL || journal_file_name(name, journal_name))
+        {
+            journal_fail();
+            return;
+        }
+        rc = dbf_open(journal_fp, journal_name, FA_OPEN_ALWAYS | FA_READ | FA_WRITE);
+        if(rc != FR_OK)
+        {
+            journal_fail();
+            return;
+        }
+        journal_dev = dev;
+        if(dbf_lseek(journal_fp, f_size(journal_fp)) != FR_OK)
+        {
+            journal_fail();
+            return;
+        }
+        journal_used = f_size(journal_fp) ? 1 : 0;
+        journal_pending = 0;
+    }
+
+    ///@brief An interrupted transaction - its data is in the cache already
+    if(journal_tx)
+        journal_put_commit();
+
+    journal_tx = 1;
+    journal_count = 0;
+    journal_sum = 0;
+}
+
+
+/// @brief Record data of the open transaction
+/// @param[in] dev: image
+/// @param[in] pos: byte position in the image
+/// @param[in] buf: data
+/// @param[in] size: number of bytes
+/// @return void
+void journal_data(void *dev, uint32_t pos, uint8_t *buf, int size)
+{
+    uint8_t head[JOURNAL_DATA_HEAD];
+
+    if(!journal_tx || journal_dev != dev || size <= 0)
+        return;
+
+    head[0] = JOURNAL_DATA;
+    V2B_LSB(head, 1, 4, pos);
+    V2B_LSB(head, 5, 2, size);
+    if(journal_write(head, sizeof(head)))
+        return;
+    if(journal_write(buf, size))
+        return;
+    journal_sum = journal_checksum(journal_sum, head, sizeof(head));
+    journal_sum = journal_checksum(journal_sum, buf, size);
+    ++journal_count;
+    journal_stats.records++;
+    journal_stats.bytes += size;
+}
+
+
+/// @brief End the open transaction
+///
+/// - The journal is synced every journal_group commits.
+/// @param[in] dev: image
+/// @return void
+void journal_commit(void *dev)
+{
+    if(!journal_tx || journal_dev != dev)
+        return;
+    journal_put_commit();
+    journal_tx = 0;
+    if(journal_pending >= journal_group)
+        journal_flush();
+}
+
+
+/// @brief Is a transaction open on an image
+/// @param[in] dev: image
+/// @return 1 if open
+int journal_active(void *dev)
+{
+    return(journal_tx && journal_dev == dev);
+}
+
+
+/// @brief Make the journal safe before the image is written
+///
+/// - Called by the cache before every image write.
+/// - Data of the open transaction is committed now, it is reaching the image.
+/// @param[in] dev: image
+/// @return void
+void journal_sync(void *dev)
+{
+    if(journal_dev != dev || dev == NULL)
+        return;
+    if(journal_tx && journal_count)
+    {
+        journal_put_commit();
+        journal_stats.splits++;
+    }
+    journal_flush();
+}
+
+
+/// @brief Empty the journal once the image has all of its data
+///
+/// - Called by the cache when no dirty blocks of the image are left.
+/// @param[in] dev: image
+/// @return void
+void journal_done(void *dev)
+{
+    int rc;
+
+    if(journal_dev != dev || dev == NULL || journal_tx)
+        return;
+
+    rc = FR_OK;
+    if(journal_used)
+    {
+        rc = dbf_lseek(journal_fp, 0);
+        if(rc == FR_OK)
+            rc = f_truncate(journal_fp);
+        journal_stats.checkpoints++;
+    }
+    if(dbf_close(journal_fp) != FR_OK && rc == FR_OK)
+        rc = FR_DISK_ERR;
+    journal_dev = NULL;
+    journal_used = 0;
+    journal_pending = 0;
+    if(rc != FR_OK)
+        printf("[Journal %s checkpoint failed]\n", journal_name);
+}
+
+
+/// @brief Turn the journal off
+///
+/// - Dirty blocks are written back first, that empties the open journal.
+/// - A journal still open after that, ie after a write back error or with
+///   a transaction open, is removed - see journal_remove().
+/// @return void
+void journal_off()
+{
+    cache_flush(NULL);
+    journal_remove();
+    journal_enable = 0;
+}
+
+
+/// @brief Drop the journal of an image - the image was overwritten
+/// @param[in] dev: image
+/// @param[in] name: image file name
+/// @return void
+void journal_discard(void *dev, char *name)
+{
+    char jname[JOURNAL_NAME_LEN];
+
+    if(journal_dev == dev && dev != NULL)
+    {
+        f_close(journal_fp);
+        journal_dev = NULL;
+        journal_tx = 0;
+    }
+    if(journal_file_name(name, jname) == 0)
+        f_unlink(jname);
+}
+
+
+/// @brief Read one journal record header
+/// @param[in] fp: journal file
+/// @param[out] rec: record, type first
+/// @return record size without data, 0 at the end or on a bad record
+static int journal_read_head(FIL *fp, uint8_t *rec)
+{
+    UINT bytes = 0;
+    int size;
+
+    if(f_read(fp, rec, 1, &bytes) != FR_OK || bytes != 1)
+        return(0);
+    if(rec[0] == JOURNAL_DATA)
+        size = JOURNAL_DATA_HEAD;
+    else if(rec[0] == JOURNAL_COMMIT)
+        size = JOURNAL_COMMIT_SIZE;
+    else
+        return(0);
+    if(f_read(fp, rec + 1, size - 1, &bytes) != FR_OK || bytes != (UINT) (size - 1))
+        return(0);
+    return(size);
+}
+
+
+/// @brief Write committed transactions of a journal to its image
+///
+/// - Called at startup for every image, before the host can write.
+/// - Each transaction is checked with its commit record first, then applied.
+/// - The journal is removed afterwards.
+/// - Uses gpib_iobuff.
+/// @param[in] name: image file name
+/// @return transactions replayed, -1 on error
+int journal_replay(char *name)
+{
+    char jname[JOURNAL_NAME_LEN];
+    uint8_t rec[JOURNAL_COMMIT_SIZE];
+    FIL jfp, ifp;
+    UINT bytes;
+    uint32_t start, pos, sum, next;
+    int count, size, i, head;
+    int image = 0;
+    int done = 0;
+    int ret = 0;
+
+    if(journal_file_name(name, jname))
+        return(-1);
+    if(f_open(&jfp, jname, FA_OPEN_EXISTING | FA_READ) != FR_OK)
+        return(0);
+
+    start = 0;
+    count = 0;
+    sum = 0;
+    while( (head = journal_read_head(&jfp, rec)) )
+    {
+        if(rec[0] == JOURNAL_DATA)
+        {
+            size = B2V_LSB(rec, 5, 2);
+            if(size <= 0 || size > GPIB_IOBUFF_LEN)
+                break;
+            if(f_read(&jfp, gpib_iobuff, size, &bytes) != FR_OK || bytes != (UINT) size)
+                break;
+            sum = journal_checksum(sum, rec, head);
+            sum = journal_checksum(sum, gpib_iobuff, size);
+            ++count;
+            continue;
+        }
+
+        ///@brief Commit - a torn or damaged transaction ends the replay
+        if(B2V_LSB(rec, 5, 2) != (uint32_t) count || B2V_LSB(rec, 7, 4) != sum)
+            break;
+        next = f_tell(&jfp);
+
+        if(!image)
+        {
+            if(dbf_open(&ifp, name, FA_OPEN_EXISTING | FA_READ | FA_WRITE) != FR_OK)
+            {
+                ret = -1;
+                break;
+            }
+            image = 1;
+        }
+
+        f_lseek(&jfp, start);
+        for(i=0;i<count;++i)
+        {
+            journal_read_head(&jfp, rec);
+            pos = B2V_LSB(rec, 1, 4);
+            size = B2V_LSB(rec, 5, 2);
+            if(f_read(&jfp, gpib_iobuff, size, &bytes) != FR_OK || bytes != (UINT) size)
+                break;
+            if(dbf_lseek(&ifp, pos) != FR_OK)
+                break;
+            if(dbf_write(&ifp, gpib_iobuff, size, &bytes) != FR_OK || bytes != (UINT) size)
+                break;
+        }
+        if(i < count)
+        {
+            ret = -1;
+            break;
+        }
+        f_lseek(&jfp, next);
+        ++done;
+
+        start = next;
+        count = 0;
+        sum = 0;
+    }
+
+    f_close(&jfp);
+    if(image && dbf_close(&ifp) != FR_OK)
+        ret = -1;
+    if(ret < 0)
+    {
+        ///@brief Keep the journal, the next startup tries again
+        printf("[Journal %s replay failed]\n", jname);
+        return(-1);
+    }
+
+    f_unlink(jname);
+    journal_stats.replayed += done;
+    if(done)
+        printf("Journal %s: %d transactions replayed\n", jname, done);
+    return(done);
+}
+
+
+/// @brief Display or reset the journal counters
+/// @param[in] reset: clear the counters
+/// @return void
+void journal_display(int reset)
+{
+    if(reset)
+    {
+        memset(&journal_stats, 0, sizeof(journal_stats));
+        return;
+    }
+
+    printf("Journal: %s, group commit:%d\n",
+        journal_enable ? "enabled" : "disabled", (int) journal_group);
+    printf("  records:%lu bytes:%lu commits:%lu split:%lu\n",
+        (unsigned long) journal_stats.records,
+        (unsigned long) journal_stats.bytes,
+        (unsigned long) journal_stats.commits,
+        (unsigned long) journal_stats.splits);
+    printf("  syncs:%lu checkpoints:%lu replayed:%lu errors:%lu\n",
+        (unsigned long) journal_stats.syncs,
+        (unsigned long) journal_stats.checkpoints,
+        (unsigned long) journal_stats.replayed,
+        (unsigned long) journal_stats.errors);
+}
+
+#else  // #ifdef JOURNAL_SUPPORT
+
+/// @brief Remove the journal of an image
+///
+/// - Not built with JOURNAL_SUPPORT - a journal left by a build that had it
+///   would write its older data over our writes once journals are back.
+/// @param[in] name: image file name
+/// @return 0
+int journal_replay(char *name)
+{
+    char jname[JOURNAL_NAME_LEN];
+
+    if(journal_file_name(name, jname) == 0 && f_unlink(jname) == FR_OK)
+        printf("Journal %s: removed, not replayed\n", jname);
+    return(0);
+}
+#endif // #ifdef JOURNAL_SUPPORT
@@ -0,0 +1,76 @@
+/**
+ @file gpib/journal.h
+
+ @brief SS80 write-ahead journal for HP85 disk emulator project for AVR.
+
+ @par Edit History
+ - [1.0]   [Mike Gore]  Initial revision of file.
+
+ @par Copyright &copy; 2014-2020 Mike Gore, All rights reserved. GPL
+ @see http://github.com/magore/hp85disk
+ @see http://github.com/magore/hp85disk/COPYRIGHT.md for Copyright details
+
+*/
+
+#ifndef _JOURNAL_H_
+#define _JOURNAL_H_
+
+#if defined(JOURNAL_SUPPORT) && !defined(CACHE_SUPPORT)
+#error JOURNAL_SUPPORT needs CACHE_SUPPORT
+#endif
+
+///@brief Journal record types, the first byte of every record
+#define JOURNAL_DATA        0xD5    ///< data: position, size, data
+#define JOURNAL_COMMIT      0xC3    ///< commit: sequence, records, checksum
+
+///@brief Record header sizes in bytes
+#define JOURNAL_DATA_HEAD   7       ///< type, 4 byte position, 2 byte size
+#define JOURNAL_COMMIT_SIZE 11      ///< type, 4 byte sequence, 2 byte records, 4 byte checksum
+
+///@brief Longest journal file name
+#define JOURNAL_NAME_LEN    64
+
+///@brief Journal counters
+typedef struct
+{
+    uint32_t records;       ///< data records written
+    uint32_t bytes;         ///< data bytes written
+    uint32_t commits;       ///< transactions committed
+    uint32_t splits;        ///< transactions committed early, the image was written mid transaction
+    uint32_t syncs;         ///< journal syncs, one per group of commits
+    uint32_t checkpoints;   ///< journals emptied after the image was written
+    uint32_t replayed;      ///< transactions replayed at startup
+    uint32_t errors;        ///< journal write errors
+} JournalStatsType;
+
+extern uint8_t journal_enable;
+extern uint8_t journal_group;
+extern JournalStatsType journal_stats;
+
+#ifndef JOURNAL_SUPPORT
+///@brief Not built - SS80 writes are not journaled
+#define journal_begin(dev,name)         ((void) (dev))
+#define journal_data(dev,pos,buf,size)  ((void) (dev))
+#define journal_commit(dev)             ((void) (dev))
+#define journal_sync(dev)               ((void) (dev))
+#define journal_done(dev)               ((void) (dev))
+#define journal_discard(dev,name)       ((void) (dev))
+#endif
+
+/* journal.c */
+#ifdef JOURNAL_SUPPORT
+void journal_begin ( void *dev , char *name );
+void journal_data ( void *dev , uint32_t pos , uint8_t *buf , int size );
+void journal_commit ( void *dev );
+int journal_active ( void *dev );
+void journal_sync ( void *dev );
+void journal_done ( void *dev );
+void journal_off ( void );
+void journal_discard ( void *dev , char *name );
+int journal_replay ( char *name );
+void journal_display ( int reset );
+#else
+int journal_replay ( char *name );
+#endif
+
+#endif  // #ifndef _JOURNAL_H_
@@ -0,0 +1,220 @@
+/**
+ @file gpib/latency.c
+
+ @brief Per device latency histograms for HP85 disk emulator project for AVR.
+
+ @par Edit History
+ - [1.0]   [Mike Gore]  Initial revision of file.
+
+ @par Copyright &copy; 2014-2020 Mike Gore, All rights reserved. GPL
+ @see http://github.com/magore/hp85disk
+ @see http://github.com/magore/hp85disk/COPYRIGHT.md for Copyright details
+
+ - Each disk device in Devices[] has a histogram for the command phase,
+   disk I/O and GPIB data transfers.
+ - A sample costs two clock_gettime() calls and a few additions.
+ - Build with LATENCY_STATS=1, each disk then has about 240 bytes of
+   histograms. Without it lat_begin() and lat_end() are empty.
+ - Use "gpib latency" to display, reset or save the results as CSV.
+
+*/
+
+
+#include "user_config.h"
+
+#include "defines.h"
+#include "drives.h"
+#include "gpib_hal.h"
+#include "gpib.h"
+#include "gpib_task.h"
+#include "latency.h"
+
+#include "posix.h"
+
+/// @brief Histograms of the active device, set by set_active_device()
+LatencyType *LATp = NULL;
+
+/// @brief Latency measurements enabled
+uint8_t lat_enable = 1;
+
+#ifdef LATENCY_STATS
+/// @brief Stage names for lat_dump() and lat_csv()
+static char *lat_names[LAT_STAGES] = { "CMD", "DISK", "GPIB" };
+
+
+/// @brief Start a measurement
+/// @param[out] start: start time
+/// @return void
+void lat_begin(lat_t *start)
+{
+    clock_gettime(0, (ts_t *) start);
+}
+
+
+/// @brief End a measurement and add it to the active device histogram
+/// @param[in] stage: LAT_CMD, LAT_DISK or LAT_GPIB
+/// @param[in] start: start time from lat_begin()
+/// @return void
+void lat_end(int stage, lat_t *start)
+{
+    lat_end_bytes(stage, start, 0);
+}
+
+
+/// @brief End a measurement of a transfer and add it to the active device histogram
+/// @param[in] stage: LAT_CMD, LAT_DISK or LAT_GPIB
+/// @param[in] start: start time from lat_begin()
+/// @param[in] bytes: bytes transferred, negative counts as 0
+/// @return void
+void lat_end_bytes(int stage, lat_t *start, int bytes)
+{
+    uint32_t us;
+    LatHistType *h;
+    uint8_t b;
+
+    if(!lat_enable || LATp == NULL || stage < 0 || stage >= LAT_STAGES)
+        return;
+
+    us = timespec_us((ts_t *) start, NULL);
+
+    b = 0;
+    while(b < LAT_BUCKETS-1 && us >= (1UL << (b+LAT_SHIFT)))
+        ++b;
+
+    h = &LATp->stage[stage];
+    h->count[b]++;
+    h->samples++;
+    ///@brief Saturate - 32 bit math only on the AVR
+    if(h->total_us + us < h->total_us)
+        h->total_us = 0xffffffffUL;
+    else
+        h->total_us += us;
+    if(bytes > 0)
+    {
+        if(h->bytes + (uint32_t) bytes < h->bytes)
+            h->bytes = 0xffffffffUL;
+        else
+            h->bytes += bytes;
+    }
+    if(us > h->max_us)
+        h->max_us = us;
+}
+
+
+/// @brief Clear the histograms of all devices
+/// @return void
+void lat_reset()
+{
+    int i;
+    for(i=0;i<MAX_DEVICES;++i)
+    {
+        if(Devices[i].lat != NULL)
+            memset(Devices[i].lat, 0, sizeof(LatencyType));
+    }
+}
+
+
+/// @brief Average of a histogram
+/// @param[in] h: histogram
+/// @return average in microseconds
+static uint32_t lat_avg(LatHistType *h)
+{
+    if(!h->samples)
+        return(0);
+    return( (uint32_t) (h->total_us / h->samples) );
+}
+
+
+/// @brief Display the histograms of all devices
+/// @return void
+void lat_dump()
+{
+    int i,s,b;
+    LatencyType *lat;
+    LatHistType *h;
+
+    printf("Latency: %s, bucket N counts times < %d << N us\n",
+        lat_enable ? "enabled" : "disabled", 1 << LAT_SHIFT);
+
+    for(i=0;i<MAX_DEVICES;++i)
+    {
+        lat = (LatencyType *) Devices[i].lat;
+        if(lat == NULL || (Devices[i].TYPE != AMIGO_TYPE && Devices[i].TYPE != SS80_TYPE))
+            continue;
+        printf("Device:%d %s address:%d\n",
+            i, type_to_str(Devices[i].TYPE), Devices[i].ADDRESS);
+        for(s=0;s<LAT_STAGES;++s)
+        {
+            h = &lat->stage[s];
+            printf("  %-4s samples:%8ld avg:%8ld us max:%8ld us\n",
+                lat_names[s], (long) h->samples, (long) lat_avg(h), (long) h->max_us);
+            if(!h->samples)
+                continue;
+            printf("      ");
+            for(b=0;b<LAT_BUCKETS;++b)
+            {
+                if(!h->count[b])
+                    continue;
+                if(b == LAT_BUCKETS-1)
+                    printf(" >=%ld:%ld", (1L << (b-1+LAT_SHIFT)), (long) h->count[b]);
+                else
+                    printf(" <%ld:%ld", (1L << (b+LAT_SHIFT)), (long) h->count[b]);
+            }
+            printf("\n");
+        }
+    }
+}
+
+
+/// @brief Save the histograms of all devices as CSV
+///
+/// - One line per device and stage, bucket columns are labeled by their upper limit
+/// @param[in] name: file name, NULL or empty for the console
+/// @return 1 on success, 0 on error
+int lat_csv(char *name)
+{
+    FILE *fo = stdout;
+    int i,s,b;
+    LatencyType *lat;
+    LatHistType *h;
+
+    if(name && *name)
+    {
+        fo = fopen(name,"wb");
+        if(fo == NULL)
+        {
+            perror("open failed");
+            return(0);
+        }
+    }
+
+    fprintf(fo,"device,type,address,stage,samples,avg_us,max_us");
+    for(b=0;b<LAT_BUCKETS-1;++b)
+        fprintf(fo,",lt%ld", (1L << (b+LAT_SHIFT)));
+    fprintf(fo,",ge%ld\n", (1L << (LAT_BUCKETS-2+LAT_SHIFT)));
+
+    for(i=0;i<MAX_DEVICES;++i)
+    {
+        lat = (LatencyType *) Devices[i].lat;
+        if(lat == NULL || (Devices[i].TYPE != AMIGO_TYPE && Devices[i].TYPE != SS80_TYPE))
+            continue;
+        for(s=0;s<LAT_STAGES;++s)
+        {
+            h = &lat->stage[s];
+            fprintf(fo,"%d,%s,%d,%s,%ld,%ld,%ld",
+                i, type_to_str(Devices[i].TYPE), Devices[i].ADDRESS, lat_names[s],
+                (long) h->samples, (long) lat_avg(h), (long) h->max_us);
+            for(b=0;b<LAT_BUCKETS;++b)
+                fprintf(fo,",%ld", (long) h->count[b]);
+            fprintf(fo,"\n");
+        }
+    }
+
+    if(fo != stdout)
+    {
+        fclose(fo);
+        printf("Saved:%s\n", name);
+    }
+    return(1);
+}
+#endif // #ifdef LATENCY_STATS
@@ -0,0 +1,74 @@
+/**
+ @file gpib/latency.h
+
+ @brief Per device latency histograms for HP85 disk emulator project for AVR.
+
+ @par Edit History
+ - [1.0]   [Mike Gore]  Initial revision of file.
+
+ @par Copyright &copy; 2014-2020 Mike Gore, All rights reserved. GPL
+ @see http://github.com/magore/hp85disk
+ @see http://github.com/magore/hp85disk/COPYRIGHT.md for Copyright details
+
+*/
+
+#ifndef _LATENCY_H_
+#define _LATENCY_H_
+
+///@brief Histogram buckets - bucket N counts times below 2^(N+LAT_SHIFT) microseconds
+/// The last bucket counts everything else
+#define LAT_SHIFT   4
+#define LAT_BUCKETS 16
+
+///@brief Transaction stages we time
+enum
+{
+    LAT_CMD,    // command phase - read and decode the command bytes
+    LAT_DISK,   // disk read or write
+    LAT_GPIB,   // GPIB data transfer
+    LAT_STAGES
+};
+
+///@brief One stage histogram
+typedef struct
+{
+    uint32_t count[LAT_BUCKETS];
+    uint32_t samples;
+    uint32_t max_us;
+    uint32_t total_us;      ///< saturates at 0xffffffff
+    uint32_t bytes;         ///< bytes moved, see lat_end_bytes(), saturates
+} LatHistType;
+
+///@brief Latency histograms of one device, see Devices[].lat
+typedef struct
+{
+    LatHistType stage[LAT_STAGES];
+} LatencyType;
+
+///@brief Start time of a measurement
+typedef ts_t lat_t;
+
+extern LatencyType *LATp;
+extern uint8_t lat_enable;
+
+#ifdef LATENCY_STATS
+///@brief Histograms of a new device, see alloc_device()
+#define lat_alloc()             safecalloc(sizeof(LatencyType),1)
+#else
+///@brief Not built - no RAM is used and nothing is measured
+#define lat_alloc()             NULL
+#define lat_begin(start)        ((void) (start))
+#define lat_end(stage,start)    ((void) (start))
+#define lat_end_bytes(stage,start,bytes)    ((void) (start))
+#endif
+
+#ifdef LATENCY_STATS
+/* latency.c */
+void lat_begin ( lat_t *start );
+void lat_end ( int stage , lat_t *start );
+void lat_end_bytes ( int stage , lat_t *start , int bytes );
+void lat_reset ( void );
+void lat_dump ( void );
+int lat_csv ( char *name );
+#endif
+#endif // #ifndef _LATENCY_H_
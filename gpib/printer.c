@@ -276,18 +276,18 @@ void plot_echo( int gpib_address)
 // DEBUGGING
     gpib_decode_header(stdout);
 
-    len = controller_send_str(from,to,"*idn?\n",0);
-    len = controller_read_str(to,from, line, 256 );
+    len = controller_send_str(from,to,0,"*idn?\n",0);
+    len = controller_read_str(to,from,0, line, 256 );
     printf("received:[%d] %s\n", len, line);
 
-    len = controller_send_str(from,to,":HARDcopy:DEVice?\n",0);
-    len = controller_read_str(to, from, line, 256);
+    len = controller_send_str(from,to,0,":HARDcopy:DEVice?\n",0);
+    len = controller_read_str(to, from, 0, line, 256);
     printf("received:[%d] %s\n", len, line);
 
-    //len = controller_send_str(from,to,":PRINt?\n",0);
-    //len = controller_read_str(to, from, line, 256);
+    //len = controller_send_str(from,to,0,":PRINt?\n",0);
+    //len = controller_read_str(to, from, 0, line, 256);
 
-    len = controller_send_str(from,to,":wav:data?\n",0);
+    len = controller_send_str(from,to,0,":wav:data?\n",0);
     len = controller_read_trace(to,from);
     printf("received:[%d] bytes\n", len);
 }
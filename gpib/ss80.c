@@ -26,6 +26,9 @@
 #include "gpib_task.h"
 #include "amigo.h"
 #include "ss80.h"
+#include "latency.h"
+#include "cache.h"
+#include "journal.h"
 
 /// @verbatim
 ///  See LIF filesystem Reference
@@ -163,12 +166,11 @@ void V2B_MSB_Index1(uint8_t *B, int index,int size, uint32_t val)
 }
 
 ///@brief Pack Controller data into bytes
-///@param[out] *size: number of bytes in result
-///@return pointer to packer array
-uint8_t *SS80ControllerPack(int *size)
+///@param[in] disk: SS80 device
+///@param[out] B: SS80_DESCRIBE_CONTROLLER bytes
+///@return void
+void SS80ControllerPack(SS80DiskType *disk, uint8_t *B)
 {
-    static uint8_t B[5];
-    *size = 5;
     /*
         uint8_t C1;  //<  MSB units installed bit field
                      //< one bit per unit, Unit 15 always set
@@ -183,20 +185,20 @@ uint8_t *SS80ControllerPack(int *size)
                  //< 5 = SS/80 integrated multi-unit controller.
                  //< 6 = SS/80 integrated multi-port controller.
     */
-    V2B_MSB_Index1(B,1,2,SS80p->CONTROLLER.UNITS_INSTALLED);
-    V2B_MSB_Index1(B,2,2,SS80p->CONTROLLER.TRANSFER_RATE);
-    V2B_MSB_Index1(B,5,1,SS80p->CONTROLLER.TYPE);
-
-    return(B);
+    V2B_MSB_Index1(B,1,2,disk->CONTROLLER.UNITS_INSTALLED);
+    V2B_MSB_Index1(B,3,2,disk->CONTROLLER.TRANSFER_RATE);
+    V2B_MSB_Index1(B,5,1,disk->CONTROLLER.TYPE);
 }
 
 ///@brief Pack Unit data into bytes
-///@param[out] *size: number of bytes in result
-///@return pointer to packer array
-uint8_t *SS80UnitPack(int *size)
+///@param[in] disk: SS80 device
+///@param[in] media: unit and volume described
+///@param[out] B: SS80_DESCRIBE_UNIT bytes
+///@return void
+void SS80UnitPack(SS80DiskType *disk, SS80MediaType *media, uint8_t *B)
 {
-    static uint8_t B[19];
-    *size = 19;
+    uint8_t volumes = 0;
+    int i;
     /*
         uint8_t U1;  //<  Type 0-Fixed, 1-Flexible, 2-Tape
                      //< (+128-dumb, does not detect media change)
@@ -221,27 +223,38 @@ uint8_t *SS80UnitPack(int *size)
         uint8_t U19; //<  Removable volume byte, one bit per volume,
                      //< ie 00000111 = 3 volumes
     */
-    V2B_MSB_Index1(B,1,1,SS80p->UNIT.UNIT_TYPE);
-    V2B_MSB_Index1(B,2,3,SS80p->UNIT.DEVICE_NUMBER);
-    V2B_MSB_Index1(B,5,2,SS80p->UNIT.BYTES_PER_BLOCK);
-    V2B_MSB_Index1(B,7,1,SS80p->UNIT.BUFFERED_BLOCKS);
-    V2B_MSB_Index1(B,8,1,SS80p->UNIT.BURST_SIZE);
-    V2B_MSB_Index1(B,9,2,SS80p->UNIT.BLOCK_TIME);
-    V2B_MSB_Index1(B,11,2,SS80p->UNIT.CONTINUOUS_TRANSFER_RATE);
-    V2B_MSB_Index1(B,13,2,SS80p->UNIT.OPTIMAL_RETRY_TIME);
-    V2B_MSB_Index1(B,15,2,SS80p->UNIT.ACCESS_TIME);
-    V2B_MSB_Index1(B,17,1,SS80p->UNIT.MAXIMUM_INTERLEAVE);
-    V2B_MSB_Index1(B,18,1,SS80p->UNIT.FIXED_VOLUMES);
-    V2B_MSB_Index1(B,19,1,SS80p->UNIT.REMOVABLE_VOLUMES);
-    return(B);
+    V2B_MSB_Index1(B,1,1,disk->UNIT.UNIT_TYPE);
+    V2B_MSB_Index1(B,2,3,disk->UNIT.DEVICE_NUMBER);
+    V2B_MSB_Index1(B,5,2,disk->UNIT.BYTES_PER_BLOCK);
+    V2B_MSB_Index1(B,7,1,disk->UNIT.BUFFERED_BLOCKS);
+    V2B_MSB_Index1(B,8,1,disk->UNIT.BURST_SIZE);
+    V2B_MSB_Index1(B,9,2,disk->UNIT.BLOCK_TIME);
+    V2B_MSB_Index1(B,11,2,disk->UNIT.CONTINUOUS_TRANSFER_RATE);
+    V2B_MSB_Index1(B,13,2,disk->UNIT.OPTIMAL_RETRY_TIME);
+    V2B_MSB_Index1(B,15,2,disk->UNIT.ACCESS_TIME);
+    V2B_MSB_Index1(B,17,1,disk->UNIT.MAXIMUM_INTERLEAVE);
+    ///@brief Units share one description, the volume bytes are per unit
+    for(i=0;i<disk->MEDIA_COUNT;++i)
+    {
+        if(disk->MEDIA[i].UNIT_NUMBER == media->UNIT_NUMBER)
+            volumes |= (1 << disk->MEDIA[i].VOLUME_NUMBER);
+    }
+    V2B_MSB_Index1(B,18,1,disk->UNIT.FIXED_VOLUMES ? volumes : 0);
+    V2B_MSB_Index1(B,19,1,disk->UNIT.REMOVABLE_VOLUMES ? volumes : 0);
 }
+
 ///@brief Pack Voulme data into bytes
-///@param[out] *size: number of bytes in result
-///@return pointer to packer array
-uint8_t *SS80VolumePack(int *size)
+///
+/// - The VOLUME geometry only fits a volume of the VOLUME size, other
+///   volumes report 0 for it - they are addressed by block number only.
+///@param[in] disk: SS80 device
+///@param[in] media: unit and volume described
+///@param[out] B: SS80_DESCRIBE_VOLUME bytes
+///@return void
+void SS80VolumePack(SS80DiskType *disk, SS80MediaType *media, uint8_t *B)
 {
-    static uint8_t B[13];
-    *size = 13;
+    uint8_t geometry = (media->MAX_BLOCK_NUMBER == disk->VOLUME.MAX_BLOCK_NUMBER);
+
     /*
         uint8_t V1;  //<  MSB Max cylinder
         uint8_t V2;  //<
@@ -257,12 +270,141 @@ uint8_t *SS80VolumePack(int *size)
         uint8_t V12; //<     LSB
         uint8_t V13; //<  Interleave
     */
-    V2B_MSB_Index1(B,1,3,SS80p->VOLUME.MAX_CYLINDER);
-    V2B_MSB_Index1(B,4,1,SS80p->VOLUME.MAX_HEAD);
-    V2B_MSB_Index1(B,5,2,SS80p->VOLUME.MAX_SECTOR);
-    V2B_MSB_Index1(B,7,6,SS80p->VOLUME.MAX_BLOCK_NUMBER);
-    V2B_MSB_Index1(B,13,1,SS80p->VOLUME.INTERLEAVE);
-    return(B);
+    V2B_MSB_Index1(B,1,3,geometry ? disk->VOLUME.MAX_CYLINDER : 0);
+    V2B_MSB_Index1(B,4,1,geometry ? disk->VOLUME.MAX_HEAD : 0);
+    V2B_MSB_Index1(B,5,2,geometry ? disk->VOLUME.MAX_SECTOR : 0);
+    V2B_MSB_Index1(B,7,6,media->MAX_BLOCK_NUMBER);
+    V2B_MSB_Index1(B,13,1,disk->VOLUME.INTERLEAVE);
+}
+
+///@brief Pack the describe bytes of every unit and volume of a device
+///
+/// - Called once by Post_Config(), SS80_describe() just sends them.
+/// - Call again after changing the CONTROLLER, UNIT or VOLUME settings.
+///@param[in] disk: SS80 device
+///@return void
+void SS80_Describe_Pack(SS80DiskType *disk)
+{
+    SS80MediaType *media;
+    int i;
+
+    for(i=0;i<disk->MEDIA_COUNT;++i)
+    {
+        media = &disk->MEDIA[i];
+        SS80ControllerPack(disk, media->DESCRIBE);
+        SS80UnitPack(disk, media, media->DESCRIBE + SS80_DESCRIBE_CONTROLLER);
+        SS80VolumePack(disk, media, media->DESCRIBE + SS80_DESCRIBE_CONTROLLER + SS80_DESCRIBE_UNIT);
+    }
+}
+
+///@brief Single block reads timed by SS80_measure(), spread over the image
+#define SS80_TUNE_PASSES    4
+
+///@brief Blocks of the sequential read timed by SS80_measure()
+#define SS80_TUNE_BLOCKS    16
+
+/// @brief Measure the disk and bus throughput of an SS80 device
+///
+/// - Disk: single block reads with an open and seek each, like a cache miss,
+///   and one sequential read with one open, like a read-ahead fill.
+/// - Bus: bytes over time of the GPIB latency histogram, only after the host
+///   has done some transfers and only with LATENCY_STATS.
+///   - Write samples include the time the host takes to send, so this is
+///     a lower bound.
+/// - 32 bit math, see rate_per_second().
+/// - FILL is the number of blocks that take as long to read as one open,
+///   longer disk reads hide the open time.
+/// - Uses gpib_iobuff, do not call during a transaction.
+/// @param[in] disk: SS80 device, results in disk->TUNE
+/// @param[in] lat: device latency histograms, Devices[].lat, or NULL
+/// @return 0 on sucess, -1 on disk error
+int SS80_measure(SS80DiskType *disk, void *lat)
+{
+    LatencyType *hist = (LatencyType *) lat;
+    SS80TuneType *t = &disk->TUNE;
+    SS80MediaType *media = &disk->MEDIA[0];
+    uint32_t block, us, fill;
+    ts_t start;
+    FIL fp;
+    UINT bytes;
+    int i, rc;
+    int errors = 0;
+    int size = disk->UNIT.BYTES_PER_BLOCK;
+
+    if(disk->MEDIA_COUNT == 0 || size > GPIB_IOBUFF_LEN)
+        return(-1);
+
+    us = 0;
+    for(i=0;i<SS80_TUNE_PASSES;++i)
+    {
+        block = (media->MAX_BLOCK_NUMBER / SS80_TUNE_PASSES) * i;
+        clock_gettime(0, (ts_t *) &start);
+        if(dbf_open_read(media->NAME, block * size, gpib_iobuff, size, &errors) != size)
+            return(-1);
+        us += timespec_us(&start, NULL);
+    }
+    t->OPEN_US = us / SS80_TUNE_PASSES;
+
+    rc = dbf_open(&fp, media->NAME, FA_OPEN_EXISTING | FA_READ);
+    if(rc != FR_OK)
+        return(-1);
+    clock_gettime(0, (ts_t *) &start);
+    for(i=0;i<SS80_TUNE_BLOCKS;++i)
+    {
+        rc = dbf_read(&fp, gpib_iobuff, size, &bytes);
+        if(rc != FR_OK || bytes != (UINT) size)
+            break;
+    }
+    us = timespec_us(&start, NULL);
+    dbf_close(&fp);
+    if(i < SS80_TUNE_BLOCKS)
+        return(-1);
+
+    t->BLOCK_US = us / SS80_TUNE_BLOCKS;
+    if(!t->BLOCK_US)
+        t->BLOCK_US = 1;
+    t->DISK_RATE = rate_per_second((uint32_t) size * SS80_TUNE_BLOCKS, us ? us : 1);
+
+    t->BUS_RATE = 0;
+    if(hist != NULL)
+        t->BUS_RATE = rate_per_second(hist->stage[LAT_GPIB].bytes, hist->stage[LAT_GPIB].total_us);
+
+    fill = (t->OPEN_US + t->BLOCK_US - 1) / t->BLOCK_US;
+    if(fill < 1)
+        fill = 1;
+    if(fill > CACHE_FILL_MAX)
+        fill = CACHE_FILL_MAX;
+    t->FILL = fill;
+    return(0);
+}
+
+/// @brief Rewrite the describe timing from the measured throughput
+///
+/// - The slower of the disk and the bus sets BLOCK_TIME and
+///   CONTINUOUS_TRANSFER_RATE.
+/// - BUFFERED_BLOCKS and BURST_SIZE stay 1 and 0, SS80 has no burst mode.
+/// @param[in] disk: SS80 device measured by SS80_measure()
+/// @return void
+void SS80_tune_describe(SS80DiskType *disk)
+{
+    SS80TuneType *t = &disk->TUNE;
+    uint32_t rate = t->DISK_RATE;
+    uint32_t val;
+
+    if(!rate)
+        return;
+    if(t->BUS_RATE && t->BUS_RATE < rate)
+        rate = t->BUS_RATE;
+
+    ///@brief microseconds per block - bytes per block * 1000000 / rate
+    val = rate_per_second(disk->UNIT.BYTES_PER_BLOCK, rate);
+    disk->UNIT.BLOCK_TIME = val > 0xffff ? 0xffff : (val ? val : 1);
+
+    ///@brief kilobytes per second
+    val = rate / 1000;
+    disk->UNIT.CONTINUOUS_TRANSFER_RATE = val > 0xffff ? 0xffff : (val ? val : 1);
+
+    SS80_Describe_Pack(disk);
 }
 
 /// @brief  SS80 nitialize all devices
@@ -329,6 +471,8 @@ int SS80_Execute_State(void)
             SS80s->estate = EXEC_IDLE;
             break;
     }
+    ///@brief The transaction is over, temporary complementary values end
+    SS80s->Length = SS80s->LengthDefault;
     gpib_enable_PPR(SS80p->HEADER.PPR);
     return(ret);
 }
@@ -371,11 +515,29 @@ int SS80_locate_and_read( void )
     int len;
     uint16_t status;
     uint32_t Address = SS80_Blocks_to_Bytes(SS80s->AddressBlocks);
+    int fill;
+    lat_t lat;
 
     SS80s->qstat = 0;
 
     status = 0;
 
+    ///@brief Adaptive read-ahead
+    /// It doubles while each transfer starts where the last one ended
+    if(Address == SS80s->ReadNext)
+    {
+        SS80s->ReadAhead = SS80s->ReadAhead ? SS80s->ReadAhead * 2 : 1;
+        ///@brief Limited to the measured fill size, see SS80_measure()
+        if(SS80p->TUNE.FILL && SS80s->ReadAhead > SS80p->TUNE.FILL)
+            SS80s->ReadAhead = SS80p->TUNE.FILL;
+        if(SS80s->ReadAhead > CACHE_FILL_MAX)
+            SS80s->ReadAhead = CACHE_FILL_MAX;
+    }
+    else
+    {
+        SS80s->ReadAhead = 0;
+    }
+
     if( GPIB_IO_RD(IFC) == 0)
         return(IFC_FLAG);
 
@@ -419,7 +581,12 @@ int SS80_locate_and_read( void )
             gpib_timer_elapsed_begin();
 #endif
 
-        len = dbf_open_read(SS80p->HEADER.NAME, Address, gpib_iobuff, chunk, &SS80s->Errors);
+        ///@brief On a miss read the rest of this transfer and the read-ahead at once
+        fill = (count + CACHE_BLOCK_SIZE - 1) / CACHE_BLOCK_SIZE + SS80s->ReadAhead;
+
+        lat_begin(&lat);
+        len = cache_read(SS80s->media, SS80s->media->NAME, Address, gpib_iobuff, chunk, fill, &SS80s->Errors);
+        lat_end(LAT_DISK, &lat);
 
 #if SDEBUG
         if(debuglevel & 64)
@@ -440,7 +607,9 @@ int SS80_locate_and_read( void )
         if(debuglevel & 64)
             gpib_timer_elapsed_begin();
 #endif
+        lat_begin(&lat);
         len = gpib_write_str(gpib_iobuff, chunk, &status);
+        lat_end_bytes(LAT_GPIB, &lat, len);
 #if SDEBUG
         if(debuglevel & 64)
             gpib_timer_elapsed_end("GPIB Write");
@@ -476,6 +645,11 @@ int SS80_locate_and_read( void )
     }
 
     SS80s->AddressBlocks = SS80_Bytes_to_Blocks(Address);
+    SS80s->ReadNext = Address;
+
+    ///@brief Sequential reads - read ahead while the host is busy
+    if(SS80s->ReadAhead && !SS80s->qstat)
+        cache_hint(SS80s->media, SS80s->media->NAME, Address);
     return (status & ERROR_MASK);
 }
 
@@ -501,6 +675,7 @@ int SS80_locate_and_write(void)
     int io_skip;
     uint16_t status;
     uint32_t Address = SS80_Blocks_to_Bytes(SS80s->AddressBlocks);
+    lat_t lat;
 
     io_skip = 0;
 
@@ -525,10 +700,16 @@ int SS80_locate_and_write(void)
 
     status = 0;
 
+    ///@brief JOURNAL - the blocks of this write are one transaction
+    if(!io_skip)
+        journal_begin(SS80s->media, SS80s->media->NAME);
+
     while(count > 0)                              // Loop until we have received Length sectors or EOI
     {
         if( GPIB_IO_RD(IFC) == 0)
         {
+            ///@brief What was received is in the cache, it will be written
+            journal_commit(SS80s->media);
             return(IFC_FLAG);
         }
 
@@ -543,7 +724,9 @@ int SS80_locate_and_write(void)
         if(debuglevel & 128)
             gpib_timer_elapsed_begin();
 #endif
+        lat_begin(&lat);
         len = gpib_read_str(gpib_iobuff, (UINT) chunk, &status);
+        lat_end_bytes(LAT_GPIB, &lat, len);
 
 #if SDEBUG
         if(debuglevel & 128)
@@ -574,7 +757,10 @@ int SS80_locate_and_write(void)
                 if(debuglevel & 64)
                     gpib_timer_elapsed_begin();
 #endif
-                len2 = dbf_open_write(SS80p->HEADER.NAME, Address, gpib_iobuff, len, &SS80s->Errors);
+                lat_begin(&lat);
+                journal_data(SS80s->media, Address, gpib_iobuff, len);
+                len2 = cache_write(SS80s->media, SS80s->media->NAME, Address, gpib_iobuff, len, &SS80s->Errors);
+                lat_end(LAT_DISK, &lat);
 #if SDEBUG
                 if(debuglevel & 64)
                     gpib_timer_elapsed_end("Disk Write");
@@ -611,6 +797,17 @@ int SS80_locate_and_write(void)
             break;
     }
 
+    journal_commit(SS80s->media);
+
+    ///@brief CACHE_SYNC - the report phase must see write back errors
+    if(cache_sync && !io_skip && cache_flush(SS80s->media))
+    {
+        SS80s->Errors |= ERR_WRITE;
+        if(mmc_wp_status())
+            SS80s->Errors |= ERR_WP;
+        SS80s->qstat = 1;
+    }
+
     if(count > 0)
     {
         if(debuglevel & 1)
@@ -627,6 +824,135 @@ int SS80_locate_and_write(void)
     return ( status & ERROR_MASK );
 }
 
+///@brief Copy Data buffer size, twice this is allocated
+/// - One half holds the source, the other the destination for compare.
+/// - gpib_iobuff is used when we can not allocate it.
+#ifndef SS80_COPY_BUFFER
+#define SS80_COPY_BUFFER 1024
+#endif
+
+///@brief Copy Data counters, see SS80_op_display()
+uint32_t SS80_copy_written;
+uint32_t SS80_copy_skipped;
+
+/// @brief  SS80 Copy Data between two images or inside one image
+///
+/// - Reference: CS80 pg 4-20.
+/// - The data never crosses the bus, we read and write the image files.
+/// - Dirty cached blocks of both images are written back first, the
+///   destination cache is updated with what we write.
+/// - Chunks already equal on the destination are not written, this saves
+///   SD card writes for zero filled or unchanged areas.
+/// - Overlapping ranges inside one image are copied from the end.
+/// @param[in] src: source image.
+/// @param[in] from: source byte position.
+/// @param[in] dst: destination image.
+/// @param[in] to: destination byte position.
+/// @param[in] size: number of bytes.
+/// @return  0 on sucess
+/// @return  ERR_* flags on fail
+int SS80_copy_data(SS80MediaType *src, uint32_t from, SS80MediaType *dst, uint32_t to, uint32_t size)
+{
+    FIL fi, fo;
+    FIL *fp;
+    uint8_t *buf, *cmp;
+    uint32_t done, off;
+    UINT bytes;
+    int chunk, len;
+    int same, backward;
+    int rc;
+    int errors = 0;
+
+    same = (src == dst || strcmp(src->NAME, dst->NAME) == 0);
+    if(!size || (same && from == to))
+        return(0);
+    backward = same && to > from && to < from + size;
+
+    if(cache_flush(src) || cache_flush(dst))
+        return(ERR_WRITE);
+
+    buf = safecalloc(SS80_COPY_BUFFER * 2, 1);
+    if(buf != NULL)
+    {
+        chunk = SS80_COPY_BUFFER;
+    }
+    else
+    {
+        buf = gpib_iobuff;
+        chunk = GPIB_IOBUFF_LEN / 2;
+    }
+    cmp = buf + chunk;
+
+    rc = dbf_open(&fi, src->NAME, same ? (FA_OPEN_EXISTING | FA_READ | FA_WRITE) : (FA_OPEN_EXISTING | FA_READ));
+    if(rc != FR_OK)
+    {
+        errors = ERR_DISK | ERR_READ;
+        goto copy_exit;
+    }
+    fp = &fi;
+    if(!same)
+    {
+        rc = dbf_open(&fo, dst->NAME, FA_OPEN_EXISTING | FA_READ | FA_WRITE);
+        if(rc != FR_OK)
+        {
+            errors = ERR_DISK | ERR_WRITE;
+            dbf_close(&fi);
+            goto copy_exit;
+        }
+        fp = &fo;
+    }
+
+    for(done = 0; done < size; done += len)
+    {
+        len = chunk;
+        if((uint32_t) len > size - done)
+            len = size - done;
+        off = backward ? size - done - len : done;
+
+        rc = dbf_lseek(&fi, from + off);
+        if(rc == FR_OK)
+            rc = dbf_read(&fi, buf, len, &bytes);
+        if(rc != FR_OK || bytes != (UINT) len)
+        {
+            errors = ERR_READ;
+            break;
+        }
+
+        ///@brief Skip the write if the destination already has the data
+        rc = dbf_lseek(fp, to + off);
+        if(rc == FR_OK)
+            rc = dbf_read(fp, cmp, len, &bytes);
+        if(rc == FR_OK && bytes == (UINT) len && memcmp(buf, cmp, len) == 0)
+        {
+            SS80_copy_skipped += len;
+            continue;
+        }
+
+        rc = dbf_lseek(fp, to + off);
+        if(rc == FR_OK)
+            rc = dbf_write(fp, buf, len, &bytes);
+        if(rc != FR_OK || bytes != (UINT) len)
+        {
+            errors = ERR_WRITE;
+            if(mmc_wp_status())
+                errors |= ERR_WP;
+            break;
+        }
+        cache_update(dst, to + off, buf, len);
+        SS80_copy_written += len;
+    }
+
+    if(dbf_close(&fi) != FR_OK)
+        errors |= ERR_DISK;
+    if(!same && dbf_close(&fo) != FR_OK)
+        errors |= ERR_DISK;
+
+copy_exit:
+    if(buf != gpib_iobuff)
+        safefree(buf);
+    return(errors);
+}
+
 ///@brief fault messages
 ///TODO move these to __memx
 /// - Reference: SS80 pg 4-59..64.
@@ -861,10 +1187,26 @@ int SS80_send_status( void )
     if(SS80s->Errors & ERR_UNIT)
         SS80_set_extended_status(tmp+2, 6);
 
+    // Bit 5 Illegal Opcode
+    if(SS80s->Errors & ERR_OPCODE)
+        SS80_set_extended_status(tmp+2, 5);
+
+    // Bit 10 Message Sequence
+    if(SS80s->Errors & ERR_SEQUENCE)
+        SS80_set_extended_status(tmp+2, 10);
+
+    // Bit 12 Message Length
+    if(SS80s->Errors & ERR_LENGTH)
+        SS80_set_extended_status(tmp+2, 12);
+
     // Bit 7 Address Bounds
     if(SS80s->Errors & ERR_SEEK)
         SS80_set_extended_status(tmp+2, 7);
 
+    // Bit 8 Parameter Bounds
+    if(SS80s->Errors & ERR_PARAM)
+        SS80_set_extended_status(tmp+2, 8);
+
     // Bit 22 Unit fault
     if(SS80s->Errors & ERR_READ)
         SS80_set_extended_status(tmp+2, 22);
@@ -920,470 +1262,887 @@ int SS80_send_status( void )
 int SS80_describe( void )
 {
     uint16_t status;
-
-    uint8_t *B;
-    int size;
-
-        
+    SS80MediaType *media;
 
 #if SDEBUG
     if(debuglevel & 32)
         printf("[SS80 Describe]\n");
 #endif
 
-    status = 0;
+    ///@brief Packed by Post_Config(), an unknown unit gets unit 0 volume 0
+    media = SS80s->media ? SS80s->media : &SS80p->MEDIA[0];
 
-    B = SS80ControllerPack(&size);
-    if(gpib_write_str(B,size, &status) != size)
+    status = EOI_FLAG;
+    if(gpib_write_str(media->DESCRIBE,SS80_DESCRIBE_SIZE,&status) != SS80_DESCRIBE_SIZE)
     {
         if(debuglevel & 1)
-            printf("[SS80 Describe Controller FAILED]\n");
+            printf("[SS80 Describe FAILED]\n");
         return(status & ERROR_MASK);
     }
 
-    status = 0;
+    return(0);
+}
+
+/// @brief  Find the image of a unit and volume
+///
+/// - Unit 15 is the controller, it uses unit 0.
+/// @param[in] unit: unit number
+/// @param[in] volume: volume number
+/// @return media or NULL if there is no such unit or volume
+SS80MediaType *SS80_find_media(uint8_t unit, uint8_t volume)
+{
+    int i;
 
-    B = SS80UnitPack(&size);
-    if(gpib_write_str(B,size, &status) != size)
+    if(unit == 15)
+        unit = 0;
+    for(i=0;i<SS80p->MEDIA_COUNT;++i)
     {
-        if(debuglevel & 1)
-            printf("[SS80 Describe Unit FAILED]\n");
-        return(status & ERROR_MASK);
+        if(SS80p->MEDIA[i].UNIT_NUMBER == unit && SS80p->MEDIA[i].VOLUME_NUMBER == volume)
+            return(&SS80p->MEDIA[i]);
     }
+    return(NULL);
+}
 
-    status = EOI_FLAG;
-    B = SS80VolumePack(&size);
-    if(gpib_write_str(B,size,&status) != size)
+
+/// @brief  Volumes installed on a unit
+/// @param[in] unit: unit number
+/// @return one bit per volume
+uint8_t SS80_unit_volumes(uint8_t unit)
+{
+    int i;
+    uint8_t volumes = 0;
+
+    for(i=0;i<SS80p->MEDIA_COUNT;++i)
     {
-        if(debuglevel & 1)
-            printf("[SS80 Describe Volume FAILED]\n");
-        return(status & ERROR_MASK);
+        if(SS80p->MEDIA[i].UNIT_NUMBER == unit)
+            volumes |= (1 << SS80p->MEDIA[i].VOLUME_NUMBER);
     }
+    return(volumes);
+}
 
-    return(0);
+
+/// @brief  Select the image for the current unit and volume
+///
+/// - Read-ahead history belongs to the image so it starts over.
+/// @return void
+void SS80_select_media(void)
+{
+    SS80MediaType *media = SS80_find_media(SS80s->unitNO, SS80s->volNO);
+
+    if(media != SS80s->media)
+    {
+        SS80s->media = media;
+        SS80s->ReadNext = 0xffffffffUL;
+        SS80s->ReadAhead = 0;
+    }
 }
 
+
 /// @brief  Check unit number and assign
+///
+/// - An invalid unit is selected too, it has no image so the rest of the
+///   command message can not read or write the unit selected before.
+///   - Not even after a Set Volume.
 /// @param[in] unit: unit number to assign
 /// @return void
 void SS80_Check_Unit(uint8_t unit)
 {
-    if(unit != 0 && unit != 15)
+    if(unit != 15 && (unit >= SS80_MAX_UNITS || !SS80_unit_volumes(unit)))
     {
         SS80s->Errors |= ERR_UNIT;
         if(debuglevel & 1)
             printf("[SS80 UNIT:%d invalid]\n", (int) unit);
     }
-    else 
-    {
-        SS80s->unitNO  = unit;
-    }
+    SS80s->unitNO  = unit;
+    SS80_select_media();
 }
 
 /// @brief  Check volume number and assign
+///
+/// - A unit that has no volume 0 may be selected before its volume.
+/// - An invalid volume is selected too, see SS80_Check_Unit().
 /// @param[in] volume: volume number to assign
 /// @return void
 void SS80_Check_Volume(uint8_t volume)
 {
-    if(volume != 0)
+    if(volume >= SS80_MAX_VOLUMES || SS80_find_media(SS80s->unitNO, volume) == NULL)
     {
         SS80s->Errors |= ERR_UNIT;
         if(debuglevel & 1)
             printf("[SS80 Volume:%d invalid]\n", (int) volume);
     }
-    else 
-    {
-        SS80s->volNO  = volume;
-    }
+    SS80s->volNO  = volume;
+    SS80_select_media();
 }
 
 
-/// @brief  Process OP Codes following 0x65 Command State.
+// =============================================
+/// @brief  SS80 opcode tables
 ///
-/// - References: SS80 pg 3-18, CS80 pg 4-6.
-/// - 3.8 COMPLEMENTARY COMMANDS
-/// - State: COMMAND STATE. 
-/// @return  0 on sucess.
-/// @return flags on fail.
-/// @see gpib.h ERROR_MASK defines for a full list.
-/// 
-/// @verbatim
-///  Notes:
-///  We set DPPR on entry and EPPR on exit
-///     DPPR = gpib_disable_PPR(SS80p->HEADER.PPR);
-///     EPPR = gpib_enable_PPR(SS80p->HEADER.PPR);
-/// 
-///  Valid OP Codes for Command State (0x65):
-///     Real Time, General Purpose, Complementary, DIagnostic
-///     Diagnostic
-///     In this Order:
-///        (1 to N) Complementary
-///        and/or
-///        (1) of Real Time, General Purpose, Diagnostic
-///        (This later group is always LAST)
-///     OP Code Sequence errors: TODO
-/// 
-///  We Read all of the Data/Opcodes/Parameters at once
-///     (while ATN is false).
-///     Last byte read should be EOI or an error
-///  Why read all at once ?
-///     SS80 "Command Messages" are buffered one at a time.
-///     A "Command Message" contains all ALL opcodes & their parameters
-///     (See SS80 Section 4-12, Page 4-6)
-/// 
-///  Unknown OP Code processing rules
-///     Skip the remaining codes, Wait for Report Phase
-/// @endverbatim
-
-int SS80_Command_State( void )
+/// - References: SS80 3-17 Figure 3-8, CS80 2-1, 4-6.
+/// - SS80_cmd_map[] and SS80_trans_map[] give the SS80_ops[] entry for every
+///   opcode after the Command (0x65) and Transparent (0x72) secondaries.
+/// - SS80_ops[] gives the parameter length, class and handler of each opcode.
+/// - A command message is 0 .. N complementary opcodes followed by at most
+///   one real time, general purpose, diagnostic or transparent opcode.
+/// - The tables live in flash on the AVR, see __memx.
+
+///@brief Opcode classes
+#define SS80_OP_COMP        0x01    ///< complementary - more may follow
+#define SS80_OP_REAL_TIME   0x02    ///< real time - ends the message
+#define SS80_OP_GENERAL     0x04    ///< general purpose - ends the message
+#define SS80_OP_DIAG        0x08    ///< diagnostic - ends the message
+#define SS80_OP_TRANSPARENT 0x10    ///< transparent - ends the message
+#define SS80_OP_TODO        0x80    ///< accepted and skipped - not implemented
+
+///@brief Opcode table entry
+typedef struct
 {
-    int ch;                                       // Current OP Code
-    uint16_t status;                              // Current status
-    int len;                                      // Size of Data/Op Codes/Parameters read in bytes
-    int ind;                                      // Buffer index
-
-    gpib_disable_PPR(SS80p->HEADER.PPR);
-
-    status = EOI_FLAG;
-    len = gpib_read_str(gpib_iobuff, GPIB_IOBUFF_LEN, &status);
-    if(status & ERROR_MASK)
-    {
-/// @todo FIXME
-        if(debuglevel & 1)
-            printf("[SS80 Command State GPIB Read ERROR]\n");
-        return(status & ERROR_MASK);
-    }
-
-    if(!len)
-        return(0);
-
-    if( !(status & EOI_FLAG) )
-    {
-        if(debuglevel & 1)
-            printf("[GPIB buffer OVERFLOW!]\n");
-    }
+    uint8_t len;                                ///< parameter bytes
+    uint8_t flags;                              ///< SS80_OP_* class
+    int (*handler)(uint8_t op, uint8_t *p);     ///< NULL if there is nothing to do
+    char name[26];                              ///< for debug and SS80_op_display()
+} SS80OpType;
+
+///@brief SS80_ops[] index
+enum SS80_OP_IDS
+{
+    SS80_OP_INVALID,
+    SS80_OP_SET_UNIT,
+    SS80_OP_SET_VOLUME,
+    SS80_OP_SET_ADDRESS,
+    SS80_OP_SET_LENGTH,
+    SS80_OP_NOP,
+    SS80_OP_SET_RPS,
+    SS80_OP_SET_RELEASE,
+    SS80_OP_SET_STATUS_MASK,
+    SS80_OP_SET_RETURN_ADDRESSING,
+    SS80_OP_LOCATE_AND_READ,
+    SS80_OP_LOCATE_AND_WRITE,
+    SS80_OP_LOCATE_AND_VERIFY,
+    SS80_OP_SPARE_BLOCK,
+    SS80_OP_REQUEST_STATUS,
+    SS80_OP_RELEASE,
+    SS80_OP_RELEASE_DENIED,
+    SS80_OP_VALIDATE_KEY,
+    SS80_OP_INITIATE_DIAGNOSTIC,
+    SS80_OP_DESCRIBE,
+    SS80_OP_INITIALIZE_MEDIA,
+    SS80_OP_COPY_DATA,
+    SS80_OP_DOOR_UNLOCK,
+    SS80_OP_DOOR_LOCK,
+    SS80_OP_PARITY_CHECKING,
+    SS80_OP_READ_LOOPBACK,
+    SS80_OP_WRITE_LOOPBACK,
+    SS80_OP_CHANNEL_CLEAR,
+    SS80_OP_CANCEL,
+    SS80_OP_IDS_COUNT
+};
 
-    ind = 0;
-    while(ind < len)
-    {
-        ch = gpib_iobuff[ind++];
+///@brief Times each opcode was accepted, see SS80_op_display()
+uint32_t SS80_op_count[SS80_OP_IDS_COUNT];
 
-        ///@brief set unit number
-        ///TODO We do not support multiple units yet - we DO track it
-        if(ch >= 0x20 && ch <= 0x2f)
-        {
-            SS80_Check_Unit(ch - 0x20);
-            // TODO unit support
+///@brief Command messages rejected, see SS80_op_display()
+uint32_t SS80_op_rejects;
 
-#if SDEBUG
-            if(debuglevel & 32)
-                printf("[SS80 Set Unit:(%d)]\n", SS80s->unitNO);
-#endif
-            continue;
-        }
 
-        ///@brief set volume number
-        ///TODO We do not support multiple Volumes yet - we DO track it
-        if(ch >= 0x40 && ch <= 0x4f)
-        {
-            SS80_Check_Volume(ch - 0x40);
+/// @brief  Set Unit
+///  Type: COMPLEMENTARY, also allowed before transparent opcodes
+/// @param[in] op: opcode
+/// @param[in] p: parameters
+/// @return  0
+static int SS80_op_set_unit(uint8_t op, uint8_t *p)
+{
+    SS80_Check_Unit(op - 0x20);
 #if SDEBUG
-            if(debuglevel & 32)
-                printf("[SS80 Set Volume: (%d)]\n", SS80s->volNO);
+    if(debuglevel & 32)
+        printf("[SS80 Set Unit:(%d)]\n", SS80s->unitNO);
 #endif
-            continue;
-        }
+    return(0);
+}
 
-        if(ch == 0x00)
-        {
-/// @todo FIXME,
-///  In Execute state calls  SS80_locate_and_read();
-            SS80s->estate = EXEC_LOCATE_AND_READ;
-#if SDEBUG
-            if(debuglevel & 32)
-                printf("[SS80 Locate and Read]\n");
-#endif
-            break;
-        }
 
-        if(ch == 0x02)
-        {
-/// @todo FIXME,
-///  SS80_locate_and_write();
-            SS80s->estate = EXEC_LOCATE_AND_WRITE;
+/// @brief  Set Volume
+///  Type: COMPLEMENTARY
+/// @param[in] op: opcode
+/// @param[in] p: parameters
+/// @return  0
+static int SS80_op_set_volume(uint8_t op, uint8_t *p)
+{
+    SS80_Check_Volume(op - 0x40);
 #if SDEBUG
-            if(debuglevel & 32)
-                printf("[SS80 Locate and Write]\n");
+    if(debuglevel & 32)
+        printf("[SS80 Set Volume: (%d)]\n", SS80s->volNO);
 #endif
-            break;
-        }
+    return(0);
+}
 
-/// @todo FIXME
-///  Important SS80 and CS80 differences regarding Complementary Commands!
-///  CS80 pg 2-1
-///  1) In CS80 when only complementary commands appear in a message 
-///     they will set the system defaults:
-///     Unit, number, data transfer length, burst size, maximum retry time, 
-///     and Rotational Position Sensing (RPS) window size and location.
-///  2) If, in the same message, they proceed a Real Time, General Purpose
-///     or Diagnostic they are TEMPORARY and just for that single transaction!
-///  3) The exeption to these rules are Set Unit, Set Volume
 
-/// @todo  Only handles 4-byte Addresses at the moment
+/// @brief  Set Address
+///  Type: COMPLEMENTARY
 ///  CS80 pg 4-11, 2-14
 ///  SS80 pg 4-67
-        // Set address
-        if (ch == 0x10)
-        {
-            /* upper two MSB unused */
-            /* gpib_iobuff[ind+0] MSB unused */
-            /* gpib_iobuff[ind+1] MSB unused */
-            SS80s->AddressBlocks = B2V_MSB(gpib_iobuff,ind,6);
-            ind += 6;
+/// @todo  Only handles 4-byte Addresses at the moment
+/// @param[in] op: opcode
+/// @param[in] p: parameters
+/// @return  0
+static int SS80_op_set_address(uint8_t op, uint8_t *p)
+{
+    /* upper two MSB unused */
+    /* p[0] MSB unused */
+    /* p[1] MSB unused */
+    SS80s->AddressBlocks = B2V_MSB(p,0,6);
 #if SDEBUG
-            if(debuglevel & 32)
-                printf("[SS80 Set Address:(%08lXH)]\n", 
-                    (long)SS80_Blocks_to_Bytes(SS80s->AddressBlocks));
+    if(debuglevel & 32)
+        printf("[SS80 Set Address:(%08lXH)]\n", 
+            (long)SS80_Blocks_to_Bytes(SS80s->AddressBlocks));
 #endif
-            continue;
-        }
+    return(0);
+}
 
+
+/// @brief  Set Length
+///  Type: COMPLEMENTARY
 ///  SS80 pg 4-73
-        // Set Length
-        if(ch == 0x18)
-        {
-            /* gpib_iobuff[ind+0] MSB */
-            SS80s->Length = B2V_MSB(gpib_iobuff,ind,4);
-            ind += 4;
+///  - The new length is the default only when no other opcode follows,
+///    see SS80_Command_State().
+/// @param[in] op: opcode
+/// @param[in] p: parameters
+/// @return  0
+static int SS80_op_set_length(uint8_t op, uint8_t *p)
+{
+    /* p[0] MSB */
+    SS80s->Length = B2V_MSB(p,0,4);
 #if SDEBUG
-            if(debuglevel & 32)
-                printf("[SS80 Set Length:(%08lXH)]\n", (long)SS80s->Length);
+    if(debuglevel & 32)
+        printf("[SS80 Set Length:(%08lXH)]\n", (long)SS80s->Length);
 #endif
-            continue;
-        }
+    return(0);
+}
 
 
-// SS80 $S80 4-47
-        // NO OP
-        if(ch == 0x34)
-        {
-#if SDEBUG
-            if(debuglevel & 32)
-                printf("[SS80 NO-OP]\n");
-#endif
-            continue;
-        }
-// SS80 $S80 4-79
-        // Set RPS
-        if (ch == 0x39)
-        {
-            ind += 2;
+/// @brief  Set Status Mask
+///  Type: COMPLEMENTARY
+///  SS80 pg 4-81
+///  CS80 4-15,2-20
+/// @todo TODO
+/// @param[in] op: opcode
+/// @param[in] p: parameters
+/// @return  0
+static int SS80_op_set_status_mask(uint8_t op, uint8_t *p)
+{
 #if SDEBUG
-            if(debuglevel & 32)
-                printf("[SS80 Set RPS NO-OP]\n");
+    if(debuglevel & (16+32))
+    {
+        printf("[SS80 Set Status Mask - TODO]\n");
+        SS80_display_extended_status(p, "TODO Mask these Status Bits");
+    }
 #endif
-            continue;
-        }
+    return(0);
+}
 
-// SS80 $S80 4-75
-        // Set Release
-        if (ch == 0x3B)
-        {
-            ind++;
-#if SDEBUG
-            if(debuglevel & 32)
-                printf("[SS80 Set Release NO-OP]\n");
-#endif
-            continue;
-        }
 
+/// @brief  Locate and Read
+///  Type: REAL TIME
+///  In Execute state calls SS80_locate_and_read()
+/// @param[in] op: opcode
+/// @param[in] p: parameters
+/// @return  0
+static int SS80_op_locate_and_read(uint8_t op, uint8_t *p)
+{
+    SS80s->estate = EXEC_LOCATE_AND_READ;
+    return(0);
+}
 
-/// @brief  Set Return Addressing
-///  Type: COMPLEMENTARY
-///  Phases: Command, Report
-///  SS80 pg 4-81
-///  CS80 4-18,2-24
 
-        if(ch == 0x48)
-        {
-/// @todo TODO
-///  Skip Parameters
-            ind++;
-#if SDEBUG
-            if(debuglevel & (16+32))
-                printf("[SS80 Set Return Addressing - TODO]\n");
-#endif
-            continue;
-        }
+/// @brief  Locate and Write
+///  Type: REAL TIME
+///  In Execute state calls SS80_locate_and_write()
+/// @param[in] op: opcode
+/// @param[in] p: parameters
+/// @return  0
+static int SS80_op_locate_and_write(uint8_t op, uint8_t *p)
+{
+    SS80s->estate = EXEC_LOCATE_AND_WRITE;
+    return(0);
+}
 
-/// @todo  not implmented yet
-///  SS80 pg 4-43
-///  CS80 pg 4-20, 2-28
 
-        if(ch == 0x04)
-        {
-/// @todo TODO
-/// @todo FIXME
-///  Execute NOW
-#if SDEBUG
-            if(debuglevel & (16+32))
-                printf("[SS80 Locate and Verify - TODO]\n");
-#endif
-            break;
-        }
+/// @brief  Request Status
+///  Type: GENERAL PURPOSE
+///  In Execute state calls SS80_send_status()
+/// @param[in] op: opcode
+/// @param[in] p: parameters
+/// @return  0
+static int SS80_op_request_status(uint8_t op, uint8_t *p)
+{
+    SS80s->estate = EXEC_SEND_STATUS;
+    return(0);
+}
 
-        if(ch == 0x0E)
-        {
-#if SDEBUG
-            if(debuglevel & 32)
-                printf("[SS80 Release NO-OP]\n");
-#endif
-/// @todo FIXME
-///  The class GENERAL PURPOSE suggests yes
-            break;
-        }
-        if(ch == 0x0F)
-        {
-#if SDEBUG
-            if(debuglevel & 32)
-                printf("[SS80 Release Denied NO-OP]\n");
-#endif
-/// @todo FIXME
-///  The class GENERAL PURPOSE suggests yes
-            break;
-        }
 
-/// @brief  Validate Key, Set Format Options, Download
+/// @brief  Describe
 ///  Type: GENERAL PURPOSE
-///  Phases: Command, Report
-///  Must be last command in sequence
-///  SS80 pg 4-91
-///  CS80 N/A
+///  In Execute state calls SS80_describe()
+/// @param[in] op: opcode
+/// @param[in] p: parameters
+/// @return  0
+static int SS80_op_describe(uint8_t op, uint8_t *p)
+{
+    SS80s->estate = EXEC_DESCRIBE;
+    return(0);
+}
+
+
+///@brief Initialize Media bytes per fill, see SS80_idle()
+#define SS80_FILL_SLICE     8192
+
+///@brief Initialize Media fills per idle time slice stop after this long
+/// - A host command that arrives meanwhile waits for one slice at most.
+#define SS80_FILL_SLICE_US  20000L
+
+///@brief Pending Initialize Media - one at a time
+typedef struct
+{
+    SS80StateType *state;   ///< device state, NULL if no fill is pending
+    SS80MediaType *media;   ///< image being filled
+    uint32_t pos;           ///< next byte to fill
+    uint32_t size;          ///< image size in bytes
+    uint8_t ppr;            ///< PPR bit of the device, enabled when done
+    ts_t start;             ///< time the fill started
+} SS80FillType;
+
+static SS80FillType SS80_fill;
 
-        if(ch == 0x31)
+
+/// @brief Fill one time slice of a pending Initialize Media
+///
+/// - Called by gpib_idle_task() while the bus is idle.
+/// - Fills of SS80_FILL_SLICE bytes until SS80_FILL_SLICE_US is used up.
+/// - When done PPR is enabled, the host then reads the result in the
+///   report phase - a fill error sets QSTAT = 1 and the error bits.
+/// @return 1 if slices are left, 0 if done or nothing is pending
+int SS80_idle(void)
+{
+    SS80StateType *state = SS80_fill.state;
+    uint32_t len;
+    ts_t start;
+    int errors = 0;
+
+    if(state == NULL)
+        return(0);
+
+    clock_gettime(0, (ts_t *) &start);
+    do
+    {
+        len = SS80_fill.size - SS80_fill.pos;
+        if(len > SS80_FILL_SLICE)
+            len = SS80_FILL_SLICE;
+        if(dbf_open_fill(SS80_fill.media->NAME, SS80_fill.pos, len, 0, &errors, 0) != (long) len)
         {
-/// @todo TODO
-///  Skip Parameters
-            ind += 2;
-#if SDEBUG
-            if(debuglevel & 32)
-                printf("[SS80 Validate Key - TODO]\n");
-#endif
+            state->Errors |= (errors | ERR_WRITE);
+            state->qstat = 1;
+            if(debuglevel & 1)
+                printf("[SS80 Initialize Media FAILED]\n");
+            SS80_fill.size = SS80_fill.pos;
             break;
         }
+        SS80_fill.pos += len;
+    }
+    while(SS80_fill.pos < SS80_fill.size && timespec_us(&start, NULL) < SS80_FILL_SLICE_US);
+
+    if(SS80_fill.pos < SS80_fill.size)
+        return(1);
 
-        if(ch == 0x35)
-        {
-            SS80s->estate = EXEC_DESCRIBE;
 #if SDEBUG
-            if(debuglevel & 32)
-                printf("[SS80 Describe]\n");
+    if(debuglevel & 64)
+    {
+        uint32_t us = timespec_us((ts_t *) &SS80_fill.start, NULL);
+
+        printf("[SS80 Initialize Media %lu bytes in %lu ms, %lu bytes/s]\n",
+            (unsigned long) SS80_fill.pos, (unsigned long) (us / 1000UL),
+            (unsigned long) rate_per_second(SS80_fill.pos, us ? us : 1));
+    }
 #endif
-            break;
-        }
+    SS80_fill.state = NULL;
+    gpib_enable_PPR(SS80_fill.ppr);
+    return(0);
+}
+
+
+/// @brief Finish a pending Initialize Media now
+///
+/// - The device must be done before it does anything else for the host.
+/// @param[in] state: device state, NULL for any device
+/// @return void
+static void SS80_fill_finish(SS80StateType *state)
+{
+    if(SS80_fill.state == NULL || (state != NULL && SS80_fill.state != state))
+        return;
+    while(SS80_idle())
+        ;
+}
+
 
 /// @brief  Initialize Media
 ///  Type: GENERAL PURPOSE
-///  Phases: Command, Report
-///  This command must be last and only one
-///  SS80 pg 4-33
-///  CS80 4-19,2-26
+///  SS80 pg 4-35
+///  - Parameters: options and block interleave, both ignored.
+///  - The image of the current unit and volume is filled with zeros.
+///  - There is no execution phase - the fill is done in idle time slices
+///    and PPR stays off until it is done, see SS80_idle().
+///    - Any other command for the device finishes it first.
+/// @param[in] op: opcode
+/// @param[in] p: parameters
+/// @return  0
+static int SS80_op_initialize_media(uint8_t op, uint8_t *p)
+{
+    SS80MediaType *media = SS80s->media;
+    uint32_t size;
+
+    SS80s->qstat = 0;
+    if(media == NULL)
+    {
+        SS80s->Errors |= ERR_UNIT;
+        SS80s->qstat = 1;
+        return(0);
+    }
+
+    size = SS80_Blocks_to_Bytes(media->MAX_BLOCK_NUMBER + 1);
 
-        if(ch == 0x37)
-        {
-            ind += 2;
-/// @todo TODO
-/// @todo FIXME
 #if SDEBUG
-            if(debuglevel & (16+32))
-                printf("[SS80 Initialize Media TODO]\n");
+    if(debuglevel & 32)
+        printf("[SS80 Initialize Media %s (%lXH) bytes]\n", media->NAME, (long) size);
 #endif
-            break;
-        }
 
-/// @brief  Set Status Mask
+    ///@brief Dirty blocks would be written over the new media later
+    cache_invalidate(media);
+    journal_discard(media, media->NAME);
+    SS80s->ReadNext = 0xffffffffUL;
+
+    SS80_fill_finish(NULL);
+    clock_gettime(0, (ts_t *) &SS80_fill.start);
+    SS80_fill.state = SS80s;
+    SS80_fill.media = media;
+    SS80_fill.pos = 0;
+    SS80_fill.size = size;
+    SS80_fill.ppr = SS80p->HEADER.PPR;
+    gpib_idle_set(1);
+    return(0);
+}
+
+
+/// @brief  Copy Data
 ///  Type: GENERAL PURPOSE
-///  Phases: Command, Report
-///  Must be last command in sequence
-///  SS80 pg 4-81
-///  CS80 4-15,2-20
+///  CS80 pg 4-20
+///  - Parameters: source then destination, each one
+///    Set Unit, Set Volume and Set Address with a 6 byte block address.
+///  - Set Length gives the number of bytes.
+///  - Only the units and volumes at our address can be used.
+///  - There is no execution phase, the copy is done here.
+/// @param[in] op: opcode
+/// @param[in] p: parameters
+/// @return  0
+static int SS80_op_copy_data(uint8_t op, uint8_t *p)
+{
+    SS80MediaType *media[2];
+    uint32_t block[2];
+    uint32_t blocks;
+    int i;
+
+    SS80s->qstat = 0;
+    blocks = SS80_Bytes_to_Blocks(SS80s->Length + SS80p->UNIT.BYTES_PER_BLOCK - 1);
 
-        if(ch == 0x3E)
+    ///@brief p points at gpib_iobuff - read all parameters before the copy
+    for(i=0;i<2;++i, p += 9)
+    {
+        if((p[0] & 0xf0) != 0x20 || (p[1] & 0xf8) != 0x40 || p[2] != 0x10)
         {
-/// @todo TODO
+            SS80s->Errors |= ERR_PARAM;
+            SS80s->qstat = 1;
+            return(0);
+        }
+        media[i] = SS80_find_media(p[0] & 0x0f, p[1] & 0x07);
+        block[i] = B2V_MSB(p,3,6);
+        if(media[i] == NULL)
+        {
+            SS80s->Errors |= ERR_UNIT;
+            SS80s->qstat = 1;
+            return(0);
+        }
+        if(block[i] + blocks > media[i]->MAX_BLOCK_NUMBER + 1)
+        {
+            SS80s->Errors |= ERR_SEEK;
+            SS80s->qstat = 1;
+            return(0);
+        }
+    }
+
 #if SDEBUG
-            if(debuglevel & (16+32))
-            {
-                printf("[SS80 Set Status Mask - TODO]\n");
-                SS80_display_extended_status(gpib_iobuff+ind, "TODO Mask these Status Bits");
-            }
+    if(debuglevel & 32)
+        printf("[SS80 Copy Data %s:%08lXH to %s:%08lXH (%lXH)]\n",
+            media[0]->NAME, (long) block[0], media[1]->NAME, (long) block[1], (long) SS80s->Length);
 #endif
-            ind += 8;
-            break;
-        }
 
-        if (ch == 0x4C)
-        {
+    i = SS80_copy_data(media[0], SS80_Blocks_to_Bytes(block[0]),
+        media[1], SS80_Blocks_to_Bytes(block[1]), SS80s->Length);
+    if(i)
+    {
+        SS80s->Errors |= i;
+        SS80s->qstat = 1;
+        if(debuglevel & 1)
+            printf("[SS80 Copy Data FAILED]\n");
+    }
+    return(0);
+}
+
+
+/// @brief  HP-IB Parity Checking
+///  Type: TRANSPARENT
 /// @todo TODO
+/// @param[in] op: opcode
+/// @param[in] p: parameters
+/// @return  0
+static int SS80_op_parity_checking(uint8_t op, uint8_t *p)
+{
+    gpib_enable_PPR(SS80p->HEADER.PPR);
+    return(0);
+}
+
+
+/// @brief  Channel Independent Clear
+///  Type: TRANSPARENT
+///  SS80 4-11
+///  CS80 4-26, 3-2,3-5
+///  The UNIT is optional and has already been set if specified
+/// @param[in] op: opcode
+/// @param[in] p: parameters
+/// @return  0
+static int SS80_op_channel_clear(uint8_t op, uint8_t *p)
+{
+    return(SS80_Channel_Independent_Clear( SS80s->unitNO ));
+}
+
+
+/// @brief  Cancel
+///  Type: TRANSPARENT
+///  SS80 4-9
+///  CS80 4-26, 3-6
+/// @param[in] op: opcode
+/// @param[in] p: parameters
+/// @return  0
+static int SS80_op_cancel(uint8_t op, uint8_t *p)
+{
+    return(SS80_Cancel( ) );
+}
+
+
+///@brief Opcode table - indexed by enum SS80_OP_IDS
+static __memx const SS80OpType SS80_ops[SS80_OP_IDS_COUNT] =
+{
+    [SS80_OP_INVALID]               = { 0, 0,                               NULL,                       "Invalid" },
+    [SS80_OP_SET_UNIT]              = { 0, SS80_OP_COMP,                    SS80_op_set_unit,           "Set Unit" },
+    [SS80_OP_SET_VOLUME]            = { 0, SS80_OP_COMP,                    SS80_op_set_volume,         "Set Volume" },
+    [SS80_OP_SET_ADDRESS]           = { 6, SS80_OP_COMP,                    SS80_op_set_address,        "Set Address" },
+    [SS80_OP_SET_LENGTH]            = { 4, SS80_OP_COMP,                    SS80_op_set_length,         "Set Length" },
+    [SS80_OP_NOP]                   = { 0, SS80_OP_COMP,                    NULL,                       "No Op" },
+    [SS80_OP_SET_RPS]               = { 2, SS80_OP_COMP,                    NULL,                       "Set RPS" },
+    [SS80_OP_SET_RELEASE]           = { 1, SS80_OP_COMP,                    NULL,                       "Set Release" },
+    [SS80_OP_SET_STATUS_MASK]       = { 8, SS80_OP_COMP,                    SS80_op_set_status_mask,    "Set Status Mask" },
+    [SS80_OP_SET_RETURN_ADDRESSING] = { 1, SS80_OP_COMP|SS80_OP_TODO,       NULL,                       "Set Return Addressing" },
+    [SS80_OP_LOCATE_AND_READ]       = { 0, SS80_OP_REAL_TIME,               SS80_op_locate_and_read,    "Locate and Read" },
+    [SS80_OP_LOCATE_AND_WRITE]      = { 0, SS80_OP_REAL_TIME,               SS80_op_locate_and_write,   "Locate and Write" },
+    [SS80_OP_LOCATE_AND_VERIFY]     = { 0, SS80_OP_REAL_TIME|SS80_OP_TODO,  NULL,                       "Locate and Verify" },
+    [SS80_OP_SPARE_BLOCK]           = { 1, SS80_OP_GENERAL|SS80_OP_TODO,    NULL,                       "Spare Block" },
+    [SS80_OP_REQUEST_STATUS]        = { 0, SS80_OP_GENERAL,                 SS80_op_request_status,     "Request Status" },
+    [SS80_OP_RELEASE]               = { 0, SS80_OP_GENERAL,                 NULL,                       "Release" },
+    [SS80_OP_RELEASE_DENIED]        = { 0, SS80_OP_GENERAL,                 NULL,                       "Release Denied" },
+    [SS80_OP_VALIDATE_KEY]          = { 2, SS80_OP_GENERAL|SS80_OP_TODO,    NULL,                       "Validate Key" },
+    [SS80_OP_INITIATE_DIAGNOSTIC]   = { 3, SS80_OP_DIAG|SS80_OP_TODO,       NULL,                       "Initiate Diagnostic" },
+    [SS80_OP_DESCRIBE]              = { 0, SS80_OP_GENERAL,                 SS80_op_describe,           "Describe" },
+    [SS80_OP_INITIALIZE_MEDIA]      = { 2, SS80_OP_GENERAL,                 SS80_op_initialize_media,   "Initialize Media" },
+    [SS80_OP_COPY_DATA]             = { 18, SS80_OP_GENERAL,                SS80_op_copy_data,          "Copy Data" },
+    [SS80_OP_DOOR_UNLOCK]           = { 0, SS80_OP_GENERAL|SS80_OP_TODO,    NULL,                       "Door Unlock" },
+    [SS80_OP_DOOR_LOCK]             = { 0, SS80_OP_GENERAL|SS80_OP_TODO,    NULL,                       "Door Lock" },
+    [SS80_OP_PARITY_CHECKING]       = { 1, SS80_OP_TRANSPARENT|SS80_OP_TODO,SS80_op_parity_checking,    "HP-IB Parity Checking" },
+    [SS80_OP_READ_LOOPBACK]         = { 4, SS80_OP_TRANSPARENT|SS80_OP_TODO,NULL,                       "Read Loopback" },
+    [SS80_OP_WRITE_LOOPBACK]        = { 4, SS80_OP_TRANSPARENT|SS80_OP_TODO,NULL,                       "Write Loopback" },
+    [SS80_OP_CHANNEL_CLEAR]         = { 0, SS80_OP_TRANSPARENT,             SS80_op_channel_clear,      "Channel Independent Clear" },
+    [SS80_OP_CANCEL]                = { 0, SS80_OP_TRANSPARENT,             SS80_op_cancel,             "Cancel" },
+};
+
+///@brief Command state (0x65) opcodes - SS80 3-17 Figure 3-8
+static __memx const uint8_t SS80_cmd_map[256] =
+{
+    [0x00]          = SS80_OP_LOCATE_AND_READ,
+    [0x02]          = SS80_OP_LOCATE_AND_WRITE,
+    [0x04]          = SS80_OP_LOCATE_AND_VERIFY,
+    [0x06]          = SS80_OP_SPARE_BLOCK,
+    [0x0D]          = SS80_OP_REQUEST_STATUS,
+    [0x0E]          = SS80_OP_RELEASE,
+    [0x0F]          = SS80_OP_RELEASE_DENIED,
+    [0x10]          = SS80_OP_SET_ADDRESS,
+    [0x18]          = SS80_OP_SET_LENGTH,
+    [0x20 ... 0x2F] = SS80_OP_SET_UNIT,
+    [0x31]          = SS80_OP_VALIDATE_KEY,
+    [0x33]          = SS80_OP_INITIATE_DIAGNOSTIC,
+    [0x34]          = SS80_OP_NOP,
+    [0x35]          = SS80_OP_DESCRIBE,
+    [0x37]          = SS80_OP_INITIALIZE_MEDIA,
+    [0x39]          = SS80_OP_SET_RPS,
+    [0x3B]          = SS80_OP_SET_RELEASE,
+    [0x3E]          = SS80_OP_SET_STATUS_MASK,
+    [0x40 ... 0x47] = SS80_OP_SET_VOLUME,
+    [0x48]          = SS80_OP_SET_RETURN_ADDRESSING,
+    [0x4C]          = SS80_OP_DOOR_UNLOCK,
+    [0x4D]          = SS80_OP_DOOR_LOCK,
+    [0x58]          = SS80_OP_COPY_DATA,
+};
+
+///@brief Transparent state (0x72) opcodes - CS80 4-26
+static __memx const uint8_t SS80_trans_map[256] =
+{
+    [0x01]          = SS80_OP_PARITY_CHECKING,
+    [0x02]          = SS80_OP_READ_LOOPBACK,
+    [0x03]          = SS80_OP_WRITE_LOOPBACK,
+    [0x08]          = SS80_OP_CHANNEL_CLEAR,
+    [0x09]          = SS80_OP_CANCEL,
+    [0x20 ... 0x2F] = SS80_OP_SET_UNIT,
+};
+
+
+/// @brief  Copy an opcode name out of the table
+/// @param[in] id: SS80_ops[] index
+/// @param[out] name: at least sizeof(SS80_ops[0].name) bytes
+/// @return  name
+static char *SS80_op_name(uint8_t id, char *name)
+{
+    int i;
+
+    for(i=0;i<(int)sizeof(SS80_ops[0].name);++i)
+        name[i] = SS80_ops[id].name[i];
+    name[sizeof(SS80_ops[0].name)-1] = 0;
+    return(name);
+}
+
+
+/// @brief  Check a whole command message before we act on any of it
+///
+/// - Every opcode must be in the map and have all of its parameters.
+/// - Only complementary opcodes may come before the last opcode.
+/// - Reference: CS80 4-6, a message with an error is rejected as a whole.
+/// @param[in] map: SS80_cmd_map or SS80_trans_map
+/// @param[in] buf: message
+/// @param[in] len: message size
+/// @param[out] last: SS80_OP_COMP unless a message ending opcode was found
+/// @return  0 or ERR_OPCODE, ERR_LENGTH, ERR_SEQUENCE
+static int SS80_op_validate(__memx const uint8_t *map, uint8_t *buf, int len, uint8_t *last)
+{
+    int ind = 0;
+    uint8_t op, id, flags;
+
+    *last = SS80_OP_COMP;
+    while(ind < len)
+    {
+        if(!(*last & SS80_OP_COMP))
+            return(ERR_SEQUENCE);
+        op = buf[ind++];
+        id = map[op];
+        if(id == SS80_OP_INVALID)
+        {
+            if(debuglevel & 1)
+                printf("[SS80 Invalid OP Code (%02XH) at (%d) of (%d)]\n", op, ind-1, len);
+            return(ERR_OPCODE);
+        }
+        flags = SS80_ops[id].flags;
+        ind += SS80_ops[id].len;
+        if(ind > len)
+            return(ERR_LENGTH);
+        *last = flags;
+    }
+    return(0);
+}
+
+
+/// @brief  Act on every opcode of a checked message
+/// @param[in] map: SS80_cmd_map or SS80_trans_map
+/// @param[in] buf: message
+/// @param[in] len: message size
+/// @return  GPIB error flags from the last handler
+static int SS80_op_execute(__memx const uint8_t *map, uint8_t *buf, int len)
+{
+    int ind = 0;
+    int ret = 0;
+    uint8_t op, id;
+    int (*handler)(uint8_t op, uint8_t *p);
 #if SDEBUG
-            if(debuglevel & (16+32))
-                printf("[SS80 Door UnLock - TODO]\n");
+    char name[sizeof(SS80_ops[0].name)];
 #endif
-            break;
-        }
 
-        if (ch == 0x4D)
-        {
-/// @todo TODO
+    while(ind < len)
+    {
+        op = buf[ind++];
+        id = map[op];
+        ++SS80_op_count[id];
+        handler = SS80_ops[id].handler;
 #if SDEBUG
+        ///@brief Complementary handlers display their own parameters
+        if(SS80_ops[id].flags & SS80_OP_TODO)
+        {
             if(debuglevel & (16+32))
-                printf("[SS80 Door Lock - TODO]\n");
-#endif
-            break;
+                printf("[SS80 %s - TODO]\n", SS80_op_name(id, name));
         }
-
-        if(ch == 0x0D)
+        else if(handler == NULL || !(SS80_ops[id].flags & SS80_OP_COMP))
         {
-            SS80s->estate = EXEC_SEND_STATUS;
-#if SDEBUG
             if(debuglevel & 32)
-                printf("[SS80 Request Status]\n");
-#endif
-            break;
+                printf("[SS80 %s]\n", SS80_op_name(id, name));
         }
+#endif
+        if(handler)
+            ret = handler(op, buf + ind);
+        ind += SS80_ops[id].len;
+    }
+    return(ret);
+}
 
-/// @brief  Initiate Diagnostic
-///  Type: DIAGNOSTIC
-///  Phases: Command, Report
-///  Must be last command in sequence
-///  SS80 pg 4-35
-///  CS80 N/A
 
-        if(ch == 0x33)
-        {
-/// @todo TODO
-            ind += 3;
-#if SDEBUG
-            if(debuglevel & (16+32))
-                printf("[SS80 Iniate Diagnostic - TODO]\n");
-#endif
-            break;
-        }
+/// @brief  Display or reset the opcode counters
+/// @param[in] reset: clear the counters
+/// @return  void
+void SS80_op_display(int reset)
+{
+    int i;
+    char name[sizeof(SS80_ops[0].name)];
+
+    if(reset)
+    {
+        memset(SS80_op_count, 0, sizeof(SS80_op_count));
+        SS80_op_rejects = 0;
+        SS80_copy_written = 0;
+        SS80_copy_skipped = 0;
+        return;
+    }
+    printf("SS80 opcodes\n");
+    for(i=1;i<SS80_OP_IDS_COUNT;++i)
+    {
+        if(SS80_op_count[i])
+            printf("  %8lu %s\n", (unsigned long) SS80_op_count[i], SS80_op_name(i, name));
+    }
+    printf("  %8lu Rejected messages\n", (unsigned long) SS80_op_rejects);
+    printf("  %8lu Copy Data bytes written\n", (unsigned long) SS80_copy_written);
+    printf("  %8lu Copy Data bytes already equal\n", (unsigned long) SS80_copy_skipped);
+}
+
+
+/// @brief  Reject a command message
+/// @param[in] err: ERR_OPCODE, ERR_LENGTH or ERR_SEQUENCE
+/// @param[in] len: message size
+/// @return  void
+static void SS80_op_reject(int err, int len)
+{
+    ++SS80_op_rejects;
+    SS80s->Errors |= err;
+    SS80s->qstat = 1;
+    if(debuglevel & 1)
+        printf("[SS80 Message of (%d) bytes rejected: %s]\n", len,
+            (err & ERR_OPCODE) ? "Illegal Opcode" :
+            (err & ERR_LENGTH) ? "Message Length" : "Message Sequence");
+}
+
+
+/// @brief  Process OP Codes following 0x65 Command State.
+///
+/// - References: SS80 pg 3-18, CS80 pg 4-6.
+/// - 3.8 COMPLEMENTARY COMMANDS
+/// - State: COMMAND STATE. 
+/// @return  0 on sucess.
+/// @return flags on fail.
+/// @see gpib.h ERROR_MASK defines for a full list.
+/// 
+/// @verbatim
+///  Notes:
+///  We set DPPR on entry and EPPR on exit
+///     DPPR = gpib_disable_PPR(SS80p->HEADER.PPR);
+///     EPPR = gpib_enable_PPR(SS80p->HEADER.PPR);
+/// 
+///  Valid OP Codes for Command State (0x65):
+///     Real Time, General Purpose, Complementary, DIagnostic
+///     Diagnostic
+///     In this Order:
+///        (1 to N) Complementary
+///        and/or
+///        (1) of Real Time, General Purpose, Diagnostic
+///        (This later group is always LAST)
+///     See SS80_cmd_map[] and SS80_ops[]
+/// 
+///  We Read all of the Data/Opcodes/Parameters at once
+///     (while ATN is false).
+///     Last byte read should be EOI or an error
+///  Why read all at once ?
+///     SS80 "Command Messages" are buffered one at a time.
+///     A "Command Message" contains all ALL opcodes & their parameters
+///     (See SS80 Section 4-12, Page 4-6)
+/// 
+///  Complementary Commands CS80 pg 2-1
+///  1) When only complementary commands appear in a message they set
+///     the defaults - of ours only Set Length has one.
+///  2) If, in the same message, they proceed a Real Time, General Purpose
+///     or Diagnostic they are TEMPORARY and just for that single transaction!
+///  3) The exeption to these rules are Set Unit, Set Volume
+///     Set Address is the current position, the transfers move it.
+/// 
+///  Unknown OP Code, missing parameters or a complementary opcode after
+///  the last opcode: the whole message is rejected, QSTAT = 1
+/// @endverbatim
+
+int SS80_Command_State( void )
+{
+    uint16_t status;                              // Current status
+    int len;                                      // Size of Data/Op Codes/Parameters read in bytes
+    int err;
+    uint8_t last;
 
-        if(debuglevel & 1 )
-            printf("[SS80 Invalid OP Code (%02XH)]\n", ch & 0xff);
+    gpib_disable_PPR(SS80p->HEADER.PPR);
 
-        break;
+    status = EOI_FLAG;
+    len = gpib_read_str(gpib_iobuff, GPIB_IOBUFF_LEN, &status);
+    if(status & ERROR_MASK)
+    {
+/// @todo FIXME
+        if(debuglevel & 1)
+            printf("[SS80 Command State GPIB Read ERROR]\n");
+        return(status & ERROR_MASK);
     }
 
-    if( ind != len)
+    if(!len)
+        return(0);
+
+    if( !(status & EOI_FLAG) )
     {
         if(debuglevel & 1)
-            printf("[SS80 Execute Command, Error at (%d) of (%d) OP Codes]\n", 
-                ind, len);
+            printf("[GPIB buffer OVERFLOW!]\n");
     }
 
-    gpib_enable_PPR(SS80p->HEADER.PPR);
+    err = SS80_op_validate(SS80_cmd_map, gpib_iobuff, len, &last);
+    if(err)
+    {
+        SS80_op_reject(err, len);
+    }
+    else
+    {
+        SS80_op_execute(SS80_cmd_map, gpib_iobuff, len);
+
+        ///@brief Complementary only - the new length is the default
+        if(last & SS80_OP_COMP)
+            SS80s->LengthDefault = SS80s->Length;
+        ///@brief No execution phase - the transaction is over
+        else if(SS80s->estate == EXEC_IDLE)
+            SS80s->Length = SS80s->LengthDefault;
+    }
+
+    ///@brief Initialize Media enables PPR once it is done
+    if(SS80_fill.state != SS80s)
+        gpib_enable_PPR(SS80p->HEADER.PPR);
 
     return(status & ERROR_MASK);
 }
@@ -1404,6 +2163,7 @@ int SS80_Command_State( void )
 /// 
 ///  Valid OP Codes for Transparent State (0x70 or 0x72):
 ///     [Unit Complementary] Transparent
+///     See SS80_trans_map[] and SS80_ops[]
 ///
 ///  UNIVERSAL DEVICE CLEAR
 ///  AMIGO CLEAR
@@ -1428,20 +2188,16 @@ int SS80_Command_State( void )
 ///     (See SS80 Section 4-12, Page 4-6)
 /// 
 ///  Unknown OP Code processing rules
-///     Skip the remaining codes, Wait for Report Phase
+///     The whole message is rejected, Wait for Report Phase
 
 /// @endverbatim
 
 int SS80_Transparent_State( void )
 {
-/// @todo FIXME
-
-    int ch;                                       // Current OP Code
     uint16_t status;                              // Current status
     int len;                                      // Size of Data/Op Codes/Parameters read in bytes
-    int ind;                                      // Buffer index
-    ///@brief  work in progress, unit support
-
+    int err;
+    uint8_t last;
 
     gpib_disable_PPR(SS80p->HEADER.PPR);
 
@@ -1467,112 +2223,14 @@ int SS80_Transparent_State( void )
             printf("[GPIB buffer OVERFLOW!]\n");
     }
 
-    ind = 0;
-
-    while(ind < len)
-    {
-        ch = gpib_iobuff[ind++];
-        ///TODO We do not support multiple units yet - we DO track it
-        if(ch >= 0x20 && ch <= 0x2f)
-        {
-            SS80_Check_Unit(ch - 0x20);
-            continue;
-        }
-
-        ///@brief HP-IB PARITY CHECKING
-        if(ch == 0x01)
-        {
-/// @todo TODO
-///  Skip Paramter
-            ind++;
-#if SDEBUG
-            if(debuglevel & (16+32))
-                printf("[SS80 HP-IB Parity Checking - TODO]\n");
-#endif
-            gpib_enable_PPR(SS80p->HEADER.PPR);
-            break;
-        }
-/// @todo FIXME
-///  SS80 4-49
-///  CS80 4-27, 3-7
-
-        ///@breif READ LOOPBACK
-        if(ch == 0x02)
-        {
-            ind += 4;
-/// @todo TODO
-///  DO NOT EPPR
-#if SDEBUG
-            if(debuglevel & (16+32))
-                printf("[SS80 Read Loopback - TODO]\n");
-#endif
-            break;
-        }
-/// @todo FIXME
-///  SS80 4-49
-///  CS80 4-27, 3-7
-
-        ///@breif WRITE LOOPBACK
-        if(ch == 0x03)
-        {
-            ind += 4;
-/// @todo TODO
-///  DO NOT EPPR
-#if SDEBUG
-            if(debuglevel & (16+32))
-                printf("[SS80 Write Loopback - TODO]\n");
-#endif
-            break;
-        }
-
-
-/// @todo FIXME
-///  SS80 4-11
-///  CS80 4-26, 3-2,3-5
-
-        ///@brief CHANNEL INDEPENDENT CLEAR
-        ///TODO We do not support multiple UNITS yet - we DO track it
-        ///TODO The UNIT is optional and has already been set if specified
-        if(ch == 0x08)                            // 0x08 OP Code
-        {
-#if SDEBUG
-            if(debuglevel & 32)
-                printf("[SS80 Channel Independent Clear (%d)]\n", SS80s->unitNO);
-#endif
-            return(SS80_Channel_Independent_Clear( SS80s->unitNO ));
-        }
-
-/// @todo FIXME
-///  SS80 4-9
-///  CS80 4-26, 3-6
-
-        ///@brief CANCEL
-        ///TODO We do not support multiple units yet
-        if(ch == 0x09)                            // 0x09 OP Code
-        {
-#if SDEBUG
-            if(debuglevel & 32)
-                printf("[SS80 Cancel (%d)]\n", SS80s->unitNO);
-#endif
-            return(SS80_Cancel( ) );
-
-            break;
-        }
-
-        if(debuglevel & 1)
-            printf("[SS80 Invalid OP Code (%02XH)]\n", ch & 0xff);
-        break;
-    }
-
-    if( ind != len)
+    err = SS80_op_validate(SS80_trans_map, gpib_iobuff, len, &last);
+    if(err)
     {
-        if(debuglevel & 1)
-            printf("[SS80 Transparent Command, Error at (%d) of (%d) OP Codes]\n", 
-                ind,len);
+        SS80_op_reject(err, len);
+        return(status & ERROR_MASK);
     }
 
-
-    return(status & ERROR_MASK);
+    return( SS80_op_execute(SS80_trans_map, gpib_iobuff, len) | (status & ERROR_MASK) );
 }
 
 
@@ -1588,10 +2246,22 @@ int SS80_Transparent_State( void )
 
 int SS80_cmd_seek( void )
 {
+    ///@brief No image for this unit and volume
+    if(SS80s->media == NULL)
+    {
+        SS80s->qstat = 1;
+        SS80s->Errors |= ERR_UNIT;
+
+        if(debuglevel & 1)
+            printf("[SS80 Unit:%d Volume:%d has no image]\n",
+                (int) SS80s->unitNO, (int) SS80s->volNO);
+        return(1);
+    }
+
 /// @todo  Let f_lseek do bounds checking instead ???
 ///  Will we read or write past the end of the disk ??
     if ( (SS80s->AddressBlocks + SS80_Bytes_to_Blocks(SS80s->Length))
-             > SS80p->VOLUME.MAX_BLOCK_NUMBER )
+             > SS80s->media->MAX_BLOCK_NUMBER )
     {
         SS80s->qstat = 1;
         SS80s->Errors |= ERR_SEEK;
@@ -1725,18 +2395,25 @@ int SS80_Report( void )
 /// @param[in] u: unit
 /// @return  void
 
-///TODO We do not support multiple units yet
-///TODO We do not support multiple Volumes yet
+/// - All units at this address share one state.
 void Clear_Common(int u)
 {
+    int i;
+
     if(u != SS80s->unitNO && u != 15)
         return;
 
+    SS80_fill_finish(SS80s);
+    for(i=0;i<SS80p->MEDIA_COUNT;++i)
+        cache_flush(&SS80p->MEDIA[i]);           // Write back before the host moves on
+
     if(u == 15)
         SS80s->unitNO = 0;
     SS80s->volNO = 0;
+    SS80_select_media();
     SS80s->AddressBlocks = 0;
     SS80s->Length = 0;
+    SS80s->LengthDefault = 0;
     SS80s->estate = EXEC_IDLE;
 
 /// @todo FIXME
@@ -1926,15 +2603,22 @@ int SS80_COMMANDS(uint8_t ch)
 {
     if(SS80_is_MTA(talking) || SS80_is_MLA(listening))
     {
+        SS80_fill_finish(SS80s);
+
         if(ch == 0x65 )
         {
             if(SS80_is_MLA(listening))
             {
+                int ret;
+                lat_t lat;
 #if SDEBUG
                 if(debuglevel & 32)
                     printf("[SS80 Command State]\n");
 #endif
-                return ( SS80_Command_State() );
+                lat_begin(&lat);
+                ret = SS80_Command_State();
+                lat_end(LAT_CMD, &lat);
+                return ( ret );
             }
             return(0);
         }
@@ -25,22 +25,31 @@
 /* ss80.c */
 void SS80_Test ( void );
 void V2B_MSB_Index1 ( uint8_t *B , int index , int size , uint32_t val );
-uint8_t *SS80ControllerPack ( int *size );
-uint8_t *SS80UnitPack ( int *size );
-uint8_t *SS80VolumePack ( int *size );
+void SS80ControllerPack ( SS80DiskType *disk , uint8_t *B );
+void SS80UnitPack ( SS80DiskType *disk , SS80MediaType *media , uint8_t *B );
+void SS80VolumePack ( SS80DiskType *disk , SS80MediaType *media , uint8_t *B );
+void SS80_Describe_Pack ( SS80DiskType *disk );
+int SS80_measure ( SS80DiskType *disk , void *lat );
+void SS80_tune_describe ( SS80DiskType *disk );
 void SS80_init ( void );
 int SS80_Execute_State ( void );
 uint32_t SS80_Blocks_to_Bytes ( uint32_t block );
 uint32_t SS80_Bytes_to_Blocks ( uint32_t bytes );
 int SS80_locate_and_read ( void );
 int SS80_locate_and_write ( void );
+int SS80_copy_data ( SS80MediaType *src , uint32_t from , SS80MediaType *dst , uint32_t to , uint32_t size );
 int SS80_test_extended_status ( uint8_t *p , int bit );
 void SS80_set_extended_status ( uint8_t *p , int bit );
 void SS80_display_extended_status ( uint8_t *p , char *message );
 int SS80_send_status ( void );
 int SS80_describe ( void );
+SS80MediaType *SS80_find_media ( uint8_t unit , uint8_t volume );
+uint8_t SS80_unit_volumes ( uint8_t unit );
+void SS80_select_media ( void );
 void SS80_Check_Unit ( uint8_t unit );
 void SS80_Check_Volume ( uint8_t volume );
+int SS80_idle ( void );
+void SS80_op_display ( int reset );
 int SS80_Command_State ( void );
 int SS80_Transparent_State ( void );
 int SS80_cmd_seek ( void );
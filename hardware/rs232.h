@@ -42,6 +42,9 @@ struct _uart
 };
 
 #define UARTS 1
+
+///@brief Uart ring buffers - rs232.c
+extern struct _uart uarts[UARTS];
 #define kbhit( uart) uart_rx_count( uart )
 
 #define uart_putc(a,c) uart0_putchar(c,NULL)
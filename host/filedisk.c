@@ -0,0 +1,386 @@
+/**
+ @file host/filedisk.c
+
+ @brief FatFs disk image file for the HP85 disk emulator host build.
+
+ @par Edit History
+ - [1.0]   [Mike Gore]  Initial revision of file.
+
+ @par Copyright &copy; 2014-2020 Mike Gore, Inc. All rights reserved. GPL
+ @see http://github.com/magore/hp85disk
+ @see http://github.com/magore/hp85disk/COPYRIGHT.md for Copyright details
+
+ Host C library side - do not include the firmware headers here.
+ - Takes the place of the SD card, see DRV_FILE in fatfs.hal/diskio.c.
+ - The image is a plain FAT file system without a partition table,
+   it can be loop mounted or inspected with mtools.
+*/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <ftw.h>
+
+#include "ff.h"
+#include "filedisk.h"
+
+static int disk_fd = -1;
+static int disk_readonly = 0;
+static LBA_t disk_sectors = 0;
+///@brief RAM copy of the image, writes are discarded when we exit
+static BYTE *disk_mem = NULL;
+
+/// @brief Open the disk image, create a sparse image if it does not exist.
+///
+/// @param[in] name: image file name.
+/// @param[in] megabytes: size of a new image, 0 = do not create.
+/// @param[in] readonly: open read only.
+/// @return 1 if a new image was created, 0 if opened, -1 on error.
+int file_disk_open(const char *name, uint32_t megabytes, int readonly)
+{
+    struct stat st;
+    int created = 0;
+
+    file_disk_close();
+
+    disk_readonly = readonly;
+    disk_fd = open(name, readonly ? O_RDONLY : O_RDWR);
+    if(disk_fd < 0 && errno == ENOENT && megabytes && !readonly)
+    {
+        disk_fd = open(name, O_RDWR | O_CREAT | O_EXCL, 0644);
+        if(disk_fd >= 0 && ftruncate(disk_fd, (off_t) megabytes * 1024L * 1024L) < 0)
+        {
+            perror(name);
+            file_disk_close();
+            return(-1);
+        }
+        created = 1;
+    }
+    if(disk_fd < 0)
+    {
+        perror(name);
+        return(-1);
+    }
+
+    if(fstat(disk_fd, &st) < 0)
+    {
+        perror(name);
+        file_disk_close();
+        return(-1);
+    }
+    disk_sectors = st.st_size / FILE_DISK_SS;
+    if(!disk_sectors)
+    {
+        fprintf(stderr,"%s: empty disk image\n", name);
+        file_disk_close();
+        return(-1);
+    }
+    return(created);
+}
+
+/// @brief Close the disk image.
+/// @return void
+void file_disk_close()
+{
+    if(disk_fd >= 0)
+        close(disk_fd);
+    disk_fd = -1;
+    disk_sectors = 0;
+    free(disk_mem);
+    disk_mem = NULL;
+}
+
+/// @brief Load the whole disk image into RAM, the file is no longer changed.
+///
+/// - Used by trace replay so every run starts from the same image.
+/// @return 0 on success, -1 on error.
+int file_disk_memory()
+{
+    size_t len = (size_t) disk_sectors * FILE_DISK_SS;
+    ssize_t ret;
+
+    if(disk_fd < 0)
+        return(-1);
+    if(disk_mem)
+        return(0);
+    disk_mem = malloc(len);
+    if(!disk_mem)
+    {
+        fprintf(stderr,"no memory for a %ld byte disk image\n", (long) len);
+        return(-1);
+    }
+    ret = pread(disk_fd, disk_mem, len, 0);
+    if(ret < 0 || (size_t) ret != len)
+    {
+        perror("disk image read");
+        free(disk_mem);
+        disk_mem = NULL;
+        return(-1);
+    }
+    return(0);
+}
+
+/// @brief Create a FAT file system on the whole disk image.
+/// @return 0 on success, -1 on error.
+int file_disk_format()
+{
+    MKFS_PARM opt;
+    BYTE *work;
+    FRESULT rc;
+
+    memset(&opt, 0, sizeof(opt));
+    opt.fmt = FM_ANY | FM_SFD;
+
+    work = calloc(FF_MAX_SS * 8, 1);
+    if(!work)
+        return(-1);
+    rc = f_mkfs("", &opt, work, FF_MAX_SS * 8);
+    free(work);
+    if(rc != FR_OK)
+    {
+        fprintf(stderr,"f_mkfs failed: %d\n", (int) rc);
+        return(-1);
+    }
+    return(0);
+}
+
+/// @brief Copy a host file into the disk image if it is not already there.
+///
+/// @param[in] src: host file name.
+/// @param[in] dst: FatFs file name.
+/// @return 1 if copied, 0 if it already exists, -1 on error.
+static int file_disk_import_file(const char *src, const char *dst)
+{
+    FIL fp;
+    FRESULT rc;
+    FILE *fi;
+    UINT bw;
+    size_t len;
+    int ret = 1;
+    char buf[4096];
+
+    fi = fopen(src, "rb");
+    if(fi == NULL)
+    {
+        perror(src);
+        return(-1);
+    }
+
+    rc = f_open(&fp, dst, FA_WRITE | FA_CREATE_NEW);
+    if(rc == FR_EXIST)
+    {
+        fclose(fi);
+        return(0);
+    }
+    if(rc != FR_OK)
+    {
+        fprintf(stderr,"%s: f_open failed: %d\n", dst, (int) rc);
+        fclose(fi);
+        return(-1);
+    }
+
+    while((len = fread(buf, 1, sizeof(buf), fi)) > 0)
+    {
+        rc = f_write(&fp, buf, len, &bw);
+        if(rc != FR_OK || bw != len)
+        {
+            fprintf(stderr,"%s: f_write failed: %d\n", dst, (int) rc);
+            ret = -1;
+            break;
+        }
+    }
+    fclose(fi);
+    if(f_close(&fp) != FR_OK)
+        ret = -1;
+    return(ret);
+}
+
+///@brief Length of the directory name being imported
+static size_t import_len;
+///@brief Number of files copied and errors for file_disk_import()
+static int import_files, import_errors;
+
+/// @brief nftw() callback - copy one file or directory into the disk image.
+///
+/// @param[in] path: host path name.
+/// @param[in] st: unused.
+/// @param[in] type: nftw() file type.
+/// @param[in] ftw: unused.
+/// @return 0 to continue the walk.
+static int file_disk_import_entry(const char *path, const struct stat *st, int type, struct FTW *ftw)
+{
+    FRESULT rc;
+    const char *dst = path + import_len;
+
+    if(!*dst)
+        return(0);                                // the top directory itself
+
+    if(type == FTW_D)
+    {
+        rc = f_mkdir(dst);
+        if(rc != FR_OK && rc != FR_EXIST)
+        {
+            fprintf(stderr,"%s: f_mkdir failed: %d\n", dst, (int) rc);
+            ++import_errors;
+        }
+        return(0);
+    }
+    if(type == FTW_F)
+    {
+        switch(file_disk_import_file(path, dst))
+        {
+            case 1:
+                ++import_files;
+                break;
+            case -1:
+                ++import_errors;
+                break;
+        }
+    }
+    return(0);
+}
+
+/// @brief Copy a host directory tree into the disk image.
+///
+/// - Files that already exist in the image are not replaced
+///   so the changes made by the emulator are kept.
+/// @param[in] dir: host directory.
+/// @return number of files copied or -1 on error.
+int file_disk_import(const char *dir)
+{
+    FATFS *fs;
+    FRESULT rc;
+    int ret;
+
+    fs = calloc(sizeof(FATFS), 1);
+    if(!fs)
+        return(-1);
+    rc = f_mount(fs, "", 1);
+    if(rc != FR_OK)
+    {
+        fprintf(stderr,"f_mount failed: %d\n", (int) rc);
+        free(fs);
+        return(-1);
+    }
+
+    import_len = strlen(dir);
+    while(import_len > 1 && dir[import_len-1] == '/')
+        --import_len;
+    import_files = 0;
+    import_errors = 0;
+
+    ret = nftw(dir, file_disk_import_entry, 16, FTW_PHYS);
+    if(ret < 0)
+        perror(dir);
+
+    f_mount(NULL, "", 0);
+    free(fs);
+
+    if(ret < 0 || import_errors)
+        return(-1);
+    return(import_files);
+}
+
+// =============================================
+///@brief FatFs disk interface, see fatfs.hal/diskio.c
+
+/// @brief Disk status.
+/// @return STA_NOINIT when no image is open.
+DSTATUS file_disk_status()
+{
+    if(disk_fd < 0)
+        return(STA_NOINIT);
+    return(disk_readonly ? STA_PROTECT : 0);
+}
+
+/// @brief Initialize disk - the image was opened by file_disk_open().
+/// @return Disk status.
+DSTATUS file_disk_initialize()
+{
+    return(file_disk_status());
+}
+
+/// @brief Read sectors.
+/// @param[out] buff: data.
+/// @param[in] sector: first sector.
+/// @param[in] count: number of sectors.
+/// @return RES_OK on success.
+DRESULT file_disk_read(BYTE *buff, LBA_t sector, UINT count)
+{
+    size_t len = (size_t) count * FILE_DISK_SS;
+    ssize_t ret;
+
+    if(disk_fd < 0)
+        return(RES_NOTRDY);
+    if(sector + count > disk_sectors)
+        return(RES_PARERR);
+    if(disk_mem)
+    {
+        memcpy(buff, disk_mem + (size_t) sector * FILE_DISK_SS, len);
+        return(RES_OK);
+    }
+    ret = pread(disk_fd, buff, len, (off_t) sector * FILE_DISK_SS);
+    if(ret < 0 || (size_t) ret != len)
+        return(RES_ERROR);
+    return(RES_OK);
+}
+
+/// @brief Write sectors.
+/// @param[in] buff: data.
+/// @param[in] sector: first sector.
+/// @param[in] count: number of sectors.
+/// @return RES_OK on success.
+DRESULT file_disk_write(const BYTE *buff, LBA_t sector, UINT count)
+{
+    size_t len = (size_t) count * FILE_DISK_SS;
+    ssize_t ret;
+
+    if(disk_fd < 0)
+        return(RES_NOTRDY);
+    if(disk_readonly)
+        return(RES_WRPRT);
+    if(sector + count > disk_sectors)
+        return(RES_PARERR);
+    if(disk_mem)
+    {
+        memcpy(disk_mem + (size_t) sector * FILE_DISK_SS, buff, len);
+        return(RES_OK);
+    }
+    ret = pwrite(disk_fd, buff, len, (off_t) sector * FILE_DISK_SS);
+    if(ret < 0 || (size_t) ret != len)
+        return(RES_ERROR);
+    return(RES_OK);
+}
+
+/// @brief Miscellaneous disk functions.
+/// @param[in] cmd: control code.
+/// @param[in,out] buff: control data.
+/// @return RES_OK on success.
+DRESULT file_disk_ioctl(BYTE cmd, void *buff)
+{
+    if(disk_fd < 0)
+        return(RES_NOTRDY);
+
+    switch(cmd)
+    {
+        case CTRL_SYNC:
+            return(RES_OK);
+        case GET_SECTOR_COUNT:
+            *(LBA_t *) buff = disk_sectors;
+            return(RES_OK);
+        case GET_SECTOR_SIZE:
+            *(WORD *) buff = FILE_DISK_SS;
+            return(RES_OK);
+        case GET_BLOCK_SIZE:
+            *(DWORD *) buff = 1;
+            return(RES_OK);
+        case CTRL_TRIM:
+            return(RES_OK);
+    }
+    return(RES_PARERR);
+}
@@ -0,0 +1,34 @@
+/**
+ @file host/filedisk.h
+
+ @brief FatFs disk image file for the HP85 disk emulator host build.
+
+ @par Edit History
+ - [1.0]   [Mike Gore]  Initial revision of file.
+
+ @par Copyright &copy; 2014-2020 Mike Gore, Inc. All rights reserved. GPL
+ @see http://github.com/magore/hp85disk
+ @see http://github.com/magore/hp85disk/COPYRIGHT.md for Copyright details
+
+*/
+
+#ifndef _FILEDISK_H_
+#define _FILEDISK_H_
+
+#include "diskio.h"
+
+///@brief Disk image sector size
+#define FILE_DISK_SS 512
+
+/* filedisk.c */
+int file_disk_open ( const char *name , uint32_t megabytes , int readonly );
+void file_disk_close ( void );
+int file_disk_memory ( void );
+int file_disk_format ( void );
+int file_disk_import ( const char *dir );
+DSTATUS file_disk_status ( void );
+DSTATUS file_disk_initialize ( void );
+DRESULT file_disk_read ( BYTE *buff , LBA_t sector , UINT count );
+DRESULT file_disk_write ( const BYTE *buff , LBA_t sector , UINT count );
+DRESULT file_disk_ioctl ( BYTE cmd , void *buff );
+#endif
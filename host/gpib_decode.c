@@ -0,0 +1,607 @@
+/**
+ @file host/gpib_decode.c
+
+ @brief Decoder for binary GPIB captures of the HP85 disk emulator.
+
+ @par Edit History
+ - [1.0]   [Mike Gore]  Initial revision of file.
+
+ @par Copyright &copy; 2014-2020 Mike Gore, Inc. All rights reserved. GPL
+ @see http://github.com/magore/hp85disk
+ @see http://github.com/magore/hp85disk/COPYRIGHT.md for Copyright details
+
+ Stand alone host program - reads a file written by "gpib capture".
+ - Default output is the same as "gpib trace", see gpib_decode_header()
+   and gpib_trace_display() in gpib/gpib.c.
+ - -t adds the time of each bus state.
+ - -p adds SS80 and AMIGO protocol decoding.
+ @see gpib/gpib_capture.h for the file format.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "gpib_ops.h"
+
+///@brief From gpib/gpib.h
+#define EOI_FLAG        0x0100
+#define SRQ_FLAG        0x0200
+#define ATN_FLAG        0x0400
+#define REN_FLAG        0x0800
+#define IFC_FLAG        0x1000
+#define PP_FLAG         0x2000
+#define TIMEOUT_FLAG    0x4000
+#define BUS_ERROR_FLAG  0x8000
+#define DAV_FLAG        0x2000
+#define NRFD_FLAG       0x4000
+#define NDAC_FLAG       0x8000
+#define CMD_MASK        0x7f
+#define UNL             0x3f
+#define UNT             0x5f
+
+#define TRACE_DISABLE   0
+#define TRACE_READ      1
+#define TRACE_BUS       2
+
+///@brief From gpib/gpib_capture.h
+#define GPIB_CAPTURE_MAGIC          "GPIBCAP"
+#define GPIB_CAPTURE_VERSION        1
+#define GPIB_CAPTURE_STATE_MASK     0x03
+#define GPIB_CAPTURE_TIME           0x03
+
+///@brief Device types for protocol decoding
+#define DEV_NONE    0
+#define DEV_AMIGO   1
+#define DEV_SS80    2
+
+///@brief Largest data phase we keep for decoding
+#define DATA_MAX    1024
+
+///@brief GPIB command mapping to printable strings - same as gpib/gpib.c
+typedef struct {
+    int cmd;
+    char *name;
+} gpib_token_t;
+
+gpib_token_t gpib_tokens[] =
+{
+    {0x01,"GTL" },
+    {0x04,"SDC" },
+    {0x05,"PPC" },
+    {0x08,"GET" },
+    {0x09,"TCT" },
+    {0x11,"LLO" },
+    {0x14,"DCL" },
+    {0x15,"PPU" },
+    {0x18,"SPE" },
+    {0x19,"SPD" },
+    {0x3F,"UNL" },
+    {0x5F,"UNT" },
+    {-1,NULL }
+};
+
+///@brief Protocol decoder state
+typedef struct {
+    int devices[32];        ///< DEV_AMIGO, DEV_SS80 or DEV_NONE by address
+    uint32_t listeners;     ///< bit mask of listening addresses
+    int talker;             ///< talk address or -1
+    int lastcmd;            ///< previous command byte or -1
+    int secondary;          ///< current secondary address or -1
+    int dir;                ///< 'L' data to the listeners, 'T' data from the talker
+    int addr;               ///< device the secondary address was sent to
+    uint8_t data[DATA_MAX]; ///< data phase bytes
+    long len;               ///< data phase length
+    int ifc;                ///< IFC was seen on the previous byte
+} proto_t;
+
+proto_t proto;
+
+int opt_time = 0;
+int opt_proto = 0;
+
+/// @brief Display the file header - same as gpib_decode_header()
+/// @param[in] fo: output file
+/// @return void
+void gpib_decode_header(FILE *fo)
+{
+    fprintf(fo,"===========================================\n");
+    fprintf(fo,"GPIB bus state\n");
+    fprintf(fo,"HH . AESRPITB gpib\n");
+    fprintf(fo,"HH = Hex value of Command or Data\n");
+    fprintf(fo,"   . = ASCII of XX only for 0x20 .. 0x7e\n");
+    fprintf(fo,"     A = ATN\n");
+    fprintf(fo,"      E = EOI\n");
+    fprintf(fo,"       S = SRQ\n");
+    fprintf(fo,"        R = REN\n");
+    fprintf(fo,"         I = IFC\n");
+    fprintf(fo,"          P = Parallel Poll seen\n");
+    fprintf(fo,"           T = TIMEOUT\n");
+    fprintf(fo,"            B = BUS_ERROR\n");
+    fprintf(fo,"              GPIB commands\n");
+}
+
+/// @brief Format one bus state - same as gpib_trace_display()
+///
+/// - The command names are written over the handshake columns
+///   just like the firmware does.
+/// @param[out] str: result, at least 64 bytes
+/// @param[in] status: data bus value (lower 8 bits) control bus (upper 8 bits)
+/// @param[in] trace_state: TRACE_DISABLE, TRACE_READ or TRACE_BUS
+/// @return void
+void gpib_trace_str(char *str, uint16_t status, int trace_state)
+{
+    char *tmp;
+    uint8_t bus = status & 0xff;
+
+    if(trace_state == TRACE_DISABLE || trace_state == TRACE_READ)
+    {
+        uint8_t printable = ' ';
+        if( !(status & ATN_FLAG) && (bus >= 0x20 && bus <= 0x7e) )
+            printable = bus;
+        sprintf(str, "%02X %c ", (int)bus & 0xff, (int)printable);
+    }
+    else
+    {
+        sprintf(str, "     ");
+    }
+
+    tmp = str + strlen(str);
+    *tmp++ = (status & ATN_FLAG) ? 'A' : '-';
+    *tmp++ = (status & EOI_FLAG) ? 'E' : '-';
+    *tmp++ = (status & SRQ_FLAG) ? 'S' : '-';
+    *tmp++ = (status & REN_FLAG) ? 'R' : '-';
+    *tmp++ = (status & IFC_FLAG) ? 'I' : '-';
+    if(trace_state == TRACE_DISABLE)
+    {
+        *tmp++ = (status & PP_FLAG) ? 'P' : '-';
+        *tmp++ = (status & TIMEOUT_FLAG) ? 'T' : '-';
+        *tmp++ = (status & BUS_ERROR_FLAG) ? 'B' : '-';
+    }
+    else
+    {
+        *tmp++ = '-';
+        *tmp++ = '-';
+        *tmp++ = '-';
+    }
+    *tmp = 0;
+
+    if(trace_state == TRACE_READ || trace_state == TRACE_BUS)
+    {
+        strcat(str, (status & DAV_FLAG) ? "  DAV" : "     ");
+        strcat(str, (status & NRFD_FLAG) ? " NRFD" : "     ");
+        strcat(str, (status & NDAC_FLAG) ? " NDAC" : "     ");
+    }
+
+    if( (status & ATN_FLAG) )
+    {
+        int i;
+        int cmd = status & CMD_MASK;
+        if(cmd >= 0x020 && cmd <= 0x3e)
+            sprintf(tmp," MLA %02Xh", cmd & 0x1f);
+        else if(cmd >= 0x040 && cmd <= 0x4e)
+            sprintf(tmp," MTA %02Xh", cmd & 0x1f);
+        else if(cmd >= 0x060 && cmd <= 0x6f)
+            sprintf(tmp," MSA %02Xh", cmd & 0x1f);
+        else
+        {
+            for(i=0;gpib_tokens[i].cmd != -1;++i)
+            {
+                if(cmd == gpib_tokens[i].cmd)
+                {
+                    strcat(tmp," ");
+                    strcat(tmp,gpib_tokens[i].name);
+                    break;
+                }
+            }
+        }
+    }
+}
+
+/// @brief Read a big endian value from the data phase
+/// @param[in] p: data
+/// @param[in] bytes: size
+/// @return value
+uint64_t get_be(uint8_t *p, int bytes)
+{
+    uint64_t val = 0;
+    while(bytes--)
+        val = (val << 8) | *p++;
+    return(val);
+}
+
+/// @brief Name of a device type
+/// @param[in] type: DEV_AMIGO or DEV_SS80
+/// @return name
+char *dev_name(int type)
+{
+    return(type == DEV_SS80 ? "SS80" : "AMIGO");
+}
+
+/// @brief Decode an SS80 command or transparent phase
+/// @param[in] addr: device address
+/// @param[in] ops: op code table
+/// @return void
+void decode_ss80_ops(int addr, ss80_op_t *ops)
+{
+    long ind = 0;
+    int i, ch;
+
+    while(ind < proto.len)
+    {
+        ch = proto.data[ind++];
+        printf("[SS80 %02d ", addr);
+        if(ch >= 0x20 && ch <= 0x2f)
+        {
+            printf("Set Unit:(%d)]\n", ch & 0x0f);
+            continue;
+        }
+        if(ops == ss80_ops && ch >= 0x40 && ch <= 0x4f)
+        {
+            printf("Set Volume:(%d)]\n", ch & 0x0f);
+            continue;
+        }
+        for(i=0; ops[i].op != -1; ++i)
+            if(ops[i].op == ch)
+                break;
+        if(ops[i].op == -1)
+        {
+            printf("Invalid OP Code (%02XH)]\n", ch);
+            return;
+        }
+        if(ind + ops[i].params > proto.len)
+        {
+            printf("%s, missing parameters]\n", ops[i].name);
+            return;
+        }
+        if(ch == 0x10)
+            printf("%s:(%08lXH)]\n", ops[i].name, (long) get_be(proto.data+ind, 6));
+        else if(ch == 0x18)
+            printf("%s:(%08lXH)]\n", ops[i].name, (long) get_be(proto.data+ind, 4));
+        else
+            printf("%s]\n", ops[i].name);
+        ind += ops[i].params;
+    }
+}
+
+/// @brief Decode a completed SS80 data phase
+/// @param[in] addr: device address
+/// @return void
+void decode_ss80(int addr)
+{
+    int sa = proto.secondary;
+
+    if(sa == 0x65 && proto.dir == 'L')
+        decode_ss80_ops(addr, ss80_ops);
+    else if(sa == 0x72 && proto.dir == 'L')
+        decode_ss80_ops(addr, ss80_transparent_ops);
+    else if(sa == 0x6e)
+        printf("[SS80 %02d Execute %s %ld bytes]\n", addr,
+            proto.dir == 'L' ? "write" : "read", proto.len);
+    else if(sa == 0x70 && proto.dir == 'T')
+        printf("[SS80 %02d Report QSTAT:%d]\n", addr, proto.len ? proto.data[0] : -1);
+    else if(sa == 0x70 && proto.dir == 'L')
+        printf("[SS80 %02d Amigo Clear]\n", addr);
+    else
+        printf("[SS80 %02d SA %02XH %c %ld bytes]\n", addr, sa, proto.dir, proto.len);
+}
+
+/// @brief Decode a completed AMIGO data phase
+/// @param[in] addr: device address
+/// @return void
+void decode_amigo(int addr)
+{
+    int i, op;
+    int sa = proto.secondary;
+    uint8_t *p = proto.data;
+
+    if(sa == 0x60)
+    {
+        printf("[AMIGO %02d %s %ld bytes]\n", addr,
+            proto.dir == 'L' ? "Write data" : "Read data", proto.len);
+        return;
+    }
+    if(sa == 0x70 && proto.dir == 'T')
+    {
+        printf("[AMIGO %02d DSJ:%d]\n", addr, proto.len ? p[0] : -1);
+        return;
+    }
+    if(sa == 0x70 && proto.dir == 'L')
+    {
+        printf("[AMIGO %02d Clear]\n", addr);
+        return;
+    }
+    if(sa == 0x68 && proto.dir == 'T')
+    {
+        printf("[AMIGO %02d Status %ld bytes]\n", addr, proto.len);
+        return;
+    }
+    if(proto.dir == 'L' && proto.len)
+    {
+        op = p[0];
+        for(i=0; amigo_ops[i].sa != -1; ++i)
+        {
+            if(amigo_ops[i].sa == sa && amigo_ops[i].op == op)
+            {
+                printf("[AMIGO %02d %s", addr, amigo_ops[i].name);
+                if(op == 0x02 && sa == 0x68 && proto.len >= 5)
+                {
+                    ///@brief unit, cylinder, head, sector - 6 byte form has a 16 bit cylinder
+                    if(proto.len == 6)
+                        printf(" unit:%d cyl:%d head:%d sector:%d",
+                            p[1], (int) get_be(p+2,2), p[4], p[5]);
+                    else
+                        printf(" unit:%d cyl:%d head:%d sector:%d",
+                            p[1], p[2], p[3], p[4]);
+                }
+                else if(proto.len >= 2)
+                    printf(" unit:%d", p[1]);
+                printf("]\n");
+                return;
+            }
+        }
+    }
+    printf("[AMIGO %02d SA %02XH %c %ld bytes]\n", addr, sa, proto.dir, proto.len);
+}
+
+/// @brief Decode the data phase that just ended
+/// @return void
+void proto_end_data()
+{
+    int addr = proto.addr;
+
+    if(proto.len && addr >= 0 && proto.secondary >= 0)
+    {
+        if(proto.devices[addr] == DEV_SS80)
+            decode_ss80(addr);
+        else if(proto.devices[addr] == DEV_AMIGO)
+            decode_amigo(addr);
+    }
+    proto.len = 0;
+}
+
+/// @brief Reset the protocol decoder after IFC
+/// @return void
+void proto_reset()
+{
+    proto.listeners = 0;
+    proto.talker = -1;
+    proto.lastcmd = -1;
+    proto.secondary = -1;
+    proto.addr = -1;
+    proto.dir = 'L';
+    proto.len = 0;
+}
+
+/// @brief Find the one listening device we know about
+/// @return address or -1
+int proto_listener()
+{
+    int i;
+    for(i=0;i<31;++i)
+        if((proto.listeners & (1UL << i)) && proto.devices[i] != DEV_NONE)
+            return(i);
+    return(-1);
+}
+
+/// @brief Feed one bus byte to the protocol decoder
+/// @param[in] status: data bus value (lower 8 bits) control bus (upper 8 bits)
+/// @return void
+void proto_byte(uint16_t status)
+{
+    int cmd;
+
+    ///@brief IFC is seen on every read while it is held LOW
+    if(status & IFC_FLAG)
+    {
+        proto_end_data();
+        if(!proto.ifc)
+            printf("[IFC]\n");
+        proto_reset();
+        proto.ifc = 1;
+        return;
+    }
+    proto.ifc = 0;
+
+    if(!(status & ATN_FLAG))
+    {
+        if(proto.len < DATA_MAX)
+            proto.data[proto.len] = status & 0xff;
+        ++proto.len;
+        if(status & EOI_FLAG)
+            proto_end_data();
+        return;
+    }
+
+    proto_end_data();
+    cmd = status & CMD_MASK;
+
+    if(cmd == UNL)
+        proto.listeners = 0;
+    else if(cmd >= 0x20 && cmd <= 0x3e)
+        proto.listeners |= 1UL << (cmd & 0x1f);
+    else if(cmd == UNT)
+        proto.talker = -1;
+    else if(cmd >= 0x40 && cmd <= 0x5e)
+        proto.talker = cmd & 0x1f;
+    else if(cmd >= 0x60)
+    {
+        ///@brief UNT followed by our secondary address is an Identify
+        if(proto.lastcmd == UNT && proto.devices[cmd & 0x1f] != DEV_NONE)
+        {
+            printf("[%s %02d Identify]\n", dev_name(proto.devices[cmd & 0x1f]), cmd & 0x1f);
+            proto.secondary = -1;
+        }
+        else if(proto.lastcmd >= 0x40 && proto.lastcmd <= 0x5e)
+        {
+            proto.secondary = cmd;
+            proto.addr = proto.talker;
+            proto.dir = 'T';
+        }
+        else
+        {
+            proto.secondary = cmd;
+            proto.addr = proto_listener();
+            proto.dir = 'L';
+        }
+    }
+    else if(cmd == 0x04 || cmd == 0x14)
+    {
+        int addr = proto_listener();
+        if(cmd == 0x14)
+            printf("[Device Clear]\n");
+        else if(addr >= 0)
+            printf("[%s %02d Selected Device Clear]\n", dev_name(proto.devices[addr]), addr);
+    }
+    proto.lastcmd = cmd;
+}
+
+/// @brief Read a little endian 16 bit value
+/// @param[in] p: data
+/// @return value
+uint16_t get_le16(uint8_t *p)
+{
+    return(p[0] | (p[1] << 8));
+}
+
+/// @brief Display usage
+/// @param[in] name: program name
+/// @return void
+void usage(char *name)
+{
+    fprintf(stderr,
+        "Usage: %s [-t] [-p] [-a ADDR] [-s ADDR] capture.bin\n"
+        "  -t       show time in seconds of each bus state\n"
+        "  -p       decode SS80 and AMIGO commands\n"
+        "  -a ADDR  AMIGO device address, may be repeated, default 0 and 1\n"
+        "  -s ADDR  SS80 device address, may be repeated, default 2 and 3\n",
+        name);
+}
+
+int main(int argc, char *argv[])
+{
+    FILE *fi;
+    uint8_t header[16];
+    uint8_t *rec;
+    uint16_t hsize, rsize;
+    uint32_t unit_ns;
+    uint32_t high = 0;
+    double now = 0;
+    long records = 0;
+    int c;
+    int user_devices = 0;
+    char str[128];
+
+    memset(&proto, 0, sizeof(proto));
+    proto_reset();
+
+    while((c = getopt(argc, argv, "tpa:s:")) != -1)
+    {
+        switch(c)
+        {
+            case 't':
+                opt_time = 1;
+                break;
+            case 'p':
+                opt_proto = 1;
+                break;
+            case 'a':
+            case 's':
+                if(atoi(optarg) < 0 || atoi(optarg) > 30)
+                {
+                    fprintf(stderr,"bad address: %s\n", optarg);
+                    return(1);
+                }
+                proto.devices[atoi(optarg)] = (c == 'a') ? DEV_AMIGO : DEV_SS80;
+                user_devices = 1;
+                break;
+            default:
+                usage(argv[0]);
+                return(1);
+        }
+    }
+    if(optind != argc - 1)
+    {
+        usage(argv[0]);
+        return(1);
+    }
+    if(!user_devices)
+    {
+        proto.devices[0] = DEV_AMIGO;
+        proto.devices[1] = DEV_AMIGO;
+        proto.devices[2] = DEV_SS80;
+        proto.devices[3] = DEV_SS80;
+    }
+
+    fi = fopen(argv[optind], "rb");
+    if(fi == NULL)
+    {
+        perror(argv[optind]);
+        return(1);
+    }
+    if(fread(header, 1, sizeof(header), fi) != sizeof(header)
+        || memcmp(header, GPIB_CAPTURE_MAGIC, 7) != 0)
+    {
+        fprintf(stderr,"%s: not a GPIB capture file\n", argv[optind]);
+        fclose(fi);
+        return(1);
+    }
+    if(header[7] != GPIB_CAPTURE_VERSION)
+    {
+        fprintf(stderr,"%s: unsupported version %d\n", argv[optind], header[7]);
+        fclose(fi);
+        return(1);
+    }
+    hsize = get_le16(header+8);
+    rsize = get_le16(header+10);
+    unit_ns = get_le16(header+12) | ((uint32_t) get_le16(header+14) << 16);
+    if(rsize < 5 || hsize < sizeof(header) || fseek(fi, hsize, SEEK_SET) != 0)
+    {
+        fprintf(stderr,"%s: bad header\n", argv[optind]);
+        fclose(fi);
+        return(1);
+    }
+
+    rec = calloc(rsize, 1);
+    if(rec == NULL)
+    {
+        fclose(fi);
+        return(1);
+    }
+
+    gpib_decode_header(stdout);
+
+    while(fread(rec, 1, rsize, fi) == rsize)
+    {
+        uint16_t status = get_le16(rec+2);
+        int state = rec[4] & GPIB_CAPTURE_STATE_MASK;
+
+        if(state == GPIB_CAPTURE_TIME)
+        {
+            high = status;
+            continue;
+        }
+        now += (double) (((uint32_t) high << 16) | get_le16(rec)) * unit_ns / 1e9;
+        high = 0;
+        ++records;
+
+        gpib_trace_str(str, status, state);
+        if(opt_time)
+            printf("%12.6f %s\n", now, str);
+        else
+            printf("%s\n", str);
+
+        ///@brief TRACE_BUS records have no data byte
+        if(opt_proto && state != TRACE_BUS)
+            proto_byte(status);
+    }
+    if(opt_proto)
+        proto_end_data();
+
+    fprintf(stderr,"%ld records, %.6f seconds\n", records, now);
+    free(rec);
+    fclose(fi);
+    return(0);
+}
@@ -0,0 +1,86 @@
+/**
+ @file host/gpib_ops.h
+
+ @brief SS80 and AMIGO op code tables for the HP85 disk emulator host tools.
+
+ @par Edit History
+ - [1.0]   [Mike Gore]  Initial revision of file.
+
+ @par Copyright &copy; 2014-2020 Mike Gore, Inc. All rights reserved. GPL
+ @see http://github.com/magore/hp85disk
+ @see http://github.com/magore/hp85disk/COPYRIGHT.md for Copyright details
+
+ Host C library side - shared by gpib_decode.c and replay.c.
+*/
+
+#ifndef _GPIB_OPS_H_
+#define _GPIB_OPS_H_
+
+///@brief SS80 command phase op codes and parameter byte counts, see gpib/ss80.c
+typedef struct {
+    int op;
+    int params;
+    char *name;
+} ss80_op_t;
+
+static ss80_op_t ss80_ops[] =
+{
+    {0x00, 0, "Locate and Read" },
+    {0x02, 0, "Locate and Write" },
+    {0x04, 0, "Locate and Verify" },
+    {0x0D, 0, "Request Status" },
+    {0x0E, 0, "Release" },
+    {0x0F, 0, "Release Denied" },
+    {0x10, 6, "Set Address" },
+    {0x18, 4, "Set Length" },
+    {0x31, 2, "Validate Key" },
+    {0x33, 3, "Initiate Diagnostic" },
+    {0x34, 0, "NO-OP" },
+    {0x35, 0, "Describe" },
+    {0x37, 2, "Initialize Media" },
+    {0x39, 2, "Set RPS" },
+    {0x3B, 1, "Set Release" },
+    {0x3E, 8, "Set Status Mask" },
+    {0x48, 1, "Set Return Addressing" },
+    {0x4C, 0, "Door UnLock" },
+    {0x4D, 0, "Door Lock" },
+    {-1, 0, NULL }
+};
+
+///@brief SS80 transparent op codes, see gpib/ss80.c
+static ss80_op_t ss80_transparent_ops[] =
+{
+    {0x01, 0, "HP-IB Parity Checking" },
+    {0x02, 0, "Read Loopback" },
+    {0x03, 0, "Write Loopback" },
+    {0x08, 0, "Channel Independent Clear" },
+    {0x09, 0, "Cancel" },
+    {-1, 0, NULL }
+};
+
+///@brief AMIGO command op codes by secondary address, see gpib/amigo.c
+typedef struct {
+    int sa;
+    int op;
+    char *name;
+} amigo_op_t;
+
+static amigo_op_t amigo_ops[] =
+{
+    {0x68, 0x00, "Cold Load Read" },
+    {0x68, 0x02, "Seek" },
+    {0x68, 0x03, "Request Status Buffered" },
+    {0x68, 0x05, "Read Unbuffered" },
+    {0x68, 0x07, "Verify" },
+    {0x68, 0x08, "Write Unbuffered" },
+    {0x68, 0x0B, "Initialize" },
+    {0x68, 0x2B, "Initialize" },
+    {0x68, 0x14, "Request Logical Address" },
+    {0x69, 0x08, "Write Buffered" },
+    {0x6A, 0x08, "Request Status Unbuffered" },
+    {0x6A, 0x05, "Read Buffered" },
+    {0x6C, 0x18, "Format" },
+    {-1, 0, NULL }
+};
+
+#endif
@@ -0,0 +1,317 @@
+/**
+ @file host/host.c
+
+ @brief Linux host services for the HP85 disk emulator host build.
+
+ @par Edit History
+ - [1.0]   [Mike Gore]  Initial revision of file.
+
+ @par Copyright &copy; 2014-2020 Mike Gore, Inc. All rights reserved. GPL
+ @see http://github.com/magore/hp85disk
+ @see http://github.com/magore/hp85disk/COPYRIGHT.md for Copyright details
+
+ Host C library side - do not include the firmware headers here.
+ - Interrupt disable and enable: a mutex shared with the timer thread.
+ - System timer: a thread calling the firmware timer task at SYSTEM_TASK_HZ.
+ - UART: stdin is read by a thread into a receive buffer, output is stdout.
+*/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "host.h"
+
+///@brief Interrupt lock, see host_cli()
+static pthread_mutex_t irq_lock = PTHREAD_MUTEX_INITIALIZER;
+
+///@brief This thread holds the interrupt lock
+static __thread int irq_held = 0;
+
+static volatile int quit_flag = 0;
+static volatile int quit_code = 0;
+
+/// @brief Disable interrupts - blocks the timer thread.
+///
+/// - Like the AVR it is harmless to call cli() when disabled.
+/// @return void
+void host_cli()
+{
+    if(irq_held)
+        return;
+    pthread_mutex_lock(&irq_lock);
+    irq_held = 1;
+}
+
+/// @brief Enable interrupts - releases the timer thread.
+/// @return void
+void host_sei()
+{
+    if(!irq_held)
+        return;
+    irq_held = 0;
+    pthread_mutex_unlock(&irq_lock);
+}
+
+// =============================================
+///@brief System timer thread
+
+///@brief Timer tick in nanoseconds - 1000HZ
+#define HOST_TIC_NS 1000000L
+
+///@brief Most ticks we make up for after the process was stalled
+#define HOST_TIC_CATCHUP 100
+
+static void (*timer_task)(void) = NULL;
+static pthread_t timer_thread;
+
+///@brief Time of the last tick, protected by the interrupt lock
+static struct timespec tick_time;
+
+/// @brief Add nanoseconds to a timespec.
+/// @param[in,out] ts: time.
+/// @param[in] ns: nanoseconds to add.
+/// @return void
+static void host_ts_add(struct timespec *ts, long ns)
+{
+    ts->tv_nsec += ns;
+    while(ts->tv_nsec >= 1000000000L)
+    {
+        ts->tv_nsec -= 1000000000L;
+        ts->tv_sec++;
+    }
+}
+
+/// @brief Call the timer task every tick like the AVR timer ISR.
+/// @param[in] arg: unused.
+/// @return NULL
+static void *host_timer_thread(void *arg)
+{
+    struct timespec next, now;
+    int missed;
+
+    clock_gettime(CLOCK_MONOTONIC, &next);
+    while(!quit_flag)
+    {
+        host_ts_add(&next, HOST_TIC_NS);
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+
+        host_cli();
+        timer_task();
+        clock_gettime(CLOCK_MONOTONIC, &tick_time);
+        host_sei();
+
+        ///@brief If we fell far behind do not try to catch up
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        missed = (int) (((now.tv_sec - next.tv_sec) * 1000000000L
+            + (now.tv_nsec - next.tv_nsec)) / HOST_TIC_NS);
+        if(missed > HOST_TIC_CATCHUP)
+            next = now;
+    }
+    return(NULL);
+}
+
+/// @brief Start the system timer thread.
+/// @param[in] task: timer task called every tick with interrupts disabled.
+/// @return 0 on success, -1 on error.
+int host_timer_start(void (*task)(void))
+{
+    if(timer_task)
+        return(0);
+    timer_task = task;
+    if(pthread_create(&timer_thread, NULL, host_timer_thread, NULL))
+    {
+        timer_task = NULL;
+        perror("host timer thread");
+        return(-1);
+    }
+    pthread_detach(timer_thread);
+    return(0);
+}
+
+/// @brief Delay in microseconds.
+/// @param[in] us: microseconds.
+/// @return void
+void host_delay_us(uint32_t us)
+{
+    struct timespec ts;
+
+    if(!us)
+        return;
+    ts.tv_sec = us / 1000000UL;
+    ts.tv_nsec = (us % 1000000UL) * 1000L;
+    while(nanosleep(&ts, &ts) < 0 && errno == EINTR)
+        ;
+}
+
+/// @brief Time since the last tick - call with interrupts disabled.
+/// @return nanoseconds, less than one tick.
+long host_tick_ns()
+{
+    struct timespec now;
+    long ns;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    if(now.tv_sec - tick_time.tv_sec > 1)
+        return(HOST_TIC_NS - 1);
+    ns = (now.tv_sec - tick_time.tv_sec) * 1000000000L + (now.tv_nsec - tick_time.tv_nsec);
+    if(ns < 0)
+        return(0);
+    if(ns >= HOST_TIC_NS)
+        return(HOST_TIC_NS - 1);
+    return(ns);
+}
+
+/// @brief Host time of day.
+/// @return seconds since 1 Jan 1970 UTC.
+uint32_t host_time()
+{
+    return( (uint32_t) time(NULL) );
+}
+
+// =============================================
+///@brief Console
+
+#define HOST_RX_SIZE 1024
+
+static pthread_mutex_t rx_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t rx_cond = PTHREAD_COND_INITIALIZER;
+static uint8_t rx_buf[HOST_RX_SIZE];
+static int rx_head = 0;
+static int rx_count = 0;
+static int rx_eof = 0;
+static int rx_eof_quit = 0;
+static pthread_t rx_thread;
+
+/// @brief Read stdin into the receive buffer.
+/// @param[in] arg: unused.
+/// @return NULL
+static void *host_rx_thread(void *arg)
+{
+    int c;
+
+    while((c = getchar()) != EOF)
+    {
+        pthread_mutex_lock(&rx_lock);
+        while(rx_count == HOST_RX_SIZE)
+            pthread_cond_wait(&rx_cond, &rx_lock);
+        rx_buf[(rx_head + rx_count) % HOST_RX_SIZE] = c;
+        rx_count++;
+        pthread_cond_broadcast(&rx_cond);
+        pthread_mutex_unlock(&rx_lock);
+    }
+    pthread_mutex_lock(&rx_lock);
+    rx_eof = 1;
+    pthread_cond_broadcast(&rx_cond);
+    pthread_mutex_unlock(&rx_lock);
+    if(rx_eof_quit)
+        host_quit(0);
+    return(NULL);
+}
+
+/// @brief Exit at the end of console input - nothing else can drive the emulator.
+/// @return void
+void host_tty_eof_quit()
+{
+    rx_eof_quit = 1;
+    if(rx_eof)
+        host_quit(0);
+}
+
+/// @brief Start the console.
+/// @return 0 on success, -1 on error.
+int host_tty_init()
+{
+    static int done = 0;
+
+    if(done)
+        return(0);
+    done = 1;
+
+    setvbuf(stdout, NULL, _IOLBF, 0);
+    if(pthread_create(&rx_thread, NULL, host_rx_thread, NULL))
+    {
+        perror("host console thread");
+        return(-1);
+    }
+    pthread_detach(rx_thread);
+    return(0);
+}
+
+/// @brief Console receive count.
+/// @return number of characters waiting.
+int host_tty_rx_count()
+{
+    int count;
+
+    ///@brief No more input - do not take the lock on every poll
+    if(rx_eof && !rx_count)
+        return(0);
+    pthread_mutex_lock(&rx_lock);
+    count = rx_count;
+    pthread_mutex_unlock(&rx_lock);
+    return(count);
+}
+
+/// @brief Console receive - waits for a character.
+/// @return character or -1 at end of input or on quit.
+int host_tty_getc()
+{
+    int c = -1;
+
+    pthread_mutex_lock(&rx_lock);
+    while(!rx_count && !rx_eof && !quit_flag)
+        pthread_cond_wait(&rx_cond, &rx_lock);
+    if(rx_count)
+    {
+        c = rx_buf[rx_head];
+        rx_head = (rx_head + 1) % HOST_RX_SIZE;
+        rx_count--;
+        pthread_cond_broadcast(&rx_cond);
+    }
+    pthread_mutex_unlock(&rx_lock);
+    return(c);
+}
+
+/// @brief Console transmit.
+/// @param[in] c: character.
+/// @return c.
+int host_tty_putc(int c)
+{
+    putchar(c & 0xff);
+    return(c);
+}
+
+// =============================================
+
+/// @brief Ask the main loop to exit.
+/// @param[in] code: process exit code.
+/// @return void
+void host_quit(int code)
+{
+    quit_code = code;
+    quit_flag = 1;
+    pthread_mutex_lock(&rx_lock);
+    pthread_cond_broadcast(&rx_cond);
+    pthread_mutex_unlock(&rx_lock);
+}
+
+/// @brief Has host_quit() been called.
+/// @return 1 if so.
+int host_quit_requested()
+{
+    return(quit_flag);
+}
+
+/// @brief Exit code passed to host_quit().
+/// @return exit code.
+int host_exit_code()
+{
+    fflush(stdout);
+    return(quit_code);
+}
@@ -0,0 +1,45 @@
+/**
+ @file host/host.h
+
+ @brief Linux host services for the HP85 disk emulator host build.
+
+ @par Edit History
+ - [1.0]   [Mike Gore]  Initial revision of file.
+
+ @par Copyright &copy; 2014-2020 Mike Gore, Inc. All rights reserved. GPL
+ @see http://github.com/magore/hp85disk
+ @see http://github.com/magore/hp85disk/COPYRIGHT.md for Copyright details
+
+ Shared by the firmware and the host C library side of the build.
+ Only use fixed size integer types here - the firmware has its own
+ time_t, off_t and FILE definitions that do not match the host C library.
+*/
+
+#ifndef _HOST_H_
+#define _HOST_H_
+
+#include <stdint.h>
+
+/* host.c */
+void host_cli ( void );
+void host_sei ( void );
+int host_timer_start ( void (*task )(void ));
+void host_delay_us ( uint32_t us );
+uint32_t host_time ( void );
+long host_tick_ns ( void );
+int host_tty_init ( void );
+void host_tty_eof_quit ( void );
+int host_tty_rx_count ( void );
+int host_tty_getc ( void );
+int host_tty_putc ( int c );
+void host_quit ( int code );
+int host_quit_requested ( void );
+int host_exit_code ( void );
+
+/* host_init.c */
+int host_init ( int argc , char *argv []);
+int host_run ( int (*bench )(int address ,int blocks ));
+
+/* host_hal.c */
+int host_bench ( int address , int blocks );
+#endif
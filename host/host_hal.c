@@ -0,0 +1,366 @@
+/**
+ @file host/host_hal.c
+
+ @brief Hardware layer replacements for the HP85 disk emulator host build.
+
+ @par Edit History
+ - [1.0]   [Mike Gore]  Initial revision of file.
+
+ @par Copyright &copy; 2014-2020 Mike Gore, Inc. All rights reserved. GPL
+ @see http://github.com/magore/hp85disk
+ @see http://github.com/magore/hp85disk/COPYRIGHT.md for Copyright details
+
+ Firmware side - provides the functions of the AVR only files
+ hardware/rs232.c, delay.c, ram.c, rtc.c, spi.c, lib/timer_hal.c
+ and fatfs.hal/mmc_hal.c on top of host.c, vbus.c and filedisk.c.
+ - host_bench() runs gpib_bench() for the vbus_ctl.c controller thread.
+*/
+
+#include "user_config.h"
+#include "fatfs.h"
+#include "filedisk.h"
+#include "gpib_hal.h"
+#include "gpib_bench.h"
+
+// =============================================
+///@brief UART - hardware/rs232.c
+
+/// @brief  Initialize UART - attach the console to stdin, stdout and stderr.
+///
+/// @param[in] uart: uart number, only uart 0 is supported.
+/// @param[in] baud: requested baud rate.
+///
+/// @return  actual baud rate - same as requested.
+uint32_t uart_init(uint8_t uart, uint32_t baud)
+{
+    if(uart)
+        return(0);
+    host_tty_init();
+    fdevopen((void *)uart0_putchar, (void *)uart0_getchar);
+    return(baud);
+}
+
+/// @brief  Flush UART receive buffer - not used on the host.
+/// @param[in] uart: uart number.
+/// @return  void
+void uart_rx_flush(uint8_t uart)
+{
+}
+
+/// @brief  UART receive character function for fdevopen().
+/// @param[in] f: unused FILE *stream pointer.
+/// @return  uart_getchar(0).
+int uart0_getchar( void *f)
+{
+    return( uart_getchar(0) );
+}
+
+/// @brief  UART transmit character function for fdevopen().
+/// @param[in] c: character to send.
+/// @param[in] f: unused FILE *stream pointer.
+/// @return  c.
+int uart0_putchar(int c, void *f)
+{
+    uart_putchar(c, 0);
+    return(c);
+}
+
+/// @brief Receive count.
+/// @param[in] uart: uart number.
+/// @return  Character count in receive buffer.
+int uart_rx_count(uint8_t uart)
+{
+    if(uart)
+        return(0);
+    return( host_tty_rx_count() );
+}
+
+/// @brief  Receive byte, waits for input.
+/// @param[in] uart: uart number.
+/// @return  Character or EOF.
+int uart_rx_byte(uint8_t uart)
+{
+    if(uart)
+        return(EOF);
+    return( host_tty_getc() );
+}
+
+/// @brief  Receive character, waits for input.
+///
+/// - The host terminal does the echo.
+/// @param[in] uart: uart number.
+/// @return  Character or EOF.
+int uart_getchar(uint8_t uart)
+{
+    int c;
+
+    if(uart)
+        return(EOF);
+    c = host_tty_getc();
+    if(c < 0)
+        return(EOF);
+    if(c == '\r')
+        c = '\n';
+    return(c);
+}
+
+/// @brief Transmit 1 byte.
+/// @param[in] c: transmit character.
+/// @param[in] uart: uart number.
+/// @return c.
+int uart_putchar(int c, int uart)
+{
+    return( host_tty_putc(c) );
+}
+
+/// @brief Do we have receive characters waiting ?.
+///
+/// - Also true when the host asks us to exit so gpib_task() returns.
+/// @param[in] uart: uart number.
+/// @return  Non zero if so.
+int uart_keyhit(uint8_t uart)
+{
+    if(host_quit_requested())
+        return(1);
+    return ( uart_rx_count( uart ) );
+}
+
+/// @brief  Transmit a character on UART 0
+/// @param[in] c: character to write
+/// @return  c
+int uart_put(int c)
+{
+    return( uart0_putchar(c,0) );
+}
+
+/// @brief  Receive a character from UART 0
+/// @return  character
+int uart_get(void)
+{
+    return(uart0_getchar(0));
+}
+
+// =============================================
+///@brief Delays - hardware/delay.c
+
+/// @brief  Delay microseconds
+/// @param[in] us: microseconds
+/// @return  void
+void delayus(uint32_t us)
+{
+    host_delay_us(us);
+}
+
+/// @brief  Delay milliseconds
+/// @param[in] ms: milliseconds
+/// @return  void
+void delayms(uint32_t ms)
+{
+    host_delay_us(ms * 1000UL);
+}
+
+// =============================================
+///@brief Memory - hardware/ram.c
+#undef calloc
+#undef free
+#undef malloc
+
+/// @brief Free memory is not tracked on the host.
+/// @return 0
+uint16_t freeRam ()
+{
+    return(0);
+}
+
+/// @brief Display free memory.
+/// @return  void
+void PrintFree()
+{
+    printf("Free Ram: host memory is not tracked\n");
+}
+
+/// @brief Safe Alloc -  Display Error message if Calloc fails
+/// @return  pointer or NULL.
+void *safecalloc(int size, int elements)
+{
+    void *p = calloc(size, elements);
+    if(!p)
+    {
+        printf("safecalloc(%d,%d) failed!\n", size, elements);
+    }
+    return(p);
+}
+
+/// @brief Safe Malloc -  Display Error message if Malloc fails
+/// @param[in] size:  size
+/// @return  pointer or NULL.
+void *safemalloc(size_t size)
+{
+    void *p = calloc(size, 1);
+    if(!p)
+    {
+        printf("safemalloc(%d) failed!\n", (int) size);
+    }
+    return(p);
+}
+
+/// @brief Safe free
+/// @param[in] p: pointer to free.
+/// @return  void.
+void safefree(void *p)
+{
+    if(p == NULL)
+        return;
+    free(p);
+}
+
+// =============================================
+///@brief RTC - hardware/rtc.c, the host clock is our RTC
+
+/// @brief  Initialize RTC - the host clock is always running
+/// @param[in] force: ignored
+/// @param[in] seconds: ignored
+/// @return 1 on success
+uint8_t rtc_init (int force, time_t seconds)
+{
+    return(1);
+}
+
+/// @brief  Set RTC - we do not change the host clock
+/// @param[in] t: ignored
+/// @return 1 on success
+uint8_t rtc_write(tm_t *t)
+{
+    return(1);
+}
+
+/// @brief  Read RTC
+/// @param[out] t: host time in UTC
+/// @return 1 on success
+uint8_t rtc_read(tm_t *t)
+{
+    time_to_tm((time_t) host_time(), 0, t);
+    return(1);
+}
+
+// =============================================
+///@brief System timer - lib/timer_hal.c
+
+/// @brief Disable the system task
+/// @return void.
+void disable_system_task()
+{
+    cli();
+}
+
+/// @brief Enable the system task
+/// @return void.
+void enable_system_task()
+{
+    sei();
+}
+
+/// @brief High resolution clock - lib/timer_hal.c
+///
+/// - The system clock plus the time since the last timer tick.
+/// @param[in] clk_id: unused.
+/// @param[out] ts: time.
+/// @return 0
+int clock_gettime(clockid_t clk_id, struct timespec *ts)
+{
+    cli();
+    ts->tv_sec = __clock.tv_sec;
+    ts->tv_nsec = __clock.tv_nsec + host_tick_ns();
+    sei();
+    if(ts->tv_nsec >= 1000000000L)
+    {
+        ts->tv_nsec -= 1000000000L;
+        ts->tv_sec++;
+    }
+    return(0);
+}
+
+/// @brief Start the host timer thread - it calls execute_timers()
+/// @return void.
+void install_timers_isr()
+{
+    if(host_timer_start(execute_timers) < 0)
+        printf("host timer start failed\n");
+}
+
+// =============================================
+///@brief SPI - only the PPR shift register is on the SPI bus
+
+/// @brief  SPI transfer to the PPR shift register
+/// @param[in] Data: byte to send
+/// @return byte read
+uint8_t SPI0_TXRX_Byte(uint8_t Data)
+{
+    return( vbus_spi_txrx(Data) );
+}
+
+// =============================================
+///@brief MMC - fatfs.hal/mmc_hal.c, the card is a disk image file
+
+/// @brief Initialize the disk image and mount FatFs, display diagnostics.
+///
+/// @param[in] verbose: display initialisation messages
+/// @return FatFs result code
+int mmc_init(int verbose)
+{
+    int rc;
+    ///@brief fatfs_scan_files() appends directory names to the path
+    char path[256] = "/";
+
+    if( verbose)
+        printf("START MMC INIT\n");
+
+    rc = disk_initialize(DEV_FILE);
+    if( rc != RES_OK  )
+        put_rc(rc);
+
+    if( rc == RES_OK)
+        rc = f_mount(&Fatfs[0],"/", 0);
+
+    if( rc != RES_OK || verbose)
+        put_rc( rc );
+
+    if( verbose && rc == RES_OK)
+        fatfs_status(path);
+
+    if( verbose)
+        printf("END MMC INIT\n");
+
+    return( rc ) ;
+}
+
+/// @brief  MMC Card Inserted status
+/// @return 1 if the disk image is open
+int mmc_ins_status()
+{
+    return( file_disk_status() & STA_NOINIT ? 0 : 1 );
+}
+
+/// @brief  MMC Card Write Protect status
+/// @return 0 == not write protected
+int mmc_wp_status()
+{
+    return( file_disk_status() & STA_PROTECT ? 1 : 0 );
+}
+
+// =============================================
+///@brief GPIB bench - gpib/gpib_bench.c as the bus controller
+
+/// @brief Run gpib_bench() in the controller thread, the blocks read are written back.
+///
+/// - The caller has switched this thread to the controller port, see vbus_ctl_port().
+/// - gpib_unread() state is thread local, see GPIB_THREAD.
+/// - Only a user abort stops us, IFC and idle work belong to the device thread.
+/// @param[in] address: SS80 drive GPIB address
+/// @param[in] blocks: blocks per transfer
+/// @return 0 on success, -1 on error
+int host_bench(int address, int blocks)
+{
+    gpib_event_mask = GPIB_EV_KEY;
+    return( gpib_bench(address, blocks, 1) );
+}
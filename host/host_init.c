@@ -0,0 +1,180 @@
+/**
+ @file host/host_init.c
+
+ @brief Command line setup for the HP85 disk emulator host build.
+
+ @par Edit History
+ - [1.0]   [Mike Gore]  Initial revision of file.
+
+ @par Copyright &copy; 2014-2020 Mike Gore, Inc. All rights reserved. GPL
+ @see http://github.com/magore/hp85disk
+ @see http://github.com/magore/hp85disk/COPYRIGHT.md for Copyright details
+
+ Host C library side - do not include the firmware headers here.
+ - Called by main() before any firmware initialisation.
+*/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "host.h"
+#include "vbus.h"
+#include "vbus_ctl.h"
+#include "filedisk.h"
+#include "replay.h"
+
+///@brief Exit when the controller self test is done
+static int host_ctl_exit = 0;
+
+///@brief The bus is shared with other processes, see -b
+static int host_shared_bus = 0;
+
+/// @brief Display command line usage.
+/// @param[in] name: program name.
+/// @return void
+static void host_usage(const char *name)
+{
+    fprintf(stderr,
+        "Usage: %s [options]\n"
+        "  -i image   FAT disk image used as the SD card [hp85disk.img]\n"
+        "  -s MB      size of a new disk image [64]\n"
+        "  -f         format the disk image\n"
+        "  -d dir     copy files from dir into the image, existing files are kept\n"
+        "  -r         open the disk image read only\n"
+        "  -b name    shared memory name of the virtual GPIB bus [private bus]\n"
+        "  -t spec    controller self test device, may be repeated\n"
+        "             amigo:ADDRESS[:PPR[:FILE]] or ss80:ADDRESS[:PPR[:FILE]]\n"
+        "  -u unit    SS80 UNIT[:VOLUME] of the last -t device [0:0]\n"
+        "  -n blocks  blocks read from each test device [16]\n"
+        "  -B         run the gpib bench on the ss80 test devices instead of the self test\n"
+        "             -n is the bench blocks per transfer, 1 .. 8\n"
+        "  -T trace   replay a gpib trace file instead of the self test\n"
+        "  -M from:to replay trace address from on emulator address to, may be repeated\n"
+        "  -m         keep the disk image in memory, changes are discarded\n"
+        "  -x         exit with the self test or replay result\n",
+        name);
+}
+
+/// @brief Parse the command line, open the virtual bus and the disk image.
+///
+/// @param[in] argc: argument count.
+/// @param[in] argv: arguments.
+/// @return 0 on success, -1 on error.
+int host_init(int argc, char *argv[])
+{
+    const char *image = "hp85disk.img";
+    const char *dir = NULL;
+    const char *bus = NULL;
+    uint32_t megabytes = 64;
+    int format = 0;
+    int readonly = 0;
+    int memory = 0;
+    int ret;
+    int c;
+
+    while((c = getopt(argc, argv, "i:s:fd:rb:t:u:n:BT:M:mxh")) != -1)
+    {
+        switch(c)
+        {
+            case 'i':
+                image = optarg;
+                break;
+            case 's':
+                megabytes = strtoul(optarg, NULL, 0);
+                break;
+            case 'f':
+                format = 1;
+                break;
+            case 'd':
+                dir = optarg;
+                break;
+            case 'r':
+                readonly = 1;
+                break;
+            case 'b':
+                bus = optarg;
+                break;
+            case 't':
+                if(vbus_ctl_add(optarg) < 0)
+                    return(-1);
+                break;
+            case 'u':
+                if(vbus_ctl_unit(optarg) < 0)
+                    return(-1);
+                break;
+            case 'n':
+                vbus_ctl_blocks(atoi(optarg));
+                break;
+            case 'B':
+                vbus_ctl_bench();
+                break;
+            case 'T':
+                if(replay_load(optarg) < 0)
+                    return(-1);
+                break;
+            case 'M':
+                if(replay_map(optarg) < 0)
+                    return(-1);
+                break;
+            case 'm':
+                memory = 1;
+                break;
+            case 'x':
+                host_ctl_exit = 1;
+                break;
+            default:
+                host_usage(argv[0]);
+                return(-1);
+        }
+    }
+
+    if(vbus_open(bus) < 0)
+        return(-1);
+    host_shared_bus = (bus && *bus);
+
+    ret = file_disk_open(image, megabytes, readonly);
+    if(ret < 0)
+        return(-1);
+    if(ret == 1 || format)
+    {
+        fprintf(stderr,"Formatting %s\n", image);
+        if(file_disk_format() < 0)
+            return(-1);
+    }
+    if(dir)
+    {
+        ret = file_disk_import(dir);
+        if(ret < 0)
+            return(-1);
+        fprintf(stderr,"Copied %d files from %s to %s\n", ret, dir, image);
+    }
+    if(memory && file_disk_memory() < 0)
+        return(-1);
+    return(0);
+}
+
+/// @brief Start the trace replay, or the controller self test if any devices were given.
+/// @param[in] bench: runs the firmware gpib bench as the controller, see -B
+/// @return 0 on success, -1 on error.
+int host_run(int (*bench)(int address, int blocks))
+{
+    if(replay_active())
+        return( replay_start(host_ctl_exit) );
+    if(!vbus_ctl_count())
+    {
+        ///@brief -x with nothing to run
+        if(host_ctl_exit)
+        {
+            host_quit(0);
+            return(0);
+        }
+        ///@brief No controller on a private bus - only the console is left
+        if(!host_shared_bus)
+            host_tty_eof_quit();
+        return(0);
+    }
+    return( vbus_ctl_start(host_ctl_exit, bench) );
+}
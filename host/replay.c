@@ -0,0 +1,671 @@
+/**
+ @file host/replay.c
+
+ @brief GPIB trace replay for the HP85 disk emulator host build.
+
+ @par Edit History
+ - [1.0]   [Mike Gore]  Initial revision of file.
+
+ @par Copyright &copy; 2014-2020 Mike Gore, Inc. All rights reserved. GPL
+ @see http://github.com/magore/hp85disk
+ @see http://github.com/magore/hp85disk/COPYRIGHT.md for Copyright details
+
+ Host C library side - do not include the firmware headers here.
+ - Replays a "gpib trace" text file, see sdcard/traces, on the virtual bus.
+ - Bytes the controller sent in the trace are sent to the emulator,
+   bytes a device sent are read back and compared with the trace.
+ - Both the old "PEASRIT" and the current "AESRPITB" flag layouts are read.
+ - A "..." line means the trace was cut short, the read continues until EOI.
+ - Reports the time and throughput of each kind of transaction.
+*/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <pthread.h>
+#include <time.h>
+
+#include "host.h"
+#include "vbus_ctl.h"
+#include "gpib_ops.h"
+#include "replay.h"
+
+static replay_rec_t *replay_recs = NULL;
+static int replay_count = 0;
+static int replay_exit = 0;
+static int replay_errors = 0;
+static int replay_transactions = 0;
+static pthread_t replay_thread;
+
+///@brief Trace address to emulator address
+static int replay_addr_map[31];
+static int replay_addr_map_init = 0;
+
+///@brief Device types by emulator address, learned from Identify
+static int replay_types[31];
+
+static replay_stat_t replay_stats[REPLAY_MAX_STATS];
+static int replay_stat_count = 0;
+
+///@brief Bus addressing state while replaying
+static struct
+{
+    int listener;       ///< last device addressed to listen or -1
+    int talker;         ///< talk address or -1
+    int lastcmd;        ///< previous command byte or -1
+    int sa;             ///< current secondary address or -1
+    int addr;           ///< device the secondary address was sent to or -1
+    int identify;       ///< the secondary address is an Identify
+} replay_bus;
+
+/// @brief Set the address map to one to one.
+/// @return void
+static void replay_map_init()
+{
+    int i;
+
+    if(replay_addr_map_init)
+        return;
+    for(i=0;i<31;++i)
+        replay_addr_map[i] = i;
+    replay_addr_map_init = 1;
+}
+
+/// @brief Replay the trace bytes of one device address on another.
+///
+/// @param[in] spec: "FROM:TO" GPIB addresses.
+/// @return 0 on success, -1 on error.
+int replay_map(const char *spec)
+{
+    int from, to;
+
+    replay_map_init();
+    if(sscanf(spec, "%d:%d", &from, &to) != 2 ||
+        from < 0 || from > 30 || to < 0 || to > 30 ||
+        from == CTL_ADDRESS || to == CTL_ADDRESS)
+    {
+        fprintf(stderr,"bad address map: %s\n", spec);
+        return(-1);
+    }
+    replay_addr_map[from] = to;
+    return(0);
+}
+
+/// @brief Read a trace file.
+///
+/// - Lines start with the hex byte, an optional ASCII character and the flags.
+/// - Any other line is skipped.
+/// @param[in] name: trace file name.
+/// @return 0 on success, -1 on error.
+int replay_load(const char *name)
+{
+    FILE *fp;
+    char line[256];
+    char flags[32];
+    replay_rec_t *rec;
+    int size = 0;
+    int lineno = 0;
+
+    replay_map_init();
+
+    fp = fopen(name, "r");
+    if(fp == NULL)
+    {
+        perror(name);
+        return(-1);
+    }
+
+    free(replay_recs);
+    replay_recs = NULL;
+    replay_count = 0;
+
+    while(fgets(line, sizeof(line), fp))
+    {
+        ++lineno;
+        if(strncmp(line, "...", 3) == 0)
+        {
+            if(replay_count)
+                replay_recs[replay_count-1].flags |= REPLAY_CUT;
+            continue;
+        }
+        if(!isxdigit(line[0]) || !isxdigit(line[1]) || line[2] != ' ' || strlen(line) < 6)
+            continue;
+        if(sscanf(line + 5, "%31s", flags) != 1)
+            continue;
+
+        if(replay_count >= size)
+        {
+            size = size ? size * 2 : 1024;
+            rec = realloc(replay_recs, size * sizeof(replay_rec_t));
+            if(rec == NULL)
+            {
+                fprintf(stderr,"%s: out of memory\n", name);
+                fclose(fp);
+                return(-1);
+            }
+            replay_recs = rec;
+        }
+        rec = &replay_recs[replay_count++];
+        rec->ch = strtoul(line, NULL, 16);
+        rec->line = lineno;
+        rec->flags = 0;
+        ///@brief The flag letters are unique in both layouts
+        if(strchr(flags, 'A'))
+            rec->flags |= REPLAY_ATN;
+        if(strchr(flags, 'E'))
+            rec->flags |= REPLAY_EOI;
+        if(strchr(flags, 'I'))
+            rec->flags |= REPLAY_IFC;
+    }
+    fclose(fp);
+
+    if(!replay_count)
+    {
+        fprintf(stderr,"%s: no GPIB trace records\n", name);
+        return(-1);
+    }
+    return(0);
+}
+
+/// @brief Do we have a trace to replay ?
+/// @return 1 if so.
+int replay_active()
+{
+    return(replay_count != 0);
+}
+
+/// @brief Time since start in microseconds.
+/// @param[in] start: start time.
+/// @return microseconds.
+static double replay_elapsed_us(struct timespec *start)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return( (now.tv_sec - start->tv_sec) * 1e6 + (now.tv_nsec - start->tv_nsec) / 1e3 );
+}
+
+/// @brief Forget the bus addressing, as IFC does.
+/// @return void
+static void replay_reset()
+{
+    replay_bus.listener = -1;
+    replay_bus.talker = -1;
+    replay_bus.lastcmd = -1;
+    replay_bus.sa = -1;
+    replay_bus.addr = -1;
+    replay_bus.identify = 0;
+}
+
+/// @brief Follow the bus addressing and map device addresses.
+///
+/// @param[in] ch: command byte from the trace.
+/// @return command byte to send.
+static uint8_t replay_command(uint8_t ch)
+{
+    int cmd = ch & 0x7f;
+    int addr = cmd & 0x1f;
+
+    if(cmd >= 0x20 && cmd <= 0x5e && addr != CTL_ADDRESS && addr != 0x1f)
+    {
+        addr = replay_addr_map[addr];
+        cmd = (cmd & 0x60) | addr;
+    }
+
+    if(cmd == CTL_UNL)
+        replay_bus.listener = -1;
+    else if(cmd >= 0x20 && cmd <= 0x3e)
+    {
+        if(addr != CTL_ADDRESS)
+            replay_bus.listener = addr;
+    }
+    else if(cmd == CTL_UNT)
+        replay_bus.talker = -1;
+    else if(cmd >= 0x40 && cmd <= 0x5e)
+        replay_bus.talker = addr;
+    else if(cmd >= 0x60)
+    {
+        replay_bus.identify = 0;
+        ///@brief UNT followed by the device secondary address is an Identify
+        if(replay_bus.lastcmd == CTL_UNT && addr <= 30)
+        {
+            addr = replay_addr_map[addr];
+            cmd = 0x60 | addr;
+            replay_bus.identify = 1;
+            replay_bus.talker = addr;
+            replay_bus.addr = addr;
+            replay_bus.sa = cmd;
+        }
+        else if(replay_bus.lastcmd >= 0x40 && replay_bus.lastcmd <= 0x5e)
+        {
+            replay_bus.sa = cmd;
+            replay_bus.addr = replay_bus.talker;
+        }
+        else
+        {
+            replay_bus.sa = cmd;
+            replay_bus.addr = replay_bus.listener;
+        }
+    }
+    replay_bus.lastcmd = cmd;
+    return(cmd);
+}
+
+/// @brief Name of the last SS80 op code in a command message.
+///
+/// @param[in] ops: op code table.
+/// @param[in] data: command message.
+/// @param[in] len: message length.
+/// @return op code name.
+static const char *replay_ss80_op(ss80_op_t *ops, const uint8_t *data, int len)
+{
+    const char *name = "Set Unit";
+    int ind = 0;
+    int i, ch;
+
+    while(ind < len)
+    {
+        ch = data[ind++];
+        if(ch >= 0x20 && ch <= 0x2f)
+            continue;
+        if(ops == ss80_ops && ch >= 0x40 && ch <= 0x4f)
+        {
+            name = "Set Volume";
+            continue;
+        }
+        for(i=0; ops[i].op != -1; ++i)
+            if(ops[i].op == ch)
+                break;
+        if(ops[i].op == -1)
+            return("Invalid OP Code");
+        name = ops[i].name;
+        ind += ops[i].params;
+    }
+    return(name);
+}
+
+/// @brief Name a transaction for the statistics.
+///
+/// @param[out] name: transaction name.
+/// @param[in] size: name buffer size.
+/// @param[in] dir: 'L' data to the device, 'T' data from the device.
+/// @param[in] data: data phase from the trace.
+/// @param[in] len: data phase length.
+/// @return void
+static void replay_name(char *name, int size, int dir, const uint8_t *data, int len)
+{
+    int sa = replay_bus.sa;
+    int type = REPLAY_UNKNOWN;
+    int i;
+
+    if(replay_bus.addr >= 0 && replay_bus.addr <= 30)
+        type = replay_types[replay_bus.addr];
+
+    if(sa < 0)
+    {
+        snprintf(name, size, "Bus commands");
+        return;
+    }
+    if(replay_bus.identify)
+    {
+        snprintf(name, size, "Identify");
+        return;
+    }
+
+    if(type == REPLAY_SS80)
+    {
+        if(sa == 0x65 && dir == 'L')
+            snprintf(name, size, "SS80 %s", replay_ss80_op(ss80_ops, data, len));
+        else if(sa == 0x72 && dir == 'L')
+            snprintf(name, size, "SS80 %s", replay_ss80_op(ss80_transparent_ops, data, len));
+        else if(sa == 0x6e)
+            snprintf(name, size, "SS80 Execute %s", dir == 'L' ? "write" : "read");
+        else if(sa == 0x70 && dir == 'T')
+            snprintf(name, size, "SS80 Report");
+        else if(sa == 0x70 && dir == 'L')
+            snprintf(name, size, "SS80 Amigo Clear");
+        else
+            snprintf(name, size, "SS80 SA %02XH %c", sa, dir);
+        return;
+    }
+
+    if(type == REPLAY_AMIGO)
+    {
+        if(sa == 0x60)
+            snprintf(name, size, "AMIGO %s", dir == 'L' ? "Write data" : "Read data");
+        else if(sa == 0x70 && dir == 'T')
+            snprintf(name, size, "AMIGO DSJ");
+        else if(sa == 0x70 && dir == 'L')
+            snprintf(name, size, "AMIGO Clear");
+        else if(sa == 0x68 && dir == 'T')
+            snprintf(name, size, "AMIGO Status");
+        else
+        {
+            snprintf(name, size, "AMIGO SA %02XH %c", sa, dir);
+            if(dir == 'L' && len)
+            {
+                for(i=0; amigo_ops[i].sa != -1; ++i)
+                {
+                    if(amigo_ops[i].sa == sa && amigo_ops[i].op == data[0])
+                    {
+                        snprintf(name, size, "AMIGO %s", amigo_ops[i].name);
+                        break;
+                    }
+                }
+            }
+        }
+        return;
+    }
+
+    snprintf(name, size, "SA %02XH %c", sa, dir);
+}
+
+/// @brief Add a transaction to the statistics.
+///
+/// @param[in] name: transaction name.
+/// @param[in] bytes: data phase bytes.
+/// @param[in] us: time in microseconds.
+/// @param[in] error: the transaction did not match the trace.
+/// @return void
+static void replay_stat(const char *name, long bytes, double us, int error)
+{
+    replay_stat_t *st;
+    int i;
+
+    for(i=0;i<replay_stat_count;++i)
+        if(strcmp(replay_stats[i].name, name) == 0)
+            break;
+    if(i == replay_stat_count)
+    {
+        if(replay_stat_count >= REPLAY_MAX_STATS)
+            return;
+        st = &replay_stats[replay_stat_count++];
+        memset(st, 0, sizeof(*st));
+        snprintf(st->name, sizeof(st->name), "%s", name);
+    }
+    st = &replay_stats[i];
+    st->count++;
+    st->bytes += bytes;
+    st->total_us += us;
+    if(us > st->max_us)
+        st->max_us = us;
+    if(error)
+        st->errors++;
+    ++replay_transactions;
+}
+
+/// @brief Display the statistics.
+/// @param[in] ms: total replay time.
+/// @return void
+static void replay_report(long ms)
+{
+    replay_stat_t *st;
+    int i;
+
+    printf("[REPLAY %d records, %d transactions, %d errors, %ld ms]\n",
+        replay_count, replay_transactions, replay_errors, ms);
+    printf("%-32s %6s %8s %6s %10s %10s %10s\n",
+        "Transaction", "count", "bytes", "errors", "avg us", "max us", "bytes/s");
+    for(i=0;i<replay_stat_count;++i)
+    {
+        st = &replay_stats[i];
+        printf("%-32s %6ld %8ld %6ld %10.1f %10.1f %10.0f\n",
+            st->name, st->count, st->bytes, st->errors,
+            st->total_us / st->count, st->max_us,
+            st->total_us > 0 ? st->bytes * 1e6 / st->total_us : 0.0);
+    }
+}
+
+/// @brief Read a data phase from the device and compare it with the trace.
+///
+/// - A data phase that does not match is still read to the end.
+/// @param[in] recs: trace records of the data phase.
+/// @param[in] len: number of records.
+/// @param[out] buf: bytes read.
+/// @return number of bytes read, -1 on error.
+static int replay_read(replay_rec_t *recs, int len, uint8_t *buf)
+{
+    int total = 0;
+    int error = 0;
+    int start, end, n, i, eoi, cut, want_eoi;
+
+    for(start=0; start < len; start = end)
+    {
+        ///@brief read up to and including each EOI
+        for(end=start; end < len; ++end)
+        {
+            if(recs[end].flags & (REPLAY_EOI | REPLAY_CUT))
+            {
+                ++end;
+                break;
+            }
+        }
+        if(total + end - start > REPLAY_READ_MAX)
+        {
+            printf("[REPLAY line %d: data phase too long]\n", recs[start].line);
+            return(-1);
+        }
+        cut = (recs[end-1].flags & REPLAY_CUT) ? 1 : 0;
+        want_eoi = (recs[end-1].flags & REPLAY_EOI) ? 1 : 0;
+
+        n = vbus_ctl_read(buf + total, cut ? REPLAY_READ_MAX - total : end - start, &eoi);
+        if(n < 0)
+        {
+            printf("[REPLAY line %d: read timeout]\n", recs[start].line);
+            return(-1);
+        }
+        for(i=0; i < n && i < end - start; ++i)
+        {
+            if(buf[total+i] != recs[start+i].ch)
+            {
+                printf("[REPLAY line %d: expected %02XH got %02XH]\n",
+                    recs[start+i].line, recs[start+i].ch, buf[total+i]);
+                error = 1;
+                break;
+            }
+        }
+        if(cut ? !eoi : (n != end - start || eoi != want_eoi))
+        {
+            printf("[REPLAY line %d: expected %d bytes%s got %d bytes%s]\n",
+                recs[start].line, end - start, want_eoi ? " with EOI" : "",
+                n, eoi ? " with EOI" : "");
+            error = 1;
+        }
+        total += n;
+    }
+    return(error ? -1 : total);
+}
+
+/// @brief Send a data phase from the trace to the device.
+///
+/// @param[in] recs: trace records of the data phase.
+/// @param[in] len: number of records.
+/// @param[in] buf: scratch buffer.
+/// @return number of bytes sent, -1 on error.
+static int replay_write(replay_rec_t *recs, int len, uint8_t *buf)
+{
+    int start, end, i;
+
+    for(start=0; start < len; start = end)
+    {
+        for(end=start; end < len; ++end)
+        {
+            if(recs[end].flags & REPLAY_EOI)
+            {
+                ++end;
+                break;
+            }
+        }
+        if(end - start > REPLAY_READ_MAX)
+        {
+            printf("[REPLAY line %d: data phase too long]\n", recs[start].line);
+            return(-1);
+        }
+        for(i=start;i<end;++i)
+            buf[i-start] = recs[i].ch;
+        if(vbus_ctl_write(buf, end - start, (recs[end-1].flags & REPLAY_EOI) ? 1 : 0))
+        {
+            printf("[REPLAY line %d: write failed]\n", recs[start].line);
+            return(-1);
+        }
+    }
+    return(len);
+}
+
+/// @brief Send our listen address before the talk address in a command group.
+///
+/// - The HP85 sends MLA after the device talk secondary, the emulator
+///   starts talking as soon as it sees the secondary so we must already listen.
+/// @param[in,out] cmd: command bytes.
+/// @param[in] n: number of bytes.
+/// @return void
+static void replay_listen_first(uint8_t *cmd, int n)
+{
+    int i, talk = -1;
+
+    for(i=0;i<n;++i)
+    {
+        if(talk < 0 && cmd[i] >= 0x40 && cmd[i] <= 0x5e && cmd[i] != CTL_MTA)
+            talk = i;
+        if(cmd[i] == CTL_MLA && talk >= 0)
+        {
+            memmove(cmd + talk + 1, cmd + talk, i - talk);
+            cmd[talk] = CTL_MLA;
+            return;
+        }
+    }
+}
+
+/// @brief Replay one transaction - IFC, or commands and a data phase.
+///
+/// @param[in] i: index of the first trace record.
+/// @param[in] buf: REPLAY_READ_MAX byte buffer.
+/// @return index of the next transaction.
+static int replay_transaction(int i, uint8_t *buf)
+{
+    struct timespec start;
+    uint8_t cmd[REPLAY_CMD_MAX];
+    uint8_t data[REPLAY_CMD_MAX];
+    char name[48];
+    int n, first, len, dir, ret, error;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    ///@brief IFC is on every record while it is held LOW
+    if(replay_recs[i].flags & REPLAY_IFC)
+    {
+        while(i < replay_count && (replay_recs[i].flags & REPLAY_IFC))
+            ++i;
+        vbus_ctl_ifc();
+        replay_reset();
+        replay_stat("IFC", 0, replay_elapsed_us(&start), 0);
+        return(i);
+    }
+
+    n = 0;
+    while(i < replay_count && (replay_recs[i].flags & (REPLAY_ATN | REPLAY_IFC)) == REPLAY_ATN)
+    {
+        cmd[n++] = replay_command(replay_recs[i++].ch);
+        if(n == REPLAY_CMD_MAX)
+            break;
+    }
+    replay_listen_first(cmd, n);
+    if(n && vbus_ctl_cmd(cmd, n))
+    {
+        printf("[REPLAY line %d: command failed]\n", replay_recs[i-1].line);
+        ++replay_errors;
+    }
+
+    first = i;
+    while(i < replay_count && !(replay_recs[i].flags & (REPLAY_ATN | REPLAY_IFC)))
+        ++i;
+    len = i - first;
+
+    dir = (replay_bus.talker == CTL_ADDRESS) ? 'L' : 'T';
+    for(n=0; n < len && n < REPLAY_CMD_MAX; ++n)
+        data[n] = replay_recs[first+n].ch;
+    replay_name(name, sizeof(name), dir, data, n);
+
+    ret = 0;
+    if(len)
+    {
+        if(replay_bus.talker == CTL_ADDRESS)
+            ret = replay_write(replay_recs + first, len, buf);
+        else if(replay_bus.talker >= 0)
+            ret = replay_read(replay_recs + first, len, buf);
+        else
+        {
+            printf("[REPLAY line %d: data without a talker]\n", replay_recs[first].line);
+            ret = -1;
+        }
+    }
+    error = (ret < 0);
+    if(error)
+        ++replay_errors;
+
+    ///@brief Learn the device type from the Identify response in the trace
+    if(replay_bus.identify && len == 2 && replay_bus.addr >= 0)
+        replay_types[replay_bus.addr] = (data[0] == 0x02) ? REPLAY_SS80 : REPLAY_AMIGO;
+
+    if(n || len || replay_bus.sa >= 0)
+        replay_stat(name, error ? 0 : ret, replay_elapsed_us(&start), error);
+
+    ///@brief The next secondary address starts a new transaction
+    replay_bus.sa = -1;
+    replay_bus.identify = 0;
+    return(i);
+}
+
+/// @brief Replay thread.
+/// @param[in] arg: unused.
+/// @return NULL
+static void *replay_task(void *arg)
+{
+    struct timespec start;
+    uint8_t dcl = 0x14;
+    uint8_t *buf;
+    int i;
+
+    buf = calloc(REPLAY_READ_MAX, 1);
+    if(buf == NULL)
+        ++replay_errors;
+    else if(vbus_ctl_wait_device())
+        ++replay_errors;
+    else
+    {
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        replay_reset();
+        ///@brief Traces start with devices in use, DCL clears the AMIGO power on DSJ
+        vbus_ctl_ifc();
+        if(vbus_ctl_cmd(&dcl, 1))
+            ++replay_errors;
+        i = 0;
+        while(i < replay_count && !host_quit_requested())
+            i = replay_transaction(i, buf);
+        replay_report((long) (replay_elapsed_us(&start) / 1000));
+    }
+    free(buf);
+
+    printf("REPLAY %s\n", replay_errors ? "FAILED" : "PASSED");
+
+    if(replay_exit)
+        host_quit(replay_errors ? 1 : 0);
+    return(NULL);
+}
+
+/// @brief Start the replay thread.
+/// @param[in] exit_when_done: call host_quit() with the result.
+/// @return 0 on success, -1 on error.
+int replay_start(int exit_when_done)
+{
+    replay_exit = exit_when_done;
+    if(pthread_create(&replay_thread, NULL, replay_task, NULL))
+    {
+        perror("replay thread");
+        return(-1);
+    }
+    pthread_detach(replay_thread);
+    return(0);
+}
@@ -0,0 +1,65 @@
+/**
+ @file host/replay.h
+
+ @brief GPIB trace replay for the HP85 disk emulator host build.
+
+ @par Edit History
+ - [1.0]   [Mike Gore]  Initial revision of file.
+
+ @par Copyright &copy; 2014-2020 Mike Gore, Inc. All rights reserved. GPL
+ @see http://github.com/magore/hp85disk
+ @see http://github.com/magore/hp85disk/COPYRIGHT.md for Copyright details
+
+*/
+
+#ifndef _REPLAY_H_
+#define _REPLAY_H_
+
+#include <stdint.h>
+
+///@brief Trace record flags
+#define REPLAY_ATN      0x01
+#define REPLAY_EOI      0x02
+#define REPLAY_IFC      0x04
+///@brief The trace was cut short after this record with "..."
+#define REPLAY_CUT      0x08
+
+///@brief Largest read when the trace was cut short
+#define REPLAY_READ_MAX 65536
+
+///@brief Largest command group sent at once
+#define REPLAY_CMD_MAX  32
+
+///@brief Number of different transaction names we keep statistics for
+#define REPLAY_MAX_STATS 64
+
+///@brief Device types learned from the Identify responses
+#define REPLAY_UNKNOWN  0
+#define REPLAY_AMIGO    1
+#define REPLAY_SS80     2
+
+///@brief One bus byte from a trace file
+typedef struct
+{
+    uint8_t ch;         ///< data or command byte
+    uint8_t flags;      ///< REPLAY_ATN, REPLAY_EOI, REPLAY_IFC, REPLAY_CUT
+    int line;           ///< trace file line number
+} replay_rec_t;
+
+///@brief Statistics for one kind of transaction
+typedef struct
+{
+    char name[48];      ///< transaction name
+    long count;         ///< number of transactions
+    long bytes;         ///< data phase bytes
+    long errors;        ///< transactions that did not match the trace
+    double total_us;    ///< total time
+    double max_us;      ///< longest transaction
+} replay_stat_t;
+
+/* replay.c */
+int replay_load ( const char *name );
+int replay_map ( const char *spec );
+int replay_active ( void );
+int replay_start ( int exit_when_done );
+#endif
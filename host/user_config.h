@@ -0,0 +1,137 @@
+/**
+ @file host/user_config.h
+
+ @brief Master Include for the Linux host build of the HP85 disk emulator.
+
+ @par Edit History
+ - [1.0]   [Mike Gore]  Initial revision of file.
+
+ @par Copyright &copy; 2014-2020 Mike Gore, Inc. All rights reserved. GPL
+ @see http://github.com/magore/hp85disk
+ @see http://github.com/magore/hp85disk/COPYRIGHT.md for Copyright details
+
+ Replaces hardware/user_config.h when the firmware sources are built for
+ Linux - see host/Makefile.
+ - There is no AVR, the GPIB bus is a shared memory virtual bus, see vbus.h
+ - The SD card is a FatFs disk image file, see filedisk.c
+ - The UART is stdin/stdout and the system timer is a thread, see host.c
+ - The firmware still uses its own printf, posix and time libraries
+   so we only take string, memory and integer support from the C library
+*/
+
+#ifndef _USER_CONFIG_H_
+#define _USER_CONFIG_H_
+
+#define MEMSPACE /**/
+
+#define SYSTEM_TASK_HZ 1000L
+
+///@brief clock_gettime() adds the time since the last tick, see host_hal.c
+#define HAVE_HIRES_TIMER 1
+
+// FATFS - the disk image has no SPI clock
+#ifndef MMC_SLOW
+  #define MMC_SLOW (500000UL)
+#endif
+
+#ifndef MMC_FAST
+  #define MMC_FAST (2500000UL)
+#endif
+
+#define NO_SCANF
+
+#ifndef GPIB_VBUS
+#error GPIB_VBUS undefined - host/user_config.h is only for the host build
+#endif
+
+#if !defined(F_CPU)
+#error F_CPU undefined
+#endif
+
+///  standard includes
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <stdarg.h>
+#include <ctype.h>
+#include <assert.h>
+
+///@brief AVR program memory support is not needed on the host
+#define PROGMEM /**/
+#define PSTR(s) (s)
+#define pgm_read_byte(p) (*(const uint8_t *)(p))
+#define pgm_read_word(p) (*(const uint16_t *)(p))
+#define pgm_read_dword(p) (*(const uint32_t *)(p))
+
+///@brief interrupt enable and disable protect state shared with the timer thread
+#define cli() host_cli()
+#define sei() host_sei()
+
+///@brief AVR busy wait delays
+#define _delay_us(us) host_delay_us(us)
+#define _delay_ms(ms) host_delay_us((ms) * 1000UL)
+
+///@brief There is no watchdog
+#define wdt_reset() /**/
+
+///@brief Bus engine state private to a thread - the vbus controller thread
+/// runs gpib_bench() next to the device, see host_bench()
+#define GPIB_THREAD __thread
+
+#include "host.h"
+#include "vbus.h"
+
+#include "hardware/hal.h"
+#include "hardware/bits.h"
+#include "hardware/delay.h"
+#include "hardware/ram.h"
+
+#include "lib/parsing.h"
+#include "lib/stringsup.h"
+#include "printf/mathio.h"
+
+///@brief printf.c only has sprintf_P, use the same 1024 byte limit
+#define sprintf(s, format, args...) snprintf(s, 1024, format, ##args)
+
+void copyright( void );
+
+#include "lib/time.h"
+#include "lib/timer.h"
+#include "lib/queue.h"
+
+#include "hardware/rtc.h"
+
+#include "fatfs.sup/fatfs.h"
+
+
+#ifndef NULL
+#define NULL        ((void *) 0)
+#endif
+
+typedef enum { false, true } bool;
+
+#define Mem_Clear(a) memset(a, 0, sizeof(a))
+#define Mem_Set(a,b) memset(a, (int) b, sizeof(a))
+
+#define UART_DEVICE_CNT     1                     /**< UART device number */
+
+#include "ram.h"
+#include "rs232.h"
+#include "spi.h"
+#include "rtc.h"
+#include "posix/posix.h"
+
+// sys.c defines alternative safe functions
+#ifndef free
+	#define free(p) safefree(p)
+#endif
+#ifndef calloc
+	#define calloc(n,s) safecalloc(n,s)
+#endif
+#ifndef malloc
+	#define malloc(s) safemalloc(s)
+#endif
+
+#endif
@@ -0,0 +1,423 @@
+/**
+ @file host/vbus.c
+
+ @brief Virtual GPIB bus for the HP85 disk emulator host build.
+
+ @par Edit History
+ - [1.0]   [Mike Gore]  Initial revision of file.
+
+ @par Copyright &copy; 2014-2020 Mike Gore, Inc. All rights reserved. GPL
+ @see http://github.com/magore/hp85disk
+ @see http://github.com/magore/hp85disk/COPYRIGHT.md for Copyright details
+
+ Host C library side - do not include the firmware headers here.
+ - The device side functions implement the gpib_hal.h GPIB_* macros.
+ - The controller side functions are used by vbus_ctl.c or by another
+   process that maps the same shared memory object.
+ - Every reader yields the CPU when the bus has not changed since its
+   last read - both sides spin on the bus like the real hardware does.
+*/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sched.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "vbus.h"
+
+static vbus_t *vbus = NULL;
+static char vbus_name[64];
+
+///@brief bus sequence number seen by the last read of this thread
+static __thread uint32_t vbus_seq_seen;
+
+///@brief The device side functions drive the controller port in this thread
+static __thread int vbus_ctl_thread = 0;
+
+#define VBUS_LD(a)    __atomic_load_n(&(a), __ATOMIC_SEQ_CST)
+#define VBUS_ST(a,v)  __atomic_store_n(&(a), (v), __ATOMIC_SEQ_CST)
+
+/// @brief Open or create the virtual bus.
+///
+/// @param[in] name: POSIX shared memory name, ie "/hp85disk", or NULL
+///  for a bus private to this process.
+/// @return 0 on success, -1 on error.
+int vbus_open(const char *name)
+{
+    int fd;
+    void *p;
+
+    if(vbus)
+        return(0);
+
+    if(name && *name)
+    {
+        fd = shm_open(name, O_RDWR | O_CREAT, 0600);
+        if(fd < 0)
+        {
+            perror(name);
+            return(-1);
+        }
+        if(ftruncate(fd, sizeof(vbus_t)) < 0)
+        {
+            perror(name);
+            close(fd);
+            return(-1);
+        }
+        p = mmap(NULL, sizeof(vbus_t), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+        snprintf(vbus_name, sizeof(vbus_name), "%s", name);
+    }
+    else
+    {
+        p = mmap(NULL, sizeof(vbus_t), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+        vbus_name[0] = 0;
+    }
+
+    if(p == MAP_FAILED)
+    {
+        perror("vbus mmap");
+        return(-1);
+    }
+    vbus = (vbus_t *) p;
+
+    if(vbus->magic != VBUS_MAGIC)
+    {
+        memset(vbus, 0, sizeof(vbus_t));
+        vbus->dev.bus_latch = 0xff;
+        vbus->dev.pin_latch = 0xffff;
+        vbus->ctl_port.bus_latch = 0xff;
+        vbus->ctl_port.pin_latch = 0xffff;
+        VBUS_ST(vbus->magic, VBUS_MAGIC);
+    }
+    return(0);
+}
+
+/// @brief Close the virtual bus and remove any shared memory object.
+/// @return void
+void vbus_close()
+{
+    if(!vbus)
+        return;
+    munmap(vbus, sizeof(vbus_t));
+    vbus = NULL;
+    if(vbus_name[0])
+        shm_unlink(vbus_name);
+    vbus_name[0] = 0;
+}
+
+/// @brief Shared bus state for display and debugging.
+/// @return vbus_t pointer or NULL if not open.
+vbus_t *vbus_state()
+{
+    return(vbus);
+}
+
+/// @brief Note a change of any bus driver.
+/// @return void
+static void vbus_changed()
+{
+    __atomic_add_fetch(&vbus->seq, 1, __ATOMIC_SEQ_CST);
+}
+
+/// @brief Yield the CPU if the bus has not changed since our last read.
+/// @return void
+static void vbus_poll()
+{
+    uint32_t seq = VBUS_LD(vbus->seq);
+    if(seq == vbus_seq_seen)
+        sched_yield();
+    vbus_seq_seen = seq;
+}
+
+/// @brief Port used by the device side functions in this thread.
+/// @return device port, or the controller port, see vbus_ctl_port().
+static vbus_port_t *vbus_port()
+{
+    return( vbus_ctl_thread ? &vbus->ctl_port : &vbus->dev );
+}
+
+/// @brief Pins a port pulls LOW.
+/// @param[in] port: port.
+/// @return mask of LOW pins, bit = VBUS pin number.
+static uint16_t vbus_port_low(vbus_port_t *port)
+{
+    return( VBUS_LD(port->pin_ddr) & ~VBUS_LD(port->pin_latch) );
+}
+
+/// @brief Data lines a port pulls LOW.
+/// @param[in] port: port.
+/// @return mask of LOW data lines, bit 0 = DIO1.
+static uint8_t vbus_port_data_low(vbus_port_t *port)
+{
+    return( VBUS_LD(port->bus_ddr) & ~VBUS_LD(port->bus_latch) );
+}
+
+/// @brief Control lines pulled LOW by all drivers.
+/// @return mask of LOW lines, bit = VBUS pin number.
+static uint16_t vbus_lines_low()
+{
+    return( (vbus_port_low(&vbus->dev) | vbus_port_low(&vbus->ctl_port)
+        | VBUS_LD(vbus->ctl_pins)) & VBUS_GPIB_LINES );
+}
+
+/// @brief Data lines pulled LOW by all drivers, including the PPR register.
+/// @return mask of LOW data lines, bit 0 = DIO1.
+static uint8_t vbus_data_low()
+{
+    uint8_t low;
+    uint16_t lines = vbus_lines_low();
+
+    low = vbus_port_data_low(&vbus->dev);
+    low |= vbus_port_data_low(&vbus->ctl_port);
+    low |= VBUS_LD(vbus->ctl_bus);
+
+    ///@brief Parallel Poll - hardware response while ATN and EOI are LOW
+    if( (lines & (1 << VBUS_ATN)) && (lines & (1 << VBUS_EOI)) )
+        low |= VBUS_LD(vbus->ppr_reg);
+    return(low);
+}
+
+// =============================================
+// Device side - see the GPIB_* macros in gpib_hal.h
+
+/// @brief Set device data bus direction.
+/// @param[in] ddr: 0xff = out, 0 = in.
+/// @return void
+void vbus_bus_dir(uint8_t ddr)
+{
+    VBUS_ST(vbus_port()->bus_ddr, ddr);
+    vbus_changed();
+}
+
+/// @brief Set data bus direction to in then read the bus.
+/// @return bus pin states, LOW = 0.
+uint8_t vbus_bus_rd()
+{
+    vbus_port_t *port = vbus_port();
+
+    if(VBUS_LD(port->bus_ddr))
+    {
+        VBUS_ST(port->bus_ddr, 0);
+        vbus_changed();
+    }
+    vbus_poll();
+    return( ~vbus_data_low() );
+}
+
+/// @brief Write the data bus latch without changing direction.
+/// @param[in] val: latch value.
+/// @return void
+void vbus_bus_latch(uint8_t val)
+{
+    VBUS_ST(vbus_port()->bus_latch, val);
+    vbus_changed();
+}
+
+/// @brief Set the data bus direction to out then write the latch.
+/// @param[in] val: bus value, 0 bits pull the line LOW.
+/// @return void
+void vbus_bus_wr(uint8_t val)
+{
+    vbus_port_t *port = vbus_port();
+
+    VBUS_ST(port->bus_latch, val);
+    VBUS_ST(port->bus_ddr, 0xff);
+    vbus_changed();
+}
+
+/// @brief Set device pin to input with pullup.
+/// @param[in] pin: VBUS pin number.
+/// @return void
+void vbus_pin_float(uint8_t pin)
+{
+    vbus_port_t *port = vbus_port();
+    uint16_t mask = 1U << pin;
+
+    VBUS_ST(port->pin_latch, VBUS_LD(port->pin_latch) | mask);
+    VBUS_ST(port->pin_ddr, VBUS_LD(port->pin_ddr) & ~mask);
+    vbus_changed();
+}
+
+/// @brief Test a pin without changing its direction.
+/// @param[in] pin: VBUS pin number.
+/// @return 1 = HI, 0 = LOW.
+uint8_t vbus_pin_tst(uint8_t pin)
+{
+    uint16_t mask = 1U << pin;
+
+    vbus_poll();
+    if(mask & VBUS_GPIB_LINES)
+        return( (vbus_lines_low() & mask) ? 0 : 1 );
+    ///@brief board pins only see the port latch
+    return( (VBUS_LD(vbus_port()->pin_latch) & mask) ? 1 : 0 );
+}
+
+/// @brief Set device pin to output LOW.
+/// @param[in] pin: VBUS pin number.
+/// @return void
+void vbus_pin_low(uint8_t pin)
+{
+    vbus_port_t *port = vbus_port();
+    uint16_t mask = 1U << pin;
+
+    VBUS_ST(port->pin_latch, VBUS_LD(port->pin_latch) & ~mask);
+    VBUS_ST(port->pin_ddr, VBUS_LD(port->pin_ddr) | mask);
+    vbus_changed();
+}
+
+/// @brief Set device pin to output HI.
+///
+/// - A PPE rising edge latches the PPR shift register.
+/// @param[in] pin: VBUS pin number.
+/// @return void
+void vbus_pin_hi(uint8_t pin)
+{
+    vbus_port_t *port = vbus_port();
+    uint16_t mask = 1U << pin;
+    uint16_t latch = VBUS_LD(port->pin_latch);
+
+    if(pin == VBUS_PPE && port == &vbus->dev && !(latch & mask))
+        VBUS_ST(vbus->ppr_reg, VBUS_LD(vbus->ppr_shift));
+
+    VBUS_ST(port->pin_latch, latch | mask);
+    VBUS_ST(port->pin_ddr, VBUS_LD(port->pin_ddr) | mask);
+    vbus_changed();
+}
+
+/// @brief Set device pin to input then read it.
+/// @param[in] pin: VBUS pin number.
+/// @return 1 = HI, 0 = LOW.
+uint8_t vbus_pin_rd(uint8_t pin)
+{
+    vbus_port_t *port = vbus_port();
+    uint16_t mask = 1U << pin;
+
+    if(VBUS_LD(port->pin_ddr) & mask)
+    {
+        VBUS_ST(port->pin_ddr, VBUS_LD(port->pin_ddr) & ~mask);
+        vbus_changed();
+    }
+    return( vbus_pin_tst(pin) );
+}
+
+/// @brief Write a pin latch without changing its direction.
+/// @param[in] pin: VBUS pin number.
+/// @param[in] val: latch value.
+/// @return void
+void vbus_latch_wr(uint8_t pin, uint8_t val)
+{
+    vbus_port_t *port = vbus_port();
+    uint16_t mask = 1U << pin;
+    uint16_t latch = VBUS_LD(port->pin_latch);
+
+    if(val)
+        latch |= mask;
+    else
+        latch &= ~mask;
+    VBUS_ST(port->pin_latch, latch);
+    vbus_changed();
+}
+
+/// @brief Read a pin latch.
+/// @param[in] pin: VBUS pin number.
+/// @return latch value.
+uint8_t vbus_latch_rd(uint8_t pin)
+{
+    return( (VBUS_LD(vbus_port()->pin_latch) & (1U << pin)) ? 1 : 0 );
+}
+
+/// @brief Read the data bus without changing direction.
+/// @return bus pin states, LOW = 0.
+uint8_t vbus_ppr_rd()
+{
+    return( ~vbus_data_low() );
+}
+
+/// @brief Read the device data bus direction.
+/// @return direction bits, 1 = out.
+uint8_t vbus_ppr_ddr_rd()
+{
+    return( VBUS_LD(vbus_port()->bus_ddr) );
+}
+
+/// @brief SPI transfer to the PPR shift register.
+/// @param[in] data: shift register value, bit 0 = DIO1.
+/// @return 0xff, nothing drives SPI MISO.
+uint8_t vbus_spi_txrx(uint8_t data)
+{
+    VBUS_ST(vbus->ppr_shift, data);
+    return(0xff);
+}
+
+// =============================================
+// Controller side
+
+/// @brief Make the device side functions drive the controller port in this thread.
+///
+/// - Lets firmware code run as the bus controller next to the device thread,
+///   see vbus_ctl.c.
+/// - The port is released when the thread switches back.
+/// @param[in] on: 1 = controller port, 0 = device port.
+/// @return void
+void vbus_ctl_port(int on)
+{
+    if(!on && vbus_ctl_thread)
+    {
+        vbus_port_t *port = &vbus->ctl_port;
+        VBUS_ST(port->bus_ddr, 0);
+        VBUS_ST(port->pin_ddr, 0);
+        VBUS_ST(port->bus_latch, 0xff);
+        VBUS_ST(port->pin_latch, 0xffff);
+        vbus_changed();
+    }
+    vbus_ctl_thread = on;
+}
+
+/// @brief Pull a control line LOW or release it.
+/// @param[in] pin: VBUS pin number.
+/// @param[in] low: 1 = pull LOW, 0 = release.
+/// @return void
+void vbus_ctl_pin(uint8_t pin, uint8_t low)
+{
+    uint16_t mask = 1U << pin;
+    uint16_t pins = VBUS_LD(vbus->ctl_pins);
+
+    if(low)
+        pins |= mask;
+    else
+        pins &= ~mask;
+    VBUS_ST(vbus->ctl_pins, pins);
+    vbus_changed();
+}
+
+/// @brief Drive the data lines.
+/// @param[in] val: data byte, 1 bits pull the line LOW, 0 releases all.
+/// @return void
+void vbus_ctl_bus(uint8_t val)
+{
+    VBUS_ST(vbus->ctl_bus, val);
+    vbus_changed();
+}
+
+/// @brief Test a control line.
+/// @param[in] pin: VBUS pin number.
+/// @return 1 = HI, 0 = LOW.
+uint8_t vbus_ctl_pin_tst(uint8_t pin)
+{
+    vbus_poll();
+    return( (vbus_lines_low() & (1U << pin)) ? 0 : 1 );
+}
+
+/// @brief Read the data lines.
+/// @return data byte, LOW lines read as 1.
+uint8_t vbus_ctl_bus_rd()
+{
+    vbus_poll();
+    return( vbus_data_low() );
+}
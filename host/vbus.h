@@ -0,0 +1,97 @@
+/**
+ @file host/vbus.h
+
+ @brief Virtual GPIB bus for the HP85 disk emulator host build.
+
+ @par Edit History
+ - [1.0]   [Mike Gore]  Initial revision of file.
+
+ @par Copyright &copy; 2014-2020 Mike Gore, Inc. All rights reserved. GPL
+ @see http://github.com/magore/hp85disk
+ @see http://github.com/magore/hp85disk/COPYRIGHT.md for Copyright details
+
+ The bus lives in shared memory and models open collector lines.
+ - A line is LOW if any side pulls it LOW - just like the real bus.
+ - The device side mirrors the AVR port model: direction and latch bits.
+ - The controller side just pulls lines LOW or releases them.
+   - Or a controller thread uses the device side functions on its own
+     port, see vbus_ctl_port().
+ - The PPR shift register is loaded by SPI0_TXRX_Byte() and latched
+   by a PPE rising edge - see ppr_set() in gpib_hal.c.
+ - The PPR register drives the data lines while ATN and EOI are both LOW.
+*/
+
+#ifndef _VBUS_H_
+#define _VBUS_H_
+
+#include <stdint.h>
+
+///@brief GPIB control lines - bit numbers in the control line masks
+#define VBUS_EOI     0
+#define VBUS_DAV     1
+#define VBUS_NRFD    2
+#define VBUS_NDAC    3
+#define VBUS_IFC     4
+#define VBUS_SRQ     5
+#define VBUS_ATN     6
+#define VBUS_REN     7
+///@brief V2 board pins - seen only by the device, never on the GPIB bus
+#define VBUS_TE      8
+#define VBUS_PE      9
+#define VBUS_DC      10
+#define VBUS_SC      11
+#define VBUS_LED1    12
+#define VBUS_LED2    13
+#define VBUS_PPE     14
+
+///@brief Mask of the pins that are GPIB bus lines
+#define VBUS_GPIB_LINES 0xff
+
+///@brief AVR style port registers of one bus driver
+typedef struct
+{
+    uint8_t  bus_ddr;       ///< data bus direction, 1 = out
+    uint8_t  bus_latch;     ///< data bus latch
+    uint16_t pin_ddr;       ///< pin direction, 1 = out
+    uint16_t pin_latch;     ///< pin latch
+} vbus_port_t;
+
+///@brief Shared memory bus state
+typedef struct
+{
+    uint32_t magic;         ///< VBUS_MAGIC once initialized
+    uint32_t seq;           ///< incremented on every change of a driver
+    vbus_port_t dev;        ///< device port
+    uint8_t  ppr_shift;     ///< PPR shift register, last SPI byte
+    uint8_t  ppr_reg;       ///< PPR output register, latched by PPE
+    uint8_t  ctl_bus;       ///< data lines the controller pulls LOW
+    uint16_t ctl_pins;      ///< control lines the controller pulls LOW
+    vbus_port_t ctl_port;   ///< controller port, see vbus_ctl_port()
+} vbus_t;
+
+#define VBUS_MAGIC 0x48503835UL
+
+/* vbus.c */
+int vbus_open ( const char *name );
+void vbus_close ( void );
+vbus_t *vbus_state ( void );
+void vbus_bus_dir ( uint8_t ddr );
+uint8_t vbus_bus_rd ( void );
+void vbus_bus_latch ( uint8_t val );
+void vbus_bus_wr ( uint8_t val );
+void vbus_pin_float ( uint8_t pin );
+uint8_t vbus_pin_tst ( uint8_t pin );
+void vbus_pin_low ( uint8_t pin );
+void vbus_pin_hi ( uint8_t pin );
+uint8_t vbus_pin_rd ( uint8_t pin );
+void vbus_latch_wr ( uint8_t pin , uint8_t val );
+uint8_t vbus_latch_rd ( uint8_t pin );
+uint8_t vbus_ppr_rd ( void );
+uint8_t vbus_ppr_ddr_rd ( void );
+uint8_t vbus_spi_txrx ( uint8_t data );
+void vbus_ctl_port ( int on );
+void vbus_ctl_pin ( uint8_t pin , uint8_t low );
+void vbus_ctl_bus ( uint8_t val );
+uint8_t vbus_ctl_pin_tst ( uint8_t pin );
+uint8_t vbus_ctl_bus_rd ( void );
+#endif
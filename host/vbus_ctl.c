@@ -0,0 +1,1074 @@
+/**
+ @file host/vbus_ctl.c
+
+ @brief Virtual GPIB bus controller for the HP85 disk emulator host build.
+
+ @par Edit History
+ - [1.0]   [Mike Gore]  Initial revision of file.
+
+ @par Copyright &copy; 2014-2020 Mike Gore, Inc. All rights reserved. GPL
+ @see http://github.com/magore/hp85disk
+ @see http://github.com/magore/hp85disk/COPYRIGHT.md for Copyright details
+
+ Host C library side - do not include the firmware headers here.
+ - Runs in its own thread and drives the virtual bus like the HP85 does.
+ - The command sequences follow sdcard/traces/gpib_trace.txt and amigo_trace.txt.
+ - Self test: identify each device, read blocks and compare them with
+   a host copy of the image, write, read back and restore SS80 blocks.
+ - Bench: gpib_bench() from gpib/gpib_bench.c runs in this thread on the
+   controller port against the SS80 devices, here the emulator is the drive.
+*/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <time.h>
+
+#include "host.h"
+#include "vbus.h"
+#include "vbus_ctl.h"
+
+static ctl_device_t ctl_devices[CTL_MAX_DEVICES];
+static int ctl_device_count = 0;
+static int ctl_test_blocks = 16;
+static int ctl_bench = 0;
+static int (*ctl_bench_run)(int address, int blocks) = NULL;
+static int ctl_exit = 0;
+static int ctl_errors = 0;
+static int ctl_checks = 0;
+static pthread_t ctl_thread;
+
+/// @brief Add a device to test.
+///
+/// @param[in] spec: "amigo:ADDRESS[:PPR[:FILE]]" or "ss80:ADDRESS[:PPR[:FILE]]"
+///   PPR defaults to ADDRESS, FILE is a host copy of the image.
+/// @return 0 on success, -1 on error.
+int vbus_ctl_add(const char *spec)
+{
+    ctl_device_t *dev;
+    char type[16];
+    int n;
+
+    if(ctl_device_count >= CTL_MAX_DEVICES)
+    {
+        fprintf(stderr,"too many devices: %s\n", spec);
+        return(-1);
+    }
+    dev = &ctl_devices[ctl_device_count];
+    memset(dev, 0, sizeof(*dev));
+    dev->ppr = -1;
+
+    n = sscanf(spec, "%15[^:]:%d:%d:%255s", type, &dev->address, &dev->ppr, dev->file);
+    if(n < 2 || dev->address < 0 || dev->address > 30)
+    {
+        fprintf(stderr,"bad device: %s\n", spec);
+        return(-1);
+    }
+    if(dev->ppr < 0)
+        dev->ppr = dev->address;
+    if(dev->ppr > 7)
+    {
+        fprintf(stderr,"bad PPR bit: %s\n", spec);
+        return(-1);
+    }
+
+    if(strcasecmp(type,"amigo") == 0)
+        dev->type = CTL_AMIGO;
+    else if(strcasecmp(type,"ss80") == 0)
+        dev->type = CTL_SS80;
+    else
+    {
+        fprintf(stderr,"bad device type: %s\n", spec);
+        return(-1);
+    }
+    ++ctl_device_count;
+    return(0);
+}
+
+/// @brief Set the SS80 unit and volume of the last device added.
+///
+/// - The device is also checked against unit 0 volume 0 at the same address.
+/// @param[in] spec: "UNIT[:VOLUME]"
+/// @return 0 on success, -1 on error.
+int vbus_ctl_unit(const char *spec)
+{
+    ctl_device_t *dev;
+    int n;
+
+    if(!ctl_device_count || ctl_devices[ctl_device_count-1].type != CTL_SS80)
+    {
+        fprintf(stderr,"unit without an ss80 device: %s\n", spec);
+        return(-1);
+    }
+    dev = &ctl_devices[ctl_device_count-1];
+    dev->volume = 0;
+    n = sscanf(spec, "%d:%d", &dev->unit, &dev->volume);
+    if(n < 1 || dev->unit < 0 || dev->unit > 14 || dev->volume < 0 || dev->volume > 7)
+    {
+        fprintf(stderr,"bad unit: %s\n", spec);
+        return(-1);
+    }
+    return(0);
+}
+
+/// @brief Set the number of blocks read from each device.
+/// @param[in] blocks: block count.
+/// @return void
+void vbus_ctl_blocks(int blocks)
+{
+    if(blocks > 0)
+        ctl_test_blocks = blocks;
+}
+
+/// @brief Run the bus benchmark instead of the self test.
+/// @return void
+void vbus_ctl_bench()
+{
+    ctl_bench = 1;
+}
+
+/// @brief Number of devices to test.
+/// @return device count.
+int vbus_ctl_count()
+{
+    return(ctl_device_count);
+}
+
+// =============================================
+///@brief Bus primitives
+
+/// @brief Milliseconds since a start time.
+/// @param[in] start: start time.
+/// @return milliseconds.
+static long ctl_elapsed_ms(struct timespec *start)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return( (now.tv_sec - start->tv_sec) * 1000L + (now.tv_nsec - start->tv_nsec) / 1000000L );
+}
+
+/// @brief Microseconds since a start time.
+/// @param[in] start: start time.
+/// @return microseconds.
+static long ctl_elapsed_us(struct timespec *start)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return( (now.tv_sec - start->tv_sec) * 1000000L + (now.tv_nsec - start->tv_nsec) / 1000L );
+}
+
+/// @brief Wait for a control line state.
+/// @param[in] pin: VBUS pin number.
+/// @param[in] level: 1 = HI, 0 = LOW.
+/// @param[in] ms: timeout in milliseconds.
+/// @param[in] msg: line name for the error message.
+/// @return 0 on success, -1 on timeout.
+static int ctl_wait(uint8_t pin, uint8_t level, long ms, const char *msg)
+{
+    struct timespec start;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    while(vbus_ctl_pin_tst(pin) != level)
+    {
+        if(host_quit_requested())
+            return(-1);
+        if(ctl_elapsed_ms(&start) > ms)
+        {
+            printf("[CTL timeout waiting for %s]\n", msg);
+            return(-1);
+        }
+    }
+    return(0);
+}
+
+/// @brief Source handshake - send one byte.
+/// @param[in] ch: byte to send.
+/// @param[in] eoi: assert EOI with the byte.
+/// @return 0 on success, -1 on timeout.
+static int ctl_put(uint8_t ch, int eoi)
+{
+    if(ctl_wait(VBUS_NDAC, 0, CTL_TIMEOUT_MS, "NDAC==0"))
+        return(-1);
+    if(ctl_wait(VBUS_NRFD, 1, CTL_TIMEOUT_MS, "NRFD==1"))
+        return(-1);
+
+    vbus_ctl_bus(ch);
+    vbus_ctl_pin(VBUS_EOI, eoi);
+    vbus_ctl_pin(VBUS_DAV, 1);
+
+    if(ctl_wait(VBUS_NDAC, 1, CTL_TIMEOUT_MS, "NDAC==1"))
+    {
+        vbus_ctl_pin(VBUS_DAV, 0);
+        vbus_ctl_pin(VBUS_EOI, 0);
+        vbus_ctl_bus(0);
+        return(-1);
+    }
+
+    vbus_ctl_pin(VBUS_DAV, 0);
+    vbus_ctl_pin(VBUS_EOI, 0);
+    vbus_ctl_bus(0);
+    return(0);
+}
+
+/// @brief Send GPIB commands with ATN asserted.
+/// @param[in] cmd: command bytes.
+/// @param[in] len: number of bytes.
+/// @return 0 on success, -1 on error.
+int vbus_ctl_cmd(const uint8_t *cmd, int len)
+{
+    int i;
+
+    ///@brief we are the talker - release the listener handshake lines
+    vbus_ctl_pin(VBUS_NRFD, 0);
+    vbus_ctl_pin(VBUS_NDAC, 0);
+    vbus_ctl_pin(VBUS_ATN, 1);
+
+    for(i=0;i<len;++i)
+    {
+        if(ctl_put(cmd[i], 0))
+        {
+            printf("[CTL command %02XH failed]\n", 0xff & cmd[i]);
+            return(-1);
+        }
+    }
+    return(0);
+}
+
+/// @brief Send data bytes.
+/// @param[in] buf: data.
+/// @param[in] len: number of bytes.
+/// @param[in] eoi: assert EOI with the last byte.
+/// @return 0 on success, -1 on error.
+int vbus_ctl_write(const uint8_t *buf, int len, int eoi)
+{
+    int i;
+
+    vbus_ctl_pin(VBUS_ATN, 0);
+    for(i=0;i<len;++i)
+    {
+        if(ctl_put(buf[i], eoi && i == len-1))
+        {
+            printf("[CTL write failed at byte %d of %d]\n", i, len);
+            return(-1);
+        }
+    }
+    return(0);
+}
+
+/// @brief Send data bytes with EOI on the last byte.
+/// @param[in] buf: data.
+/// @param[in] len: number of bytes.
+/// @return 0 on success, -1 on error.
+static int ctl_write(const uint8_t *buf, int len)
+{
+    return( vbus_ctl_write(buf, len, 1) );
+}
+
+/// @brief Receive data bytes until EOI or a byte count.
+/// @param[out] buf: data.
+/// @param[in] len: maximum number of bytes to read.
+/// @param[out] eoi: set if the last byte had EOI.
+/// @return number of bytes read, -1 on timeout.
+int vbus_ctl_read(uint8_t *buf, int len, int *eoi)
+{
+    int count = 0;
+
+    *eoi = 0;
+
+    ///@brief we are a listener - busy until the talker is released
+    vbus_ctl_pin(VBUS_NDAC, 1);
+    vbus_ctl_pin(VBUS_NRFD, 1);
+    vbus_ctl_pin(VBUS_ATN, 0);
+
+    while(!*eoi && count < len)
+    {
+        vbus_ctl_pin(VBUS_NRFD, 0);               // ready for data
+        if(ctl_wait(VBUS_DAV, 0, CTL_TIMEOUT_MS, "DAV==0"))
+            return(-1);
+        vbus_ctl_pin(VBUS_NRFD, 1);               // busy
+        buf[count++] = vbus_ctl_bus_rd();
+        *eoi = !vbus_ctl_pin_tst(VBUS_EOI);
+        vbus_ctl_pin(VBUS_NDAC, 0);               // accepted
+        if(ctl_wait(VBUS_DAV, 1, CTL_TIMEOUT_MS, "DAV==1"))
+            return(-1);
+        vbus_ctl_pin(VBUS_NDAC, 1);
+    }
+    return(count);
+}
+
+/// @brief Receive data bytes until EOI.
+/// @param[out] buf: data.
+/// @param[in] max: buffer size.
+/// @return number of bytes read, -1 on error.
+static int ctl_read(uint8_t *buf, int max)
+{
+    int len;
+    int eoi;
+
+    len = vbus_ctl_read(buf, max, &eoi);
+    if(len < 0)
+    {
+        printf("[CTL read failed]\n");
+        return(-1);
+    }
+    if(!eoi)
+    {
+        printf("[CTL read overflow > %d bytes]\n", max);
+        return(-1);
+    }
+    return(len);
+}
+
+/// @brief Parallel poll.
+/// @return data lines pulled LOW, device PPR bit 0 is DIO8.
+static uint8_t ctl_ppoll()
+{
+    uint8_t ppr;
+
+    vbus_ctl_pin(VBUS_NRFD, 0);
+    vbus_ctl_pin(VBUS_NDAC, 0);
+    vbus_ctl_pin(VBUS_ATN, 1);
+    vbus_ctl_pin(VBUS_EOI, 1);
+    ppr = vbus_ctl_bus_rd();
+    vbus_ctl_pin(VBUS_EOI, 0);
+    return(ppr);
+}
+
+/// @brief Wait for a device parallel poll response.
+/// @param[in] dev: device.
+/// @return 0 on success, -1 on timeout.
+static int ctl_wait_ppr(ctl_device_t *dev)
+{
+    struct timespec start;
+    uint8_t mask = 0x80 >> dev->ppr;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    while(!(ctl_ppoll() & mask))
+    {
+        if(host_quit_requested())
+            return(-1);
+        if(ctl_elapsed_ms(&start) > CTL_TIMEOUT_MS)
+        {
+            printf("[CTL timeout waiting for PPR bit %d]\n", dev->ppr);
+            return(-1);
+        }
+    }
+    return(0);
+}
+
+/// @brief Pulse IFC and assert REN.
+/// @return void
+void vbus_ctl_ifc()
+{
+    vbus_ctl_pin(VBUS_IFC, 1);
+    host_delay_us(500);
+    vbus_ctl_pin(VBUS_IFC, 0);
+    host_delay_us(500);
+    vbus_ctl_pin(VBUS_REN, 1);
+}
+
+/// @brief Address a device as listener and send a secondary and data.
+/// @param[in] dev: device.
+/// @param[in] sa: secondary address.
+/// @param[in] buf: data.
+/// @param[in] len: number of bytes.
+/// @return 0 on success, -1 on error.
+static int ctl_send_to(ctl_device_t *dev, uint8_t sa, const uint8_t *buf, int len)
+{
+    uint8_t cmd[4];
+    uint8_t unl = CTL_UNL;
+
+    cmd[0] = CTL_UNL;
+    cmd[1] = CTL_MTA;
+    cmd[2] = 0x20 + dev->address;
+    cmd[3] = sa;
+    if(vbus_ctl_cmd(cmd, 4))
+        return(-1);
+    if(ctl_write(buf, len))
+        return(-1);
+    return( vbus_ctl_cmd(&unl, 1) );
+}
+
+/// @brief Address a device as talker with a secondary and receive data.
+/// @param[in] dev: device.
+/// @param[in] sa: secondary address.
+/// @param[out] buf: data.
+/// @param[in] max: buffer size.
+/// @return number of bytes read, -1 on error.
+static int ctl_recv_from(ctl_device_t *dev, uint8_t sa, uint8_t *buf, int max)
+{
+    uint8_t cmd[4];
+    uint8_t unt = CTL_UNT;
+    int len;
+
+    cmd[0] = CTL_UNL;
+    cmd[1] = CTL_MLA;
+    cmd[2] = 0x40 + dev->address;
+    cmd[3] = sa;
+    if(vbus_ctl_cmd(cmd, 4))
+        return(-1);
+    len = ctl_read(buf, max);
+    if(vbus_ctl_cmd(&unt, 1))
+        return(-1);
+    return(len);
+}
+
+// =============================================
+///@brief Device protocols
+
+/// @brief Identify - SS80 4-31, AMIGO A11.
+/// @param[in] dev: device.
+/// @param[out] id: identify bytes.
+/// @return 0 on success, -1 on error.
+static int ctl_identify(ctl_device_t *dev, uint16_t *id)
+{
+    uint8_t cmd[4];
+    uint8_t buf[2];
+    uint8_t unt = CTL_UNT;
+
+    cmd[0] = CTL_UNL;
+    cmd[1] = CTL_MLA;
+    cmd[2] = CTL_UNT;
+    cmd[3] = 0x60 + dev->address;
+    if(vbus_ctl_cmd(cmd, 4))
+        return(-1);
+    if(ctl_read(buf, 2) != 2)
+        return(-1);
+    if(vbus_ctl_cmd(&unt, 1))
+        return(-1);
+    *id = (buf[0] << 8) | buf[1];
+    return(0);
+}
+
+/// @brief SS80 report phase - read QSTAT.
+/// @param[in] dev: device.
+/// @return qstat or -1 on error.
+static int ss80_report(ctl_device_t *dev)
+{
+    uint8_t qstat;
+
+    if(ctl_wait_ppr(dev))
+        return(-1);
+    if(ctl_recv_from(dev, 0x70, &qstat, 1) != 1)
+        return(-1);
+    return(qstat);
+}
+
+/// @brief SS80 command phase - set unit, volume, address, length and opcode.
+/// @param[in] dev: device.
+/// @param[in] block: block address.
+/// @param[in] bytes: transfer length.
+/// @param[in] op: 0x00 = locate and read, 0x02 = locate and write.
+/// @return 0 on success, -1 on error.
+static int ss80_command(ctl_device_t *dev, uint32_t block, uint32_t bytes, uint8_t op)
+{
+    uint8_t cmd[15];
+
+    cmd[0] = 0x20 + dev->unit;                    // Set Unit
+    cmd[1] = 0x40 + dev->volume;                  // Set Volume
+    cmd[2] = 0x10;                                // Set Address
+    cmd[3] = 0;
+    cmd[4] = 0;
+    cmd[5] = block >> 24;
+    cmd[6] = block >> 16;
+    cmd[7] = block >> 8;
+    cmd[8] = block;
+    cmd[9] = 0x18;                                // Set Length
+    cmd[10] = bytes >> 24;
+    cmd[11] = bytes >> 16;
+    cmd[12] = bytes >> 8;
+    cmd[13] = bytes;
+    cmd[14] = op;
+
+    return( ctl_send_to(dev, 0x65, cmd, sizeof(cmd)) );
+}
+
+/// @brief SS80 locate and read any number of bytes.
+/// @param[in] dev: device.
+/// @param[in] block: block address.
+/// @param[out] buf: data.
+/// @param[in] len: number of bytes.
+/// @return 0 on success, -1 on error.
+static int ss80_read_bytes(ctl_device_t *dev, uint32_t block, uint8_t *buf, int len)
+{
+    if(ss80_command(dev, block, len, 0x00))
+        return(-1);
+    if(ctl_wait_ppr(dev))
+        return(-1);
+    if(ctl_recv_from(dev, 0x6e, buf, len) != len)
+        return(-1);
+    if(ss80_report(dev) != 0)
+        return(-1);
+    return(0);
+}
+
+/// @brief SS80 locate and read.
+/// @param[in] dev: device.
+/// @param[in] block: block address.
+/// @param[out] buf: data.
+/// @param[in] blocks: number of blocks.
+/// @return 0 on success, -1 on error.
+static int ss80_read(ctl_device_t *dev, uint32_t block, uint8_t *buf, int blocks)
+{
+    return( ss80_read_bytes(dev, block, buf, blocks * CTL_BLOCK_SIZE) );
+}
+
+/// @brief SS80 locate and write.
+/// @param[in] dev: device.
+/// @param[in] block: block address.
+/// @param[in] buf: data.
+/// @param[in] blocks: number of blocks.
+/// @return 0 on success, -1 on error.
+static int ss80_write(ctl_device_t *dev, uint32_t block, const uint8_t *buf, int blocks)
+{
+    int len = blocks * CTL_BLOCK_SIZE;
+
+    if(ss80_command(dev, block, len, 0x02))
+        return(-1);
+    if(ctl_wait_ppr(dev))
+        return(-1);
+    if(ctl_send_to(dev, 0x6e, buf, len))
+        return(-1);
+    if(ss80_report(dev) != 0)
+        return(-1);
+    return(0);
+}
+
+/// @brief SS80 describe.
+/// @param[in] dev: device.
+/// @param[out] buf: CTL_DESCRIBE_SIZE bytes.
+/// @return 0 on success, -1 on error.
+static int ss80_describe(ctl_device_t *dev, uint8_t *buf)
+{
+    uint8_t cmd[3];
+
+    cmd[0] = 0x20 + dev->unit;                    // Set Unit
+    cmd[1] = 0x40 + dev->volume;                  // Set Volume
+    cmd[2] = 0x35;                                // Describe
+    if(ctl_send_to(dev, 0x65, cmd, sizeof(cmd)))
+        return(-1);
+    if(ctl_wait_ppr(dev))
+        return(-1);
+    if(ctl_recv_from(dev, 0x6e, buf, CTL_DESCRIBE_SIZE) != CTL_DESCRIBE_SIZE)
+        return(-1);
+    if(ss80_report(dev) != 0)
+        return(-1);
+    return(0);
+}
+
+/// @brief SS80 send a command message and read the report.
+/// @param[in] dev: device.
+/// @param[in] sa: 0x65 command or 0x72 transparent.
+/// @param[in] cmd: opcodes and parameters.
+/// @param[in] len: message size.
+/// @return qstat or -1 on error.
+static int ss80_message(ctl_device_t *dev, uint8_t sa, const uint8_t *cmd, int len)
+{
+    if(ctl_send_to(dev, sa, cmd, len))
+        return(-1);
+    return(ss80_report(dev));
+}
+
+/// @brief SS80 request status - 20 bytes.
+/// @param[in] dev: device.
+/// @param[out] buf: status.
+/// @return qstat or -1 on error.
+static int ss80_status(ctl_device_t *dev, uint8_t *buf)
+{
+    uint8_t cmd[2];
+
+    cmd[0] = 0x20 + dev->unit;                    // Set Unit
+    cmd[1] = 0x0d;                                // Request Status
+    if(ctl_send_to(dev, 0x65, cmd, sizeof(cmd)))
+        return(-1);
+    if(ctl_wait_ppr(dev))
+        return(-1);
+    if(ctl_recv_from(dev, 0x6e, buf, 20) != 20)
+        return(-1);
+    return(ss80_report(dev));
+}
+
+/// @brief SS80 copy data inside the device.
+/// @param[in] src: source device, unit and volume.
+/// @param[in] from: source block address.
+/// @param[in] dst: destination device, unit and volume.
+/// @param[in] to: destination block address.
+/// @param[in] blocks: number of blocks.
+/// @return qstat or -1 on error.
+static int ss80_copy(ctl_device_t *src, uint32_t from, ctl_device_t *dst, uint32_t to, int blocks)
+{
+    uint32_t bytes = blocks * CTL_BLOCK_SIZE;
+    uint8_t cmd[24];
+
+    cmd[0] = 0x18;                                // Set Length
+    cmd[1] = bytes >> 24;
+    cmd[2] = bytes >> 16;
+    cmd[3] = bytes >> 8;
+    cmd[4] = bytes;
+    cmd[5] = 0x58;                                // Copy Data
+    cmd[6] = 0x20 + src->unit;
+    cmd[7] = 0x40 + src->volume;
+    cmd[8] = 0x10;
+    cmd[9] = 0;
+    cmd[10] = 0;
+    cmd[11] = from >> 24;
+    cmd[12] = from >> 16;
+    cmd[13] = from >> 8;
+    cmd[14] = from;
+    cmd[15] = 0x20 + dst->unit;
+    cmd[16] = 0x40 + dst->volume;
+    cmd[17] = 0x10;
+    cmd[18] = 0;
+    cmd[19] = 0;
+    cmd[20] = to >> 24;
+    cmd[21] = to >> 16;
+    cmd[22] = to >> 8;
+    cmd[23] = to;
+
+    return(ss80_message(src, 0x65, cmd, sizeof(cmd)));
+}
+
+/// @brief AMIGO request DSJ - A11.
+/// @param[in] dev: device.
+/// @return dsj or -1 on error.
+static int amigo_dsj(ctl_device_t *dev)
+{
+    uint8_t dsj;
+
+    if(ctl_recv_from(dev, 0x70, &dsj, 1) != 1)
+        return(-1);
+    return(dsj);
+}
+
+/// @brief AMIGO seek and read sectors - A27, A35.
+/// @param[in] dev: device.
+/// @param[in] block: logical sector.
+/// @param[out] buf: data.
+/// @param[in] blocks: number of sectors.
+/// @return 0 on success, -1 on error.
+static int amigo_read(ctl_device_t *dev, uint32_t block, uint8_t *buf, int blocks)
+{
+    uint8_t cmd[5];
+    int i;
+
+    cmd[0] = 0x02;                                // Seek
+    cmd[1] = 0;                                   // Unit
+    cmd[2] = block / (CTL_AMIGO_SECTORS * CTL_AMIGO_HEADS);
+    cmd[3] = (block / CTL_AMIGO_SECTORS) % CTL_AMIGO_HEADS;
+    cmd[4] = block % CTL_AMIGO_SECTORS;
+    if(ctl_send_to(dev, 0x68, cmd, 5))
+        return(-1);
+    if(ctl_wait_ppr(dev))
+        return(-1);
+
+    for(i=0;i<blocks;++i)
+    {
+        cmd[0] = 0x05;                            // Read - the position advances
+        cmd[1] = 0;
+        if(ctl_send_to(dev, 0x68, cmd, 2))
+            return(-1);
+        if(ctl_wait_ppr(dev))
+            return(-1);
+        if(ctl_recv_from(dev, 0x60, buf + i * CTL_BLOCK_SIZE, CTL_BLOCK_SIZE) != CTL_BLOCK_SIZE)
+            return(-1);
+        if(ctl_wait_ppr(dev))
+            return(-1);
+    }
+    if(amigo_dsj(dev) != 0)
+        return(-1);
+    return(0);
+}
+
+// =============================================
+///@brief Self test
+
+/// @brief Count a test result.
+/// @param[in] ok: test passed.
+/// @param[in] dev: device.
+/// @param[in] msg: test name.
+/// @return ok
+static int ctl_check(int ok, ctl_device_t *dev, const char *msg)
+{
+    ++ctl_checks;
+    if(!ok)
+        ++ctl_errors;
+    printf("[CTL %s %02d: %s %s]\n", dev->type == CTL_SS80 ? "SS80 " : "AMIGO",
+        dev->address, msg, ok ? "OK" : "FAILED");
+    return(ok);
+}
+
+/// @brief Display the transfer rate of a test.
+/// @param[in] dev: device.
+/// @param[in] msg: test name.
+/// @param[in] bytes: bytes transferred.
+/// @param[in] start: start time.
+/// @return void
+static void ctl_rate(ctl_device_t *dev, const char *msg, long bytes, struct timespec *start)
+{
+    long us = ctl_elapsed_us(start);
+
+    if(us < 1)
+        us = 1;
+    printf("[CTL %s %02d: %s %ld bytes, %ld us, %ld bytes/s]\n",
+        dev->type == CTL_SS80 ? "SS80 " : "AMIGO",
+        dev->address, msg, bytes, us, (long) ((long long) bytes * 1000000LL / us));
+}
+
+/// @brief Read a part of the host copy of an image.
+/// @param[in] name: host file.
+/// @param[in] block: first block.
+/// @param[out] buf: data.
+/// @param[in] blocks: number of blocks.
+/// @return 0 on success, -1 on error.
+static int ctl_host_read(const char *name, uint32_t block, uint8_t *buf, int blocks)
+{
+    FILE *fp;
+    size_t len = (size_t) blocks * CTL_BLOCK_SIZE;
+    int ret = 0;
+
+    fp = fopen(name, "rb");
+    if(fp == NULL)
+    {
+        perror(name);
+        return(-1);
+    }
+    memset(buf, 0, len);
+    if(fseek(fp, (long) block * CTL_BLOCK_SIZE, SEEK_SET) < 0)
+        ret = -1;
+    else if(fread(buf, 1, len, fp) != len)
+        ret = -1;
+    fclose(fp);
+    return(ret);
+}
+
+/// @brief Test one device.
+/// @param[in] dev: device.
+/// @return void
+static void ctl_test_device(ctl_device_t *dev)
+{
+    uint16_t id = 0;
+    int blocks = ctl_test_blocks;
+    int len = blocks * CTL_BLOCK_SIZE;
+    uint8_t *buf, *ref;
+    struct timespec start;
+    int ok;
+    int i;
+
+    buf = calloc(len, 1);
+    ref = calloc(len, 1);
+    if(!buf || !ref)
+    {
+        free(buf);
+        free(ref);
+        ++ctl_errors;
+        return;
+    }
+
+    ok = (ctl_identify(dev, &id) == 0);
+    ctl_check(ok, dev, "identify");
+    if(ok)
+        printf("[CTL ID: %04XH]\n", id);
+
+    if(dev->type == CTL_AMIGO)
+    {
+        ///@brief the first DSJ after power on or clear may be non zero
+        amigo_dsj(dev);
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        ok = (amigo_read(dev, 0, buf, blocks) == 0);
+        if(ok)
+            ctl_rate(dev, "read", len, &start);
+        ctl_check(ok, dev, "read");
+    }
+    else
+    {
+        ///@brief the first report after power on may be non zero
+        ss80_read(dev, 0, buf, 1);
+
+        ///@brief unit installed, 256 byte blocks and our volume present
+        ok = (ss80_describe(dev, buf) == 0);
+        if(ok)
+            ok = (buf[0] & 0x80) && (((buf[0] << 8) | buf[1]) & (1 << dev->unit))
+                && buf[9] == 1 && buf[10] == 0
+                && (buf[22] & (1 << dev->volume));
+        ctl_check(ok, dev, "describe");
+
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        ok = (ss80_read(dev, 0, buf, blocks) == 0);
+        if(ok)
+            ctl_rate(dev, "read", len, &start);
+        ctl_check(ok, dev, "read");
+    }
+
+    if(ok && dev->file[0])
+    {
+        ok = (ctl_host_read(dev->file, 0, ref, blocks) == 0);
+        if(ok)
+            ok = (memcmp(buf, ref, len) == 0);
+        ctl_check(ok, dev, "compare with host file");
+    }
+
+    ///@brief SS80 write the blocks we read back unchanged
+    if(dev->type == CTL_SS80 && ok)
+    {
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        ok = (ss80_write(dev, 0, buf, blocks) == 0);
+        if(ok)
+            ctl_rate(dev, "write", len, &start);
+        if(ok)
+            ok = (ss80_read(dev, 0, ref, blocks) == 0);
+        if(ok)
+            ok = (memcmp(buf, ref, len) == 0);
+        ctl_check(ok, dev, "rewrite");
+    }
+
+    ///@brief SS80 write, read back, restore
+    if(dev->type == CTL_SS80)
+    {
+        uint32_t block = blocks;
+
+        ok = (ss80_read(dev, block, ref, 1) == 0);
+        for(i=0;i<CTL_BLOCK_SIZE;++i)
+            buf[i] = (i * 7 + dev->address) ^ ref[i];
+        if(ok)
+            ok = (ss80_write(dev, block, buf, 1) == 0);
+        if(ok)
+            ok = (ss80_read(dev, block, buf + CTL_BLOCK_SIZE, 1) == 0);
+        if(ok)
+            ok = (memcmp(buf, buf + CTL_BLOCK_SIZE, CTL_BLOCK_SIZE) == 0);
+        ctl_check(ok, dev, "write and read back");
+
+        ///@brief A partial block read bypasses the block cache so it must
+        /// see the write on the disk image
+        if(ok)
+            ok = (ss80_read_bytes(dev, block, buf + CTL_BLOCK_SIZE, CTL_BLOCK_SIZE/2) == 0);
+        if(ok)
+            ok = (memcmp(buf, buf + CTL_BLOCK_SIZE, CTL_BLOCK_SIZE/2) == 0);
+        ctl_check(ok, dev, "partial read after write");
+
+        ok = (ss80_write(dev, block, ref, 1) == 0);
+        if(ok)
+            ok = (ss80_read(dev, block, buf, 1) == 0);
+        if(ok)
+            ok = (memcmp(buf, ref, CTL_BLOCK_SIZE) == 0);
+        ctl_check(ok, dev, "restore");
+    }
+
+    ///@brief SS80 bad messages are rejected as a whole and reported
+    if(dev->type == CTL_SS80)
+    {
+        static const uint8_t bad_opcode[] = { 0x20, 0x34, 0x6f };
+        static const uint8_t bad_sequence[] = { 0x20, 0x0d, 0x34 };
+        static const uint8_t bad_length[] = { 0x20, 0x18, 0x00, 0x00 };
+        static const uint8_t clear[] = { 0x08 };
+
+        ok = (ss80_message(dev, 0x65, bad_opcode, sizeof(bad_opcode)) == 1);
+        if(ok)
+            ok = (ss80_status(dev, buf) >= 0 && (buf[2] & 0x04));
+        ctl_check(ok, dev, "illegal opcode");
+        ok = (ss80_message(dev, 0x65, bad_sequence, sizeof(bad_sequence)) == 1);
+        if(ok)
+            ok = (ss80_status(dev, buf) >= 0 && (buf[3] & 0x20));
+        ctl_check(ok, dev, "message sequence");
+        ok = (ss80_message(dev, 0x65, bad_length, sizeof(bad_length)) == 1);
+        if(ok)
+            ok = (ss80_status(dev, buf) >= 0 && (buf[3] & 0x08));
+        ctl_check(ok, dev, "message length");
+        ok = (ss80_message(dev, 0x72, clear, sizeof(clear)) == 0);
+        if(ok)
+            ok = (ss80_read(dev, 0, buf, 1) == 0);
+        ctl_check(ok, dev, "channel independent clear");
+    }
+
+    ///@brief SS80 copy data inside the device, the second copy finds
+    /// the data already there
+    if(dev->type == CTL_SS80)
+    {
+        ctl_device_t base = *dev;
+        uint32_t from = blocks + 2;
+        uint32_t to = blocks + 3;
+
+        base.unit = 0;
+        base.volume = 0;
+        ok = (ss80_read(&base, to, ref, 1) == 0);
+        if(ok)
+            ok = (ss80_read(dev, from, ref + CTL_BLOCK_SIZE, 1) == 0);
+        for(i=0;i<CTL_BLOCK_SIZE;++i)
+            buf[i] = (i * 3 + dev->address) ^ 0x5a;
+        if(ok)
+            ok = (ss80_write(dev, from, buf, 1) == 0);
+        if(ok)
+            ok = (ss80_copy(dev, from, &base, to, 1) == 0);
+        if(ok)
+            ok = (ss80_copy(dev, from, &base, to, 1) == 0);
+        if(ok)
+            ok = (ss80_read(&base, to, buf + CTL_BLOCK_SIZE, 1) == 0);
+        if(ok)
+            ok = (memcmp(buf, buf + CTL_BLOCK_SIZE, CTL_BLOCK_SIZE) == 0);
+        ctl_check(ok, dev, "copy data");
+        if(ok)
+            ok = (ss80_write(&base, to, ref, 1) == 0);
+        if(ok)
+            ok = (ss80_write(dev, from, ref + CTL_BLOCK_SIZE, 1) == 0);
+        ctl_check(ok, dev, "copy restore");
+
+        ok = (ss80_copy(dev, 0, &base, 0x7fffffff, 1) == 1);
+        if(ok)
+            ok = (ss80_status(dev, buf) >= 0 && (buf[2] & 0x01));
+        ctl_check(ok, dev, "copy address bounds");
+    }
+
+    ///@brief SS80 a write with an invalid unit is skipped, unit 0 volume 0
+    /// was selected before and must not change
+    if(dev->type == CTL_SS80)
+    {
+        static const uint8_t clear[] = { 0x08 };
+        ctl_device_t base = *dev;
+        ctl_device_t bad = *dev;
+        uint32_t block = blocks + 1;
+
+        base.unit = 0;
+        base.volume = 0;
+        bad.unit = 14;
+        bad.volume = 0;
+        ok = (ss80_read(&base, block, ref, 1) == 0);
+        for(i=0;i<CTL_BLOCK_SIZE;++i)
+            buf[i] = ~ref[i];
+        if(ok)
+            ok = (ss80_command(&bad, block, CTL_BLOCK_SIZE, 0x02) == 0);
+        if(ok)
+            ok = (ctl_wait_ppr(dev) == 0);
+        if(ok)
+            ok = (ctl_send_to(dev, 0x6e, buf, CTL_BLOCK_SIZE) == 0);
+        if(ok)
+            ok = (ss80_report(dev) == 1);
+        if(ok)
+            ok = (ss80_status(&base, buf + CTL_BLOCK_SIZE) >= 0 && (buf[CTL_BLOCK_SIZE + 2] & 0x02));
+        if(ok)
+            ok = (ss80_read(&base, block, buf + CTL_BLOCK_SIZE, 1) == 0);
+        if(ok)
+            ok = (memcmp(ref, buf + CTL_BLOCK_SIZE, CTL_BLOCK_SIZE) == 0);
+        if(ok)
+            ok = (ss80_message(&base, 0x72, clear, sizeof(clear)) == 0);
+        ctl_check(ok, dev, "invalid unit write");
+    }
+
+    ///@brief SS80 initialize media fills the image with zeros, only on
+    /// the extra units, their images are made for the test
+    if(dev->type == CTL_SS80 && dev->unit)
+    {
+        static const uint8_t init[] = { 0x20, 0x40, 0x37, 0x00, 0x00 };
+        uint8_t cmd[sizeof(init)];
+
+        memcpy(cmd, init, sizeof(cmd));
+        cmd[0] += dev->unit;
+        cmd[1] += dev->volume;
+        for(i=0;i<CTL_BLOCK_SIZE;++i)
+            buf[i] = i ^ 0xa5;
+        ok = (ss80_write(dev, blocks, buf, 1) == 0);
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        if(ok)
+            ok = (ss80_message(dev, 0x65, cmd, sizeof(cmd)) == 0);
+        if(ok)
+            printf("[CTL SS80 %02d: initialize media %ld ms]\n", dev->address, ctl_elapsed_ms(&start));
+        if(ok)
+            ok = (ss80_read(dev, blocks, buf, 1) == 0);
+        for(i=0;ok && i<CTL_BLOCK_SIZE;++i)
+            ok = (buf[i] == 0);
+        ctl_check(ok, dev, "initialize media");
+    }
+
+    ///@brief SS80 a write to this unit must not change unit 0 volume 0
+    if(dev->type == CTL_SS80 && (dev->unit || dev->volume))
+    {
+        ctl_device_t base = *dev;
+        uint32_t block = blocks + 1;
+
+        base.unit = 0;
+        base.volume = 0;
+        ok = (ss80_read(&base, block, ref, 1) == 0);
+        if(ok)
+            ok = (ss80_read(dev, block, ref + CTL_BLOCK_SIZE, 1) == 0);
+        for(i=0;i<CTL_BLOCK_SIZE;++i)
+            buf[i] = ~ref[i];
+        if(ok)
+            ok = (ss80_write(dev, block, buf, 1) == 0);
+        if(ok)
+            ok = (ss80_read(&base, block, buf + CTL_BLOCK_SIZE, 1) == 0);
+        if(ok)
+            ok = (memcmp(ref, buf + CTL_BLOCK_SIZE, CTL_BLOCK_SIZE) == 0);
+        ctl_check(ok, dev, "unit 0 unchanged");
+        if(ok)
+            ok = (ss80_write(dev, block, ref + CTL_BLOCK_SIZE, 1) == 0);
+        ctl_check(ok, dev, "unit restore");
+    }
+    free(buf);
+    free(ref);
+}
+
+/// @brief Wait for the device to start listening.
+/// @return 0 on success, -1 on timeout.
+int vbus_ctl_wait_device()
+{
+    return( ctl_wait(VBUS_NDAC, 0, 30000, "device") );
+}
+
+/// @brief Controller thread - run the self test or the bench.
+/// @param[in] arg: unused.
+/// @return NULL
+static void *ctl_task(void *arg)
+{
+    struct timespec start;
+    int i;
+
+    if(vbus_ctl_wait_device())
+    {
+        ++ctl_errors;
+    }
+    else
+    {
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        vbus_ctl_ifc();
+        for(i=0;i<ctl_device_count && !host_quit_requested();++i)
+        {
+            if(!ctl_bench)
+                ctl_test_device(&ctl_devices[i]);
+            else if(ctl_devices[i].type == CTL_SS80)
+            {
+                vbus_ctl_port(1);
+                if(ctl_bench_run(ctl_devices[i].address, ctl_test_blocks))
+                    ++ctl_errors;
+                vbus_ctl_port(0);
+            }
+        }
+        if(!ctl_bench)
+            printf("[CTL %d tests, %d errors, %ld ms]\n", ctl_checks, ctl_errors, ctl_elapsed_ms(&start));
+    }
+
+    if(ctl_bench)
+        printf("CTL bench %s\n", ctl_errors ? "FAILED" : "done");
+    else
+        printf("CTL self test %s\n", ctl_errors ? "FAILED" : "PASSED");
+
+    if(ctl_exit)
+        host_quit(ctl_errors ? 1 : 0);
+    return(NULL);
+}
+
+/// @brief Start the controller thread.
+/// @param[in] exit_when_done: call host_quit() with the result.
+/// @param[in] bench: firmware gpib bench, run for each SS80 device with -B.
+/// @return 0 on success, -1 on error.
+int vbus_ctl_start(int exit_when_done, int (*bench)(int address, int blocks))
+{
+    ctl_exit = exit_when_done;
+    ctl_bench_run = bench;
+    if(pthread_create(&ctl_thread, NULL, ctl_task, NULL))
+    {
+        perror("controller thread");
+        return(-1);
+    }
+    pthread_detach(ctl_thread);
+    return(0);
+}
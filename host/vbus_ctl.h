@@ -0,0 +1,72 @@
+/**
+ @file host/vbus_ctl.h
+
+ @brief Virtual GPIB bus controller for the HP85 disk emulator host build.
+
+ @par Edit History
+ - [1.0]   [Mike Gore]  Initial revision of file.
+
+ @par Copyright &copy; 2014-2020 Mike Gore, Inc. All rights reserved. GPL
+ @see http://github.com/magore/hp85disk
+ @see http://github.com/magore/hp85disk/COPYRIGHT.md for Copyright details
+
+*/
+
+#ifndef _VBUS_CTL_H_
+#define _VBUS_CTL_H_
+
+#include <stdint.h>
+
+///@brief Controller GPIB address - same as the HP85
+#define CTL_ADDRESS     21
+#define CTL_MLA         (0x20 + CTL_ADDRESS)
+#define CTL_MTA         (0x40 + CTL_ADDRESS)
+
+///@brief GPIB universal commands
+#define CTL_UNL         0x3f
+#define CTL_UNT         0x5f
+
+///@brief Handshake timeout in milliseconds
+#define CTL_TIMEOUT_MS  2000
+
+///@brief Maximum number of devices to test
+#define CTL_MAX_DEVICES 8
+
+///@brief Device types known to the controller
+#define CTL_AMIGO       1
+#define CTL_SS80        2
+
+///@brief AMIGO 9121 geometry
+#define CTL_AMIGO_SECTORS   16
+#define CTL_AMIGO_HEADS     2
+
+///@brief Block size for SS80 and AMIGO
+#define CTL_BLOCK_SIZE  256
+
+///@brief SS80 describe reply - 5 controller, 19 unit and 13 volume bytes
+#define CTL_DESCRIBE_SIZE   37
+
+///@brief A device to test
+typedef struct
+{
+    int type;           ///< CTL_AMIGO or CTL_SS80
+    int address;        ///< GPIB address
+    int ppr;            ///< parallel poll response bit
+    int unit;           ///< SS80 unit number
+    int volume;         ///< SS80 volume number
+    char file[256];     ///< optional host copy of the disk image to compare with
+} ctl_device_t;
+
+/* vbus_ctl.c */
+int vbus_ctl_add ( const char *spec );
+int vbus_ctl_unit ( const char *spec );
+void vbus_ctl_blocks ( int blocks );
+void vbus_ctl_bench ( void );
+int vbus_ctl_count ( void );
+int vbus_ctl_cmd ( const uint8_t *cmd , int len );
+int vbus_ctl_write ( const uint8_t *buf , int len , int eoi );
+int vbus_ctl_read ( uint8_t *buf , int len , int *eoi );
+void vbus_ctl_ifc ( void );
+int vbus_ctl_wait_device ( void );
+int vbus_ctl_start ( int exit_when_done , int (*bench )(int address ,int blocks ));
+#endif
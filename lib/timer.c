@@ -144,6 +144,55 @@ void subtract_timespec(ts_t *a, ts_t *b)
 }
 
 
+/// @brief  Microseconds from start to now.
+///
+/// - 32 bit math, saturates at 0xffffffff - about 71 minutes.
+/// @param[in] start: start time.
+/// @param[in] now: end time, NULL reads the clock.
+///
+/// @return  microseconds, 0 if the clock went backwards.
+MEMSPACE
+uint32_t timespec_us(ts_t *start, ts_t *now)
+{
+    ts_t delta;
+
+    if(now)
+        delta = *now;
+    else
+        clock_gettime(0, (ts_t *) &delta);
+    subtract_timespec(&delta, start);
+
+    if(delta.tv_sec < 0)
+        return(0);
+    if(delta.tv_sec >= 4294L)
+        return(0xffffffffUL);
+    return( (uint32_t) delta.tv_sec * 1000000UL + (uint32_t) (delta.tv_nsec / 1000L) );
+}
+
+
+/// @brief  Count per second - count * 1000000 / us in 32 bit math.
+///
+/// - Large counts are scaled down with us, keeping about 12 bits.
+/// @param[in] count: bytes, blocks ...
+/// @param[in] us: time in microseconds.
+///
+/// @return  count per second, 0 if us is 0, saturates at 0xffffffff.
+MEMSPACE
+uint32_t rate_per_second(uint32_t count, uint32_t us)
+{
+    while(count > 4294UL && us > 1)
+    {
+        count >>= 1;
+        us >>= 1;
+    }
+    if(!us)
+        return(0);
+    if(count > 4294UL)
+        return(0xffffffffUL);
+    return( count * 1000000UL / us );
+}
+
+
 /// @brief  timespec structure in seconds.nanoseconds in string.
 ///
 /// @param[in] : timespec struct we wish to display.
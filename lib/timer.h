@@ -60,6 +60,8 @@ MEMSPACE int set_timers ( void (*handler )(void ), int timer );
 MEMSPACE int kill_timer ( int timer );
 MEMSPACE void delete_all_timers ( void );
 MEMSPACE void subtract_timespec ( ts_t *a , ts_t *b );
+MEMSPACE uint32_t timespec_us ( ts_t *start , ts_t *now );
+MEMSPACE uint32_t rate_per_second ( uint32_t count , uint32_t us );
 MEMSPACE char *ts_to_str ( ts_t *val );
 MEMSPACE void display_ts ( ts_t *val );
 MEMSPACE void clock_elapsed_begin ( void );
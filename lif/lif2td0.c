@@ -0,0 +1,977 @@
+/**
+  @file   lif2td0.c
+  @brief  LIF image to TeleDisk and ImageDisk encoder
+  @par Copyright &copy; 2014-2020 Mike Gore, Inc. All rights reserved. GPL
+  @see http://github.com/magore/hp85disk
+  @see http://github.com/magore/hp85disk/COPYRIGHT.md for Copyright details
+
+  @help
+   * LIF command help
+     * lif lif2td0 [options] image.lif image.td0
+       * Convert a pure LIF image into a TeleDisk image
+       * -a selects TeleDisk "Advanced Compression" (LZSS)
+     * lif lif2imd [options] image.lif image.imd
+       * Convert a pure LIF image into an ImageDisk image
+
+  @par Edit History
+  - [1.0]   [Mike Gore]  Initial revision of file.
+
+  @Notes
+   * This is the reverse of td02lif - we use the same TeleDisk header layouts
+     td_header_t, td_comment_t, td_track_t and td_sector_t from td02lif.h
+   * The LZSS encoder in teledisk/td0_lzss.c shares the Huffman tree and
+     decoder tables with the TeleDisk decoder
+   * Disk geometry comes from, in order of priority
+     * User overrides
+     * hpdir.ini drive model (-m model)
+     * The LIF volume header
+     * 16 sectors of 256 bytes per track single sided
+*/
+
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+#include <inttypes.h>
+
+#include <time.h>
+#include "lifsup.h"
+#include "lifutils.h"
+#include "td02lif.h"
+#include "lif2td0.h"
+#include "../gpib/drives_sup.h"
+
+/// @brief Dave Dunfiled LZSS expander and matching encoder
+#include "td0_lzss.h"
+
+extern hpdir_t hpdir;
+
+
+/// @brief Pack TeleDisk image header data in architecture nutral way
+/// Computes and stores the header CRC
+/// @param[out] B: destination data
+/// @param[in] p: TeleDisk image header structure
+/// @return TeleDisk image header size (not structure size)
+int td0_pack_disk_header(uint8_t *B, td_header_t *p)
+{
+    B[0] = p->Header[0];
+    B[1] = p->Header[1];
+    V2B_LSB(B,2,1,p->VolNO);
+    V2B_LSB(B,3,1,p->ChkSig);
+    V2B_LSB(B,4,1,p->TDVersion);
+    V2B_LSB(B,5,1,p->Density);
+    V2B_LSB(B,6,1,p->DriveType);
+    V2B_LSB(B,7,1,p->TrackDensity);
+    V2B_LSB(B,8,1,p->DosMode);
+    V2B_LSB(B,9,1,p->Sides);
+
+    p->CRC = crc16(B,0, 0xA097, 10);
+    V2B_LSB(B,10,2,p->CRC);
+    return(TD_HEADER_SIZE);
+}
+
+/// @brief Pack TeleDisk comment header data in architecture nutral way
+/// Computes and stores the CRC of the comment header and comment
+/// @param[out] B: destination data
+/// @param[in] p: TeleDisk comment header structure
+/// @param[in] comment: comment data of p->Size bytes
+/// @return TeleDisk comment header size (not structure size)
+int td0_pack_comment_header(uint8_t *B, td_comment_t *p, uint8_t *comment)
+{
+    uint16_t crc;
+
+    V2B_LSB(B,2,2,p->Size);
+    V2B_LSB(B,4,1,p->Year);
+    V2B_LSB(B,5,1,p->Month);
+    V2B_LSB(B,6,1,p->Day);
+    V2B_LSB(B,7,1,p->Hour);
+    V2B_LSB(B,8,1,p->Minute);
+    V2B_LSB(B,9,1,p->Second);
+
+    crc = crc16(B+2,0,0xA097, 8);
+    p->CRC = crc16(comment,crc,0xA097,p->Size);
+    V2B_LSB(B,0,2,p->CRC);
+    return(TD_COMMENT_SIZE);
+}
+
+/// @brief Pack TeleDisk track header data in architecture nutral way
+/// Computes and stores the track header CRC
+/// @param[out] B: destination data
+/// @param[in] p: TeleDisk track header structure
+/// @return TeleDisk track header size (not structure size)
+int td0_pack_track_header(uint8_t *B, td_track_t *p)
+{
+    V2B_LSB(B,0,1,p->PSectors);
+    V2B_LSB(B,1,1,p->PCyl);
+    V2B_LSB(B,2,1,p->PSide);
+
+    p->CRC = crc16(B,0,0xA097, 3) & 0xff;
+    V2B_LSB(B,3,1,p->CRC);
+    return(TD_TRACK_SIZE);
+}
+
+/// @brief Pack TeleDisk sector header data in architecture nutral way
+/// Note: p->CRC must be set by the caller - it covers the sector data
+/// @param[out] B: destination data
+/// @param[in] p: TeleDisk sector header structure
+/// @return TeleDisk sector header size (not structure size)
+int td0_pack_sector_header(uint8_t *B, td_sector_t *p)
+{
+    V2B_LSB(B,0,1,p->Cyl);
+    V2B_LSB(B,1,1,p->Side);
+    V2B_LSB(B,2,1,p->Sector);
+    V2B_LSB(B,3,1,p->SizeExp);
+    V2B_LSB(B,4,1,p->Flags);
+    V2B_LSB(B,5,1,p->CRC);
+    return(TD_SECTOR_SIZE);
+}
+
+/// @brief Append data to a growing TeleDisk image buffer
+/// @param[in] b: buffer
+/// @param[in] data: data to append
+/// @param[in] size: size of data
+/// @return 1 on success, 0 on memory allocation error
+int td0_buffer_add(td0_buffer_t *b, uint8_t *data, long size)
+{
+    if(b->size + size > b->max)
+    {
+        long max = b->max ? b->max : 65536L;
+        uint8_t *ptr;
+
+        while(b->size + size > max)
+            max <<= 1;
+
+        ptr = realloc(b->data, max);
+        if(ptr == NULL)
+        {
+            printf("td0_buffer_add: can not allocate %ld bytes\n", max);
+            return(0);
+        }
+        b->data = ptr;
+        b->max = max;
+    }
+    memcpy(b->data + b->size, data, size);
+    b->size += size;
+    return(1);
+}
+
+/// @brief Encode one sector as a TeleDisk sector data block
+/// This is the inverse of td0_rle()
+/// We pick the smallest of:
+///   Type 1 - the whole sector is one repeated 2 byte pattern
+///   Type 2 - literal blocks and repeated 2 byte patterns
+///   Type 0 - raw sector data
+/// @param[out] dst: data block, must hold size + 5 bytes
+/// @param[in] src: sector data
+/// @param[in] size: sector size
+/// @return size of data block including the 3 byte data header
+int td0_encode_sector(uint8_t *dst, uint8_t *src, int size)
+{
+    int i, r;
+    int literal;
+    int len;
+    int raw = 0;
+    uint8_t *ptr;
+
+    // Type 1 - the whole sector is one 2 byte pattern
+    for(i=2;i<size;i+=2)
+    {
+        if(src[i] != src[0] || src[i+1] != src[1])
+            break;
+    }
+    if(i >= size)
+    {
+        V2B_LSB(dst,0,2,5);
+        dst[2] = 1;
+        V2B_LSB(dst,3,2,size >> 1);
+        dst[5] = src[0];
+        dst[6] = src[1];
+        return(7);
+    }
+
+    // Type 2 - literal blocks and repeated 2 byte patterns
+    ptr = dst + 3;
+    literal = 0;
+    i = 0;
+    while(i < size)
+    {
+        r = 1;
+        if(i + 1 < size)
+        {
+            while(r < 255 && i + (r+1)*2 <= size
+                && src[i + r*2] == src[i] && src[i + r*2 + 1] == src[i+1])
+                ++r;
+        }
+
+        // A repeat block costs 4 bytes so it must save more then that
+        if(r < 3)
+        {
+            ++i;
+            // Emit full literal blocks as we go
+            if(i - literal == 255)
+            {
+                *ptr++ = 0;
+                *ptr++ = 255;
+                memcpy(ptr, src + literal, 255);
+                ptr += 255;
+                literal = i;
+            }
+            // Give up if type 2 can not beat raw data
+            if(ptr - (dst + 3) + (i - literal) + 2 >= size)
+            {
+                raw = 1;
+                break;
+            }
+            continue;
+        }
+
+        // Flush any pending literal data
+        if(i > literal)
+        {
+            *ptr++ = 0;
+            *ptr++ = i - literal;
+            memcpy(ptr, src + literal, i - literal);
+            ptr += (i - literal);
+        }
+        *ptr++ = 1;     // 2 byte block
+        *ptr++ = r;     // repeat count
+        *ptr++ = src[i];
+        *ptr++ = src[i+1];
+        i += r * 2;
+        literal = i;
+    }
+
+    if(!raw)
+    {
+        if(size > literal)
+        {
+            *ptr++ = 0;
+            *ptr++ = size - literal;
+            memcpy(ptr, src + literal, size - literal);
+            ptr += (size - literal);
+        }
+        len = ptr - (dst + 3);
+        if(len < size)
+        {
+            V2B_LSB(dst,0,2,len + 1);
+            dst[2] = 2;
+            return(len + 3);
+        }
+    }
+
+    // Type 0 - raw data
+    V2B_LSB(dst,0,2,size + 1);
+    dst[2] = 0;
+    memcpy(dst+3, src, size);
+    return(size + 3);
+}
+
+/// @brief Convert sector size into TeleDisk and ImageDisk size exponent
+/// @param[in] size: sector size 128 .. 8192
+/// @return size exponent, -1 if size is not a power of two
+int td0_size2exp(int size)
+{
+    int exp;
+    for(exp = 0; exp <= 6; ++exp)
+    {
+        if((128 << exp) == size)
+            return(exp);
+    }
+    return(-1);
+}
+
+/// @brief Compute the physical order of sectors on a track
+/// @param[out] map: physical position to sector number map
+/// @param[in] sectors: sectors per track
+/// @param[in] interleave: interleave factor, 0 or 1 = none
+/// @param[in] first: first sector number
+/// @return void
+void td0_interleave_map(int *map, int sectors, int interleave, int first)
+{
+    int s, pos;
+
+    if(interleave < 1)
+        interleave = 1;
+
+    for(s=0;s<sectors;++s)
+        map[s] = -1;
+
+    pos = 0;
+    for(s=0;s<sectors;++s)
+    {
+        while(map[pos] != -1)
+            pos = (pos + 1) % sectors;
+        map[pos] = first + s;
+        pos = (pos + interleave) % sectors;
+    }
+}
+
+/// @brief Elapsed time in seconds since start
+/// @param[in] start: start time
+/// @return seconds
+double td0_elapsed(struct timespec *start)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return( (double) (now.tv_sec - start->tv_sec) +
+        (double) (now.tv_nsec - start->tv_nsec) / 1.0e9 );
+}
+
+/// @brief Find the disk geometry for a LIF image
+/// User overrides already in g are kept, anything else set to -1 is filled in
+/// @param[in,out] g: geometry
+/// @param[in] image: LIF image data
+/// @param[in] bytes: LIF image size
+/// @param[in] model: optional hpdir.ini drive model
+/// @return 1 on success, 0 on error
+int td0_geometry(td0_geometry_t *g, uint8_t *image, long bytes, char *model)
+{
+    lif_t LIF;
+    long sectors;
+    long need;
+
+    int cylinders = -1;
+    int heads = 1;
+    int per_track = -1;
+    int size = LIF_SECTOR_SIZE;
+    int interleave = 1;
+
+    if(model)
+    {
+        if( MATCHI_LEN(model,"hp"))
+            model +=2;
+        if(!hpdir_find_drive(model,0,1))
+        {
+            printf("Disk: %s not found in hpdir.ini\n", model);
+            return(0);
+        }
+        cylinders = hpdir.CYLINDERS;
+        heads = hpdir.HEADS;
+        per_track = hpdir.SECTORS;
+        size = hpdir.BYTES_PER_SECTOR;
+        interleave = hpdir.INTERLEAVE;
+    }
+    else
+    {
+        // The LIF volume header may have the geometry
+        lif_vol_clear(&LIF);
+        lif_str2vol(image, &LIF);
+        if(LIF.VOL.tracks_per_side && LIF.VOL.sides && LIF.VOL.sectors_per_track
+            && LIF.VOL.tracks_per_side < MAXCYL && LIF.VOL.sides <= MAXSIDES
+            && LIF.VOL.sectors_per_track < MAXSECTORS)
+        {
+            cylinders = LIF.VOL.tracks_per_side;
+            heads = LIF.VOL.sides;
+            per_track = LIF.VOL.sectors_per_track;
+        }
+    }
+
+    if(g->heads == -1)
+        g->heads = heads;
+    if(g->sectors == -1)
+        g->sectors = per_track > 0 ? per_track : 16;
+    if(g->size == -1)
+        g->size = size;
+    if(g->interleave == -1)
+        g->interleave = interleave;
+    if(g->first == -1)
+        g->first = 0;
+
+    if(td0_size2exp(g->size) < 0)
+    {
+        printf("Error: sector size:%d must be a power of 2 from 128 to 8192\n", g->size);
+        return(0);
+    }
+    if(g->heads < 1 || g->heads > MAXSIDES)
+    {
+        printf("Error: heads:%d must be 1 or %d\n", g->heads, MAXSIDES);
+        return(0);
+    }
+    if(g->sectors < 1 || (g->first + g->sectors) > MAXSECTORS)
+    {
+        printf("Error: sectors:%d first:%d exceed %d\n", g->sectors, g->first, MAXSECTORS);
+        return(0);
+    }
+
+    // Enough cylinders to hold the image
+    sectors = (bytes + g->size - 1) / g->size;
+    need = (sectors + (long) g->heads * g->sectors - 1) / ((long) g->heads * g->sectors);
+
+    if(g->cylinders == -1)
+        g->cylinders = cylinders > 0 ? cylinders : need;
+
+    if(g->cylinders < 1 || g->cylinders > MAXCYL)
+    {
+        printf("Error: cylinders:%d must be 1 to %d\n", g->cylinders, MAXCYL);
+        return(0);
+    }
+    if(g->cylinders < need)
+    {
+        printf("Warning: LIF image needs %ld cylinders, truncating to %d\n", need, g->cylinders);
+    }
+    return(1);
+}
+
+/// @brief Parse lif2td0 and lif2imd options
+/// @param[out] u: user geometry overrides, -1 = not specified
+/// @param[out] model: hpdir.ini model or NULL
+/// @param[out] compress: advanced compression flag, NULL if not supported
+/// @param[in] argc: argument count
+/// @param[in] argv: arguments
+/// @param[out] in: LIF image name
+/// @param[out] out: output image name
+/// @return 1 on success, 0 on error
+int td0_geometry_args(td0_geometry_t *u, char **model, int *compress, int argc, char *argv[], char **in, char **out)
+{
+    int i;
+    char *ptr;
+    int *val;
+
+    u->cylinders = -1;
+    u->heads = -1;
+    u->sectors = -1;
+    u->size = -1;
+    u->interleave = -1;
+    u->first = -1;
+
+    *model = NULL;
+    *in = NULL;
+    *out = NULL;
+
+    for(i=1;i<argc;++i)
+    {
+        ptr = argv[i];
+        if(!ptr)
+            break;
+
+        if(!*ptr)
+            continue;
+
+        if(*ptr == '-')
+        {
+            ++ptr;
+
+            if(*ptr == '?' || MATCH(ptr,"help") )
+                return(0);
+
+            if(*ptr == 'a' && compress != NULL)
+            {
+                *compress = 1;
+                continue;
+            }
+
+            if(*ptr == 'm')
+            {
+                ++ptr;
+                if(*ptr || (ptr = argv[++i]) )
+                    *model = ptr;
+                continue;
+            }
+
+            val = NULL;
+            switch(*ptr)
+            {
+                case 'f': val = &u->first; break;
+                case 'h': val = &u->heads; break;
+                case 'i': val = &u->interleave; break;
+                case 'n': val = &u->sectors; break;
+                case 's': val = &u->size; break;
+                case 't': val = &u->cylinders; break;
+            }
+            if(val == NULL)
+            {
+                printf("ERROR: bad options:[%s]\n", ptr);
+                return(0);
+            }
+            ++ptr;
+            if(*ptr || (ptr = argv[++i]) )
+                *val = atoi(ptr);
+            continue;
+        }
+        else if(*in == NULL)
+        {
+            *in = ptr;
+        }
+        else if(*out == NULL)
+        {
+            *out = ptr;
+        }
+        else
+        {
+            printf("ERROR: bad options:[%s]\n", ptr);
+            return(0);
+        }
+    }
+
+    if(!*in || !strlen(*in))
+    {
+        printf("Expected LIF filename\n");
+        return(0);
+    }
+
+    if(!*out || !strlen(*out))
+    {
+        printf("Expected output filename\n");
+        return(0);
+    }
+
+    if(strcasecmp(*in,*out) == 0)
+    {
+        printf("LIF and output names can not be the same\n");
+        return(0);
+    }
+    return(1);
+}
+
+/// @brief Read a whole LIF image into memory
+/// @param[in] name: LIF image name
+/// @param[out] bytes: image size
+/// @return image data or NULL on error
+uint8_t *td0_load_lif(char *name, long *bytes)
+{
+    lif_t *LIF;
+    uint8_t *image;
+
+    // Validates the volume and directory
+    LIF = lif_open_volume(name,"rb");
+    if(LIF == NULL)
+    {
+        printf("Error: %s is not a LIF image\n", name);
+        return(NULL);
+    }
+
+    *bytes = LIF->imagebytes;
+    image = lif_calloc(*bytes + LIF_SECTOR_SIZE);
+    if(image == NULL)
+    {
+        lif_close_volume(LIF);
+        return(NULL);
+    }
+
+    if(lif_read(LIF, image, 0, *bytes) != *bytes)
+    {
+        lif_free(image);
+        lif_close_volume(LIF);
+        return(NULL);
+    }
+
+    lif_close_volume(LIF);
+    return(image);
+}
+
+/// @brief Write a LIF image as a TeleDisk image
+/// @param[in] name: TeleDisk image name
+/// @param[in] image: LIF image data
+/// @param[in] bytes: LIF image size
+/// @param[in] g: disk geometry
+/// @param[in] compress: use TeleDisk advanced compression
+/// @param[in] comment: comment string
+/// @return 1 on success, 0 on error
+int td0_write_td0(char *name, uint8_t *image, long bytes, td0_geometry_t *g, int compress, char *comment)
+{
+    FILE *fo;
+    int c,h,s;
+    int len;
+    long block, out;
+    int map[MAXSECTORS];
+    uint8_t *data, *zero;
+    uint8_t headerbuf[TD_HEADER_SIZE];
+    uint8_t commentbuf[TD_COMMENT_SIZE];
+    uint8_t trackbuf[TD_TRACK_SIZE];
+    uint8_t sectorbuf[TD_SECTOR_SIZE];
+    uint8_t *sectordata;
+    td_header_t td_header;
+    td_comment_t td_comment;
+    td_track_t td_track;
+    td_sector_t td_sector;
+    td0_buffer_t b;
+    time_t t;
+    tm_t tm;
+    struct timespec start;
+    double encode_time, compress_time = 0;
+
+    memset(&b,0,sizeof(b));
+
+    zero = lif_calloc(g->size);
+    sectordata = lif_calloc(g->size + 8);
+    if(zero == NULL || sectordata == NULL)
+    {
+        lif_free(zero);
+        lif_free(sectordata);
+        return(0);
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    // Comment header and comment, NUL terminated lines
+    t = time(0);
+    gmtime_r(&t, (tm_t *) &tm);
+    memset(&td_comment,0,sizeof(td_comment));
+    td_comment.Size = strlen(comment) + 1;
+    td_comment.Year = tm.tm_year;
+    td_comment.Month = tm.tm_mon;
+    td_comment.Day = tm.tm_mday;
+    td_comment.Hour = tm.tm_hour;
+    td_comment.Minute = tm.tm_min;
+    td_comment.Second = tm.tm_sec;
+    td0_pack_comment_header(commentbuf, &td_comment, (uint8_t *) comment);
+
+    if(!td0_buffer_add(&b, commentbuf, TD_COMMENT_SIZE) ||
+       !td0_buffer_add(&b, (uint8_t *) comment, td_comment.Size) )
+        goto error;
+
+    td0_interleave_map(map, g->sectors, g->interleave, g->first);
+
+    // Tracks are stored cylinder by cylinder, side by side
+    for(c=0;c<g->cylinders;++c)
+    {
+        for(h=0;h<g->heads;++h)
+        {
+            td_track.PSectors = g->sectors;
+            td_track.PCyl = c;
+            td_track.PSide = h;
+            td0_pack_track_header(trackbuf, &td_track);
+            if(!td0_buffer_add(&b, trackbuf, TD_TRACK_SIZE))
+                goto error;
+
+            for(s=0;s<g->sectors;++s)
+            {
+                block = ((long) c * g->heads + h) * g->sectors + (map[s] - g->first);
+                if( (block + 1) * g->size <= bytes)
+                {
+                    data = image + block * g->size;
+                }
+                else if(block * g->size < bytes)
+                {
+                    // Partial last sector
+                    memset(zero, 0, g->size);
+                    memcpy(zero, image + block * g->size, bytes - block * g->size);
+                    data = zero;
+                }
+                else
+                {
+                    memset(zero, 0, g->size);
+                    data = zero;
+                }
+
+                td_sector.Cyl = c;
+                td_sector.Side = h;
+                td_sector.Sector = map[s];
+                td_sector.SizeExp = td0_size2exp(g->size);
+                td_sector.Flags = 0;
+                // td02lif checks the low byte of the CRC of the sector data
+                td_sector.CRC = crc16(data,0,0xA097,g->size) & 0xff;
+                td0_pack_sector_header(sectorbuf, &td_sector);
+
+                len = td0_encode_sector(sectordata, data, g->size);
+
+                if(!td0_buffer_add(&b, sectorbuf, TD_SECTOR_SIZE) ||
+                   !td0_buffer_add(&b, sectordata, len) )
+                    goto error;
+            }
+        }
+    }
+
+    // End of image
+    td_track.PSectors = 0xff;
+    td_track.PCyl = 0;
+    td_track.PSide = 0;
+    td0_pack_track_header(trackbuf, &td_track);
+    if(!td0_buffer_add(&b, trackbuf, TD_TRACK_SIZE))
+        goto error;
+
+    encode_time = td0_elapsed(&start);
+
+    // Image header - never compressed
+    memset(&td_header,0,sizeof(td_header));
+    strcpy((char *) td_header.Header, compress ? "td" : "TD");
+    td_header.VolNO = 0;
+    td_header.ChkSig = 0;
+    td_header.TDVersion = TD_VERSION;
+    td_header.Density = 0;          // 250K
+    td_header.DriveType = 1;        // 5.25
+    td_header.TrackDensity = 0x80;  // Comment present
+    td_header.DosMode = 0;
+    td_header.Sides = g->heads;
+    td0_pack_disk_header(headerbuf, &td_header);
+
+    fo = fopen(name,"wb");
+    if(fo == NULL)
+    {
+        printf("Error: Can't create TeleDisk file: %s\n", name);
+        goto error;
+    }
+
+    out = fwrite(headerbuf, 1, TD_HEADER_SIZE, fo);
+
+    if(compress)
+    {
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        out += lzss_compress(fo, b.data, b.size);
+        compress_time = td0_elapsed(&start);
+    }
+    else
+    {
+        out += fwrite(b.data, 1, b.size, fo);
+    }
+
+    if(ferror(fo))
+    {
+        printf("Error: writing TeleDisk file: %s\n", name);
+        fclose(fo);
+        goto error;
+    }
+    fclose(fo);
+
+    printf("TeleDisk file:         %s\n", name);
+    printf("\tVersion:       %02d\n", td_header.TDVersion);
+    if(compress)
+        printf("\tAdvanced Compression\n");
+    else
+        printf("\tNot Compressed\n");
+    printf("\tCylinders:     %d\n", g->cylinders);
+    printf("\tSides:         %02d\n", g->heads);
+    printf("\tSectors:       %d\n", g->sectors);
+    printf("\tSector Size:   %d\n", g->size);
+    printf("\tInterleave:    %d\n", g->interleave);
+    printf("\tLIF bytes:     %ld\n", bytes);
+    printf("\tRLE bytes:     %ld\n", b.size + TD_HEADER_SIZE);
+    printf("\tTeleDisk bytes:%ld\n", out);
+    printf("\tRatio:         %.2f%%\n", bytes ? 100.0 * out / bytes : 0.0);
+    printf("\tRLE encode:    %.6f sec\n", encode_time);
+    if(compress)
+    {
+        printf("\tLZSS compress: %.6f sec, %.2f MB/s\n", compress_time,
+            compress_time > 0 ? (b.size / compress_time) / 1.0e6 : 0.0);
+    }
+
+    free(b.data);
+    lif_free(zero);
+    lif_free(sectordata);
+    return(1);
+
+error:
+    free(b.data);
+    lif_free(zero);
+    lif_free(sectordata);
+    return(0);
+}
+
+/// @brief Write a LIF image as an ImageDisk image
+/// Each track is written as a mode, cylinder, head, sector count and size
+/// header followed by the sector numbering map and the sector data records
+/// Sectors filled with a single byte value are written compressed
+/// @param[in] name: ImageDisk image name
+/// @param[in] image: LIF image data
+/// @param[in] bytes: LIF image size
+/// @param[in] g: disk geometry
+/// @param[in] comment: comment string
+/// @return 1 on success, 0 on error
+int td0_write_imd(char *name, uint8_t *image, long bytes, td0_geometry_t *g, char *comment)
+{
+    FILE *fo;
+    int c,h,s,i;
+    long block;
+    int map[MAXSECTORS];
+    uint8_t *data, *zero;
+    uint8_t trackbuf[5];
+    uint8_t type;
+    time_t t;
+    tm_t tm;
+    struct timespec start;
+    double encode_time;
+    long out;
+
+    zero = lif_calloc(g->size);
+    if(zero == NULL)
+        return(0);
+
+    fo = fopen(name,"wb");
+    if(fo == NULL)
+    {
+        printf("Error: Can't create ImageDisk file: %s\n", name);
+        lif_free(zero);
+        return(0);
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    t = time(0);
+    gmtime_r(&t, (tm_t *) &tm);
+    fprintf(fo,"IMD %s: %02d/%02d/%04d %02d:%02d:%02d\r\n",
+        IMD_VERSION,
+        tm.tm_mday, tm.tm_mon + 1, tm.tm_year + 1900,
+        tm.tm_hour, tm.tm_min, tm.tm_sec);
+    fprintf(fo,"%s\r\n", comment);
+    fputc(0x1a, fo);
+
+    td0_interleave_map(map, g->sectors, g->interleave, g->first);
+
+    for(c=0;c<g->cylinders;++c)
+    {
+        for(h=0;h<g->heads;++h)
+        {
+            trackbuf[0] = IMD_MODE_250K_MFM;
+            trackbuf[1] = c;
+            trackbuf[2] = h;
+            trackbuf[3] = g->sectors;
+            trackbuf[4] = td0_size2exp(g->size);
+            fwrite(trackbuf, 1, 5, fo);
+
+            for(s=0;s<g->sectors;++s)
+                fputc(map[s], fo);
+
+            for(s=0;s<g->sectors;++s)
+            {
+                block = ((long) c * g->heads + h) * g->sectors + (map[s] - g->first);
+                if( (block + 1) * g->size <= bytes)
+                {
+                    data = image + block * g->size;
+                }
+                else
+                {
+                    memset(zero, 0, g->size);
+                    if(block * g->size < bytes)
+                        memcpy(zero, image + block * g->size, bytes - block * g->size);
+                    data = zero;
+                }
+
+                for(i=1;i<g->size;++i)
+                {
+                    if(data[i] != data[0])
+                        break;
+                }
+
+                if(i == g->size)
+                {
+                    type = IMD_SECTOR_COMPRESSED;
+                    fputc(type, fo);
+                    fputc(data[0], fo);
+                }
+                else
+                {
+                    type = IMD_SECTOR_NORMAL;
+                    fputc(type, fo);
+                    fwrite(data, 1, g->size, fo);
+                }
+            }
+        }
+    }
+
+    out = ftell(fo);
+    if(ferror(fo))
+    {
+        printf("Error: writing ImageDisk file: %s\n", name);
+        fclose(fo);
+        lif_free(zero);
+        return(0);
+    }
+    fclose(fo);
+    lif_free(zero);
+
+    encode_time = td0_elapsed(&start);
+
+    printf("ImageDisk file:        %s\n", name);
+    printf("\tVersion:       %s\n", IMD_VERSION);
+    printf("\tCylinders:     %d\n", g->cylinders);
+    printf("\tSides:         %02d\n", g->heads);
+    printf("\tSectors:       %d\n", g->sectors);
+    printf("\tSector Size:   %d\n", g->size);
+    printf("\tInterleave:    %d\n", g->interleave);
+    printf("\tLIF bytes:     %ld\n", bytes);
+    printf("\tImageDisk bytes:%ld\n", out);
+    printf("\tRatio:         %.2f%%\n", bytes ? 100.0 * out / bytes : 0.0);
+    printf("\tEncode:        %.6f sec\n", encode_time);
+    return(1);
+}
+
+
+void lif2td0_help(int full)
+{
+    printf("lif2td0 help\n");
+    if(full)
+    {
+        printf(
+            "Usage: lif lif2td0 [options] file.lif file.td0\n"
+            "       lif lif2imd [options] file.lif file.imd\n"
+            "lif2td0 and lif2imd options:\n"
+            "Notes: for any option that is NOT specified it is taken from the LIF volume header\n"
+            "\t -a             - TeleDisk advanced (LZSS) compression, lif2td0 only\n"
+            "\t -mMODEL | -m MODEL - use hpdir.ini drive geometry\n"
+            "\t -tNN | -t NN   - force cylinders\n"
+            "\t -h1|2 | -h 1|2 - force heads/surfaces\n"
+            "\t -nNN | -n NN   - force sectors per track\n"
+            "\t -sNN | -s NN   - force sector size\n"
+            "\t -iNN | -i NN   - sector interleave\n"
+            "\t -fNN | -f NN   - first sector number on a track, default 0\n"
+            "\n"
+        );
+    }
+}
+
+/// @brief Common lif2td0 and lif2imd conversion
+/// @param[in] argc: argument count
+/// @param[in] argv: arguments
+/// @param[in] imd: 1 = ImageDisk, 0 = TeleDisk
+/// @return 1 on success, 0 on error
+static int lif2image(int argc, char *argv[], int imd)
+{
+    td0_geometry_t g;
+    char *model;
+    char *lifname, *outname;
+    int compress = 0;
+    uint8_t *image;
+    long bytes;
+    int ret;
+    char comment[256];
+
+    if(argc <= 1)
+    {
+        lif2td0_help(1);
+        return(1);
+    }
+
+    if(!td0_geometry_args(&g, &model, imd ? NULL : &compress, argc, argv, &lifname, &outname))
+    {
+        lif2td0_help(1);
+        return(0);
+    }
+
+    image = td0_load_lif(lifname, &bytes);
+    if(image == NULL)
+        return(0);
+
+    if(!td0_geometry(&g, image, bytes, model))
+    {
+        lif_free(image);
+        return(0);
+    }
+
+    snprintf(comment, sizeof(comment)-1, "LIF image %s", basename(lifname));
+
+    if(imd)
+        ret = td0_write_imd(outname, image, bytes, &g, comment);
+    else
+        ret = td0_write_td0(outname, image, bytes, &g, compress, comment);
+
+    lif_free(image);
+    return(ret);
+}
+
+/// @brief Convert a LIF image into a TeleDisk image
+/// @param[in] argc: argument count
+/// @param[in] argv: arguments
+/// @return 1 on success, 0 on error
+int lif2td0(int argc, char *argv[])
+{
+    return( lif2image(argc, argv, 0) );
+}
+
+/// @brief Convert a LIF image into an ImageDisk image
+/// @param[in] argc: argument count
+/// @param[in] argv: arguments
+/// @return 1 on success, 0 on error
+int lif2imd(int argc, char *argv[])
+{
+    return( lif2image(argc, argv, 1) );
+}
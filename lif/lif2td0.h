@@ -0,0 +1,77 @@
+/**
+  @file   lif2td0.h
+  @brief  LIF image to TeleDisk and ImageDisk encoder
+  @par Copyright &copy; 2014-2020 Mike Gore, Inc. All rights reserved. GPL
+  @see http://github.com/magore/hp85disk
+  @see http://github.com/magore/hp85disk/COPYRIGHT.md for Copyright details
+
+  @help
+   * LIF command help
+     * lif lif2td0 [options] image.lif image.td0
+       * Convert a pure LIF image into a TeleDisk image
+     * lif lif2imd [options] image.lif image.imd
+       * Convert a pure LIF image into an ImageDisk image
+
+  @par Edit History
+  - [1.0]   [Mike Gore]  Initial revision of file.
+*/
+
+
+#ifndef _LIF2TD0_H_
+#define _LIF2TD0_H_
+
+///@brief TeleDisk version we claim to be (2.1)
+#define TD_VERSION      21
+
+///@brief ImageDisk version we claim to be
+#define IMD_VERSION     "1.18"
+
+///@brief ImageDisk track mode 250 kbps MFM
+#define IMD_MODE_250K_MFM   5
+
+///@brief ImageDisk sector data record types we write
+#define IMD_SECTOR_NORMAL       1
+#define IMD_SECTOR_COMPRESSED   2
+
+///@brief Physical disk geometry used to lay out the LIF image
+/// Filled in from hpdir.ini, the LIF volume header or user overrides
+typedef struct
+{
+    int cylinders;          // Cylinders (tracks per side)
+    int heads;              // Heads/Sides
+    int sectors;            // Sectors per track
+    int size;               // Sector size in bytes
+    int interleave;         // Sector interleave, 0 or 1 = none
+    int first;              // First sector number on a track
+} td0_geometry_t;
+
+///@brief Growing memory buffer used to assemble a TeleDisk image
+/// TeleDisk advanced compression encodes everything after the image
+/// header as a single LZSS block so we build it in memory first
+typedef struct
+{
+    uint8_t *data;          // buffer
+    long size;              // bytes used
+    long max;               // bytes allocated
+} td0_buffer_t;
+
+/* lif2td0.c */
+int td0_pack_disk_header ( uint8_t *B , td_header_t *p );
+int td0_pack_comment_header ( uint8_t *B , td_comment_t *p , uint8_t *comment );
+int td0_pack_track_header ( uint8_t *B , td_track_t *p );
+int td0_pack_sector_header ( uint8_t *B , td_sector_t *p );
+int td0_buffer_add ( td0_buffer_t *b , uint8_t *data , long size );
+int td0_encode_sector ( uint8_t *dst , uint8_t *src , int size );
+int td0_size2exp ( int size );
+void td0_interleave_map ( int *map , int sectors , int interleave , int first );
+double td0_elapsed ( struct timespec *start );
+int td0_geometry ( td0_geometry_t *g , uint8_t *image , long bytes , char *model );
+int td0_geometry_args ( td0_geometry_t *u , char **model , int *compress , int argc , char *argv [], char **in , char **out );
+uint8_t *td0_load_lif ( char *name , long *bytes );
+int td0_write_td0 ( char *name , uint8_t *image , long bytes , td0_geometry_t *g , int compress , char *comment );
+int td0_write_imd ( char *name , uint8_t *image , long bytes , td0_geometry_t *g , char *comment );
+void lif2td0_help ( int full );
+int lif2td0 ( int argc , char *argv []);
+int lif2imd ( int argc , char *argv []);
+
+#endif
@@ -0,0 +1,512 @@
+/**
+  @file   lif_fuzz.c
+  @brief  Fuzzing entry point and parser throughput benchmark
+  @par Copyright &copy; 2014-2020 Mike Gore, Inc. All rights reserved. GPL
+  @see http://github.com/magore/hp85disk
+  @see http://github.com/magore/hp85disk/COPYRIGHT.md for Copyright details
+
+  @help
+   * LIF command help
+     * lif bench image [loops]
+       * Report MB/s for each TeleDisk or LIF parse stage
+   * Fuzzing - see Makefile
+     * make fuzz-corpus
+     * make fuzz       - libFuzzer (clang)
+     * make fuzz-afl   - AFL
+     * make fuzz-asan  - gcc ASan build that runs each corpus file once
+
+  @par Edit History
+  - [1.0]   [Mike Gore]  Initial revision of file.
+
+  @Notes
+   * lif_fuzz_input() feeds one untrusted buffer to the TeleDisk parsers
+     td0_unpack_disk_header, td0_unpack_track_header, td0_unpack_sector_header,
+     td0_rle via td0_read_disk() and to the LIF parsers lif_str2vol and
+     lif_str2dir
+   * Built with -DLIF_FUZZ main() in lifsup.c is left out
+     * -DLIF_LIBFUZZER - libFuzzer supplies main()
+     * otherwise main() here runs each file named on the command line,
+       or stdin, once - this is what AFL and the ASan build use
+*/
+
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+#include <inttypes.h>
+
+#include <time.h>
+#include "lifsup.h"
+#include "lifutils.h"
+#include "td02lif.h"
+#include "lif2td0.h"
+#include "td0_tests.h"
+#include "lif_fuzz.h"
+
+/// @brief Dave Dunfiled LZSS expander
+#include "td0_lzss.h"
+
+extern disk_t disk;
+
+
+/// @brief Run the LIF volume and directory parsers on a buffer
+/// @param[in] data: LIF image data
+/// @param[in] size: data size
+/// @return number of directory entries parsed
+long lif_fuzz_lif(uint8_t *data, long size)
+{
+    long offset, end;
+    long entries = 0;
+    lif_t LIF;
+
+    if(size < LIF_SECTOR_SIZE)
+        return(0);
+
+    memset(&LIF, 0, sizeof(LIF));
+    lif_str2vol(data, &LIF);
+    LIF.filestart = LIF.VOL.DirStartSector + LIF.VOL.DirSectors;
+    LIF.sectors = size / LIF_SECTOR_SIZE;
+    if(!lif_check_volume(&LIF))
+        return(0);
+
+    offset = (long) LIF.VOL.DirStartSector * LIF_SECTOR_SIZE;
+    end = offset + (long) LIF.VOL.DirSectors * LIF_SECTOR_SIZE;
+    if(end > size)
+        end = size;
+
+    for( ; offset + LIF_DIR_SIZE <= end; offset += LIF_DIR_SIZE)
+    {
+        lif_str2dir(data + offset, &LIF);
+        ++entries;
+        if(LIF.DIR.FileType == 0xffff)
+            break;
+        if(LIF.DIR.FileType == 0)
+            continue;
+        if(!lif_check_dir(&LIF))
+            break;
+    }
+    return(entries);
+}
+
+/// @brief Run the TeleDisk parsers on a buffer
+/// @param[in] data: TeleDisk image data
+/// @param[in] size: data size
+/// @return 1 if the image decoded, 0 on error
+int lif_fuzz_td0(uint8_t *data, long size)
+{
+    int ret = 0;
+
+    td0_init_sectors(&disk);
+    disk.td0_name = "fuzz";
+    disk.fi = fmemopen(data, size, "rb");
+    if(!disk.fi)
+        return(0);
+
+    if( td0_read_header(&disk) )
+        ret = td0_read_disk(&disk);
+
+    fclose(disk.fi);
+    disk.fi = NULL;
+    td0_free_comment(&disk);
+    td0_free_sectors(&disk);
+    return(ret);
+}
+
+/// @brief Feed one untrusted buffer to the TeleDisk and LIF parsers
+/// @param[in] data: input data
+/// @param[in] size: input size
+/// @return 0
+int lif_fuzz_input(const uint8_t *data, size_t size)
+{
+    uint8_t *copy;
+
+    // Parsers take writable buffers, fmemopen needs at least one byte
+    copy = malloc(size + 1);
+    if(!copy)
+        return(0);
+    memcpy(copy, data, size);
+
+    if(size >= 2 && (MATCH_LEN((char *) copy, "TD") || MATCH_LEN((char *) copy, "td")))
+        lif_fuzz_td0(copy, size);
+    else
+        lif_fuzz_lif(copy, size);
+
+    free(copy);
+    return(0);
+}
+
+#ifdef LIF_FUZZ
+/// @brief libFuzzer entry point
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+    return(lif_fuzz_input(data, size));
+}
+
+#ifndef LIF_LIBFUZZER
+/// @brief Run each file named on the command line, or stdin, once
+/// Used by AFL (afl-fuzz ... ./lif_fuzz_afl @@) and the ASan build
+int main(int argc, char *argv[])
+{
+    int i;
+    long size;
+    uint8_t *data;
+    FILE *fp;
+
+    for(i = (argc > 1) ? 1 : 0; i < argc; ++i)
+    {
+        fp = (argc > 1) ? fopen(argv[i],"rb") : stdin;
+        if(!fp)
+        {
+            printf("Can't open: %s\n", argv[i]);
+            continue;
+        }
+        data = malloc(LIF_FUZZ_MAX);
+        if(!data)
+            return(1);
+        size = fread(data, 1, LIF_FUZZ_MAX, fp);
+        if(fp != stdin)
+            fclose(fp);
+        lif_fuzz_input(data, size);
+        free(data);
+    }
+    return(0);
+}
+#endif
+#endif
+
+/// @brief Read a whole file into memory
+/// @param[in] name: file name
+/// @param[out] size: file size
+/// @return data or NULL on error
+uint8_t *lif_bench_load(char *name, long *size)
+{
+    FILE *fp;
+    uint8_t *data;
+    struct stat sb;
+
+    *size = 0;
+    if(stat(name, &sb) != 0 || sb.st_size <= 0)
+    {
+        printf("Can't stat: %s\n", name);
+        return(NULL);
+    }
+    fp = fopen(name, "rb");
+    if(!fp)
+    {
+        printf("Can't open: %s\n", name);
+        return(NULL);
+    }
+    // Padding for td0_rle reading past the last block
+    data = calloc(sb.st_size + TD_BLOCK_PAD, 1);
+    if(data)
+        *size = fread(data, 1, sb.st_size, fp);
+    fclose(fp);
+    return(data);
+}
+
+/// @brief Display one benchmark stage result
+/// @param[in] name: stage name
+/// @param[in] bytes: bytes processed
+/// @param[in] seconds: elapsed time
+/// @return void
+void lif_bench_report(char *name, double bytes, double seconds)
+{
+    printf("%-28s %12.0f bytes %9.4f sec %10.2f MB/s\n",
+        name, bytes, seconds,
+        seconds > 0 ? bytes / seconds / 1e6 : 0.0);
+}
+
+/// @brief Decode the TeleDisk stream following the image header
+/// Reads the same way td0_read() does, LZSS decompression when enabled
+/// otherwise plain file reads, but keeps the final partial block
+/// @param[in] data: TeleDisk image data
+/// @param[in] size: data size
+/// @param[out] stream: decoded stream, caller frees
+/// @return decoded stream size, -1 on error
+long lif_bench_stream(uint8_t *data, long size, uint8_t **stream)
+{
+    int c;
+    long used = 0;
+    long max = size * 4 + LIF_FUZZ_CHUNK;
+    uint8_t *ptr;
+
+    *stream = NULL;
+
+    td0_init_liftel();
+    disk.td0_name = "bench";
+    disk.fi = fmemopen(data, size, "rb");
+    if(!disk.fi)
+        return(-1);
+
+    if( !td0_read_header(&disk) )
+    {
+        fclose(disk.fi);
+        disk.fi = NULL;
+        td0_free_comment(&disk);
+        return(-1);
+    }
+
+    ptr = malloc(max + TD_BLOCK_PAD);
+    while(ptr)
+    {
+        if(used + LIF_FUZZ_CHUNK > max)
+        {
+            max *= 2;
+            ptr = realloc(ptr, max + TD_BLOCK_PAD);
+            if(!ptr)
+                break;
+        }
+        if(disk.compressed)
+        {
+            c = lzss_getbyte(disk.fi);
+            if(c == EOF)
+                break;
+            ptr[used++] = c;
+        }
+        else
+        {
+            c = fread(ptr + used, 1, LIF_FUZZ_CHUNK, disk.fi);
+            if(c <= 0)
+                break;
+            used += c;
+        }
+    }
+    fclose(disk.fi);
+    disk.fi = NULL;
+    td0_free_comment(&disk);
+
+    if(!ptr)
+        return(-1);
+    // td0_rle may read a block header past the end
+    memset(ptr + used, 0, TD_BLOCK_PAD);
+    *stream = ptr;
+    return(used);
+}
+
+/// @brief Walk the decoded TeleDisk stream
+/// Unpacks every track and sector header and optionally expands the
+/// sector data with td0_rle()
+/// @param[in] stream: decoded TeleDisk stream after the image header
+/// @param[in] size: stream size
+/// @param[in] rle: 1 = expand sector data
+/// @return bytes expanded if rle, otherwise stream bytes walked
+long lif_bench_walk(uint8_t *stream, long size, int rle)
+{
+    int s, len;
+    long pos = 0;
+    long expanded = 0;
+    td_track_t td_track;
+    td_sector_t td_sector;
+    uint8_t sector[16*1024];
+
+    while(pos + TD_TRACK_SIZE <= size)
+    {
+        td0_unpack_track_header(stream + pos, &td_track);
+        pos += TD_TRACK_SIZE;
+        if(td_track.PSectors == 0xff)
+            break;
+
+        for(s=0;s<td_track.PSectors;++s)
+        {
+            if(pos + TD_SECTOR_SIZE > size)
+                return(rle ? expanded : pos);
+            td0_unpack_sector_header(stream + pos, &td_sector);
+            pos += TD_SECTOR_SIZE;
+
+            if( (td_sector.SizeExp & 0xf8) || (td_sector.Flags & 0x30) )
+                continue;
+            if(pos + 2 > size)
+                return(rle ? expanded : pos);
+            len = B2V_LSB(stream, pos, 2);
+            if(pos + 2 + len > size)
+                return(rle ? expanded : pos);
+            if(rle)
+            {
+                len = td0_rle(sector, stream + pos, TD_SECTOR_BYTES(td_sector.SizeExp));
+                if(len > 0)
+                    expanded += len;
+                len = B2V_LSB(stream, pos, 2);
+            }
+            pos += 2 + len;
+        }
+    }
+    return(rle ? expanded : pos);
+}
+
+/// @brief TeleDisk parse stage benchmark
+/// @param[in] data: TeleDisk image data
+/// @param[in] size: data size
+/// @param[in] loops: repeat count for each stage
+/// @return 1 on success 0 on error
+int lif_bench_td0(uint8_t *data, long size, int loops)
+{
+    int i;
+    long bytes = 0;
+    long stream_size;
+    uint8_t *stream;
+    td_header_t td_header;
+    volatile long sink = 0;
+    struct timespec start;
+
+    td0_test_quiet(1);
+    stream_size = lif_bench_stream(data, size, &stream);
+    td0_test_quiet(0);
+    if(stream_size < 0)
+    {
+        printf("Error: not a TeleDisk image\n");
+        return(0);
+    }
+
+    printf("TeleDisk image: %ld bytes, %s, decoded stream: %ld bytes, %d loops\n",
+        size, disk.compressed ? "advanced compression" : "not compressed",
+        stream_size, loops);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for(i=0;i<loops*1000;++i)
+    {
+        sink += td0_unpack_disk_header(data, &td_header);
+        bytes += TD_HEADER_SIZE;
+    }
+    lif_bench_report("td0_unpack_disk_header", bytes, td0_elapsed(&start));
+
+    // Decoding the stream is where LZSS decompression happens
+    bytes = 0;
+    td0_test_quiet(1);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for(i=0;i<loops;++i)
+    {
+        uint8_t *tmp;
+        bytes += lif_bench_stream(data, size, &tmp);
+        free(tmp);
+    }
+    td0_test_quiet(0);
+    lif_bench_report(disk.compressed ? "lzss_getbyte" : "fread", bytes, td0_elapsed(&start));
+
+    bytes = 0;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for(i=0;i<loops;++i)
+        bytes += lif_bench_walk(stream, stream_size, 0);
+    lif_bench_report("track/sector headers", bytes, td0_elapsed(&start));
+
+    bytes = 0;
+    td0_test_quiet(1);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for(i=0;i<loops;++i)
+        bytes += lif_bench_walk(stream, stream_size, 1);
+    td0_test_quiet(0);
+    lif_bench_report("td0_rle", bytes, td0_elapsed(&start));
+
+    // td0_read_disk checks every sector with crc16
+    bytes = 0;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for(i=0;i<loops;++i)
+    {
+        sink += crc16(stream, 0, 0xA097, stream_size);
+        bytes += stream_size;
+    }
+    lif_bench_report("crc16", bytes, td0_elapsed(&start));
+
+    bytes = 0;
+    td0_test_quiet(1);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for(i=0;i<loops;++i)
+    {
+        lif_fuzz_td0(data, size);
+        bytes += size;
+    }
+    td0_test_quiet(0);
+    lif_bench_report("td0_read_disk", bytes, td0_elapsed(&start));
+
+    // Clearing and freeing the track/sector table, part of td0_read_disk above
+    bytes = 0;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for(i=0;i<loops;++i)
+    {
+        td0_init_sectors(&disk);
+        td0_free_sectors(&disk);
+        bytes += sizeof(disk_t);
+    }
+    lif_bench_report("td0_init/free_sectors", bytes, td0_elapsed(&start));
+
+    free(stream);
+    return(1);
+}
+
+/// @brief LIF parse stage benchmark
+/// @param[in] data: LIF image data
+/// @param[in] size: data size
+/// @param[in] loops: repeat count for each stage
+/// @return 1 on success 0 on error
+int lif_bench_lif(uint8_t *data, long size, int loops)
+{
+    int i;
+    long bytes = 0;
+    long entries;
+    lif_t LIF;
+    struct timespec start;
+
+    if(size < LIF_SECTOR_SIZE)
+    {
+        printf("Error: not a LIF image\n");
+        return(0);
+    }
+
+    td0_test_quiet(1);
+    entries = lif_fuzz_lif(data, size);
+    td0_test_quiet(0);
+
+    printf("LIF image: %ld bytes, %ld directory entries, %d loops\n",
+        size, entries, loops);
+
+    memset(&LIF, 0, sizeof(LIF));
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for(i=0;i<loops*1000;++i)
+    {
+        lif_str2vol(data, &LIF);
+        bytes += LIF_SECTOR_SIZE;
+    }
+    lif_bench_report("lif_str2vol", bytes, td0_elapsed(&start));
+
+    bytes = 0;
+    td0_test_quiet(1);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for(i=0;i<loops*100;++i)
+        bytes += lif_fuzz_lif(data, size) * LIF_DIR_SIZE;
+    td0_test_quiet(0);
+    lif_bench_report("lif_str2dir", bytes, td0_elapsed(&start));
+    return(1);
+}
+
+/// @brief Parser throughput benchmark
+/// @param[in] argc: argument count
+/// @param[in] argv: bench image [loops]
+/// @return 1 on success 0 on error
+int lif_bench(int argc, char *argv[])
+{
+    int ret;
+    int loops = 20;
+    long size;
+    uint8_t *data;
+
+    if(argc < 2 || !argv[1])
+    {
+        printf("Usage: lif bench image.td0|image.lif [loops]\n");
+        return(0);
+    }
+    if(argc > 2 && argv[2])
+        loops = atoi(argv[2]);
+    if(loops < 1)
+        loops = 1;
+
+    data = lif_bench_load(argv[1], &size);
+    if(!data)
+        return(0);
+
+    if(size >= 2 && (MATCH_LEN((char *) data, "TD") || MATCH_LEN((char *) data, "td")))
+        ret = lif_bench_td0(data, size, loops);
+    else
+        ret = lif_bench_lif(data, size, loops);
+
+    free(data);
+    return(ret);
+}
@@ -0,0 +1,33 @@
+/**
+  @file   lif_fuzz.h
+  @brief  Fuzzing entry point and parser throughput benchmark
+  @par Copyright &copy; 2014-2020 Mike Gore, Inc. All rights reserved. GPL
+  @see http://github.com/magore/hp85disk
+  @see http://github.com/magore/hp85disk/COPYRIGHT.md for Copyright details
+
+  @par Edit History
+  - [1.0]   [Mike Gore]  Initial revision of file.
+*/
+
+#ifndef _LIF_FUZZ_H_
+#define _LIF_FUZZ_H_
+
+///@brief Largest fuzz input we read from a file
+#define LIF_FUZZ_MAX    (4L*1024*1024)
+///@brief Read size used while decoding a TeleDisk stream
+#define LIF_FUZZ_CHUNK  4096
+
+/* lif_fuzz.c */
+long lif_fuzz_lif ( uint8_t *data , long size );
+int lif_fuzz_td0 ( uint8_t *data , long size );
+int lif_fuzz_input ( const uint8_t *data , size_t size );
+int LLVMFuzzerTestOneInput ( const uint8_t *data , size_t size );
+uint8_t *lif_bench_load ( char *name , long *size );
+void lif_bench_report ( char *name , double bytes , double seconds );
+long lif_bench_stream ( uint8_t *data , long size , uint8_t **stream );
+long lif_bench_walk ( uint8_t *stream , long size , int rle );
+int lif_bench_td0 ( uint8_t *data , long size , int loops );
+int lif_bench_lif ( uint8_t *data , long size , int loops );
+int lif_bench ( int argc , char *argv []);
+
+#endif
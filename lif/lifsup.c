@@ -261,6 +261,8 @@ void copyright()
     printf("\n");
 }
 
+// The fuzzing harness in lif_fuzz.c supplies its own main()
+#ifndef LIF_FUZZ
 int main(int argc, char *argv[])
 {
 
@@ -290,5 +292,6 @@ int main(int argc, char *argv[])
     }
 #endif
 }
+#endif  // LIF_FUZZ
 
 #endif
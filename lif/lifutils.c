@@ -80,8 +80,20 @@
    * OPTIONAL - compile time add on
      * lif td02lif image.td0 image.lif
        * Convert TeleDIsk LIF encoded disk into pure LIF file
+     * lif lif2td0 [-a] [-m model] image.lif image.td0
+       * Convert pure LIF file into a TeleDisk image, -a for advanced compression
+     * lif lif2imd [-m model] image.lif image.imd
+       * Convert pure LIF file into an ImageDisk image
+     * lif td0inspect image.td0 [query]
+       * Decode a TeleDisk image once and answer queries from stdin
+       * Queries: info, tracks, track, sector, crc, interleave, format
+     * lif td0test [count] [seed] [megabytes]
+       * Fuzz the TeleDisk RLE expander against the original version
+       * Check the LZSS tree rebuild and benchmark LZSS decoding
+     * lif bench image.td0|image.lif [loops]
+       * Report MB/s for each TeleDisk or LIF parse stage
        * Uses code from external HxCFloppyEmulator library to decode TELEDISK format
-       * The HxCFloppyEmulator library is Copyright (C) 2006-2014 Jean-Fran▒ois DEL NERO
+       * The HxCFloppyEmulator library is Copyright (C) 2006-2014 Jean-Franâois DEL NERO
        * See: https://github.com/jfdelnero/libhxcfe/tree/master/sources/loaders/teledisk_loader
     
 */
@@ -95,6 +107,12 @@
 #include "../gpib/drives_sup.h"
 #include "../gpib/drives_sup.c"
 extern MEMSPACE int td02lif(int argc, char *srgv[]);
+extern MEMSPACE int lif2td0(int argc, char *srgv[]);
+extern MEMSPACE int lif2imd(int argc, char *srgv[]);
+extern MEMSPACE void lif2td0_help(int full);
+extern MEMSPACE int td0_tests(int argc, char *argv[]);
+extern MEMSPACE int td0_inspect(int argc, char *argv[]);
+extern MEMSPACE int lif_bench(int argc, char *argv[]);
 
 #else 
 #include "user_config.h"
@@ -130,6 +148,11 @@ void lif_help(int full)
         "lif rename lifimage oldlifname newlifname\n"
 #ifdef LIF_STAND_ALONE
         "lif td02lif [options] image.td0 image.lif\n"
+        "lif lif2td0 [options] image.lif image.td0\n"
+        "lif lif2imd [options] image.lif image.imd\n"
+        "lif td0inspect image.td0 [query]\n"
+        "lif td0test [count] [seed] [megabytes]\n"
+        "lif bench image.td0|image.lif [loops]\n"
 #endif
         "Use -d after first keyword 'lif' above for LIF filesystem debugging\n"
         "\n"
@@ -172,6 +195,7 @@ int lif_tests(int argc, char *argv[])
         lif_help(1);
 #ifdef TELEDISK
         td0_help(1);
+        lif2td0_help(1);
 #endif
         return(1);
     }
@@ -263,6 +287,63 @@ int lif_tests(int argc, char *argv[])
         td02lif(argc,argv);
         return(1);
     }
+    if (MATCHARGS(ptr,"lif2td0", (ind + 0) ,argc))
+    {
+        int i;
+        // shift the arguments down by 1
+        for(i=1;i<argc;++i)
+        {
+            argv[i-1] = argv[i];
+        }
+        argv[argc--] = NULL;
+
+        lif2td0(argc,argv);
+        return(1);
+    }
+    if (MATCHARGS(ptr,"lif2imd", (ind + 0) ,argc))
+    {
+        int i;
+        // shift the arguments down by 1
+        for(i=1;i<argc;++i)
+        {
+            argv[i-1] = argv[i];
+        }
+        argv[argc--] = NULL;
+
+        lif2imd(argc,argv);
+        return(1);
+    }
+    if (MATCHARGS(ptr,"td0inspect", (ind + 0) ,argc))
+    {
+        int i;
+        // shift the arguments down by 1
+        for(i=1;i<argc;++i)
+        {
+            argv[i-1] = argv[i];
+        }
+        argv[argc--] = NULL;
+
+        td0_inspect(argc,argv);
+        return(1);
+    }
+    if (MATCHARGS(ptr,"bench", (ind + 0) ,argc))
+    {
+        int i;
+        // shift the arguments down by 1
+        for(i=1;i<argc;++i)
+        {
+            argv[i-1] = argv[i];
+        }
+        argv[argc--] = NULL;
+
+        lif_bench(argc,argv);
+        return(1);
+    }
+    if (MATCHARGS(ptr,"td0test", (ind + 0) ,argc))
+    {
+        td0_tests(argc-ind,argv+ind);
+        return(1);
+    }
 #endif
     return(0);
 }
@@ -59,6 +59,9 @@ disk_t disk;
 /// @brief Teledisk liftel analysis and user overrides
 liftel_t liftel;
 
+/// @brief Empty comment used when the image has no comment block
+static uint8_t td0_nocomment[1];
+
 
 /// @brief Extract TeleDisk image header data in architecture nutral way
 /// @param[in] B: source data
@@ -204,12 +207,54 @@ int td0_read(void *p, int osize, int size, FILE *fp)
     return(1);
 }
 
+/// @brief Fill memory with copies of a pattern
+/// Single byte patterns are a memset, otherwise the filled area is
+/// doubled with memcpy so each copy is wider than the last
+/// @param[out] dst: destination
+/// @param[in] pattern: pattern data
+/// @param[in] size: pattern size
+/// @param[in] count: number of copies
+/// @return bytes written
+int td0_fill(uint8_t *dst, uint8_t *pattern, int size, int count)
+{
+    int i;
+    int total, done;
+
+    total = size * count;
+    if(total <= 0)
+        return(0);
+
+    for(i=1;i<size;++i)
+    {
+        if(pattern[i] != pattern[0])
+            break;
+    }
+    if(i >= size)
+    {
+        memset(dst, pattern[0], total);
+        return(total);
+    }
+
+    memcpy(dst, pattern, size);
+    done = size;
+    while(done <= total - done)
+    {
+        memcpy(dst + done, dst, done);
+        done <<= 1;
+    }
+    if(done < total)
+        memcpy(dst + done, dst, total - done);
+    return(total);
+}
+
 /// @brief Expand a Run Length encoded TeleDisk sector
 /// Notes: the source length is encoded in the source data
 /// Credits based on work (C) 2006-2014 Jean-Franois DEL NERO
 ///    Part of the HxCFloppyEmulator library GNU GPL version 2 or later
 /// Rewitten for clarity,to enforce size limits, provide error reporting
 /// and to avoid word order dependent assumptions,
+/// Repeated patterns are expanded in bulk with td0_fill()
+/// The max limit is checked once per block instead of once per copy
 /// @param[out] dst: destination expanded data
 /// @param[in] src: source data
 /// @param[in] max: maximum size of destination data
@@ -224,6 +269,7 @@ int td0_rle(uint8_t *dst, uint8_t *src, int max)
     int error = 0;
     uint8_t size;
     uint8_t repeat;
+    int count;
 
     result = 0;       // expanded size
 
@@ -237,7 +283,13 @@ int td0_rle(uint8_t *dst, uint8_t *src, int max)
     {
         case 0:
 
-            if(len > max)
+            if(len < 0)
+            {
+                printf("td0_rle: type 0 len:%d < 0\n", len);
+                result = 0;
+                error = 1;
+            }
+            else if(len > max)
             {
                 printf("td0_rle: type 0 len:%d > max:%d\n", len, max);
                 memcpy(dst,src,max);
@@ -261,13 +313,8 @@ int td0_rle(uint8_t *dst, uint8_t *src, int max)
                 error = 1;
                 len = max;
             }
-            while (len >= 2)
-            {
-                *dst++ = src[2];
-                *dst++ = src[3];
-                result += 2;
-                len -= 2;
-            }
+            // Whole 2 byte patterns only
+            result = td0_fill(dst, src+2, 2, len >> 1);
             break;
         case 2:
             result = 0;
@@ -296,8 +343,8 @@ int td0_rle(uint8_t *dst, uint8_t *src, int max)
                 }
                 else
                 {
-                    ///@brief block size
-                    size = (1 << src[0]);
+                    ///@brief block size, anything over 128 does not fit a uint8_t
+                    size = (src[0] < 8) ? (1 << src[0]) : 0;
 
                     ///@brief repeat count
                     repeat = src[1];
@@ -305,23 +352,20 @@ int td0_rle(uint8_t *dst, uint8_t *src, int max)
                     src += 2;
                     len -= 2;
 
-                    while(repeat--)
+                    ///@brief copies that fit
+                    count = repeat;
+                    if(size && (result + size * count) > max)
                     {
-
-                        if((result+size) > max)
-                        {
-                            printf("td0_rle: type 1 len:%d > max:%d\n", 
-                                result+size, max);
-                            error = 1;
-                            break;
-                        }
-
-                        memcpy(dst, src, size);
-
-                        result += size;
-                        dst += size;
+                        count = (max - result) / size;
+                        printf("td0_rle: type 1 len:%d > max:%d\n", 
+                            result + size * count + size, max);
+                        error = 1;
                     }
 
+                    count = td0_fill(dst, src, size, count);
+                    result += count;
+                    dst += count;
+
                     src += size;
                     len -= size;
                 }
@@ -368,7 +412,7 @@ void td0_sectorinfo(td_sector_t *P)
         (int) P->Cyl,
         (int) P->Side,
         (int) P->Sector,
-        (int) 128 << P->SizeExp);
+        (int) TD_SECTOR_BYTES(P->SizeExp));
 }
 
 /// @brief Convert Denisity to bitrate
@@ -409,6 +453,25 @@ long td0_density2bitrate(uint8_t density)
 /// disk->comment has optional comment string or empty string
 ///    If disk.td_comment.Size > 0
 int td0_open(disk_t *disk, char *name)
+{
+    // TeleDisk Image name
+    disk->td0_name = lif_stralloc(name);
+
+    disk->fi = fopen(disk->td0_name,"rb");
+    if(!disk->fi)
+    {
+        printf("Error: Can't open TeleDisk file: %s\n",disk->td0_name);
+        return(0);
+	}
+    return( td0_read_header(disk) );
+}
+
+/// @brief Process TeleDisk image header and optional comment block
+/// @param[in] *disk: TeleDisk information structure
+/// @return 1 on success 0 on error
+/// Note: disk->fi must be open at the start of the image
+///   disk->td0_name is only used for messages
+int td0_read_header(disk_t *disk)
 {
     uint16_t crc;
     tm_t tm;
@@ -423,19 +486,9 @@ int td0_open(disk_t *disk, char *name)
     memset((td_comment_t *) &disk->td_comment,0,sizeof(disk->td_comment));
 
     // Default is NO comment
-    disk->comment = "";
+    disk->comment = td0_nocomment;
     disk->compressed = 0;
 
-    // TeleDisk Image name
-    disk->td0_name = lif_stralloc(name);
-
-    disk->fi = fopen(disk->td0_name,"rb");
-    if(!disk->fi)
-    {
-        printf("Error: Can't open TeleDisk file: %s\n",disk->td0_name);
-        return(0);
-	}
-
     ///@process TeleDisk disk image header
     if( fread( headerbuf, 1, TD_HEADER_SIZE, disk->fi ) != TD_HEADER_SIZE)
     {
@@ -560,7 +613,7 @@ int td0_read_disk(disk_t *disk)
     uint8_t trackbuf[TD_TRACK_SIZE];
     uint8_t sectorbuf[TD_SECTOR_SIZE];
 
-	uint8_t buffer[8*1024];
+	uint8_t buffer[TD_BLOCK_SIZE];
 
 
     // ==============================================================
@@ -605,6 +658,7 @@ int td0_read_disk(disk_t *disk)
 
         disk->track[t].Cyl = td_track.PCyl;
         disk->track[t].Side = td_track.PSide;
+        disk->track[t].PSectors = 0;
 
 
         // ====================================================
@@ -633,6 +687,9 @@ int td0_read_disk(disk_t *disk)
 
             td0_unpack_sector_header(sectorbuf, (td_sector_t *)&td_sector);
 
+            // Physical sector order including duplicates
+            disk->track[t].order[s] = td_sector.Sector;
+            disk->track[t].PSectors = s + 1;
 
             //FIXME add flag override for this test
             if(td_track.PCyl != td_sector.Cyl )
@@ -683,7 +740,10 @@ int td0_read_disk(disk_t *disk)
 
 			disk->track[t].sectors[index].cylinder = td_sector.Cyl;
 			disk->track[t].sectors[index].side = td_sector.Side;
-			disk->track[t].sectors[index].size = 128<<td_sector.SizeExp;
+			disk->track[t].sectors[index].size = TD_SECTOR_BYTES(td_sector.SizeExp);
+			disk->track[t].sectors[index].flags = td_sector.Flags;
+			disk->track[t].sectors[index].crc = -1;
+			disk->track[t].sectors[index].order = s;
 			disk->track[t].sectors[index].data = 
             calloc(disk->track[t].sectors[index].size,1);
 
@@ -714,7 +774,6 @@ int td0_read_disk(disk_t *disk)
                 uint16_t crc;
 
                 ///@brief Compute how much data to read
-                memset(buffer,0,sizeof(buffer));
                 // Read Sector Data
                 if( !td0_read(buffer,1, sizeof(uint16_t),disk->fi) )
                 {
@@ -725,6 +784,17 @@ int td0_read_disk(disk_t *disk)
                 }
                 len = B2V_LSB(buffer,0,2);
 
+                ///@brief largest sector is 16K plus the encoding type
+                /// td0_rle may read a block header past the end so we keep
+                /// TD_BLOCK_PAD zero bytes after the data
+                if(len > (int) sizeof(buffer) - 2 - TD_BLOCK_PAD)
+                {
+                    printf("Error: sector data block size:%d too large\n", len);
+                    printf("\t");
+                    td0_trackinfo(disk,t,index);
+                    return(0);
+                }
+
                 if( !td0_read(buffer+2,1, len,disk->fi) )
                 {
                     printf("Error: reading sector data\n");
@@ -732,6 +802,7 @@ int td0_read_disk(disk_t *disk)
                     td0_trackinfo(disk, t,index);
                     return (0);
                 }
+                memset(buffer+2+len,0,TD_BLOCK_PAD);
 
                 ///@brief td0_rle does not use len
                 /// internal data in the buffer does this
@@ -750,6 +821,7 @@ int td0_read_disk(disk_t *disk)
 
                 crc = crc16(disk->track[t].sectors[index].data,0,0xA097,result);
                 crc &= 0xff;
+                disk->track[t].sectors[index].crc = (td_sector.CRC == crc);
                 if(td_sector.CRC != crc)
                 {
                     printf("Warning: Sector CRC16:%04Xh != %04Xh\n", 
@@ -773,6 +845,7 @@ int td0_read_disk(disk_t *disk)
 
 	}   // for(t = 0; t < MAXTRACKS; ++t)
 
+    disk->tracks = t;
 	return (1);
 }
 
@@ -1128,6 +1201,9 @@ printf("liftel.Size:%d\n", liftel.Size);
                 disk->track[t].sectors[s].side = disk->track[t].sectors[j].side;
                 disk->track[t].sectors[s].sector = s;
                 disk->track[t].sectors[s].size = disk->track[t].sectors[j].size;
+                disk->track[t].sectors[s].flags = disk->track[t].sectors[j].flags;
+                disk->track[t].sectors[s].crc = disk->track[t].sectors[j].crc;
+                disk->track[t].sectors[s].order = disk->track[t].sectors[j].order;
                 disk->track[t].sectors[s].data = disk->track[t].sectors[j].data;
 
                 // Delete the REMAP sector so it will not get reused !!
@@ -1539,6 +1615,7 @@ void td0_init_sectors(disk_t *disk)
     disk->td0_name = NULL;
     disk->compressed = 0;
     disk->t = 0;
+    disk->tracks = 0;
 
     memset((td_header_t *) & disk->td_header, 0, sizeof(td_header_t));
     memset((td_comment_t *) & disk->td_comment,0,sizeof(td_comment_t));
@@ -1553,16 +1630,52 @@ void td0_init_sectors(disk_t *disk)
             disk->track[t].Sectors = 0;
             disk->track[t].First = MAXSECTORS-1;
             disk->track[t].Last = 0;
+            disk->track[t].PSectors = 0;
+            disk->track[t].order[s] = 0;
 
             disk->track[t].sectors[s].cylinder = 0;
             disk->track[t].sectors[s].side = 0;
             disk->track[t].sectors[s].sector = -1;
             disk->track[t].sectors[s].size = 0;
+            disk->track[t].sectors[s].flags = 0;
+            disk->track[t].sectors[s].crc = -1;
+            disk->track[t].sectors[s].order = -1;
             disk->track[t].sectors[s].data = NULL;
         }
     }
 }
 
+/// @brief Free the optional comment string
+/// @param[in] disk: TeleDisk information structure
+/// @return void
+void td0_free_comment(disk_t *disk)
+{
+    if(disk->comment && disk->comment != td0_nocomment)
+        free(disk->comment);
+    disk->comment = td0_nocomment;
+}
+
+/// @brief Free track sector data
+/// Sectors are marked as unused afterwards
+/// @param[in] disk: TeleDisk information structure
+/// @return void
+void td0_free_sectors(disk_t *disk)
+{
+    int t,s;
+
+    for(t = 0; t<MAXTRACKS; ++t)
+    {
+        for(s=0;s<MAXSECTORS;++s)
+        {
+            if(disk->track[t].sectors[s].data != NULL)
+                free(disk->track[t].sectors[s].data);
+            disk->track[t].sectors[s].data = NULL;
+            disk->track[t].sectors[s].sector = -1;
+            disk->track[t].sectors[s].size = 0;
+        }
+    }
+}
+
 
 
 /// @brief Convert a Teledisk LIF formatted disk image into a pure LIF image
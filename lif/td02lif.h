@@ -52,6 +52,13 @@
 ///@brief Size of TeleDisk sector header size
 #define TD_SECTOR_SIZE  6
 
+///@brief Sector size in bytes from td_sector_t SizeExp, 0 if not supported
+#define TD_SECTOR_BYTES(exp) ( ((exp) & 0xf8) ? 0 : (128 << (exp)) )
+
+///@brief Largest sector data block, 16K sector + length + type + padding
+#define TD_BLOCK_PAD    512
+#define TD_BLOCK_SIZE   (16*1024 + 3 + TD_BLOCK_PAD)
+
 ///@brief Maximum number of sectors per track
 ///Used for sector data and sorting tables
 #define MAXSECTORS 255
@@ -200,6 +207,9 @@ typedef struct {
     int side;               // Sector ID Side
     int sector;             // Sector ID Sector Number 
     int size;               // Sector ID Sector Size  converted to Bytes
+    int flags;              // TeleDisk sector header flags
+    int crc;                // Sector data CRC 1 = good, 0 = bad, -1 = not checked
+    int order;              // Physical position of the sector on the track
     uint8_t *data;          // Sector Data
 } sector_t;
 
@@ -210,6 +220,8 @@ typedef struct {
     int First;
     int Last;
     int Size; // Size of first sector
+    int PSectors;   // TeleDisk Track Header count of Sectors including duplicates
+    uint8_t order[MAXSECTORS];      // Sector ID numbers in physical order
     sector_t sectors[MAXSECTORS];   // Disk Sectors
 } track_t;
 
@@ -222,6 +234,7 @@ typedef struct {
     td_header_t     td_header;          // TeleDisk Header
     td_comment_t    td_comment;         // Comment Header
     uint8_t         *comment;           // Optional comment string if td_comment.Size != 0
+    int             tracks;             // Number of TeleDisk tracks read
     track_t         track[MAXTRACKS];   // Track and Sector Data
 } disk_t;
 
@@ -302,11 +315,13 @@ int td0_unpack_track_header ( uint8_t *B , td_track_t *p );
 int td0_unpack_sector_header ( uint8_t *B , td_sector_t *p );
 void td0_compressed ( int flag );
 int td0_read ( void *p , int osize , int size , FILE *fp );
+int td0_fill ( uint8_t *dst , uint8_t *pattern , int size , int count );
 int td0_rle ( uint8_t *dst , uint8_t *src , int max );
 void td0_trackinfo ( disk_t *disk , int trackind , int index );
 void td0_sectorinfo ( td_sector_t *P );
 long td0_density2bitrate ( uint8_t density );
 int td0_open ( disk_t *disk , char *name );
+int td0_read_header ( disk_t *disk );
 int td0_read_disk ( disk_t *disk );
 int td0_analize_format ( disk_t *disk );
 int td0_save_lif ( disk_t *disk , lif_t *LIF );
@@ -314,6 +329,8 @@ int td0_save_lif_sector ( disk_t *disk , uint8_t *data , int size , lif_t *LIF )
 void td0_help ( int full );
 void td0_init_liftel ( void );
 void td0_init_sectors ( disk_t *disk );
+void td0_free_comment ( disk_t *disk );
+void td0_free_sectors ( disk_t *disk );
 int td02lif ( int argc , char *argv []);
 
 
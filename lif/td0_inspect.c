@@ -0,0 +1,468 @@
+/**
+  @file   td0_inspect.c
+  @brief  TeleDisk image inspection
+  @par Copyright &copy; 2014-2020 Mike Gore, Inc. All rights reserved. GPL
+  @see http://github.com/magore/hp85disk
+  @see http://github.com/magore/hp85disk/COPYRIGHT.md for Copyright details
+
+  @help
+   * LIF command help
+     * lif td0inspect image.td0 [command]
+       * Decode a TeleDisk image once and answer queries about it
+       * Without a command queries are read from stdin, one per line
+
+  @par Edit History
+  - [1.0]   [Mike Gore]  Initial revision of file.
+
+  @Notes
+   * The image is decoded a single time with td0_read_disk() into the
+     track/sector table of a disk_t, every query works from that table
+   * td0_analize_format() deletes and remaps sectors so the format query
+     runs it on a copy of the table
+*/
+
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include <inttypes.h>
+
+#include <time.h>
+#include "lifsup.h"
+#include "lifutils.h"
+#include "td02lif.h"
+#include "lif2td0.h"
+#include "td0_inspect.h"
+
+extern disk_t disk;
+extern liftel_t liftel;
+
+
+/// @brief Decode a TeleDisk image into the track/sector table
+/// @param[out] disk: TeleDisk information structure
+/// @param[in] name: TeleDisk image name
+/// @return 1 on success 0 on error
+int td0_inspect_load(disk_t *disk, char *name)
+{
+    int t,s;
+    long sectors = 0;
+    double seconds;
+    struct timespec start;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    td0_init_liftel();
+    td0_init_sectors(disk);
+
+    if( !td0_open(disk, name) || !td0_read_disk(disk) )
+    {
+        if(disk->fi)
+            fclose(disk->fi);
+        disk->fi = NULL;
+        return(0);
+    }
+    fclose(disk->fi);
+    disk->fi = NULL;
+
+    for(t=0;t<disk->tracks;++t)
+    {
+        for(s=0;s<MAXSECTORS;++s)
+        {
+            if(disk->track[t].sectors[s].sector != -1)
+                ++sectors;
+        }
+    }
+
+    seconds = td0_elapsed(&start);
+    printf("Decoded %d tracks, %ld sectors in %.3f seconds\n",
+        disk->tracks, sectors, seconds);
+    return(1);
+}
+
+/// @brief Find a track by its TeleDisk track header cylinder and side
+/// @param[in] disk: TeleDisk information structure
+/// @param[in] cyl: cylinder
+/// @param[in] side: side
+/// @return track index or -1 if not found
+int td0_inspect_find(disk_t *disk, int cyl, int side)
+{
+    int t;
+
+    for(t=0;t<disk->tracks;++t)
+    {
+        if(disk->track[t].Cyl == cyl && disk->track[t].Side == side)
+            return(t);
+    }
+    printf("Error: cylinder:%d side:%d not found\n", cyl, side);
+    return(-1);
+}
+
+/// @brief Sector data CRC status as a string
+/// @param[in] crc: sector_t crc value
+/// @return "ok", "BAD" or "--"
+char *td0_inspect_crcstr(int crc)
+{
+    if(crc == 1)
+        return("ok");
+    if(crc == 0)
+        return("BAD");
+    return("--");
+}
+
+/// @brief Compute the sector interleave of a track from its physical order
+/// The interleave is the most common physical distance between
+/// sectors with consecutive ID numbers
+/// @param[in] disk: TeleDisk information structure
+/// @param[in] t: track index
+/// @return interleave, 1 = none, 0 if unknown
+int td0_interleave(disk_t *disk, int t)
+{
+    int i, id, next, d;
+    int n = disk->track[t].PSectors;
+    int best = 0;
+    int count[MAXSECTORS];
+    int pos[MAXSECTORS];
+
+    if(n < 2)
+        return(0);
+
+    for(i=0;i<MAXSECTORS;++i)
+    {
+        pos[i] = -1;
+        count[i] = 0;
+    }
+
+    for(i=0;i<n;++i)
+    {
+        id = disk->track[t].order[i];
+        if(pos[id] == -1)
+            pos[id] = i;
+    }
+
+    for(id=0;id<MAXSECTORS;++id)
+    {
+        if(pos[id] == -1)
+            continue;
+        for(next=id+1;next<MAXSECTORS;++next)
+        {
+            if(pos[next] != -1)
+                break;
+        }
+        if(next >= MAXSECTORS)
+            break;
+        d = (pos[next] - pos[id] + n) % n;
+        ++count[d];
+    }
+
+    for(d=1;d<n;++d)
+    {
+        if(count[d] > count[best])
+            best = d;
+    }
+    return(best);
+}
+
+/// @brief Display TeleDisk header and comment
+/// @param[in] disk: TeleDisk information structure
+/// @return void
+void td0_inspect_info(disk_t *disk)
+{
+    printf("TeleDisk file:         %s\n",disk->td0_name);
+    printf("\tVersion:       %02d\n",disk->td_header.TDVersion);
+    printf("\t%s\n", disk->compressed ? "Advanced Compression" : "Not Compressed");
+    printf("\tDensity:       %02Xh, %ld bps\n",disk->td_header.Density,
+        td0_density2bitrate(disk->td_header.Density));
+    printf("\tDriveType:     %02Xh\n",disk->td_header.DriveType);
+    printf("\tTrackDensity:  %02Xh\n",disk->td_header.TrackDensity & 0x7f);
+    printf("\tDosMode:       %02Xh\n",disk->td_header.DosMode);
+    printf("\tSides:         %02d\n",disk->td_header.Sides);
+    printf("\tTracks:        %02d\n",disk->tracks);
+    if(disk->td_comment.Size)
+    {
+        printf("\tComment Size:  %d\n", disk->td_comment.Size);
+        printf("%s\n", disk->comment);
+    }
+}
+
+/// @brief List all tracks
+/// @param[in] disk: TeleDisk information structure
+/// @return void
+void td0_inspect_tracks(disk_t *disk)
+{
+    int t,s;
+    int sectors, bad, first, last;
+
+    printf("Track Cyl Side Sectors First Last Interleave CRC errors\n");
+    for(t=0;t<disk->tracks;++t)
+    {
+        sectors = 0;
+        bad = 0;
+        first = -1;
+        last = -1;
+        for(s=0;s<MAXSECTORS;++s)
+        {
+            if(disk->track[t].sectors[s].sector == -1)
+                continue;
+            if(first == -1)
+                first = s;
+            last = s;
+            ++sectors;
+            if(disk->track[t].sectors[s].crc == 0)
+                ++bad;
+        }
+        printf("%5d %3d %4d %7d %5d %4d %10d %d\n",
+            t, disk->track[t].Cyl, disk->track[t].Side,
+            sectors, first, last, td0_interleave(disk,t), bad);
+    }
+}
+
+/// @brief List sectors of a track in physical order
+/// @param[in] disk: TeleDisk information structure
+/// @param[in] t: track index
+/// @return void
+void td0_inspect_track(disk_t *disk, int t)
+{
+    int i, id;
+    sector_t *S;
+
+    printf("Track: %d, Cyl: %02d, Side: %02d, Sectors: %02d, Interleave: %d\n",
+        t, disk->track[t].Cyl, disk->track[t].Side,
+        disk->track[t].PSectors, td0_interleave(disk,t));
+    printf("Position Sector Size Flags CRC\n");
+    for(i=0;i<disk->track[t].PSectors;++i)
+    {
+        id = disk->track[t].order[i];
+        S = &disk->track[t].sectors[id];
+        // Duplicate sectors are not stored
+        if(S->sector == -1 || S->order != i)
+        {
+            printf("%8d %6d   duplicate\n", i, id);
+            continue;
+        }
+        printf("%8d %6d %4d   %02Xh %s\n",
+            i, id, S->size, S->flags, td0_inspect_crcstr(S->crc));
+    }
+}
+
+/// @brief Display sector ID and data
+/// @param[in] disk: TeleDisk information structure
+/// @param[in] t: track index
+/// @param[in] id: sector ID number
+/// @return 1 on success 0 on error
+int td0_inspect_sector(disk_t *disk, int t, int id)
+{
+    sector_t *S;
+
+    if(id < 0 || id >= MAXSECTORS || disk->track[t].sectors[id].sector == -1)
+    {
+        printf("Error: sector:%d not found\n", id);
+        return(0);
+    }
+    S = &disk->track[t].sectors[id];
+    printf("Sector ID: Cyl: %02d, Side: %02d, Sector: %02d, Size: %d\n",
+        S->cylinder, S->side, S->sector, S->size);
+    printf("Position: %d, Flags: %02Xh, CRC: %s\n",
+        S->order, S->flags, td0_inspect_crcstr(S->crc));
+    if(S->data)
+        hexdump(S->data, S->size);
+    else
+        printf("No sector data\n");
+    return(1);
+}
+
+/// @brief List all sectors with a bad data CRC
+/// @param[in] disk: TeleDisk information structure
+/// @return number of bad sectors
+int td0_inspect_crc(disk_t *disk)
+{
+    int t,s;
+    int bad = 0;
+    long checked = 0;
+
+    for(t=0;t<disk->tracks;++t)
+    {
+        for(s=0;s<MAXSECTORS;++s)
+        {
+            if(disk->track[t].sectors[s].sector == -1)
+                continue;
+            if(disk->track[t].sectors[s].crc != -1)
+                ++checked;
+            if(disk->track[t].sectors[s].crc != 0)
+                continue;
+            printf("CRC error: track:%d, ", t);
+            td0_trackinfo(disk,t,s);
+            ++bad;
+        }
+    }
+    printf("%ld sectors checked, %d CRC errors\n", checked, bad);
+    return(bad);
+}
+
+/// @brief Run td0_analize_format() on a copy of the track/sector table
+/// @param[in] disk: TeleDisk information structure
+/// @return 1 on success 0 on error
+int td0_inspect_format(disk_t *disk)
+{
+    int t,s;
+    int ret;
+    uint8_t *data;
+    disk_t *copy;
+
+    copy = calloc(sizeof(disk_t),1);
+    if(!copy)
+    {
+        printf("Can't allocate TeleDisk table copy\n");
+        return(0);
+    }
+    memcpy(copy, disk, sizeof(disk_t));
+
+    for(t=0;t<MAXTRACKS;++t)
+    {
+        for(s=0;s<MAXSECTORS;++s)
+        {
+            if(!disk->track[t].sectors[s].data)
+                continue;
+            data = malloc(disk->track[t].sectors[s].size);
+            if(data)
+                memcpy(data, disk->track[t].sectors[s].data, disk->track[t].sectors[s].size);
+            copy->track[t].sectors[s].data = data;
+        }
+    }
+
+    td0_init_liftel();
+    ret = td0_analize_format(copy);
+
+    td0_free_sectors(copy);
+    free(copy);
+    return(ret);
+}
+
+/// @brief td0inspect query help
+/// @return void
+void td0_inspect_help()
+{
+    printf(
+        "td0inspect queries\n"
+        "    info                  TeleDisk header and comment\n"
+        "    tracks                list tracks, sector counts, interleave and CRC errors\n"
+        "    track cyl side        list sectors in physical order\n"
+        "    sector cyl side id    sector ID, CRC status and data dump\n"
+        "    crc                   list sectors with bad data CRC\n"
+        "    interleave [cyl side] sector interleave\n"
+        "    format                td0_analize_format results\n"
+        "    quit\n"
+    );
+}
+
+/// @brief Run one td0inspect query
+/// @param[in] disk: TeleDisk information structure
+/// @param[in] argc: argument count
+/// @param[in] argv: query and arguments
+/// @return 0 to quit, 1 to continue
+int td0_inspect_command(disk_t *disk, int argc, char *argv[])
+{
+    int t;
+    char *ptr;
+
+    if(argc < 1 || !argv[0] || !*argv[0])
+        return(1);
+
+    ptr = argv[0];
+
+    if(MATCHI(ptr,"quit") || MATCHI(ptr,"exit") || MATCHI(ptr,"q"))
+        return(0);
+
+    if(MATCHI(ptr,"help") || MATCHI(ptr,"?"))
+        td0_inspect_help();
+    else if(MATCHI(ptr,"info"))
+        td0_inspect_info(disk);
+    else if(MATCHI(ptr,"tracks"))
+        td0_inspect_tracks(disk);
+    else if(MATCHARGS(ptr,"track",3,argc))
+    {
+        t = td0_inspect_find(disk, atoi(argv[1]), atoi(argv[2]));
+        if(t >= 0)
+            td0_inspect_track(disk, t);
+    }
+    else if(MATCHARGS(ptr,"sector",4,argc))
+    {
+        t = td0_inspect_find(disk, atoi(argv[1]), atoi(argv[2]));
+        if(t >= 0)
+            td0_inspect_sector(disk, t, atoi(argv[3]));
+    }
+    else if(MATCHI(ptr,"crc"))
+        td0_inspect_crc(disk);
+    else if(MATCHI(ptr,"interleave"))
+    {
+        if(argc >= 3)
+        {
+            t = td0_inspect_find(disk, atoi(argv[1]), atoi(argv[2]));
+            if(t >= 0)
+                printf("Interleave: %d\n", td0_interleave(disk,t));
+        }
+        else
+        {
+            for(t=0;t<disk->tracks;++t)
+                printf("Cyl: %02d, Side: %02d, Interleave: %d\n",
+                    disk->track[t].Cyl, disk->track[t].Side, td0_interleave(disk,t));
+        }
+    }
+    else if(MATCHI(ptr,"format"))
+        td0_inspect_format(disk);
+    else if(!MATCHI(ptr,"track") && !MATCHI(ptr,"sector"))
+        printf("Unknown query: %s, try help\n", ptr);
+
+    return(1);
+}
+
+/// @brief Decode a TeleDisk image once and answer queries about it
+/// Queries come from the command line or one per line from stdin
+/// @param[in] argc: argument count
+/// @param[in] argv: td0inspect image.td0 [query]
+/// @return 1 on success 0 on error
+int td0_inspect(int argc, char *argv[])
+{
+    int count;
+    int prompt;
+    char line[256];
+    char *args[16];
+
+    if(argc < 2 || !argv[1])
+    {
+        printf("Usage: lif td0inspect image.td0 [query]\n");
+        td0_inspect_help();
+        return(0);
+    }
+
+    if( !td0_inspect_load(&disk, argv[1]) )
+    {
+        td0_free_sectors(&disk);
+        return(0);
+    }
+
+    if(argc > 2)
+    {
+        td0_inspect_command(&disk, argc-2, argv+2);
+        td0_free_sectors(&disk);
+        return(1);
+    }
+
+    prompt = isatty(0);
+    while(1)
+    {
+        if(prompt)
+        {
+            printf("td0> ");
+            fflush(stdout);
+        }
+        if(fgets(line, sizeof(line), stdin) == NULL)
+            break;
+        count = split_args(line, args, 16);
+        if(!td0_inspect_command(&disk, count, args))
+            break;
+    }
+
+    td0_free_sectors(&disk);
+    return(1);
+}
@@ -0,0 +1,30 @@
+/**
+  @file   td0_inspect.h
+  @brief  TeleDisk image inspection
+  @par Copyright &copy; 2014-2020 Mike Gore, Inc. All rights reserved. GPL
+  @see http://github.com/magore/hp85disk
+  @see http://github.com/magore/hp85disk/COPYRIGHT.md for Copyright details
+
+  @par Edit History
+  - [1.0]   [Mike Gore]  Initial revision of file.
+*/
+
+#ifndef _TD0_INSPECT_H_
+#define _TD0_INSPECT_H_
+
+/* td0_inspect.c */
+int td0_inspect_load ( disk_t *disk , char *name );
+int td0_inspect_find ( disk_t *disk , int cyl , int side );
+char *td0_inspect_crcstr ( int crc );
+int td0_interleave ( disk_t *disk , int t );
+void td0_inspect_info ( disk_t *disk );
+void td0_inspect_tracks ( disk_t *disk );
+void td0_inspect_track ( disk_t *disk , int t );
+int td0_inspect_sector ( disk_t *disk , int t , int id );
+int td0_inspect_crc ( disk_t *disk );
+int td0_inspect_format ( disk_t *disk );
+void td0_inspect_help ( void );
+int td0_inspect_command ( disk_t *disk , int argc , char *argv []);
+int td0_inspect ( int argc , char *argv []);
+
+#endif
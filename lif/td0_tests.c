@@ -0,0 +1,578 @@
+/**
+  @file   td0_tests.c
+  @brief  TeleDisk decoder tests
+  @par Copyright &copy; 2014-2020 Mike Gore, Inc. All rights reserved. GPL
+  @see http://github.com/magore/hp85disk
+  @see http://github.com/magore/hp85disk/COPYRIGHT.md for Copyright details
+
+  @help
+   * LIF command help
+     * lif td0test [count] [seed] [megabytes]
+       * Fuzz td0_rle against the original byte at a time expander
+       * Compare the LZSS tree rebuild against the original version
+       * LZSS decode speed on a synthetic advanced compression image
+
+  @par Edit History
+  - [1.0]   [Mike Gore]  Initial revision of file.
+
+  @Notes
+   * td0_rle_ref is the original td0_rle kept verbatim as the reference
+   * lzss_rebuild_ref is the original insertion sort tree rebuild
+   * Both decoders get the same source and the same pre filled destination
+     so any difference in result, expanded data or over run is reported
+*/
+
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+#include <inttypes.h>
+
+#include <time.h>
+#include "lifsup.h"
+#include "lifutils.h"
+#include "td02lif.h"
+#include "lif2td0.h"
+#include "td0_tests.h"
+
+/// @brief Dave Dunfiled LZSS expander and matching encoder
+#include "td0_lzss.h"
+
+extern unsigned short parent[], son[], freq[];
+
+///@brief guard bytes after max to catch over runs
+#define TD0_TEST_GUARD  64
+
+///@brief keeps the benchmark loops from being optimized away
+volatile int td0_rle_sink;
+
+/// @brief Reference Run Length expander - the original td0_rle
+/// Notes: the source length is encoded in the source data
+/// Credits based on work (C) 2006-2014 Jean-Francois DEL NERO
+///    Part of the HxCFloppyEmulator library GNU GPL version 2 or later
+/// Rewitten for clarity,to enforce size limits, provide error reporting
+/// and to avoid word order dependent assumptions,
+/// @param[out] dst: destination expanded data
+/// @param[in] src: source data
+/// @param[in] max: maximum size of destination data
+/// @return size of expanded data, negative if size > max
+int td0_rle_ref(uint8_t *dst, uint8_t *src, int max)
+{
+    int len;  
+    int result;     // expanded result size, -expanded result size
+
+    uint8_t type;   // Encoding type, we support 0,1,2
+  
+    int error = 0;
+    uint8_t size;
+    uint8_t repeat;
+
+    result = 0;       // expanded size
+
+    len  = B2V_LSB(src,0,2) -1;
+    type = B2V_LSB(src,2,1);
+    src += 3;
+
+    // printf("td0_rle: len:%3d, type:%d\n", (int) len, (int)type);
+
+    switch ( type )
+    {
+        case 0:
+
+            if(len > max)
+            {
+                printf("td0_rle: type 0 len:%d > max:%d\n", len, max);
+                memcpy(dst,src,max);
+                result = -max;
+                error = 1;
+            }
+            else
+            {
+                memcpy(dst,src,len);
+                result = len;
+            }
+            break;
+
+        case 1:
+            result = 0;
+            ///@actual length
+            len  = B2V_LSB(src,0,2) << 1;
+            if(len > max)
+            {
+                printf("td0_rle: type 1 len:%d > max:%d\n", len, max);
+                error = 1;
+                len = max;
+            }
+            while (len >= 2)
+            {
+                *dst++ = src[2];
+                *dst++ = src[3];
+                result += 2;
+                len -= 2;
+            }
+            break;
+        case 2:
+            result = 0;
+            do
+            {
+                if( !src[0] )
+                {
+                    size = src[1];
+                    src += 2;
+                    len -= 2;
+
+                    if((result+size) > max)
+                    {
+                        printf("td0_rle: type 1 len:%d > max:%d\n", 
+                            result+size, max);
+                        error = 1;
+                        break;
+                    }
+
+                    memcpy(dst,src,size);
+
+                    result += size;
+                    dst += size;
+                    src += size;
+                    len -= size;
+                }
+                else
+                {
+                    ///@brief block size
+                    /// Shifts of 32 or more are undefined, td0_rle treats
+                    /// them as 0 like the 8..31 shifts that truncate to 0
+                    size = (src[0] < 32) ? (1 << src[0]) : 0;
+
+                    ///@brief repeat count
+                    repeat = src[1];
+
+                    src += 2;
+                    len -= 2;
+
+                    while(repeat--)
+                    {
+
+                        if((result+size) > max)
+                        {
+                            printf("td0_rle: type 1 len:%d > max:%d\n", 
+                                result+size, max);
+                            error = 1;
+                            break;
+                        }
+
+                        memcpy(dst, src, size);
+
+                        result += size;
+                        dst += size;
+                    }
+
+                    src += size;
+                    len -= size;
+                }
+
+            }
+            while(len > 0);
+            if(len)
+            {
+                printf("td0_rle: type 1 len:%d < 0\n", len);
+                error = 1;
+            }
+            break;
+
+        default:
+            printf("td0_rle error unsupported type:%02Xh\n", type);
+            result = -1;
+            break;
+    }
+    if(error)
+        return(-result);
+    return (result);
+}
+
+
+/// @brief Hide or restore stdout while the decoders report errors
+/// @param[in] quiet: 1 hide, 0 restore
+/// @return void
+void td0_test_quiet(int quiet)
+{
+    static int saved = -1;
+    int fd;
+
+    fflush(stdout);
+    if(quiet && saved < 0)
+    {
+        saved = dup(1);
+        fd = open("/dev/null", O_WRONLY);
+        if(fd >= 0)
+        {
+            dup2(fd,1);
+            close(fd);
+        }
+    }
+    else if(!quiet && saved >= 0)
+    {
+        dup2(saved,1);
+        close(saved);
+        saved = -1;
+    }
+}
+
+/// @brief Build a random TeleDisk data block
+/// Type 2 blocks are made from literal and repeat headers with random
+/// sizes so we hit both the normal and the over max cases
+/// @param[out] src: data block, must hold TD0_TEST_SRC bytes
+/// @return void
+void td0_test_block(uint8_t *src)
+{
+    int i;
+    int len;
+    int type;
+    int pos;
+
+    for(i=0;i<TD0_TEST_SRC;++i)
+        src[i] = rand();
+
+    type = rand() % 4;
+    if(type == 3)
+        type = rand() & 0xff;
+
+    switch(rand() % 3)
+    {
+        case 0: len = rand() % 64; break;
+        case 1: len = rand() % 1100; break;
+        default: len = rand() % (TD0_TEST_SRC - 600); break;
+    }
+
+    V2B_LSB(src,0,2,len+1);
+    V2B_LSB(src,2,1,type);
+
+    if(type == 1)
+    {
+        // repeat count in 2 byte words
+        V2B_LSB(src,3,2,rand() % 700);
+        // mostly single byte patterns
+        if(rand() & 1)
+            src[6] = src[5];
+    }
+    else if(type == 2)
+    {
+        pos = 3;
+        while(pos < len + 3)
+        {
+            if(rand() % 3 == 0)
+            {
+                src[pos] = 0;
+                src[pos+1] = rand() % 128;
+                pos += 2 + src[pos+1];
+            }
+            else
+            {
+                // block size is 1 << src[pos], keep the shift defined
+                src[pos] = (rand() % 8) ? 1 + rand() % 4 : rand() % 32;
+                src[pos+1] = rand();
+                if(rand() & 1)
+                    memset(src+pos+2, src[pos+2], 16);
+                pos += 2 + (src[pos] < 8 ? (1 << src[pos]) : 0);
+            }
+        }
+    }
+}
+
+/// @brief Fuzz td0_rle against td0_rle_ref
+/// @param[in] count: number of random blocks
+/// @param[in] seed: random seed
+/// @return number of mismatches
+long td0_rle_fuzz(long count, unsigned int seed)
+{
+    long i;
+    long errors = 0;
+    int max;
+    int ret, ref;
+    uint8_t *src, *dst, *dst_ref;
+
+    src = calloc(TD0_TEST_SRC,1);
+    dst = calloc(TD0_TEST_DST + TD0_TEST_GUARD,1);
+    dst_ref = calloc(TD0_TEST_DST + TD0_TEST_GUARD,1);
+    if(!src || !dst || !dst_ref)
+    {
+        printf("td0_rle_fuzz: out of memory\n");
+        if(src) free(src);
+        if(dst) free(dst);
+        if(dst_ref) free(dst_ref);
+        return(1);
+    }
+
+    srand(seed);
+    for(i=0;i<count;++i)
+    {
+        td0_test_block(src);
+
+        switch(rand() % 4)
+        {
+            case 0: max = 128; break;
+            case 1: max = 256; break;
+            case 2: max = 1024; break;
+            default: max = rand() % TD0_TEST_DST; break;
+        }
+
+        memset(dst, 0xA5, TD0_TEST_DST + TD0_TEST_GUARD);
+        memset(dst_ref, 0xA5, TD0_TEST_DST + TD0_TEST_GUARD);
+
+        td0_test_quiet(1);
+        ref = td0_rle_ref(dst_ref, src, max);
+        ret = td0_rle(dst, src, max);
+        td0_test_quiet(0);
+
+        if(ret != ref || memcmp(dst, dst_ref, TD0_TEST_DST + TD0_TEST_GUARD))
+        {
+            if(errors < 10)
+                printf("td0_rle_fuzz: test:%ld type:%d max:%d result:%d expected:%d\n",
+                    i, (int) src[2], max, ret, ref);
+            ++errors;
+        }
+    }
+
+    free(src);
+    free(dst);
+    free(dst_ref);
+    return(errors);
+}
+
+/// @brief Time td0_rle and td0_rle_ref on one data block
+/// @param[in] src: data block
+/// @param[in] max: expanded size
+/// @param[in] name: block description
+/// @return void
+void td0_rle_bench(uint8_t *src, int max, char *name)
+{
+    int i;
+    int loops = 20000;
+    double ref_time, new_time;
+    struct timespec start, end;
+    uint8_t *dst = calloc(max,1);
+
+    if(!dst)
+        return;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for(i=0;i<loops;++i)
+        td0_rle_sink += td0_rle_ref(dst, src, max);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    ref_time = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for(i=0;i<loops;++i)
+        td0_rle_sink += td0_rle(dst, src, max);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    new_time = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+
+    printf("td0_rle %-20s reference:%8.1f MB/s new:%8.1f MB/s\n",
+        name,
+        ref_time > 0 ? (double) max * loops / ref_time / 1e6 : 0.0,
+        new_time > 0 ? (double) max * loops / new_time / 1e6 : 0.0);
+    free(dst);
+}
+
+/// @brief Reference LZSS tree rebuild - the original insertion sort version
+/// Kept verbatim from lzss_update() in teledisk/td0_lzss.c
+/// @return void
+void lzss_rebuild_ref()
+{
+    unsigned short i, j, k, f, l;
+
+    // Halve cumulative freq for leaf nodes
+    for(i = j = 0; i < TSIZE; ++i) {
+        if(son[i] >= TSIZE) {
+            freq[j] = (freq[i] + 1) / 2;
+            son[j] = son[i];
+            ++j; } }
+
+    // make a tree - first connect children nodes
+    for(i = 0, j = N_CHAR; j < TSIZE; i += 2, ++j) {
+        k = i + 1;
+        f = freq[j] = freq[i] + freq[k];
+        for(k = j - 1; f < freq[k]; --k);
+        ++k;
+        l = (j - k) * sizeof(unsigned short);
+
+        memmove(&freq[k+1], &freq[k], l);
+        freq[k] = f;
+        memmove(&son[k+1], &son[k], l);
+        son[k] = i; }
+
+    // Connect parent nodes
+    for(i = 0 ; i < TSIZE ; ++i)
+        if((k = son[i]) >= TSIZE)
+            parent[k] = i;
+        else
+            parent[k] = parent[k+1] = i;
+}
+
+/// @brief Compare lzss_rebuild against lzss_rebuild_ref
+/// Drives the adaptive Huffman tree with skewed random codes and checks
+/// that both rebuilds give the same tree from each state
+/// @param[in] count: number of tree states to compare
+/// @param[in] seed: random seed
+/// @return number of mismatches
+long lzss_rebuild_test(long count, unsigned int seed)
+{
+    long i;
+    int n;
+    long errors = 0;
+    static unsigned short f[TSIZE+1], s[TSIZE], p[TSIZE+N_CHAR];
+    static unsigned short rf[TSIZE+1], rs[TSIZE], rp[TSIZE+N_CHAR];
+
+    srand(seed);
+    init_huffman();
+    for(i=0;i<count;++i)
+    {
+        // Mostly a few codes so frequencies climb, some uniform noise
+        for(n = rand() % 2000; n > 0; --n)
+            lzss_update((rand() & 3) ? rand() % 8 : rand() % N_CHAR);
+
+        memcpy(f, freq, sizeof(f));
+        memcpy(s, son, sizeof(s));
+        memcpy(p, parent, sizeof(p));
+
+        lzss_rebuild_ref();
+        memcpy(rf, freq, sizeof(rf));
+        memcpy(rs, son, sizeof(rs));
+        memcpy(rp, parent, sizeof(rp));
+
+        memcpy(freq, f, sizeof(f));
+        memcpy(son, s, sizeof(s));
+        memcpy(parent, p, sizeof(p));
+        lzss_rebuild();
+
+        if(memcmp(rf, freq, sizeof(rf)) || memcmp(rs, son, sizeof(rs)) ||
+            memcmp(rp, parent, sizeof(rp)))
+        {
+            if(errors < 10)
+                printf("lzss_rebuild_test: state:%ld tree mismatch\n", i);
+            ++errors;
+        }
+    }
+    return(errors);
+}
+
+/// @brief LZSS decode benchmark on a large synthetic image
+/// Sector sized runs of blank, patterned, text and random data like a
+/// LIF disk, compressed with lzss_compress() and decoded with lzss_getbyte()
+/// @param[in] size: synthetic image size in bytes
+/// @param[in] seed: random seed
+/// @return 1 if the decoded data matches, 0 on error
+int lzss_bench(long size, unsigned int seed)
+{
+    int c;
+    long i, j, len;
+    long compressed, decoded = 0;
+    int kind;
+    double seconds;
+    uint8_t *data;
+    FILE *fp;
+    struct timespec start;
+
+    data = malloc(size);
+    fp = tmpfile();
+    if(!data || !fp)
+    {
+        printf("lzss_bench: can not allocate %ld bytes\n", size);
+        if(data) free(data);
+        if(fp) fclose(fp);
+        return(0);
+    }
+
+    srand(seed);
+    for(i=0;i<size;)
+    {
+        kind = rand() % 8;
+        len = 256 * (1 + rand() % 16);
+        for(j=0;j<len && i<size;++j,++i)
+        {
+            if(kind < 4)
+                data[i] = 0xff;
+            else if(kind < 6)
+                data[i] = (j * 7) & 0x3f;
+            else if(kind == 6)
+                data[i] = "10 PRINT \"HP85\"\r\n"[j % 16];
+            else
+                data[i] = rand();
+        }
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    compressed = lzss_compress(fp, data, size);
+    seconds = td0_elapsed(&start);
+    printf("lzss compress:  %ld bytes to %ld bytes, %.1f%%, %.2f MB/s\n",
+        size, compressed, 100.0 * compressed / size,
+        seconds > 0 ? size / seconds / 1e6 : 0.0);
+
+    rewind(fp);
+    init_decompress();
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    while(decoded < size && (c = lzss_getbyte(fp)) != EOF)
+    {
+        if(c != data[decoded])
+            break;
+        ++decoded;
+    }
+    seconds = td0_elapsed(&start);
+    printf("lzss decode:    %ld bytes, %.2f MB/s\n",
+        decoded, seconds > 0 ? decoded / seconds / 1e6 : 0.0);
+
+    if(decoded != size)
+        printf("lzss decode: mismatch at offset %ld\n", decoded);
+
+    fclose(fp);
+    free(data);
+    return(decoded == size);
+}
+
+/// @brief TeleDisk decoder tests
+/// @param[in] argc: argument count
+/// @param[in] argv: count and seed
+/// @return 0 on success, 1 on mismatch
+int td0_tests(int argc, char *argv[])
+{
+    long count = 20000;
+    unsigned int seed = 1;
+    long megabytes = 4;
+    long errors, tree_errors;
+    uint8_t block[16];
+
+    if(argc > 0 && argv[0])
+        count = strtol(argv[0],NULL,0);
+    if(argc > 1 && argv[1])
+        seed = strtoul(argv[1],NULL,0);
+    if(argc > 2 && argv[2])
+        megabytes = strtol(argv[2],NULL,0);
+
+    errors = td0_rle_fuzz(count, seed);
+    printf("td0_rle fuzz: %ld tests, seed:%u, %ld mismatches\n", count, seed, errors);
+
+    // Typical blank and patterned 256 byte sectors
+    V2B_LSB(block,0,2,6);
+    V2B_LSB(block,2,1,1);
+    V2B_LSB(block,3,2,128);
+    block[5] = 0xff; block[6] = 0xff;
+    td0_rle_bench(block, 256, "type 1 FFFF");
+    block[5] = 0x12; block[6] = 0x34;
+    td0_rle_bench(block, 256, "type 1 1234");
+
+    V2B_LSB(block,0,2,7);
+    V2B_LSB(block,2,1,2);
+    block[3] = 2; block[4] = 64;
+    block[5] = 1; block[6] = 2; block[7] = 3; block[8] = 4;
+    td0_rle_bench(block, 256, "type 2 4x64");
+
+    tree_errors = lzss_rebuild_test(count / 100 + 1, seed);
+    printf("lzss_rebuild: %ld tree states, %ld mismatches\n", count / 100 + 1, tree_errors);
+    errors += tree_errors;
+
+    if(megabytes > 0 && !lzss_bench(megabytes * 1024 * 1024, seed))
+        ++errors;
+
+    return(errors ? 1 : 0);
+}
@@ -0,0 +1,31 @@
+/**
+  @file   td0_tests.h
+  @brief  TeleDisk decoder tests
+  @par Copyright &copy; 2014-2020 Mike Gore, Inc. All rights reserved. GPL
+  @see http://github.com/magore/hp85disk
+  @see http://github.com/magore/hp85disk/COPYRIGHT.md for Copyright details
+
+  @par Edit History
+  - [1.0]   [Mike Gore]  Initial revision of file.
+*/
+
+#ifndef _TD0_TESTS_H_
+#define _TD0_TESTS_H_
+
+///@brief largest random TeleDisk data block
+#define TD0_TEST_SRC    (16384+3)
+///@brief largest expanded sector
+#define TD0_TEST_DST    8192
+
+/* td0_tests.c */
+int td0_rle_ref ( uint8_t *dst , uint8_t *src , int max );
+void td0_test_quiet ( int quiet );
+void td0_test_block ( uint8_t *src );
+long td0_rle_fuzz ( long count , unsigned int seed );
+void td0_rle_bench ( uint8_t *src , int max , char *name );
+void lzss_rebuild_ref ( void );
+long lzss_rebuild_test ( long count , unsigned int seed );
+int lzss_bench ( long size , unsigned int seed );
+int td0_tests ( int argc , char *argv []);
+
+#endif
@@ -32,17 +32,6 @@
 
 #include "td0_lzss.h"
 
-// LZSS parameters
-#define SBSIZE		4096				// Size of Ring buffer
-#define LASIZE		60					// Size of Look-ahead buffer
-#define THRESHOLD	2					// Minimum match for compress
-
-// Huffman coding parameters
-#define N_CHAR	(256-THRESHOLD+LASIZE)	// Character code (= 0..N_CHAR-1)
-#define TSIZE		(N_CHAR*2-1)		// Size of table
-#define ROOT		(TSIZE-1)			// Root position
-#define MAX_FREQ	0x8000				// Update when cumulative frequency reaches this value
-
 unsigned short
 	parent[TSIZE+N_CHAR],	// parent nodes (0..T-1) and leaf positions (rest)
 	son[TSIZE],				// pointers to child nodes (son[], son[]+1)
@@ -84,12 +73,32 @@ const unsigned char d_code_lzss[256] = {		// Huffman decoder tables
 const unsigned char d_len_lzss[] = { 2, 2, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 6, 6, 6, 7 };
 
 /*
- * Initialise the decompressor trees and state variables
+ * Initialise the adaptive Huffman tree shared by the encoder and decoder
  */
-void init_decompress( )
+void init_huffman( )
 {
 	unsigned short i, j;
 
+	for(i = j = 0; i < N_CHAR; ++i) {		// Walk up
+		freq[i] = 1;
+		son[i] = i + TSIZE;
+		parent[i+TSIZE] = i; }
+
+	while(i <= ROOT) {						// Back down
+		freq[i] = freq[j] + freq[j+1];
+		son[i] = j;
+		parent[j] = parent[j+1] = i++;
+		j += 2; }
+
+	freq[TSIZE] = 0xFFFF;
+	parent[ROOT] = 0;
+}
+
+/*
+ * Initialise the decompressor trees and state variables
+ */
+void init_decompress( )
+{
 	memset(&parent,0,(TSIZE+N_CHAR)*2);
 	memset(&son,0, (TSIZE)*2);
 	memset(&freq,0,(TSIZE+1)*2);
@@ -105,58 +114,65 @@ void init_decompress( )
 	Eof=0;
 	memset(&ring_buff,0,SBSIZE+LASIZE-1);
 
-
-	for(i = j = 0; i < N_CHAR; ++i) {		// Walk up
-		freq[i] = 1;
-		son[i] = i + TSIZE;
-		parent[i+TSIZE] = i; }
-
-	while(i <= ROOT) {						// Back down
-		freq[i] = freq[j] + freq[j+1];
-		son[i] = j;
-		parent[j] = parent[j+1] = i++;
-		j += 2; }
+	init_huffman();
 
 	memset(ring_buff, ' ',(SBSIZE+LASIZE-1));
-	freq[TSIZE] = 0xFFFF;
-	parent[ROOT] = Bitbuff = Bits = 0;
+	Bitbuff = Bits = 0;
 	GBr = SBSIZE - LASIZE;
 }
 
+/*
+ * Rebuild the tree with halved leaf frequencies
+ *
+ * The leaves are already in frequency order and the new internal nodes
+ * (sums of node pairs 0+1, 2+3, ...) are created in frequency order, so
+ * the tree is a merge of the two lists. On equal frequencies the leaf
+ * goes first - the same tree the original insertion sort built.
+ */
+void lzss_rebuild( )
+{
+	static unsigned short
+		lfreq[N_CHAR], lcode[N_CHAR],	// halved leaves in tree order
+		ifreq[N_CHAR];					// internal node frequencies
+	unsigned short i, j, k, n, m;
+
+	// Halve cumulative freq for leaf nodes
+	for(i = j = 0; i < TSIZE; ++i) {
+		if(son[i] >= TSIZE) {
+			lfreq[j] = (freq[i] + 1) / 2;
+			lcode[j] = son[i];
+			++j; } }
+
+	// Merge leaves and internal nodes - internal node m joins nodes 2m
+	// and 2m+1 so it can be created once they have been placed
+	for(i = j = n = m = 0; i < TSIZE; ++i) {
+		while(n < N_CHAR-1 && 2*n+1 < i) {
+			ifreq[n] = freq[2*n] + freq[2*n+1];
+			++n; }
+		if(j < N_CHAR && (m == n || lfreq[j] <= ifreq[m])) {
+			freq[i] = lfreq[j];
+			son[i] = lcode[j++]; }
+		else {
+			freq[i] = ifreq[m];
+			son[i] = 2*m++; } }
+
+	// Connect parent nodes
+	for(i = 0 ; i < TSIZE ; ++i)
+		if((k = son[i]) >= TSIZE)
+			parent[k] = i;
+		else
+			parent[k] = parent[k+1] = i;
+}
+
 /*
  * Increment frequency tree entry for a given code
  */
 void lzss_update(int c)
 {
-	unsigned short i, j, k, f, l;
-
-	if(freq[ROOT] == MAX_FREQ) {		// Tree is full - rebuild
-		// Halve cumulative freq for leaf nodes
-		for(i = j = 0; i < TSIZE; ++i) {
-			if(son[i] >= TSIZE) {
-				freq[j] = (freq[i] + 1) / 2;
-				son[j] = son[i];
-				++j; } }
-
-		// make a tree - first connect children nodes
-		for(i = 0, j = N_CHAR; j < TSIZE; i += 2, ++j) {
-			k = i + 1;
-			f = freq[j] = freq[i] + freq[k];
-			for(k = j - 1; f < freq[k]; --k);
-			++k;
-			l = (j - k) * sizeof(unsigned short);
-
-			memmove(&freq[k+1], &freq[k], l);
-			freq[k] = f;
-			memmove(&son[k+1], &son[k], l);
-			son[k] = i; }
-
-		// Connect parent nodes
-		for(i = 0 ; i < TSIZE ; ++i)
-			if((k = son[i]) >= TSIZE)
-				parent[k] = i;
-			else
-				parent[k] = parent[k+1] = i; }
+	unsigned short i, j, k, l;
+
+	if(freq[ROOT] == MAX_FREQ)			// Tree is full - rebuild
+		lzss_rebuild();
 
 	c = parent[c+TSIZE];
 	do {
@@ -303,3 +319,284 @@ int lzss_getbyte(FILE *fp)
 		GBstate = 0; }			// Reset to non-string state
 }
 
+
+/*
+ * LZSS encoder - based in part on Haruhiko Okumura's LZHUF.C
+ *
+ * Produces a stream that lzss_getbyte() above decodes, using the same
+ * adaptive Huffman tree (lzss_update) and the same ring buffer parameters.
+ */
+
+#define NIL			SBSIZE				// End of tree marker
+
+short
+	lson[SBSIZE+1],			// left children of the match tree
+	rson[SBSIZE+257],		// right children (last 256 are the roots)
+	dad[SBSIZE+1];			// parents of the match tree
+
+unsigned short
+	match_position,			// Position of longest match
+	match_length,			// Length of longest match
+	PutBuff,				// left-aligned output bit buffer
+	PutLen;					// bits in output bit buffer
+
+unsigned char
+	p_len_lzss[64],			// Huffman encoder tables for the upper 6 position
+	p_code_lzss[64];		// bits - derived from d_code_lzss/d_len_lzss
+
+long
+	PutCount;				// bytes written
+
+/*
+ * Build the position encoder tables from the decoder tables
+ * The decoder reads an 8 bit value, the upper 6 position bits are
+ * d_code_lzss[] and the prefix length is d_len_lzss[] + 1 bits
+ */
+static void init_position_tables(void)
+{
+	unsigned short i, c;
+
+	for(i = 0; i < 256; ++i) {
+		c = d_code_lzss[i];
+		p_len_lzss[c] = d_len_lzss[i >> 4] + 1;
+		if(!i || c != d_code_lzss[i-1])
+			p_code_lzss[c] = i; }
+}
+
+/*
+ * Initialise the match tree
+ */
+static void init_tree(void)
+{
+	unsigned short i;
+
+	for(i = SBSIZE + 1; i <= SBSIZE + 256; ++i)
+		rson[i] = NIL;
+	for(i = 0; i < SBSIZE; ++i)
+		dad[i] = NIL;
+}
+
+/*
+ * Insert string ring_buff[r..r+LASIZE-1] into the match tree
+ * Sets match_position and match_length to the longest match found
+ */
+static void insert_node(short r)
+{
+	short i, p;
+	int cmp;
+	unsigned char *key;
+	unsigned short pos;
+
+	cmp = 1;
+	key = &ring_buff[r];
+	p = SBSIZE + 1 + key[0];
+	rson[r] = lson[r] = NIL;
+	match_length = 0;
+
+	for(;;) {
+		if(cmp >= 0) {
+			if(rson[p] != NIL)
+				p = rson[p];
+			else {
+				rson[p] = r;
+				dad[r] = p;
+				return; } }
+		else {
+			if(lson[p] != NIL)
+				p = lson[p];
+			else {
+				lson[p] = r;
+				dad[r] = p;
+				return; } }
+
+		for(i = 1; i < LASIZE; ++i)
+			if((cmp = key[i] - ring_buff[p + i]) != 0)
+				break;
+
+		if(i > THRESHOLD) {
+			pos = ((r - p) & (SBSIZE - 1)) - 1;
+			if(i > match_length) {
+				match_position = pos;
+				if((match_length = i) >= LASIZE)
+					break; }
+			else if(i == match_length && pos < match_position)
+				match_position = pos; } }
+
+	// Replace node p with r
+	dad[r] = dad[p];
+	lson[r] = lson[p];
+	rson[r] = rson[p];
+	dad[lson[p]] = r;
+	dad[rson[p]] = r;
+	if(rson[dad[p]] == p)
+		rson[dad[p]] = r;
+	else
+		lson[dad[p]] = r;
+	dad[p] = NIL;
+}
+
+/*
+ * Remove node p from the match tree
+ */
+static void delete_node(short p)
+{
+	short q;
+
+	if(dad[p] == NIL)					// Not in tree
+		return;
+
+	if(rson[p] == NIL)
+		q = lson[p];
+	else if(lson[p] == NIL)
+		q = rson[p];
+	else {
+		q = lson[p];
+		if(rson[q] != NIL) {
+			do
+				q = rson[q];
+			while(rson[q] != NIL);
+			rson[dad[q]] = lson[q];
+			dad[lson[q]] = dad[q];
+			lson[q] = lson[p];
+			dad[lson[p]] = q; }
+		rson[q] = rson[p];
+		dad[rson[p]] = q; }
+
+	dad[q] = dad[p];
+	if(rson[dad[p]] == p)
+		rson[dad[p]] = q;
+	else
+		lson[dad[p]] = q;
+	dad[p] = NIL;
+}
+
+/*
+ * Output the upper l bits of c
+ */
+static void lzss_PutCode(FILE *fp, unsigned short l, unsigned short c)
+{
+	PutBuff |= c >> PutLen;
+	if((PutLen += l) >= 8) {
+		fputc(PutBuff >> 8, fp);
+		++PutCount;
+		if((PutLen -= 8) >= 8) {
+			fputc(PutBuff & 0xff, fp);
+			++PutCount;
+			PutLen -= 8;
+			PutBuff = c << (l - PutLen); }
+		else
+			PutBuff <<= 8; }
+}
+
+/*
+ * Encode a character value by walking the tree from the leaf to the root
+ */
+static void lzss_EncodeChar(FILE *fp, unsigned short c)
+{
+	unsigned long code;
+	unsigned short len, k;
+
+	code = 0;
+	len = 0;
+	k = parent[c + TSIZE];
+
+	// travel from leaf to root
+	do {
+		code >>= 1;
+		// odd node addresses select the bigger brother node
+		if(k & 1)
+			code |= 0x80000000UL;
+		++len;
+	} while((k = parent[k]) != ROOT);
+
+	// Codes longer then 16 bits are possible in theory - send them in two parts
+	if(len > 16) {
+		lzss_PutCode(fp, 16, (unsigned short)(code >> 16));
+		lzss_PutCode(fp, len - 16, (unsigned short)code); }
+	else
+		lzss_PutCode(fp, len, (unsigned short)(code >> 16));
+
+	lzss_update(c);
+}
+
+/*
+ * Encode a string index - upper 6 bits Huffman coded, lower 6 bits direct
+ */
+static void lzss_EncodePosition(FILE *fp, unsigned short c)
+{
+	unsigned short i;
+
+	i = c >> 6;
+	lzss_PutCode(fp, p_len_lzss[i], (unsigned short)p_code_lzss[i] << 8);
+	lzss_PutCode(fp, 6, (c & 0x3f) << 10);
+}
+
+/*
+ * Compress a memory buffer to a file
+ *
+ * The output can be read back with init_decompress() and lzss_getbyte()
+ * Returns the number of bytes written
+ */
+long lzss_compress(FILE *fp, unsigned char *src, long size)
+{
+	short i, r, s, len, last_match_length;
+	long in = 0;
+
+	init_huffman();
+	init_position_tables();
+	init_tree();
+
+	PutBuff = PutLen = 0;
+	PutCount = 0;
+	match_position = match_length = 0;
+
+	s = 0;
+	r = SBSIZE - LASIZE;
+	memset(ring_buff, ' ', (SBSIZE+LASIZE-1));
+
+	for(len = 0; len < LASIZE && in < size; ++len)
+		ring_buff[r + len] = src[in++];
+
+	if(!len)
+		return(0);
+
+	for(i = 1; i <= LASIZE; ++i)
+		insert_node(r - i);
+	insert_node(r);
+
+	do {
+		if(match_length > len)
+			match_length = len;
+		if(match_length <= THRESHOLD) {
+			match_length = 1;
+			lzss_EncodeChar(fp, ring_buff[r]); }
+		else {
+			lzss_EncodeChar(fp, 255 - THRESHOLD + match_length);
+			lzss_EncodePosition(fp, match_position); }
+
+		last_match_length = match_length;
+		for(i = 0; i < last_match_length && in < size; ++i) {
+			delete_node(s);
+			ring_buff[s] = src[in++];
+			if(s < LASIZE - 1)
+				ring_buff[s + SBSIZE] = ring_buff[s];
+			s = (s + 1) & (SBSIZE - 1);
+			r = (r + 1) & (SBSIZE - 1);
+			insert_node(r); }
+
+		while(i++ < last_match_length) {
+			delete_node(s);
+			s = (s + 1) & (SBSIZE - 1);
+			r = (r + 1) & (SBSIZE - 1);
+			if(--len)
+				insert_node(r); }
+
+	} while(len > 0);
+
+	// Flush remaining bits
+	if(PutLen) {
+		fputc(PutBuff >> 8, fp);
+		++PutCount; }
+
+	return(PutCount);
+}
@@ -1,6 +1,19 @@
 
+// LZSS parameters
+#define SBSIZE		4096				// Size of Ring buffer
+#define LASIZE		60					// Size of Look-ahead buffer
+#define THRESHOLD	2					// Minimum match for compress
+
+// Huffman coding parameters
+#define N_CHAR	(256-THRESHOLD+LASIZE)	// Character code (= 0..N_CHAR-1)
+#define TSIZE		(N_CHAR*2-1)		// Size of table
+#define ROOT		(TSIZE-1)			// Root position
+#define MAX_FREQ	0x8000				// Update when cumulative frequency reaches this value
+
 /* td0_lzss.c */
+void init_huffman ( void );
 void init_decompress ( void );
+void lzss_rebuild ( void );
 void lzss_update ( int c );
 unsigned short lzss_GetChar ( FILE *fp );
 unsigned short GetBit ( FILE *fp );
@@ -8,6 +21,7 @@ unsigned short lzss_GetByte ( FILE *fp );
 unsigned short lzss_DecodeChar ( FILE *fp );
 unsigned short lzss_DecodePosition ( FILE *fp );
 int lzss_getbyte ( FILE *fp );
+long lzss_compress ( FILE *fp , unsigned char *src , long size );
 
 
 
@@ -14,9 +14,11 @@
 #include <user_config.h>
 
 
+#ifndef GPIB_VBUS
 #ifndef _IOM1284P_H_
 #error _IOM1284P_H_
 #endif
+#endif
 
 #include "gpib/defines.h"
 #include "gpib/gpib_hal.h"
@@ -90,11 +92,13 @@ void delay_tests()
     clock_elapsed_end("delayms(1100)");
 }
 
+#ifndef GPIB_VBUS
 #ifdef OPTIBOOT
 void(*RESET) (void) = (0x10000-0x400);
 #else
 void(*RESET) (void) = 0;
 #endif
+#endif
 
 
 /// @brief  Display the main help menu - calls all other help menus
@@ -188,12 +192,17 @@ void task(uint8_t gpib)
     }
     else if ( MATCHARGS(ptr,"reset",(ind+0),argc))
     {
+#ifdef GPIB_VBUS
+		///@brief The host build exits
+		host_quit(0);
+#else
 		cli();	
 		uart_rx_flush(0);
 		cli();	
 		MCUSR = (1 << EXTRF);
         RESET();
 		// should not return!
+#endif
         result = 1;
     }
     else if ( MATCHARGS(ptr,"setdate",(ind+0),argc))
@@ -245,11 +254,21 @@ void task(uint8_t gpib)
 
 /// @brief  main() for gpib project
 /// @return  should never return!
+#ifdef GPIB_VBUS
+int main(int argc, char *argv[])
+#else
 int main(void)
+#endif
 {
     ts_t ts;
     uint32_t actual,baud;
 
+#ifdef GPIB_VBUS
+    ///@brief Open the virtual GPIB bus and the disk image - see host/host_init.c
+    if(host_init(argc, argv) < 0)
+        return(1);
+#endif
+
     ///@ initialize bus state as soon as practical
     gpib_bus_init();
 
@@ -285,6 +304,7 @@ int main(void)
     delayms(200); ///@brief Power up delay
 
 
+#ifndef GPIB_VBUS
     ///@ initialize SPI bus 
     printf("initializing SPI bus\n");
     spi_init(MMC_SLOW,GPIO_B3);
@@ -293,6 +313,7 @@ int main(void)
     printf("initializing I2C bus\n");
     TWI_Init(TWI_BIT_PRESCALE_4, TWI_BITLENGTH_FROM_FREQ(4, 100000));
     sep();
+#endif
 
     printf("initializing RTC\n");
     ///@ initialize clock by RTC if we have it
@@ -365,6 +386,13 @@ int main(void)
     ///@brief Format any drives that do not yet exist
     format_drives();
 
+    ///@brief Write committed SS80 journal transactions to their images
+    replay_drives();
+
+    ///@brief Measure disk throughput, SS80_TUNE = 1 also rewrites describe
+    sep();
+    tune_drives(ss80_tune);
+
     ///@brief Display Address Summary
     sep();
     display_Addresses();
@@ -386,9 +414,20 @@ int main(void)
     sep();
     printf("Starting GPIB TASK\n");
 
+#ifdef GPIB_VBUS
+    ///@brief Start the optional virtual bus controller self test
+    host_run(host_bench);
+
+    while (!host_quit_requested())
+    {
+        task(1);
+    }
+    return( host_exit_code() );
+#else
     ///@brief Keep the task running - it exits after every user interaction, ie key press
     while (1)
     {
         task(1);
     }
+#endif
 }